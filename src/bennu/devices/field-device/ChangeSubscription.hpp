@@ -0,0 +1,117 @@
+#ifndef BENNU_FIELDDEVICE_CHANGESUBSCRIPTION_HPP
+#define BENNU_FIELDDEVICE_CHANGESUBSCRIPTION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bennu {
+namespace field_device {
+
+/*
+ * Set of tags a comms module wants to be told about (see
+ * DataManager::subscribe). Writers mark a subscribed tag dirty whenever its
+ * value changes; the subscriber waits for changes and collects the indices
+ * (into the tag list it subscribed with) of everything that changed since it
+ * last looked. A tag that changes several times in between is reported once.
+ */
+class ChangeSubscription
+{
+public:
+    explicit ChangeSubscription(const std::size_t count) :
+        mCount(count),
+        mWords((count + 63) / 64),
+        mDirty(new std::atomic<std::uint64_t>[mWords]),
+        mPending(false),
+        mReady(false)
+    {
+        for (std::size_t i = 0; i < mWords; ++i)
+        {
+            mDirty[i].store(0, std::memory_order_relaxed);
+        }
+        // report the initial value of everything
+        markAll();
+        signal();
+    }
+
+    std::size_t size() const
+    {
+        return mCount;
+    }
+
+    // Block until a subscribed tag changes or the timeout expires. Returns true if anything changed.
+    template<typename Rep, typename Period>
+    bool wait(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        bool ready = mCondition.wait_for(lock, timeout, [this]{ return mReady; });
+        mReady = false;
+        return ready;
+    }
+
+    // Indices of the tags that changed since the last call, in ascending order
+    void getChanged(std::vector<std::size_t>& changed)
+    {
+        changed.clear();
+        for (std::size_t w = 0; w < mWords; ++w)
+        {
+            std::uint64_t bits = mDirty[w].exchange(0, std::memory_order_acquire);
+            while (bits)
+            {
+                int bit = __builtin_ctzll(bits);
+                changed.push_back(w * 64 + bit);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    // Mark a tag dirty (writer side); subscribers are woken by signal()
+    void mark(const std::size_t index)
+    {
+        mDirty[index / 64].fetch_or(std::uint64_t(1) << (index % 64), std::memory_order_release);
+        mPending.store(true, std::memory_order_release);
+    }
+
+    // Mark every tag dirty, e.g. so a newly connected client gets the full state
+    void markAll()
+    {
+        for (std::size_t i = 0; i < mCount; i += 64)
+        {
+            std::size_t n = std::min<std::size_t>(64, mCount - i);
+            mDirty[i / 64].fetch_or(n == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1, std::memory_order_release);
+        }
+        mPending.store(true, std::memory_order_release);
+    }
+
+    // Wake the subscriber if anything was marked since the last signal
+    void signal()
+    {
+        if (mPending.exchange(false, std::memory_order_acq_rel))
+        {
+            {
+                std::scoped_lock<std::mutex> lock(mMutex);
+                mReady = true;
+            }
+            mCondition.notify_all();
+        }
+    }
+
+private:
+    std::size_t mCount;
+    std::size_t mWords;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> mDirty; // one bit per subscribed tag
+    std::atomic<bool> mPending;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mReady;
+};
+
+} // namespace field_device
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_CHANGESUBSCRIPTION_HPP
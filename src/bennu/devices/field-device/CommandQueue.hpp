@@ -0,0 +1,155 @@
+#ifndef BENNU_FIELDDEVICE_COMMANDQUEUE_HPP
+#define BENNU_FIELDDEVICE_COMMANDQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace bennu {
+namespace field_device {
+
+/*
+ * Bounded lock-free multi-producer/single-consumer queue (a ring of cells
+ * with per-cell sequence numbers). Any number of protocol threads can push
+ * commands while the scan thread pops them; nobody ever blocks. When the ring
+ * is full, push fails and the overflow counter is bumped.
+ */
+template<typename T>
+class CommandQueue
+{
+public:
+    // Capacity is rounded up to a power of two
+    explicit CommandQueue(std::size_t capacity) :
+        mCapacity(roundUp(capacity)),
+        mMask(mCapacity - 1),
+        mBuffer(new Cell[mCapacity]),
+        mEnqueuePos(0),
+        mDequeuePos(0),
+        mOverflows(0),
+        mHighWater(0)
+    {
+        for (std::size_t i = 0; i < mCapacity; ++i)
+        {
+            mBuffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    // Safe to call from any thread. 'value' is only moved from if the push succeeds.
+    bool push(T&& value)
+    {
+        Cell* cell;
+        std::size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &mBuffer[pos & mMask];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                mOverflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        // the consumer may already be past this cell
+        std::size_t deq = mDequeuePos.load(std::memory_order_relaxed);
+        std::size_t depth = pos + 1 > deq ? pos + 1 - deq : 0;
+        std::size_t high = mHighWater.load(std::memory_order_relaxed);
+        while (depth > high && !mHighWater.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {}
+        return true;
+    }
+
+    // Consumer thread only
+    bool pop(T& value)
+    {
+        std::size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = &mBuffer[pos & mMask];
+        std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1) < 0)
+        {
+            return false;
+        }
+        value = std::move(cell->data);
+        cell->sequence.store(pos + mCapacity, std::memory_order_release);
+        mDequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return depth() == 0;
+    }
+
+    // Approximate while producers are active
+    std::size_t depth() const
+    {
+        std::size_t enq = mEnqueuePos.load(std::memory_order_relaxed);
+        std::size_t deq = mDequeuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    std::size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+    // Number of pushes rejected because the queue was full
+    std::uint64_t overflows() const
+    {
+        return mOverflows.load(std::memory_order_relaxed);
+    }
+
+    // Deepest the queue has been
+    std::size_t highWater() const
+    {
+        return mHighWater.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    static std::size_t roundUp(std::size_t n)
+    {
+        std::size_t p = 2;
+        while (p < n)
+        {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const std::size_t mCapacity;
+    const std::size_t mMask;
+    std::unique_ptr<Cell[]> mBuffer;
+    alignas(64) std::atomic<std::size_t> mEnqueuePos;
+    alignas(64) std::atomic<std::size_t> mDequeuePos;
+    alignas(64) std::atomic<std::uint64_t> mOverflows;
+    std::atomic<std::size_t> mHighWater;
+};
+
+} // namespace field_device
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_COMMANDQUEUE_HPP
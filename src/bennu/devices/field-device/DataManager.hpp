@@ -2,29 +2,62 @@
 #define BENNU_FIELDDEVICE_DATAMANAGER_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex> // std::scoped_lock
 #include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "bennu/devices/field-device/ChangeSubscription.hpp"
+#include "bennu/devices/field-device/CommandQueue.hpp"
 #include "bennu/devices/field-device/DataStore.hpp"
+#include "bennu/devices/field-device/LatencyTrace.hpp"
 
 namespace bennu {
 namespace field_device {
 
+/*
+ * Pre-resolved reference to a tag. Internal tags live in the internal store,
+ * external tags point straight at the i/o point backing them.
+ */
+struct TagHandle
+{
+    PointHandle point{INVALID_HANDLE};
+    bool external{false};
+
+    bool valid() const
+    {
+        return point != INVALID_HANDLE;
+    }
+};
+
 class DataManager
 {
 public:
+    // (point handle, value) updates published to the external store in one go
+    typedef DataStore<std::string>::Batch PointBatch;
+
+    // (tag handle, value) updates, e.g. values polled by a comms client
+    typedef std::vector<std::pair<TagHandle, DataStore<std::string>::Value>> TagBatch;
+
     DataManager() :
         mInternalData(new DataStore<std::string>), // tags
         mExternalData(new DataStore<std::string>) // i/o points
     {
+        mInternalData->setChangeHandler([this](const std::vector<PointHandle>& changed) { notifyChanges(false, changed); });
+        mExternalData->setChangeHandler([this](const std::vector<PointHandle>& changed) { notifyChanges(true, changed); });
     }
 
     ~DataManager() = default;
 
+    DataManager(const DataManager&) = delete;
+    DataManager& operator=(const DataManager&) = delete;
+
     // add Binary/Analog data point from Input/Output modules
     template<typename T>
     void addExternalData(const std::string& id, const std::string& point)
@@ -37,7 +70,83 @@ public:
     template<typename T>
     void addInternalData(const std::string& tag, const T& value)
     {
-        mInternalData->addData(tag, value);
+        TagHandle handle;
+        handle.point = mInternalData->addData(tag, value);
+        handle.external = false;
+        // an external mapping for the same tag name takes precedence
+        mTagHandles.emplace(tag, handle);
+    }
+
+    // Resolve a tag once (at config time) so it can be read/written without any string lookups
+    TagHandle getTagHandle(const std::string& tag) const
+    {
+        auto iter = mTagHandles.find(tag);
+        if (iter != mTagHandles.end())
+        {
+            return iter->second;
+        }
+        return TagHandle();
+    }
+
+    PointHandle getPointHandle(const std::string& point) const
+    {
+        return mExternalData->getHandle(point);
+    }
+
+    template<typename T>
+    T getData(const TagHandle& handle) const
+    {
+        return handle.external ? mExternalData->getData<T>(handle.point) : mInternalData->getData<T>(handle.point);
+    }
+
+    // Run 'fn' so that every value it reads with getData comes from one published
+    // state of the data (it may run more than once, so it should only read)
+    template<typename F>
+    void readSnapshot(F&& fn) const
+    {
+        mExternalData->readSnapshot([&]() { mInternalData->readSnapshot(fn); });
+    }
+
+    double getTimestamp(const TagHandle& handle) const
+    {
+        return handle.external ? mExternalData->getTimestamp(handle.point) : mInternalData->getTimestamp(handle.point);
+    }
+
+    template<typename T>
+    bool setData(const TagHandle& handle, const T& value) const
+    {
+        return handle.external ? mExternalData->setData<T>(handle.point, value) : false;
+    }
+
+    bool hasData(const TagHandle& handle) const
+    {
+        return handle.external ? mExternalData->hasData(handle.point) : mInternalData->hasData(handle.point);
+    }
+
+    /*
+     * Subscribe to value changes of the given tags (typically every tag a
+     * comms module serves). The subscription reports changes as indices into
+     * 'tags', and starts out with every tag marked changed.
+     */
+    std::shared_ptr<ChangeSubscription> subscribe(const std::vector<TagHandle>& tags)
+    {
+        auto subscription = std::make_shared<ChangeSubscription>(tags.size());
+        std::scoped_lock<std::shared_mutex> lock(mWatchMutex);
+        for (std::size_t i = 0; i < tags.size(); ++i)
+        {
+            if (!tags[i].valid())
+            {
+                continue;
+            }
+            auto& watchers = tags[i].external ? mExternalWatchers : mInternalWatchers;
+            if (watchers.size() <= tags[i].point)
+            {
+                watchers.resize(tags[i].point + 1);
+            }
+            watchers[tags[i].point].push_back({subscription.get(), i});
+        }
+        mSubscriptions.push_back(subscription);
+        return subscription;
     }
 
     bool getPointByTag(const std::string& tag, std::string& point) const
@@ -58,65 +167,113 @@ public:
     template<typename T>
     T getDataByTag(const std::string& tag) const
     {
-        auto iter = mTagToPoint.find(tag);
-        if (iter != mTagToPoint.end())
+        return getData<T>(getTagHandle(tag));
+    }
+
+    double getTimestampByTag(const std::string& tag) const
+    {
+        return getTimestamp(getTagHandle(tag));
+    }
+
+    template<typename T>
+    bool setDataByTag(const std::string& tag, const T& value) const
+    {
+        return setData<T>(getTagHandle(tag), value);
+    }
+
+    template<typename T>
+    bool setDataByPoint(const std::string& point, const T& value) const
+    {
+        return setDataByPoint<T>(mExternalData->getHandle(point), value);
+    }
+
+    template<typename T>
+    bool setDataByPoint(const PointHandle point, const T& value, const double source = 0) const
+    {
+        double ts = source > 0 ? source : LatencyTrace::now();
+        return mExternalData->setData<T>(point, value, ts);
+    }
+
+    // Publish a whole frame of i/o point updates as one version of the external store.
+    // 'source' is when the provider published them (seconds since the epoch), if known;
+    // it becomes the points' timestamp.
+    void setDataByPoints(const PointBatch& batch, const double source = 0) const
+    {
+        double ts = source > 0 ? source : LatencyTrace::now();
+        mExternalData->setData(batch, ts);
+        if (mTrace)
         {
-            auto pointIter = mExternalPoints.find(iter->second);
-            if (pointIter != mExternalPoints.end())
+            mTrace->record(LatencyTrace::eReceive, source);
+            if (source > 0)
             {
-                return mExternalData->getData<T>(pointIter->second);
+                // frames without a publish time must not hide the last one that had it
+                mLatestSource.store(source, std::memory_order_relaxed);
             }
         }
-        else
+    }
+
+    // Publish tag values as one update of each store they live in, stamped 'ts'
+    // (seconds since the epoch)
+    void setDataByTags(const TagBatch& batch, const double ts) const
+    {
+        PointBatch internal, external;
+        for (const auto& t : batch)
         {
-            return mInternalData->getData<T>(tag);
+            (t.first.external ? external : internal).emplace_back(t.first.point, t.second);
+        }
+        if (!internal.empty())
+        {
+            mInternalData->setData(internal, ts);
+        }
+        if (!external.empty())
+        {
+            mExternalData->setData(external, ts);
         }
-        return T();
     }
 
-    double getTimestampByTag(const std::string& tag) const
+    // Start recording LatencyTrace histograms (off by default)
+    void enableTrace()
     {
-        auto iter = mTagToPoint.find(tag);
-        if (iter != mTagToPoint.end())
+        if (!mTrace)
         {
-            auto pointIter = mExternalPoints.find(iter->second);
-            if (pointIter != mExternalPoints.end())
-            {
-                return mExternalData->getTimestamp(pointIter->second);
-            }
+            mTrace.reset(new LatencyTrace);
         }
+    }
 
-        return 0;
+    // nullptr unless tracing is enabled
+    const LatencyTrace* getTrace() const
+    {
+        return mTrace.get();
     }
 
-    template<typename T>
-    bool setDataByTag(const std::string& tag, const T& value) const
+    // Scan thread, at the start of a cycle
+    void traceScan() const
     {
-        auto iter = mTagToPoint.find(tag);
-        if (iter != mTagToPoint.end())
+        if (mTrace)
         {
-            auto pointIter = mExternalPoints.find(iter->second);
-            if (pointIter != mExternalPoints.end())
-            {
-                return mExternalData->setData<T>(pointIter->second, value);
-            }
-            return false;
+            mTrace->record(LatencyTrace::eScan, mLatestSource.load(std::memory_order_relaxed));
         }
-        return false;
     }
 
-    template<typename T>
-    bool setDataByPoint(const std::string& point, const T& value) const
+    // Protocol servers, for every point value handed to a master
+    void traceRead(const TagHandle& handle) const
     {
-        double ts = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
-        return mExternalData->setData<T>(point, value, ts);
+        if (mTrace && handle.external)
+        {
+            mTrace->record(LatencyTrace::eProtocol, mExternalData->getTimestamp(handle.point));
+        }
     }
 
-    bool addTagToPointMapping(const std::string& tag, const std::string& point)
+    bool addTagToPointMapping(const std::string& tag, const std::string& id)
     {
-        if (mExternalPoints.find(point) != mExternalPoints.end())
+        auto iter = mExternalPoints.find(id);
+        if (iter != mExternalPoints.end())
         {
-            mTagToPoint[tag] = point;
+            mTagToPoint[tag] = id;
+            TagHandle handle;
+            handle.point = mExternalData->getHandle(iter->second);
+            handle.external = true;
+            mTagHandles[tag] = handle;
             return true;
         }
         return false;
@@ -124,17 +281,7 @@ public:
 
     bool hasTag(const std::string& tag) const
     {
-        auto iter = mTagToPoint.find(tag);
-        if (iter != mTagToPoint.end())
-        {
-            auto extIter = mExternalPoints.find(iter->second);
-            if (extIter != mExternalPoints.end())
-            {
-                return mExternalData->hasData(extIter->second);
-            }
-            return false;
-        }
-        return (mInternalData->hasData(tag));
+        return hasData(getTagHandle(tag));
     }
 
     bool hasPoint(const std::string& point) const
@@ -162,16 +309,19 @@ public:
         mAnalogTags.push_back(tag);
     }
 
-    void addUpdatedBinaryTag(const std::string& tag, bool status)
+    /*
+     * Tag writes from protocol threads (and logic) are queued as commands and
+     * applied by the scan thread. Returns false if the command queue is full
+     * and the write was dropped.
+     */
+    bool addUpdatedBinaryTag(const std::string& tag, bool status)
     {
-        std::scoped_lock<std::shared_mutex> lock(mBinaryMutex);
-        mUpdatedBinaryTags[tag] = status;
+        return queueCommand(TagCommand{tag, true, status, 0});
     }
 
-    void addUpdatedAnalogTag(const std::string& tag, double value)
+    bool addUpdatedAnalogTag(const std::string& tag, double value)
     {
-        std::scoped_lock<std::shared_mutex> lock(mAnalogMutex);
-        mUpdatedAnalogTags[tag] = value;
+        return queueCommand(TagCommand{tag, false, false, value});
     }
 
     const std::vector<std::string>& getBinaryTags() const
@@ -184,63 +334,85 @@ public:
         return mAnalogTags;
     }
 
-    const std::map<std::string, bool>& getUpdatedBinaryTags() const
+    /*
+     * The remaining updated-tag functions are for the scan thread only. They
+     * drain the command queue into this scan's updates, coalescing several
+     * writes to the same tag into its latest value (kept at the position of
+     * the first write, so tags are applied in the order they were first
+     * written this scan).
+     */
+    const std::vector<std::pair<std::string, bool>>& getUpdatedBinaryTags()
     {
+        drainCommands();
         return mUpdatedBinaryTags;
     }
 
-    const std::map<std::string, double>& getUpdatedAnalogTags() const
+    const std::vector<std::pair<std::string, double>>& getUpdatedAnalogTags()
     {
+        drainCommands();
         return mUpdatedAnalogTags;
     }
 
     bool isUpdatedBinaryTag(const std::string& tag)
     {
-        std::scoped_lock<std::shared_mutex> lock(mBinaryMutex);
-        return mUpdatedBinaryTags.count(tag);
+        drainCommands();
+        return mUpdatedBinaryIndex.count(tag);
     }
 
     bool isUpdatedAnalogTag(const std::string& tag)
     {
-        std::scoped_lock<std::shared_mutex> lock(mAnalogMutex);
-        return mUpdatedAnalogTags.count(tag);
+        drainCommands();
+        return mUpdatedAnalogIndex.count(tag);
     }
 
     //  Update any internal-tag data values
     void updateInternalData()
     {
+        drainCommands();
+        DataStore<std::string>::Batch batch;
+        for (auto& t : mUpdatedBinaryTags)
         {
-            std::scoped_lock<std::shared_mutex> lock(mBinaryMutex);
-            for (auto& t : mUpdatedBinaryTags)
+            auto handle = mInternalData->getHandle(t.first);
+            if (handle != INVALID_HANDLE)
             {
-                if (mInternalData->hasData(t.first))
-                {
-                    mInternalData->setData<bool>(t.first, t.second);
-                }
+                batch.emplace_back(handle, t.second);
             }
         }
+        for (auto& t : mUpdatedAnalogTags)
         {
-            std::scoped_lock<std::shared_mutex> lock(mAnalogMutex);
-            for (auto& t : mUpdatedAnalogTags)
+            auto handle = mInternalData->getHandle(t.first);
+            if (handle != INVALID_HANDLE)
             {
-                if (mInternalData->hasData(t.first))
-                {
-                    mInternalData->setData<double>(t.first, t.second);
-                }
+                batch.emplace_back(handle, t.second);
             }
         }
+        mInternalData->setData(batch);
     }
 
+    // Writes still queued after this are kept for the next scan
     void clearUpdatedTags()
     {
-        {
-            std::lock_guard<std::shared_mutex> lock(mBinaryMutex);
-            mUpdatedAnalogTags.clear();
-        }
-        {
-            std::lock_guard<std::shared_mutex> lock(mAnalogMutex);
-            mUpdatedBinaryTags.clear();
-        }
+        mUpdatedBinaryTags.clear();
+        mUpdatedAnalogTags.clear();
+        mUpdatedBinaryIndex.clear();
+        mUpdatedAnalogIndex.clear();
+    }
+
+    // Commands waiting for the scan thread
+    std::size_t getCommandQueueDepth() const
+    {
+        return mCommands.depth();
+    }
+
+    std::size_t getCommandQueueHighWater() const
+    {
+        return mCommands.highWater();
+    }
+
+    // Tag writes dropped because the command queue was full
+    std::uint64_t getCommandQueueOverflows() const
+    {
+        return mCommands.overflows();
     }
 
     bool isBinary(const std::string& tag)
@@ -253,18 +425,108 @@ public:
         return std::find(mAnalogTags.begin(), mAnalogTags.end(), tag) != mAnalogTags.end();
     }
 
-
 private:
+    static const std::size_t cCommandQueueSize = 4096;
+
+    // Queued write to a tag
+    struct TagCommand
+    {
+        std::string tag;
+        bool binary;
+        bool status;
+        double value;
+    };
+
+    bool queueCommand(TagCommand&& cmd)
+    {
+        if (!mCommands.push(std::move(cmd)))
+        {
+            std::cout << "E: DataManager -- command queue full, dropped write to " << cmd.tag << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Scan thread only
+    void drainCommands()
+    {
+        TagCommand cmd;
+        while (mCommands.pop(cmd))
+        {
+            if (cmd.binary)
+            {
+                coalesce(mUpdatedBinaryTags, mUpdatedBinaryIndex, cmd.tag, cmd.status);
+            }
+            else
+            {
+                coalesce(mUpdatedAnalogTags, mUpdatedAnalogIndex, cmd.tag, cmd.value);
+            }
+        }
+    }
+
+    template<typename T>
+    static void coalesce(std::vector<std::pair<std::string, T>>& updates,
+                         std::unordered_map<std::string, std::size_t>& index,
+                         const std::string& tag, const T& value)
+    {
+        auto iter = index.find(tag);
+        if (iter != index.end())
+        {
+            updates[iter->second].second = value;
+        }
+        else
+        {
+            index.emplace(tag, updates.size());
+            updates.emplace_back(tag, value);
+        }
+    }
+
+    // A subscription interested in a store slot, and the index it knows the slot by
+    struct Watcher
+    {
+        ChangeSubscription* subscription;
+        std::size_t index;
+    };
+
+    // Runs on the writer's thread for every published batch
+    void notifyChanges(const bool external, const std::vector<PointHandle>& changed)
+    {
+        std::shared_lock<std::shared_mutex> lock(mWatchMutex);
+        const auto& watchers = external ? mExternalWatchers : mInternalWatchers;
+        for (auto handle : changed)
+        {
+            if (handle < watchers.size())
+            {
+                for (const auto& w : watchers[handle])
+                {
+                    w.subscription->mark(w.index);
+                }
+            }
+        }
+        for (auto& subscription : mSubscriptions)
+        {
+            subscription->signal();
+        }
+    }
+
     std::shared_ptr<DataStore<std::string>> mInternalData; // internal tags
     std::shared_ptr<DataStore<std::string>> mExternalData; // i/o points
     std::map<std::string, std::string> mExternalPoints; // id ==> point
-    std::map<std::string, std::string> mTagToPoint; // tag ==> point
+    std::map<std::string, std::string> mTagToPoint; // tag ==> id
+    std::unordered_map<std::string, TagHandle> mTagHandles; // tag ==> resolved store slot
     std::vector<std::string> mBinaryTags;
     std::vector<std::string> mAnalogTags;
-    std::map<std::string, bool> mUpdatedBinaryTags;
-    std::map<std::string, double> mUpdatedAnalogTags;
-    std::shared_mutex mBinaryMutex;
-    std::shared_mutex mAnalogMutex;
+    CommandQueue<TagCommand> mCommands{cCommandQueueSize}; // protocol/logic writes ==> scan thread
+    std::vector<std::pair<std::string, bool>> mUpdatedBinaryTags; // this scan's writes, scan thread only
+    std::vector<std::pair<std::string, double>> mUpdatedAnalogTags;
+    std::unordered_map<std::string, std::size_t> mUpdatedBinaryIndex; // tag ==> position in the list above
+    std::unordered_map<std::string, std::size_t> mUpdatedAnalogIndex;
+    std::vector<std::shared_ptr<ChangeSubscription>> mSubscriptions;
+    std::vector<std::vector<Watcher>> mInternalWatchers; // internal slot ==> subscribers
+    std::vector<std::vector<Watcher>> mExternalWatchers; // external slot ==> subscribers
+    std::shared_mutex mWatchMutex; // guards the subscriptions/watchers above
+    std::unique_ptr<LatencyTrace> mTrace;
+    mutable std::atomic<double> mLatestSource{0}; // publish time of the newest traced input
 
 };
 
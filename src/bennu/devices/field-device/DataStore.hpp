@@ -1,117 +1,371 @@
 #ifndef BENNU_DEVICES_FIELDDEVICE_DATASTORE_HPP
 #define BENNU_DEVICES_FIELDDEVICE_DATASTORE_HPP
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring> // std::memcpy
+#include <functional>
+#include <limits>
 #include <mutex> // std::scoped_lock
 #include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace bennu {
 namespace field_device {
 
+/*
+ * Dense index of a point inside a DataStore. Handles are handed out when a
+ * point is added and never change afterwards, so callers resolve a point name
+ * once at config time and use the handle for every read/write after that.
+ */
+typedef std::uint32_t PointHandle;
+
+const PointHandle INVALID_HANDLE = std::numeric_limits<PointHandle>::max();
+
+/*
+ * Point values are read far more often than they are written (every protocol
+ * server thread reads, only the subscriber and scan threads write), so reads
+ * never take a lock:
+ *
+ *   - Each record is a seqlock. Readers copy the record and retry if a writer
+ *     touched it in the meantime.
+ *   - Writers serialize on a writer-only mutex and publish updates in
+ *     batches. Every published batch bumps the store version, which readers
+ *     use to take a consistent snapshot of several points (see readSnapshot).
+ *   - Records live in fixed size chunks that never move, so points can still
+ *     be added while other threads are reading.
+ *   - An optional change handler is told which points actually changed value
+ *     in each published batch, so nobody has to poll the store for changes.
+ */
 template<typename P>
 class DataStore
 {
 public:
-    DataStore() {}
+    typedef std::variant<int, double, bool> Value;
+
+    typedef std::vector<std::pair<PointHandle, Value>> Batch;
+
+    // Called by the writer with the handles whose value changed in a published batch
+    typedef std::function<void(const std::vector<PointHandle>&)> ChangeHandler;
+
+    DataStore() :
+        mSize(0),
+        mVersion(0)
+    {
+        for (auto& chunk : mChunks)
+        {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+    }
 
     ~DataStore()
     {
         clear();
     }
 
+    // Not safe while other threads are still using the store
     void clear()
     {
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
-        mData.clear();
+        std::scoped_lock<std::mutex, std::shared_mutex> lock(mWriteMutex, mIndexMutex);
+        for (auto& chunk : mChunks)
+        {
+            delete[] chunk.exchange(nullptr, std::memory_order_relaxed);
+        }
+        mSize.store(0, std::memory_order_release);
+        mPoints.clear();
+        mIndex.clear();
     }
 
-    const std::unordered_map<P, std::variant<int, double, bool>>& get() const
+    // Must be set before writers start publishing
+    void setChangeHandler(ChangeHandler handler)
     {
-        return mData;
+        std::scoped_lock<std::mutex> lock(mWriteMutex);
+        mChangeHandler = handler;
     }
 
+    // Adding an existing point resets its value and keeps its handle
     template<typename T>
-    void addData(const P& point, const T& value)
+    PointHandle addData(const P& point, const T& value)
     {
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
-        mData[point] = value;
-        mTimestamps[point] = 0;
+        std::scoped_lock<std::mutex, std::shared_mutex> lock(mWriteMutex, mIndexMutex);
+        auto iter = mIndex.find(point);
+        if (iter != mIndex.end())
+        {
+            mVersion.fetch_add(1, std::memory_order_relaxed);
+            bool changed = publish(record(iter->second), Value(value), 0);
+            mVersion.fetch_add(1, std::memory_order_release);
+            if (changed) { notify({iter->second}); }
+            return iter->second;
+        }
+
+        PointHandle handle = mSize.load(std::memory_order_relaxed);
+        if (handle / cChunkSize >= cMaxChunks)
+        {
+            return INVALID_HANDLE;
+        }
+        if (handle % cChunkSize == 0)
+        {
+            mChunks[handle / cChunkSize].store(new Record[cChunkSize], std::memory_order_release);
+        }
+        Record& r = record(handle);
+        r.mSequence.store(0, std::memory_order_relaxed);
+        r.mBits.store(0, std::memory_order_relaxed);
+        r.mType.store(0, std::memory_order_relaxed);
+        publish(r, Value(value), 0);
+        mPoints.push_back(point);
+        mIndex[point] = handle;
+        // make the new record visible to readers only once it is initialized
+        mSize.store(handle + 1, std::memory_order_release);
+        return handle;
+    }
+
+    PointHandle getHandle(const P& point)
+    {
+        std::shared_lock<std::shared_mutex> lock(mIndexMutex);
+        auto iter = mIndex.find(point);
+        return iter != mIndex.end() ? iter->second : INVALID_HANDLE;
     }
 
     template<typename T>
-    bool setData(const P& point, const T& value, const double ts = 0)
+    bool setData(const PointHandle handle, const T& value, const double ts = 0)
     {
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
-        auto iter = mData.find(point);
-        if (iter != mData.end())
+        if (!hasData(handle))
         {
-            iter->second = value;
+            return false;
+        }
+        std::scoped_lock<std::mutex> lock(mWriteMutex);
+        mVersion.fetch_add(1, std::memory_order_relaxed);
+        bool changed = publish(record(handle), Value(value), ts);
+        mVersion.fetch_add(1, std::memory_order_release);
+        if (changed) { notify({handle}); }
+        return true;
+    }
 
-            auto i = mTimestamps.find(point);
-            if (i != mTimestamps.end())
+    template<typename T>
+    bool setData(const P& point, const T& value, const double ts = 0)
+    {
+        return setData<T>(getHandle(point), value, ts);
+    }
+
+    // Publish a set of updates as a single new version of the store
+    void setData(const Batch& batch, const double ts = 0)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        PointHandle size = mSize.load(std::memory_order_acquire);
+        std::scoped_lock<std::mutex> lock(mWriteMutex);
+        mChanged.clear();
+        mVersion.fetch_add(1, std::memory_order_relaxed);
+        for (const auto& update : batch)
+        {
+            if (update.first < size && publish(record(update.first), update.second, ts))
             {
-                i->second = ts;
+                mChanged.push_back(update.first);
             }
-
-            return true;
         }
-        return false;
+        mVersion.fetch_add(1, std::memory_order_release);
+        if (!mChanged.empty()) { notify(mChanged); }
     }
 
-
     template<typename T>
-    T getData(const P& point)
+    T getData(const PointHandle handle)
     {
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
-        auto iter = mData.find(point);
-        if (iter != mData.end())
+        if (hasData(handle))
         {
-            return std::get<T>(iter->second);
+            return std::get<T>(read(handle).first);
         }
         return T();
     }
 
-    double getTimestamp(const P& device)
+    template<typename T>
+    T getData(const P& point)
     {
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
+        return getData<T>(getHandle(point));
+    }
 
-        auto iter = mTimestamps.find(device);
-        if (iter != mTimestamps.end())
+    double getTimestamp(const PointHandle handle)
+    {
+        if (hasData(handle))
         {
-            return iter->second;
+            return read(handle).second;
         }
-
         return 0;
     }
 
+    double getTimestamp(const P& point)
+    {
+        return getTimestamp(getHandle(point));
+    }
+
+    bool hasData(const PointHandle handle) const
+    {
+        return handle < mSize.load(std::memory_order_acquire);
+    }
+
     bool hasData(const P& point)
     {
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
-        return mData.find(point) != mData.end();
+        return getHandle(point) != INVALID_HANDLE;
     }
 
-    void printData()
+    size_t size() const
     {
-        if (mData.size()) { printf("\n============ DATA ============\n"); }
-        std::scoped_lock<std::shared_mutex> lock(mMutex);
-        for (const auto& kv : mData)
+        return mSize.load(std::memory_order_acquire);
+    }
+
+    // Even while no batch is being published; bumped by two for every batch
+    std::uint64_t getVersion() const
+    {
+        return mVersion.load(std::memory_order_acquire);
+    }
+
+    /*
+     * Run 'fn' until it completes without a batch being published in the
+     * middle of it, so every value it reads comes from the same version of
+     * the store. 'fn' may run more than once and should only read.
+     */
+    template<typename F>
+    void readSnapshot(F&& fn)
+    {
+        while (true)
         {
-            std::string val;
-            std::string type;
-            if (std::holds_alternative<int>(kv.second)) { val = std::to_string(std::get<int>(kv.second)); type = "int"; }
-            else if (std::holds_alternative<double>(kv.second)) { val = std::to_string(std::get<double>(kv.second)); type = "double"; }
-            else if (std::holds_alternative<bool>(kv.second)) { val = std::to_string(std::get<bool>(kv.second)); type = "bool"; }
-            printf("%s -- %s\n", kv.first.data(), val.data());
+            std::uint64_t before = mVersion.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            fn();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mVersion.load(std::memory_order_relaxed) == before)
+            {
+                return;
+            }
         }
-        if (mData.size()) { printf("==============================\n\n"); }
+    }
+
+    // Call fn(point, value) for every point, in handle order
+    template<typename F>
+    void forEach(F&& fn)
+    {
+        std::shared_lock<std::shared_mutex> lock(mIndexMutex);
+        for (size_t i = 0; i < mPoints.size(); ++i)
+        {
+            fn(mPoints[i], read(static_cast<PointHandle>(i)).first);
+        }
+    }
+
+    static std::string toString(const Value& value)
+    {
+        if (std::holds_alternative<int>(value)) { return std::to_string(std::get<int>(value)); }
+        else if (std::holds_alternative<double>(value)) { return std::to_string(std::get<double>(value)); }
+        else { return std::get<bool>(value) ? "true" : "false"; }
+    }
+
+    void printData()
+    {
+        if (size()) { printf("\n============ DATA ============\n"); }
+        forEach([](const P& point, const Value& value)
+        {
+            printf("%s -- %s\n", point.data(), toString(value).data());
+        });
+        if (size()) { printf("==============================\n\n"); }
     }
 
 private:
-    std::shared_mutex mMutex;
-    std::unordered_map<P, std::variant<int, double, bool>> mData;
-    std::unordered_map<P, double> mTimestamps;
+    static const PointHandle cChunkSize = 1024;
+    static const PointHandle cMaxChunks = 4096;
+
+    // Value (with its type) and timestamp of a point, guarded by a sequence counter
+    struct Record
+    {
+        std::atomic<std::uint64_t> mSequence;
+        std::atomic<std::uint64_t> mBits;
+        std::atomic<std::uint8_t> mType;
+        std::atomic<double> mTimestamp;
+    };
+
+    Record& record(const PointHandle handle) const
+    {
+        return mChunks[handle / cChunkSize].load(std::memory_order_acquire)[handle % cChunkSize];
+    }
+
+    // Caller must hold mWriteMutex
+    void notify(const std::vector<PointHandle>& changed)
+    {
+        if (mChangeHandler)
+        {
+            mChangeHandler(changed);
+        }
+    }
+
+    // Caller must hold mWriteMutex. Returns true if the value (not just the timestamp) changed.
+    bool publish(Record& r, const Value& value, const double ts)
+    {
+        std::uint64_t bits = 0;
+        std::visit([&bits](const auto& v) { std::memcpy(&bits, &v, sizeof(v)); }, value);
+        std::uint8_t type = static_cast<std::uint8_t>(value.index());
+        // only the writer modifies the record, so these reads need no retry
+        bool changed = r.mBits.load(std::memory_order_relaxed) != bits || r.mType.load(std::memory_order_relaxed) != type;
+
+        std::uint64_t seq = r.mSequence.load(std::memory_order_relaxed);
+        r.mSequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        r.mBits.store(bits, std::memory_order_relaxed);
+        r.mType.store(type, std::memory_order_relaxed);
+        r.mTimestamp.store(ts, std::memory_order_relaxed);
+        r.mSequence.store(seq + 2, std::memory_order_release);
+        return changed;
+    }
+
+    std::pair<Value, double> read(const PointHandle handle) const
+    {
+        const Record& r = record(handle);
+        std::uint64_t bits;
+        std::uint8_t type;
+        double ts;
+        while (true)
+        {
+            std::uint64_t before = r.mSequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            bits = r.mBits.load(std::memory_order_relaxed);
+            type = r.mType.load(std::memory_order_relaxed);
+            ts = r.mTimestamp.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (r.mSequence.load(std::memory_order_relaxed) == before)
+            {
+                break;
+            }
+        }
+
+        switch (type)
+        {
+            case 0: { int v; std::memcpy(&v, &bits, sizeof(v)); return {Value(v), ts}; }
+            case 1: { double v; std::memcpy(&v, &bits, sizeof(v)); return {Value(v), ts}; }
+            default: { bool v; std::memcpy(&v, &bits, sizeof(v)); return {Value(v), ts}; }
+        }
+    }
+
+    mutable std::array<std::atomic<Record*>, cMaxChunks> mChunks;
+    std::atomic<PointHandle> mSize;
+    std::atomic<std::uint64_t> mVersion;
+    std::mutex mWriteMutex; // writers only; readers never lock
+    ChangeHandler mChangeHandler;
+    std::vector<PointHandle> mChanged; // scratch list of changed handles, guarded by mWriteMutex
+    std::shared_mutex mIndexMutex; // guards the name index below
+    std::vector<P> mPoints; // handle ==> point, for diagnostics
+    std::unordered_map<P, PointHandle> mIndex; // point ==> handle, only used to resolve handles
 };
 
 } // namespace field_device
@@ -1,8 +1,11 @@
 #include "FieldDevice.hpp"
 
+#include <functional>
 #include <iostream>
 
+#include "bennu/devices/field-device/ScanGroup.hpp"
 #include "bennu/devices/modules/comms/base/CommsModuleCreator.hpp"
+#include "bennu/utility/WorkerPool.hpp"
 
 namespace bennu {
 namespace field_device {
@@ -13,7 +16,10 @@ using boost::property_tree::ptree_error;
 FieldDevice::FieldDevice(const std::string& name) :
     bennu::utility::DirectLoggable(name),
     mFdName(name),
-    mDataManager(new DataManager)
+    mDataManager(new DataManager),
+    mCycleTime(1000),
+    mPrintDataCycles(0),
+    mPrintDataCount(0)
 {
 }
 
@@ -22,13 +28,30 @@ bool FieldDevice::handleTreeData(const ptree& tree)
     try
     {
         mCycleTime = tree.get<unsigned int>("cycle-time", 1000);
+        mScheduler.reset(new ScanScheduler(std::chrono::milliseconds(mCycleTime)));
 
-        if (tree.get_child_optional("logic"))
+        // Optional diagnostics:
+        //   <diagnostics>
+        //     <endpoint>tcp://127.0.0.1:1331</endpoint>  (READ=scan / READ=data queries)
+        //     <print-data>10</print-data>                (dump external data every 10 cycles)
+        //     <trace>true</trace>                        (record latencies for READ=latency)
+        //     <print-logic>true</print-logic>            (print every logic line evaluated)
+        //   </diagnostics>
+        if (tree.get_child_optional("diagnostics"))
         {
-            auto logicModule{new logic::LogicModule};
-            logicModule->setDataManager(mDataManager);
-            logicModule->handleTreeData(tree);
-            mLogicModule.reset(logicModule);
+            ptree diagTree = tree.get_child("diagnostics");
+            mPrintDataCycles = diagTree.get<unsigned int>("print-data", 0);
+            if (diagTree.get<bool>("trace", false))
+            {
+                mDataManager->enableTrace();
+            }
+            if (diagTree.get_child_optional("endpoint"))
+            {
+                distributed::Endpoint ep;
+                ep.str = diagTree.get<std::string>("endpoint");
+                mDiagnostics.reset(new distributed::Server(ep));
+                mDiagnostics->setHandler(std::bind(&FieldDevice::diagnosticsHandler, this, std::placeholders::_1));
+            }
         }
 
         auto inputs = tree.equal_range("input");
@@ -92,13 +115,21 @@ bool FieldDevice::handleTreeData(const ptree& tree)
             }
         }
 
+        // Logic is compiled against the tags above, so it has to come after them
+        if (tree.get_child_optional("logic"))
+        {
+            auto logicModule{new logic::LogicModule};
+            logicModule->setDataManager(mDataManager);
+            logicModule->handleTreeData(tree);
+            mLogicModule.reset(logicModule);
+        }
+
         if (tree.get_child_optional("comms"))
         {
             ptree commsTree = tree.get_child("comms");
             comms::CommsModuleCreator::the()->handleCommsTreeData(commsTree, mDataManager);
         }
 
-        startDevice();
         return true;
     }
     catch (ptree_bad_path& e)
@@ -123,33 +154,133 @@ void FieldDevice::processOutputs()
     mDataManager->clearUpdatedTags();
 }
 
-void FieldDevice::startDevice()
+void FieldDevice::startDevice(std::shared_ptr<ScanGroup> group)
+{
+    // When hosting many devices the scan runs as a chain of pool tasks rather than a thread per device
+    if (group)
+    {
+        mScheduler = group->getScheduler();
+        group->add(shared_from_this());
+    }
+    else if (utility::WorkerPool::the()->size() > 0)
+    {
+        scheduleCycle();
+    }
+    else
+    {
+        mScanThread.reset(new std::thread(std::bind(&FieldDevice::scanCycle, this)));
+    }
+    if (mDiagnostics)
+    {
+        mDiagnosticsThread.reset(new std::thread(std::bind(&distributed::Server::run, mDiagnostics)));
+    }
+}
+
+void FieldDevice::scheduleCycle()
 {
-    mScanThread.reset(new std::thread(std::bind(&FieldDevice::scanCycle, this)));
+    std::weak_ptr<FieldDevice> weak = shared_from_this();
+    utility::WorkerPool::the()->postAt(mScheduler->nextDeadline(), [weak]()
+    {
+        if (auto self = weak.lock())
+        {
+            self->mScheduler->startCycle();
+            self->runCycle();
+            // only re-posted once this cycle is done, so a device never scans concurrently with itself
+            self->scheduleCycle();
+        }
+    });
 }
 
 void FieldDevice::scanCycle()
 {
-    int i = 1;
     while (1)
     {
-        if (mLogicModule)
-        {
-            mLogicModule->scanInputs();
-            mLogicModule->scanLogic(mCycleTime);
-        }
-        processOutputs();
-        if (i % 10 == 0)
-        {
-            mDataManager->printExternalData();
-            i = 1;
-        }
-        else
+        mScheduler->waitForNextCycle();
+        runCycle();
+    }
+}
+
+void FieldDevice::runCycle()
+{
+    mScheduler->beginPhase(ScanScheduler::eInput);
+    scanInputs();
+    if (mLogicModule)
+    {
+        mScheduler->beginPhase(ScanScheduler::eLogic);
+        scanLogic();
+    }
+    mScheduler->beginPhase(ScanScheduler::eOutput);
+    scanOutputs();
+    mScheduler->endCycle();
+}
+
+void FieldDevice::scanInputs()
+{
+    mDataManager->traceScan();
+    if (mLogicModule)
+    {
+        mLogicModule->scanInputs();
+    }
+}
+
+void FieldDevice::scanLogic()
+{
+    if (mLogicModule)
+    {
+        mLogicModule->scanLogic(mCycleTime);
+    }
+}
+
+void FieldDevice::scanOutputs()
+{
+    processOutputs();
+
+    if (mPrintDataCycles && ++mPrintDataCount >= mPrintDataCycles)
+    {
+        mDataManager->printExternalData();
+        mPrintDataCount = 0;
+    }
+}
+
+std::string FieldDevice::getScanReport() const
+{
+    return mScheduler ? mScheduler->report() : "";
+}
+
+zmq::message_t FieldDevice::diagnosticsHandler(const zmq::message_t& req)
+{
+    std::string request(req.data<char>(), req.size());
+    request = request.substr(0, request.find('\0'));
+    std::string reply;
+
+    if (request.rfind("QUERY", 0) == 0 || request.rfind("query", 0) == 0)
+    {
+        reply = "ACK=scan,data,latency,";
+    }
+    else if (request == "READ=scan" || request == "read=scan")
+    {
+        reply = "ACK=" + getScanReport();
+    }
+    else if (request == "READ=data" || request == "read=data")
+    {
+        reply = "ACK=";
+        mDataManager->getExternalData()->forEach([&reply](const std::string& point, const DataStore<std::string>::Value& value)
         {
-            i++;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(mCycleTime));
+            reply += point + ":" + DataStore<std::string>::toString(value) + ",";
+        });
     }
+    else if (request == "READ=latency" || request == "read=latency")
+    {
+        auto trace = mDataManager->getTrace();
+        reply = trace ? "ACK=" + trace->report() : "ERR=Tracing is not enabled (<diagnostics><trace>true</trace>)";
+    }
+    else
+    {
+        reply = "ERR=Unknown diagnostics request (must be QUERY|READ=scan|READ=data|READ=latency)";
+    }
+
+    zmq::message_t repMsg(reply+'\0'); // must include null byte
+    return repMsg;
 }
 
 } // namespace field_device
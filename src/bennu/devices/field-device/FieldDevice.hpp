@@ -8,6 +8,8 @@
 #include <boost/property_tree/ptree.hpp>
 
 #include "bennu/devices/field-device/DataManager.hpp"
+#include "bennu/devices/field-device/ScanScheduler.hpp"
+#include "bennu/distributed/Server.hpp"
 #include "bennu/devices/modules/io/InputModule.hpp"
 #include "bennu/devices/modules/io/OutputModule.hpp"
 #include "bennu/devices/modules/logic/LogicModule.hpp"
@@ -18,6 +20,8 @@ namespace field_device {
 
 using boost::property_tree::ptree;
 
+class ScanGroup;
+
 class FieldDevice : public bennu::utility::DirectLoggable, public std::enable_shared_from_this<FieldDevice>
 {
 public:
@@ -30,11 +34,33 @@ public:
         return mDataManager;
     }
 
+    std::shared_ptr<logic::LogicModule> getLogicModule() const
+    {
+        return mLogicModule;
+    }
+
+    unsigned int getCycleTime() const
+    {
+        return mCycleTime;
+    }
+
     void processOutputs();
 
     [[ noreturn ]] void scanCycle();
 
-    void startDevice();
+    // Run one input/logic/output cycle (the body of scanCycle)
+    void runCycle();
+
+    // The phases of runCycle, for a ScanGroup scanning several devices together
+    void scanInputs();
+    void scanLogic();
+    void scanOutputs();
+
+    // Start scanning: on its own, or as part of 'group' (see ScanGroup)
+    void startDevice(std::shared_ptr<ScanGroup> group = nullptr);
+
+    // Scan timing statistics (see ScanScheduler::report); safe to call while the scan is running
+    std::string getScanReport() const;
 
 protected:
     std::string mFdName;
@@ -44,8 +70,18 @@ protected:
     std::vector<std::shared_ptr<io::OutputModule>> mOutputModules;
     std::shared_ptr<std::thread> mScanThread;
     unsigned int mCycleTime;
+    std::shared_ptr<ScanScheduler> mScheduler;             // the ScanGroup's when scanned in a group
+    unsigned int mPrintDataCycles;                          // dump external data every N cycles (0 = never)
+    unsigned int mPrintDataCount;
+    std::shared_ptr<distributed::Server> mDiagnostics;      // optional runtime query endpoint
+    std::shared_ptr<std::thread> mDiagnosticsThread;
 
 private:
+    // Post the next cycle to the shared WorkerPool for the next scan deadline
+    void scheduleCycle();
+
+    zmq::message_t diagnosticsHandler(const zmq::message_t& req);
+
     FieldDevice(const FieldDevice&);
     FieldDevice& operator =(const FieldDevice&);
 
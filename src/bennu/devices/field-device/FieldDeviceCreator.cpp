@@ -1,7 +1,10 @@
 #include "FieldDeviceCreator.hpp"
 
 #include "bennu/devices/field-device/FieldDevice.hpp"
+#include "bennu/devices/field-device/ScanGroup.hpp"
+#include "bennu/distributed/Subscriber.hpp"
 #include "bennu/parsers/Parser.hpp"
+#include "bennu/utility/WorkerPool.hpp"
 
 namespace bennu {
 namespace field_device {
@@ -14,9 +17,45 @@ bool FieldDeviceCreator::handleTreeData(const ptree& tree)
     try
     {
         std::string name = tree.get<std::string>("name");
-        mFieldDevice.reset(new FieldDevice(name));
 
-        return mFieldDevice->handleTreeData(tree);
+        // Hosting on the shared pool: subscription handlers run there too instead of on the receive thread
+        if (mFieldDevices.empty() && utility::WorkerPool::the()->size() > 0)
+        {
+            distributed::Subscriber::setExecutor([](std::function<void()> task)
+            {
+                utility::WorkerPool::the()->post(task);
+            });
+        }
+
+        std::shared_ptr<FieldDevice> device{new FieldDevice(name)};
+        mFieldDevices.push_back(device);
+
+        if (!device->handleTreeData(tree))
+        {
+            return false;
+        }
+
+        auto logic = device->getLogicModule();
+        if (utility::WorkerPool::the()->size() > 0 && logic && logic->getProgram())
+        {
+            auto key = std::make_pair(static_cast<const void*>(logic->getProgram().get()), device->getCycleTime());
+            auto& group = mScanGroups[key];
+            bool created = !group;
+            if (created)
+            {
+                group.reset(new ScanGroup(device->getCycleTime(), logic->getProgram()));
+            }
+            device->startDevice(group);
+            if (created)
+            {
+                group->start();
+            }
+        }
+        else
+        {
+            device->startDevice();
+        }
+        return true;
 
     }
     catch (ptree_bad_path& e)
@@ -1,7 +1,9 @@
 #ifndef BENNU_FIELDDEVICE_BASE_FIELDDEVICEMANAGER_HPP
 #define BENNU_FIELDDEVICE_BASE_FIELDDEVICEMANAGER_HPP
 
+#include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <boost/property_tree/ptree.hpp>
@@ -13,6 +15,7 @@ namespace field_device {
 
 class FieldDevice;
 class FieldDeviceDataHandler;
+class ScanGroup;
 
 using boost::property_tree::ptree;
 
@@ -24,7 +27,10 @@ public:
     bool handleTreeData(const ptree& tree);
 
 protected:
-    std::shared_ptr<bennu::field_device::FieldDevice> mFieldDevice;
+    // One per <field-device> element; each has its own DataManager
+    std::vector<std::shared_ptr<bennu::field_device::FieldDevice>> mFieldDevices;
+    // Pool hosted devices with the same logic program and cycle time are scanned as one batch
+    std::map<std::pair<const void*, unsigned int>, std::shared_ptr<ScanGroup>> mScanGroups;
 
     FieldDeviceCreator() {}
 
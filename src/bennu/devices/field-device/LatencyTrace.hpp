@@ -0,0 +1,68 @@
+#ifndef BENNU_FIELDDEVICE_LATENCYTRACE_HPP
+#define BENNU_FIELDDEVICE_LATENCYTRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "bennu/utility/Histogram.hpp"
+
+namespace bennu {
+namespace field_device {
+
+/*
+ * Opt-in staleness tracing along the path of a provider value (microseconds,
+ * measured against the provider's publish timestamp, so provider and field
+ * device clocks must agree):
+ *
+ *   receive   - publish to arrival in the input module (binary frames and shm:// tables)
+ *   scan      - age of the newest input when a scan cycle starts
+ *   protocol  - age of a point when a protocol server hands it to a master
+ */
+class LatencyTrace
+{
+public:
+    enum Stage
+    {
+        eReceive,
+        eScan,
+        eProtocol,
+        eNumStages
+    };
+
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Age of a value published at 'source' (seconds since the epoch); ignored if unknown
+    void record(const Stage stage, const double source)
+    {
+        if (source > 0)
+        {
+            mStages[stage].add(static_cast<std::int64_t>((now() - source) * 1e6));
+        }
+    }
+
+    const utility::Histogram& get(const Stage stage) const
+    {
+        return mStages[stage];
+    }
+
+    // Ex: "receive n=10 mean=85 p50=127 p99=255 max=201,scan ...,protocol ..."
+    std::string report() const
+    {
+        return "receive " + mStages[eReceive].summary()
+            + ",scan " + mStages[eScan].summary()
+            + ",protocol " + mStages[eProtocol].summary();
+    }
+
+private:
+    utility::Histogram mStages[eNumStages];
+
+};
+
+} // namespace field_device
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_LATENCYTRACE_HPP
@@ -0,0 +1,119 @@
+#include "ScanGroup.hpp"
+
+#include "bennu/devices/field-device/FieldDevice.hpp"
+#include "bennu/utility/WorkerPool.hpp"
+
+namespace bennu {
+namespace field_device {
+
+ScanGroup::ScanGroup(const unsigned int cycleTime, std::shared_ptr<const logic::LogicProgram> program) :
+    mScheduler(new ScanScheduler(std::chrono::milliseconds(cycleTime))),
+    mBatch(new logic::LogicBatch(program)),
+    mRemaining(0)
+{
+}
+
+void ScanGroup::add(std::shared_ptr<FieldDevice> device)
+{
+    // the batch's lanes can't grow under a running cycle, so the device joins when the next one starts
+    std::scoped_lock<std::mutex> lock(mMutex);
+    mJoining.push_back(device);
+}
+
+void ScanGroup::start()
+{
+    scheduleCycle();
+}
+
+std::size_t ScanGroup::size() const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    return mDevices.size() + mJoining.size();
+}
+
+void ScanGroup::scheduleCycle()
+{
+    std::weak_ptr<ScanGroup> weak = shared_from_this();
+    utility::WorkerPool::the()->postAt(mScheduler->nextDeadline(), [weak]()
+    {
+        if (auto self = weak.lock())
+        {
+            self->mScheduler->startCycle();
+            // the next cycle is only posted once this one is done, so the group never scans concurrently with itself
+            self->runCycle();
+        }
+    });
+}
+
+void ScanGroup::runCycle()
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        for (auto& device : mJoining)
+        {
+            device->getLogicModule()->joinBatch(mBatch);
+            mDevices.push_back(device);
+        }
+        mJoining.clear();
+    }
+
+    mScheduler->beginPhase(ScanScheduler::eInput);
+    if (mDevices.empty())
+    {
+        evaluate();
+        return;
+    }
+    mRemaining = mDevices.size();
+    auto self = shared_from_this();
+    for (std::size_t i = 0; i < mDevices.size(); ++i)
+    {
+        utility::WorkerPool::the()->post([self, i]() { self->scanInputs(i); });
+    }
+}
+
+void ScanGroup::scanInputs(const std::size_t index)
+{
+    mDevices[index]->scanInputs();
+    if (--mRemaining == 0)
+    {
+        evaluate();
+    }
+}
+
+void ScanGroup::evaluate()
+{
+    mScheduler->beginPhase(ScanScheduler::eLogic);
+    for (auto& device : mDevices)
+    {
+        device->getLogicModule()->requestLines();
+    }
+    mBatch->evaluate();
+
+    mScheduler->beginPhase(ScanScheduler::eOutput);
+    if (mDevices.empty())
+    {
+        mScheduler->endCycle();
+        scheduleCycle();
+        return;
+    }
+    mRemaining = mDevices.size();
+    auto self = shared_from_this();
+    for (std::size_t i = 0; i < mDevices.size(); ++i)
+    {
+        utility::WorkerPool::the()->post([self, i]() { self->scanOutputs(i); });
+    }
+}
+
+void ScanGroup::scanOutputs(const std::size_t index)
+{
+    mDevices[index]->scanLogic();
+    mDevices[index]->scanOutputs();
+    if (--mRemaining == 0)
+    {
+        mScheduler->endCycle();
+        scheduleCycle();
+    }
+}
+
+} // namespace field_device
+} // namespace bennu
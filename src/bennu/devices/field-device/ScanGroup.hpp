@@ -0,0 +1,71 @@
+#ifndef BENNU_FIELDDEVICE_BASE_SCANGROUP_HPP
+#define BENNU_FIELDDEVICE_BASE_SCANGROUP_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "bennu/devices/field-device/ScanScheduler.hpp"
+#include "bennu/devices/modules/logic/LogicBatch.hpp"
+
+namespace bennu {
+namespace field_device {
+
+class FieldDevice;
+
+/*
+ * Field devices hosted on the WorkerPool that run the same compiled logic
+ * program at the same cycle time, scanned together on one schedule. Each
+ * device's inputs are scanned as its own pool task; once the last one is
+ * done a single LogicBatch::evaluate() runs the logic for all of them, and
+ * each device's logic results and outputs are then applied as its own pool
+ * task. The cycle ends (and the next one is scheduled) when the last device
+ * is done, so the group still never scans concurrently with itself.
+ */
+class ScanGroup : public std::enable_shared_from_this<ScanGroup>
+{
+public:
+    ScanGroup(const unsigned int cycleTime, std::shared_ptr<const logic::LogicProgram> program);
+
+    // Give the device a lane in the group's batch; it is scanned from the next cycle on
+    void add(std::shared_ptr<FieldDevice> device);
+
+    // Start scanning on the shared WorkerPool
+    void start();
+
+    std::shared_ptr<ScanScheduler> getScheduler() const
+    {
+        return mScheduler;
+    }
+
+    std::size_t size() const;
+
+private:
+    // Post the next cycle to the shared WorkerPool for the next scan deadline
+    void scheduleCycle();
+
+    void runCycle();
+
+    // Per device pool tasks; the last one of each phase moves the cycle on
+    void scanInputs(const std::size_t index);
+    void scanOutputs(const std::size_t index);
+
+    void evaluate();
+
+    std::shared_ptr<ScanScheduler> mScheduler;
+    std::shared_ptr<logic::LogicBatch> mBatch;
+    std::vector<std::shared_ptr<FieldDevice>> mDevices;        // only changed between cycles
+    std::vector<std::shared_ptr<FieldDevice>> mJoining;        // added since the last cycle started
+    std::atomic<std::size_t> mRemaining;                        // device tasks left in the current phase
+    mutable std::mutex mMutex;                                  // guards mJoining
+
+    ScanGroup(const ScanGroup&);
+    ScanGroup& operator =(const ScanGroup&);
+
+};
+
+} // namespace field_device
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_BASE_SCANGROUP_HPP
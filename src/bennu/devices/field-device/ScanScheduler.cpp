@@ -0,0 +1,125 @@
+#include "ScanScheduler.hpp"
+
+#include <sstream>
+#include <thread>
+
+namespace bennu {
+namespace field_device {
+
+ScanScheduler::ScanScheduler(const std::chrono::microseconds& period) :
+    mPeriod(period.count() > 0 ? period : std::chrono::microseconds(1)),
+    mPhase(eNumPhases),
+    mStarted(false),
+    mCycles(0),
+    mOverruns(0),
+    mSkipped(0)
+{
+}
+
+void ScanScheduler::waitForNextCycle()
+{
+    std::this_thread::sleep_until(nextDeadline());
+    startCycle();
+}
+
+ScanScheduler::Clock::time_point ScanScheduler::nextDeadline()
+{
+    Clock::time_point now = Clock::now();
+    if (!mStarted)
+    {
+        mStarted = true;
+        mDeadline = now;
+    }
+    else
+    {
+        mDeadline += mPeriod;
+        // skip any deadlines that have already passed entirely rather than running them back to back
+        if (now > mDeadline + mPeriod)
+        {
+            auto missed = (now - mDeadline) / mPeriod;
+            mSkipped.fetch_add(missed, std::memory_order_relaxed);
+            mDeadline += missed * mPeriod;
+        }
+    }
+    return mDeadline;
+}
+
+void ScanScheduler::startCycle()
+{
+    Clock::time_point now = Clock::now();
+    mJitter.add(std::chrono::duration_cast<std::chrono::microseconds>(now - mDeadline).count());
+    mCycleStart = now;
+    mPhase = eNumPhases;
+}
+
+void ScanScheduler::beginPhase(const Phase phase)
+{
+    Clock::time_point now = Clock::now();
+    endPhase(now);
+    mPhase = phase;
+    mPhaseStart = now;
+}
+
+void ScanScheduler::endCycle()
+{
+    Clock::time_point now = Clock::now();
+    endPhase(now);
+    mCycleTime.add(std::chrono::duration_cast<std::chrono::microseconds>(now - mCycleStart).count());
+    if (now > mDeadline + mPeriod)
+    {
+        mOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    mCycles.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ScanScheduler::endPhase(const Clock::time_point& now)
+{
+    if (mPhase != eNumPhases)
+    {
+        mPhaseTime[mPhase].add(std::chrono::duration_cast<std::chrono::microseconds>(now - mPhaseStart).count());
+        mPhase = eNumPhases;
+    }
+}
+
+std::string ScanScheduler::report() const
+{
+    std::ostringstream ss;
+    ss << "period:" << mPeriod.count()
+       << ",cycles:" << getCycles()
+       << ",overruns:" << getOverruns()
+       << ",skipped:" << getSkipped()
+       << ",jitter:" << mJitter.summary()
+       << ",cycle-time:" << mCycleTime.summary();
+    for (int p = 0; p < eNumPhases; ++p)
+    {
+        ss << "," << phaseName(static_cast<Phase>(p)) << "-time:" << mPhaseTime[p].summary();
+    }
+    return ss.str();
+}
+
+void ScanScheduler::resetStatistics()
+{
+    mCycles.store(0, std::memory_order_relaxed);
+    mOverruns.store(0, std::memory_order_relaxed);
+    mSkipped.store(0, std::memory_order_relaxed);
+    mJitter.reset();
+    mCycleTime.reset();
+    for (auto& h : mPhaseTime)
+    {
+        h.reset();
+    }
+}
+
+const char* ScanScheduler::phaseName(const Phase phase)
+{
+    switch (phase)
+    {
+        case eInput:  return "input";
+        case eLogic:  return "logic";
+        case eOutput: return "output";
+        default:      return "unknown";
+    }
+}
+
+} // namespace field_device
+} // namespace bennu
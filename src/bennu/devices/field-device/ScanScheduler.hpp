@@ -0,0 +1,118 @@
+#ifndef BENNU_FIELDDEVICE_SCANSCHEDULER_HPP
+#define BENNU_FIELDDEVICE_SCANSCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "bennu/utility/Histogram.hpp"
+
+namespace bennu {
+namespace field_device {
+
+/*
+ * Fixed-period scan scheduler. Cycles start on absolute steady_clock
+ * deadlines (start + n * period) so work time does not stretch the period.
+ * A cycle that runs past its deadline is an overrun; any deadlines missed
+ * entirely are skipped (and counted) rather than run back to back.
+ *
+ * Per-phase execution times, total cycle time and wake-up jitter (how late
+ * a cycle started relative to its deadline) are kept in histograms that may
+ * be read from other threads while the scan is running.
+ */
+class ScanScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Phase
+    {
+        eInput,
+        eLogic,
+        eOutput,
+        eNumPhases
+    };
+
+    explicit ScanScheduler(const std::chrono::microseconds& period);
+
+    // Sleep until the next deadline and start a new cycle
+    void waitForNextCycle();
+
+    // Advance to the next deadline (skipping any missed entirely) and return it;
+    // for callers that wait on their own, e.g. by scheduling a pool task for it
+    Clock::time_point nextDeadline();
+
+    // Start the cycle due at the last deadline returned by nextDeadline()
+    void startCycle();
+
+    // Mark the start of a phase; the previous phase (if any) ends here
+    void beginPhase(const Phase phase);
+
+    // End the current phase and the cycle
+    void endCycle();
+
+    std::chrono::microseconds getPeriod() const
+    {
+        return mPeriod;
+    }
+
+    std::uint64_t getCycles() const
+    {
+        return mCycles.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getOverruns() const
+    {
+        return mOverruns.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getSkipped() const
+    {
+        return mSkipped.load(std::memory_order_relaxed);
+    }
+
+    const utility::Histogram& getJitter() const
+    {
+        return mJitter;
+    }
+
+    const utility::Histogram& getCycleTime() const
+    {
+        return mCycleTime;
+    }
+
+    const utility::Histogram& getPhaseTime(const Phase phase) const
+    {
+        return mPhaseTime[phase];
+    }
+
+    // Comma separated "key:value" pairs (all times in microseconds)
+    std::string report() const;
+
+    void resetStatistics();
+
+private:
+    static const char* phaseName(const Phase phase);
+
+    void endPhase(const Clock::time_point& now);
+
+    std::chrono::microseconds mPeriod;
+    Clock::time_point mDeadline;     // when the current cycle was due to start
+    Clock::time_point mCycleStart;
+    Clock::time_point mPhaseStart;
+    int mPhase;                      // current phase, or eNumPhases when none
+    bool mStarted;
+
+    std::atomic<std::uint64_t> mCycles;
+    std::atomic<std::uint64_t> mOverruns;
+    std::atomic<std::uint64_t> mSkipped;
+    utility::Histogram mJitter;
+    utility::Histogram mCycleTime;
+    utility::Histogram mPhaseTime[eNumPhases];
+};
+
+} // namespace field_device
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_SCANSCHEDULER_HPP
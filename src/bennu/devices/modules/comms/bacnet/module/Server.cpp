@@ -61,47 +61,65 @@ void Server::run()
 
 /*
  * Update loop that syncs local bennu datastore with protocol datastore.
- * This handles data changes that come from a provider (inputs).
+ * This handles data changes that come from a provider (inputs). Only points
+ * whose value changed are pushed, as soon as the datastore reports them.
  */
 void Server::update()
 {
+    // Subscription indices: binary points first, then analog points (both in address order)
+    std::vector<field_device::TagHandle> handles;
+    std::vector<std::pair<std::uint16_t, PointType>> points;
+    for (const auto& kv : mBinaryPoints)
+    {
+        handles.push_back(kv.second.handle);
+        points.emplace_back(kv.first, kv.second.type);
+    }
+    for (const auto& kv : mAnalogPoints)
+    {
+        handles.push_back(kv.second.handle);
+        points.emplace_back(kv.first, kv.second.type);
+    }
+    const std::size_t numBinary = mBinaryPoints.size();
+
+    auto changes = mDataManager->subscribe(handles);
+    std::vector<std::size_t> changed;
     while (1)
     {
-        // kv = {<address>: {<tag>, eInput}}
-        for (const auto& kv : mBinaryPoints)
+        if (!changes->wait(std::chrono::seconds(1)))
         {
-            const std::string tag = kv.second.first;
-            if (mDataManager->hasTag(tag))
+            continue;
+        }
+        changes->getChanged(changed);
+        for (auto i : changed)
+        {
+            auto address = points[i].first;
+            auto type = points[i].second;
+            if (i < numBinary)
             {
-                bool status = mDataManager->getDataByTag<bool>(tag);
+                bool status = mDataManager->getData<bool>(handles[i]);
                 BACNET_BINARY_PV val = status == true ? BINARY_ACTIVE : BINARY_INACTIVE;
-                if (kv.second.second == PointType::eInput)
+                if (type == PointType::eInput)
                 {
-                    Binary_Input_Present_Value_Set(kv.first, val);
+                    Binary_Input_Present_Value_Set(address, val);
                 }
-                else if (kv.second.second == PointType::eOutput)
+                else if (type == PointType::eOutput)
                 {
-                    Binary_Output_Present_Value_Set(kv.first, val, 0);
+                    Binary_Output_Present_Value_Set(address, val, 0);
                 }
             }
-
-        }
-        for (const auto& kv : mAnalogPoints)
-        {
-            const std::string tag = kv.second.first;
-            if (mDataManager->hasTag(tag))
+            else
             {
-                if (kv.second.second == PointType::eInput)
+                double value = mDataManager->getData<double>(handles[i]);
+                if (type == PointType::eInput)
                 {
-                    Analog_Input_Present_Value_Set(kv.first, mDataManager->getDataByTag<double>(tag));
+                    Analog_Input_Present_Value_Set(address, value);
                 }
-                else if (kv.second.second == PointType::eOutput)
+                else if (type == PointType::eOutput)
                 {
-                    Analog_Output_Present_Value_Set(kv.first, mDataManager->getDataByTag<double>(tag), 16);
+                    Analog_Output_Present_Value_Set(address, value, 16);
                 }
             }
         }
-        std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 }
 
@@ -128,7 +146,7 @@ void Server::writeBinary(std::uint16_t address, bool value)
         logEvent("binary point command", "error", log_stream.str());
         return;
     }
-    mDataManager->addUpdatedBinaryTag(iter->second.first, value);
+    mDataManager->addUpdatedBinaryTag(iter->second.tag, value);
     log_stream.str("");
     log_stream << "Data successfully written.";
     logEvent("write binary", "info", log_stream.str());
@@ -157,7 +175,7 @@ void Server::writeAnalog(std::uint16_t address, float value)
         logEvent("analog point command", "error", log_stream.str());
         return;
     }
-    mDataManager->addUpdatedAnalogTag(iter->second.first, value);
+    mDataManager->addUpdatedAnalogTag(iter->second.tag, value);
     log_stream.str("");
     log_stream << "Data successfully written.";
     logEvent("write analog", "info", log_stream.str());
@@ -167,7 +185,7 @@ bool Server::addBinaryInput(const std::uint16_t address, const std::string& tag)
 {
     if (mDataManager->hasTag(tag))
     {
-        mBinaryPoints[address] = std::make_pair(tag, PointType::eInput);
+        mBinaryPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eInput};
         return true;
     }
     return false;
@@ -177,7 +195,7 @@ bool Server::addBinaryOutput(const std::uint16_t address, const std::string& tag
 {
     if (mDataManager->hasTag(tag))
     {
-        mBinaryPoints[address] = std::make_pair(tag, PointType::eOutput);
+        mBinaryPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eOutput};
         return true;
     }
     return false;
@@ -187,7 +205,7 @@ bool Server::addAnalogInput(const std::uint16_t address, const std::string& tag)
 {
     if (mDataManager->hasTag(tag))
     {
-        mAnalogPoints[address] = std::make_pair(tag, PointType::eInput);
+        mAnalogPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eInput};
         return true;
     }
     return false;
@@ -197,7 +215,7 @@ bool Server::addAnalogOutput(const std::uint16_t address, const std::string& tag
 {
     if (mDataManager->hasTag(tag))
     {
-        mAnalogPoints[address] = std::make_pair(tag, PointType::eOutput);
+        mAnalogPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eOutput};
         return true;
     }
     return false;
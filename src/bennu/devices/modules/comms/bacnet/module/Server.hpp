@@ -20,6 +20,13 @@ enum PointType
     eOutput
 };
 
+struct Point
+{
+    std::string tag;
+    field_device::TagHandle handle;
+    PointType type;
+};
+
 class Server : public CommsModule, public utility::DirectLoggable, public std::enable_shared_from_this<Server>
 {
 public:
@@ -47,8 +54,8 @@ private:
     std::uint16_t mInstance;                            // BACnet device instance of local RTU
     std::shared_ptr<std::thread> pServerThread;			// Server thread
     std::shared_ptr<std::thread> pUpdateThread;			// Data sync update thread
-    std::map<uint16_t, std::pair<std::string, PointType>> mBinaryPoints;
-    std::map<uint16_t, std::pair<std::string, PointType>> mAnalogPoints;
+    std::map<uint16_t, Point> mBinaryPoints;
+    std::map<uint16_t, Point> mAnalogPoints;
     std::ostringstream mLogStream;                      // Logging output stream
 };
 
@@ -2,6 +2,9 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
+
+#include "bennu/distributed/BulkRequest.hpp"
 
 #include "bennu/devices/modules/comms/base/Common.hpp"
 #include "bennu/devices/modules/comms/base/CommsClient.hpp"
@@ -51,43 +54,29 @@ zmq::message_t CommandInterface::messageHandler(const zmq::message_t& req)
     }
     else if (op == "READ" || op == "read")
     {
-        if (!mClient.lock()->isValidTag(tag))
+        if (distributed::BulkRequest(tag, false).isSingle())
         {
-            reply += "ERR=Client does not have a mapping for tag '" + tag + "'";
+            reply += readTag(tag);
         }
         else
         {
-            RegisterDescriptor rd;
-            auto result = mClient.lock()->readTag(tag, rd);
-            if (result.status)
-            {
-                switch (rd.mRegisterType)
-                {
-                    case comms::eValueReadWrite:
-                    case comms::eValueReadOnly:
-                    {
-                        reply += "ACK=" + tag + ":" + std::to_string(rd.mFloatValue);
-                        break;
-                    }
-                    case comms::eStatusReadWrite:
-                    case comms::eStatusReadOnly:
-                    {
-                        std::string str = rd.mStatus ? "true" : "false";
-                        reply += "ACK=" + tag + ":" + str;
-                        break;
-                    }
-                    default:
-                    {
-                        reply += "ERR=Client had a problem reading tag '" + tag + "'";
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                std::string msg(result.message); // convert char* to string
-                reply += "ERR=Failed reading tag '" + tag + "': " + msg;
-            }
+            return bulkRead(tag, false);
+        }
+    }
+    else if (op == "SNAPSHOT" || op == "snapshot")
+    {
+        return bulkRead(tag, true);
+    }
+    else if (op == "STATS" || op == "stats")
+    {
+        auto stats = mClient.lock()->getStatistics();
+        if (stats.empty())
+        {
+            reply += "ERR=Client is not scanning";
+        }
+        else
+        {
+            reply += "ACK=" + stats;
         }
     }
     else if (op == "WRITE" || op == "write")
@@ -131,12 +120,82 @@ zmq::message_t CommandInterface::messageHandler(const zmq::message_t& req)
     }
     else
     {
-        reply += "ERR=Unknown command type (must be QUERY|READ|WRITE)";
+        reply += "ERR=Unknown command type (must be QUERY|READ|SNAPSHOT|STATS|WRITE)";
     }
     printf("Sending reply for tag %s -- %s\n", tag.data(), reply.data());
     zmq::message_t repMsg(reply+'\0'); // must include null byte
     return repMsg;
 }
 
+std::string CommandInterface::readTag(const std::string& tag)
+{
+    auto client = mClient.lock();
+    if (!client->isValidTag(tag))
+    {
+        return "ERR=Client does not have a mapping for tag '" + tag + "'";
+    }
+
+    RegisterDescriptor rd;
+    auto result = client->readTag(tag, rd);
+    if (!result.status)
+    {
+        std::string msg(result.message); // convert char* to string
+        return "ERR=Failed reading tag '" + tag + "': " + msg;
+    }
+    return formatTag(tag, rd);
+}
+
+std::string CommandInterface::formatTag(const std::string& tag, const RegisterDescriptor& rd)
+{
+    switch (rd.mRegisterType)
+    {
+        case comms::eValueReadWrite:
+        case comms::eValueReadOnly:
+        {
+            return "ACK=" + tag + ":" + std::to_string(rd.mFloatValue);
+        }
+        case comms::eStatusReadWrite:
+        case comms::eStatusReadOnly:
+        {
+            std::string str = rd.mStatus ? "true" : "false";
+            return "ACK=" + tag + ":" + str;
+        }
+        default:
+        {
+            return "ERR=Client had a problem reading tag '" + tag + "'";
+        }
+    }
+}
+
+zmq::message_t CommandInterface::bulkRead(const std::string& payload, const bool snapshot)
+{
+    distributed::BulkRequest request(payload, snapshot);
+    if (request.hasPatterns())
+    {
+        auto tags = mClient.lock()->getTags();
+        if (!request.select(std::vector<std::string>(tags.begin(), tags.end())))
+        {
+            return request.reply("ERR=No tags match '" + payload + "'");
+        }
+    }
+
+    // read together so the client can coalesce requests; tags it cannot read are left out
+    const auto& tags = request.getTags();
+    std::vector<RegisterDescriptor> rds;
+    mClient.lock()->readTags(tags, rds);
+    std::string reply = "ACK=";
+    bool found = false;
+    for (std::size_t i = 0; i < tags.size(); ++i)
+    {
+        std::string value = formatTag(tags[i], rds[i]);
+        if (value.compare(0, 4, "ACK=") == 0)
+        {
+            reply.append(value, 4, std::string::npos).append(",");
+            found = true;
+        }
+    }
+    return request.reply(found ? reply : "ERR=Tags not found");
+}
+
 } // namespace comms
 } // namespace bennu
@@ -3,12 +3,14 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <thread>
 
 #include "zmq/zmq.hpp"
 
 #include "bennu/distributed/Server.hpp"
 #include "bennu/distributed/Utils.hpp"
+#include "bennu/devices/modules/comms/base/Common.hpp"
 
 namespace bennu {
 namespace comms {
@@ -28,6 +30,15 @@ public:
 protected:
     virtual zmq::message_t messageHandler(const zmq::message_t& req);
 
+    // "ACK=<tag>:<value>" or "ERR=<error message>"
+    std::string readTag(const std::string& tag);
+
+    // "ACK=<tag>:<value>" for a register read by the client
+    std::string formatTag(const std::string& tag, const comms::RegisterDescriptor& rd);
+
+    // Many-tag READ and SNAPSHOT (see distributed/BulkRequest.hpp)
+    zmq::message_t bulkRead(const std::string& payload, const bool snapshot);
+
 private:
     std::weak_ptr<CommsClient> mClient;
     std::shared_ptr<std::thread> mThread;
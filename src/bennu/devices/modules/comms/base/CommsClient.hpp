@@ -4,6 +4,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "bennu/devices/modules/comms/base/Common.hpp"
 #include "bennu/devices/modules/comms/base/CommsModule.hpp"
@@ -27,6 +28,25 @@ public:
     virtual StatusMessage writeBinaryTag(const std::string& tag, bool status) = 0;
     virtual StatusMessage writeAnalogTag(const std::string& tag, double value) = 0;
 
+    // Read many tags at once; 'rds' matches 'tags', with type eNone for tags that could not be read
+    virtual void readTags(const std::vector<std::string>& tags, std::vector<comms::RegisterDescriptor>& rds) const
+    {
+        rds.assign(tags.size(), comms::RegisterDescriptor());
+        for (std::size_t i = 0; i < tags.size(); ++i)
+        {
+            if (!isValidTag(tags[i]) || !readTag(tags[i], rds[i]).status)
+            {
+                rds[i] = comms::RegisterDescriptor();
+            }
+        }
+    }
+
+    // Scan statistics for the STATS command, one line per scanned block; empty if the client does not scan
+    virtual std::string getStatistics() const
+    {
+        return "";
+    }
+
     void addCommandInterface(std::shared_ptr<CommandInterface> ci)
     {
         mCommandInterface = ci;
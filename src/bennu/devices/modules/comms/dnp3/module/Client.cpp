@@ -5,6 +5,8 @@
 
 #include "opendnp3/ConsoleLogger.h"
 
+#include "bennu/devices/modules/comms/dnp3/module/Manager.hpp"
+
 namespace bennu {
 namespace comms {
 namespace dnp3 {
@@ -19,8 +21,8 @@ Client::Client() :
     comms::CommsClient(),
     bennu::utility::DirectLoggable("dnp3-client")
 {
-    // Initialize master stack
-    mManager.reset(new opendnp3::DNP3Manager(std::thread::hardware_concurrency(), opendnp3::ConsoleLogger::Create()));
+    // Masters share the process wide stack manager
+    mManager = getSharedManager();
 }
 
 
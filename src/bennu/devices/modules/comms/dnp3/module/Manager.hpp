@@ -0,0 +1,34 @@
+#ifndef BENNU_FIELDDEVICE_COMMS_DNP3_MANAGER_HPP
+#define BENNU_FIELDDEVICE_COMMS_DNP3_MANAGER_HPP
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "opendnp3/ConsoleLogger.h"
+#include "opendnp3/DNP3Manager.h"
+
+#include "bennu/utility/WorkerPool.hpp"
+
+namespace bennu {
+namespace comms {
+namespace dnp3 {
+
+/*
+ * One DNP3 stack manager (and its thread pool) for every outstation and
+ * master in the process, instead of a full set of threads per device. Sized
+ * to the shared WorkerPool when one is running.
+ */
+inline std::shared_ptr<opendnp3::DNP3Manager> getSharedManager()
+{
+    static std::shared_ptr<opendnp3::DNP3Manager> manager(new opendnp3::DNP3Manager(
+        static_cast<uint32_t>(std::max<std::size_t>(1, utility::WorkerPool::the()->size() > 0 ? utility::WorkerPool::the()->size() : std::thread::hardware_concurrency())),
+        opendnp3::ConsoleLogger::Create()));
+    return manager;
+}
+
+} // namespace dnp3
+} // namespace comms
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_COMMS_DNP3_MANAGER_HPP
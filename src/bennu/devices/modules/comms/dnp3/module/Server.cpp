@@ -1,3 +1,4 @@
+#include "bennu/devices/modules/comms/dnp3/module/Manager.hpp"
 #include "bennu/devices/modules/comms/dnp3/module/Server.hpp"
 #include "bennu/devices/modules/comms/dnp3/module/ServerCommandHandler.hpp"
 
@@ -18,8 +19,8 @@ namespace dnp3 {
 Server::Server(std::shared_ptr<field_device::DataManager> dm) :
     bennu::utility::DirectLoggable("dnp3-server")
 {
-    // Initialize outstation stack
-    mManager.reset(new opendnp3::DNP3Manager(std::thread::hardware_concurrency(), opendnp3::ConsoleLogger::Create()));
+    // Outstations share the process wide stack manager
+    mManager = getSharedManager();
     setDataManager(dm);
 }
 
@@ -133,34 +134,58 @@ void Server::start()
     mUpdateThread.reset(new std::thread(std::bind(&Server::update, this)));
 }
 
+/*
+ * Push datastore changes into the outstation database as soon as they happen.
+ * Only points whose value changed since the last pass are applied.
+ */
 void Server::update()
 {
+    // Subscription indices: binary points first, then analog points (both in address order)
+    std::vector<field_device::TagHandle> handles;
+    std::vector<std::uint16_t> addresses;
+    for (const auto& kv : mBinaryPoints)
+    {
+        handles.push_back(kv.second.handle);
+        addresses.push_back(kv.first);
+    }
+    for (const auto& kv : mAnalogPoints)
+    {
+        handles.push_back(kv.second.handle);
+        addresses.push_back(kv.first);
+    }
+    const std::size_t numBinary = mBinaryPoints.size();
+
+    auto changes = mDataManager->subscribe(handles);
+    std::vector<std::size_t> changed;
     while (1)
     {
-        for (const auto& kv : mBinaryPoints)
+        if (!changes->wait(std::chrono::seconds(1)))
         {
-            const std::string tag = kv.second.tag;
-            if (mDataManager->hasTag(tag))
-            {
-                opendnp3::UpdateBuilder builder;
-                builder.Update(opendnp3::Binary(mDataManager->getDataByTag<bool>(tag)), kv.first);
-                mOutstation->Apply(builder.Build());
-            }
+            continue;
         }
-        for (const auto& kv : mAnalogPoints)
+        changes->getChanged(changed);
+        if (changed.empty())
         {
-            const std::string tag = kv.second.tag;
-            if (mDataManager->hasTag(tag))
+            continue;
+        }
+
+        opendnp3::UpdateBuilder builder;
+        for (auto i : changed)
+        {
+            mDataManager->traceRead(handles[i]);
+            if (i < numBinary)
+            {
+                builder.Update(opendnp3::Binary(mDataManager->getData<bool>(handles[i])), addresses[i]);
+            }
+            else
             {
-                opendnp3::UpdateBuilder builder;
-                double ts = mDataManager->getTimestampByTag(tag);
-                builder.Update(opendnp3::Analog(mDataManager->getDataByTag<double>(tag),
+                double ts = mDataManager->getTimestamp(handles[i]);
+                builder.Update(opendnp3::Analog(mDataManager->getData<double>(handles[i]),
                                                 opendnp3::Flags(0x01),
-                                                opendnp3::DNPTime(ts)), kv.first);
-                mOutstation->Apply(builder.Build());
+                                                opendnp3::DNPTime(ts)), addresses[i]);
             }
         }
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        mOutstation->Apply(builder.Build());
     }
 }
 
@@ -249,6 +274,7 @@ bool Server::addBinaryInput
 
         point.address = address;
         point.tag = tag;
+        point.handle = mDataManager->getTagHandle(tag);
         point.svariation = sgv;
         point.evariation = egv;
         point.clazz = cls;
@@ -267,6 +293,7 @@ bool Server::addBinaryOutput(const std::uint16_t address, const std::string& tag
         Point<opendnp3::StaticBinaryVariation, opendnp3::EventBinaryVariation> point;
         point.address = address;
         point.tag = tag;
+        point.handle = mDataManager->getTagHandle(tag);
         point.sbo = sbo;
 
         mBinaryPoints[address] = point;
@@ -343,6 +370,7 @@ bool Server::addAnalogInput
 
         point.address = address;
         point.tag = tag;
+        point.handle = mDataManager->getTagHandle(tag);
         point.svariation = sgv;
         point.evariation = egv;
         point.clazz = cls;
@@ -363,6 +391,7 @@ bool Server::addAnalogOutput(const std::uint16_t address, const std::string& tag
         Point<opendnp3::StaticAnalogVariation, opendnp3::EventAnalogVariation> point;
         point.address = address;
         point.tag = tag;
+        point.handle = mDataManager->getTagHandle(tag);
         point.sbo = sbo;
 
         mAnalogPoints[address] = point;
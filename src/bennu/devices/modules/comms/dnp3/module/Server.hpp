@@ -23,6 +23,8 @@ struct Point {
     uint16_t    address {};
     std::string tag     {};
 
+    field_device::TagHandle handle {};
+
     S svariation {};
     E evariation {};
 
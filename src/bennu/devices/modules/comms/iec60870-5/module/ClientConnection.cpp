@@ -15,8 +15,8 @@ ClientConnection::ClientConnection(const std::string& rtuEndpoint) :
 
 void ClientConnection::start(std::shared_ptr<ClientConnection> clientConnection)
 {
-    // Set static shared_ptr to client connection instance so it can be used inside static 104 callback handlers
-    gClientConnection = clientConnection;
+    // Keep this instance alive for the 104 callback handlers, which get it as their parameter
+    mSelf = clientConnection;
     // If endpoint starts with tcp://, parse ip/port and use TCP
     std::size_t findResult = mRtuEndpoint.find("tcp://");
 
@@ -33,11 +33,11 @@ void ClientConnection::start(std::shared_ptr<ClientConnection> clientConnection)
         CS101_AppLayerParameters alParams = CS104_Connection_getAppLayerParameters(mConnection);
         alParams->originatorAddress = 3;
 
-        CS104_Connection_setConnectionHandler(mConnection, connectionHandler, NULL);
-        CS104_Connection_setASDUReceivedHandler(mConnection, asduReceivedHandler, NULL);
+        CS104_Connection_setConnectionHandler(mConnection, connectionHandler, this);
+        CS104_Connection_setASDUReceivedHandler(mConnection, asduReceivedHandler, this);
 
         /* uncomment to log messages */
-        //CS104_Connection_setRawMessageHandler(mConnection, rawMessageHandler, NULL);
+        //CS104_Connection_setRawMessageHandler(mConnection, rawMessageHandler, this);
 
         if (CS104_Connection_connect(mConnection))
         {
@@ -178,6 +178,7 @@ void ClientConnection::connectionHandler(void* parameter, CS104_Connection conne
  */
 bool ClientConnection::asduReceivedHandler(void* parameter, int address, CS101_ASDU asdu)
 {
+    auto connection = static_cast<ClientConnection*>(parameter);
     printf("RECVD ASDU type: %s(%i) elements: %i\n",
             TypeID_toString(CS101_ASDU_getTypeID(asdu)),
             CS101_ASDU_getTypeID(asdu),
@@ -199,7 +200,7 @@ bool ClientConnection::asduReceivedHandler(void* parameter, int address, CS101_A
             double value = MeasuredValueShort_getValue((MeasuredValueShort) io);
             printf("    IOA: %i value: %f\n", addr, value);
 
-            gClientConnection->updateAnalog(addr, value);
+            connection->updateAnalog(addr, value);
 
             MeasuredValueShort_destroy(io);
         }
@@ -234,7 +235,7 @@ bool ClientConnection::asduReceivedHandler(void* parameter, int address, CS101_A
             }
             printf("    IOA: %i value: %i\n", addr, status);
 
-            gClientConnection->updateBinary(addr, status);
+            connection->updateBinary(addr, status);
 
             DoublePointInformation_destroy(io);
         }
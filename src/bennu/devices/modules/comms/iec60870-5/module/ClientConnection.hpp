@@ -84,13 +84,11 @@ private:
     std::map<std::uint16_t, std::string> mBinaryAddressToTagMapping;
     std::map<std::uint16_t, std::string> mAnalogAddressToTagMapping;
     std::map<std::string, comms::RegisterDescriptor> mRegisters;
+    std::shared_ptr<ClientConnection> mSelf;    // passed to start(); 104 callbacks get this instance as their parameter
     
 
 };
 
-// Static shared_ptr to client connection instance so it can be used inside static 104 callback handlers
-static std::shared_ptr<ClientConnection> gClientConnection;
-
 } // namespace iec60870
 } // namespace comms
 } // namespace bennu
@@ -87,8 +87,8 @@ void DataHandler::parseServerTree(std::shared_ptr<Server> server, const ptree& t
             std::cout << "add iec60870-5-104 analog-output " << tag << std::endl;
         }
         // Initialize and start 104 server
-        //   - Pass server pointer to Server::start() so Server::gServer can be set statically
-        //     and used inside static 104 handlers
+        //   - Pass server pointer to Server::start() so it outlives the static 104 handlers,
+        //     which are given the instance as their parameter (one per device, no globals)
         server->start(endpoint, server, rPollRate, subtype);
     }
     catch (ptree_bad_path& e)
@@ -153,9 +153,9 @@ void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &t
             }
 
             // Initialize and start 104 client connection
-            //   - Pass client connection pointer to ClientConnetion::start() so
-            //     ClientConnection::gClientConnection can be set statically
-            //     and used inside static 104 handlers
+            //   - Pass client connection pointer to ClientConnection::start() so it
+            //     outlives the static 104 handlers, which are given the instance
+            //     as their parameter
             connection->start(connection);
         }
 
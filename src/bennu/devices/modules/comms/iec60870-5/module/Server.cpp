@@ -1,5 +1,6 @@
 #include "Server.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 
@@ -21,8 +22,8 @@ void Server::start(const std::string& endpoint, std::shared_ptr<Server> server,
 {
     // Set server reverse-poll rate
     mReversePollRate = rPollRate;
-    // Set static shared_ptr to server instance so it can be used inside static 104 callback handlers
-    gServer = server;
+    // Keep this instance alive for the 104 callback handlers, which get it as their parameter
+    mSelf = server;
     // If endpoint starts with tcp://, parse ip/port and use TCP
     std::size_t findResult = endpoint.find("tcp://");
 
@@ -47,20 +48,20 @@ void Server::start(const std::string& endpoint, std::shared_ptr<Server> server,
         // Set the callback handler for the interrogation command
         if (subtype.find("double") != std::string::npos)
         {
-            CS104_Slave_setInterrogationHandler(slave, interrogationHandlerDoublePoint, NULL);
+            CS104_Slave_setInterrogationHandler(slave, interrogationHandlerDoublePoint, this);
         }
         else
         {
-            CS104_Slave_setInterrogationHandler(slave, interrogationHandlerSinglePoint, NULL);
+            CS104_Slave_setInterrogationHandler(slave, interrogationHandlerSinglePoint, this);
         }
         // Set handler for other message types
-        CS104_Slave_setASDUHandler(slave, asduHandler, NULL);
+        CS104_Slave_setASDUHandler(slave, asduHandler, this);
         // Set handler to handle connection requests (optional)
-        CS104_Slave_setConnectionRequestHandler(slave, connectionRequestHandler, NULL);
+        CS104_Slave_setConnectionRequestHandler(slave, connectionRequestHandler, this);
         // Set handler to track connection events (optional)
-        CS104_Slave_setConnectionEventHandler(slave, connectionEventHandler, NULL);
+        CS104_Slave_setConnectionEventHandler(slave, connectionEventHandler, this);
         // Uncomment to log messages
-        //CS104_Slave_setRawMessageHandler(slave, rawMessageHandler, NULL);
+        //CS104_Slave_setRawMessageHandler(slave, rawMessageHandler, this);
 
         // Start 104 slave thread
         std::cout << "starting slave: " << endpoint << std::endl;
@@ -141,127 +142,119 @@ void Server::sendSpontaneousUpdate(IMasterConnection connection, int ioa, Double
 }
 
 /*
- * Reverse poll loop that sends local bennu datastore data to
+ * Reverse poll loop that sends local bennu datastore changes to
  * connected clients. Sends indications as single point values
  */
 void Server::reversePollSinglePoint()
 {
-    while (1)
-    {
-        if (mConnected)
-        {
-            CS101_AppLayerParameters alParams = IMasterConnection_getApplicationLayerParameters(mConnection);
-
-            // Send binary values
-            CS101_ASDU newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_PERIODIC, 0, 1, false, false);
-            // kv = {<address>: {<tag>, eInput}}
-            for (const auto &kv : gServer->mBinaryPoints)
-            {
-                const std::string tag = kv.second.first;
-                if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
-                {
-                    // Send current ASDU and create a new one for the remaining values
-                    IMasterConnection_sendASDU(mConnection, newAsdu);
-                    CS101_ASDU_destroy(newAsdu);
-                    newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_PERIODIC, 0, 1, false, false);
-                }
-
-                if (gServer->mDataManager->hasTag(tag))
-                {
-                    auto status = gServer->mDataManager->getDataByTag<bool>(tag);
-                    InformationObject io = (InformationObject)SinglePointInformation_create(NULL, kv.first, status, IEC60870_QUALITY_GOOD);
-                    CS101_ASDU_addInformationObject(newAsdu, io);
-                    InformationObject_destroy(io);
-                }
-            }
-            IMasterConnection_sendASDU(mConnection, newAsdu);
-            CS101_ASDU_destroy(newAsdu);
-
-            // Send analog values
-            newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_PERIODIC, 0, 1, false, false);
-            // kv = {<address>: {<tag>, eInput}}
-            for (const auto &kv : gServer->mAnalogPoints)
-            {
-                const std::string tag = kv.second.first;
-                if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
-                {
-                    // Send current ASDU and create a new one for the remaining values
-                    IMasterConnection_sendASDU(mConnection, newAsdu);
-                    CS101_ASDU_destroy(newAsdu);
-                    newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_PERIODIC, 0, 1, false, false);
-                }
-
-                if (gServer->mDataManager->hasTag(tag))
-                {
-                    auto val = gServer->mDataManager->getDataByTag<double>(tag);
-                    InformationObject io = (InformationObject)MeasuredValueShort_create(NULL, kv.first, val, IEC60870_QUALITY_GOOD);
-                    CS101_ASDU_addInformationObject(newAsdu, io);
-                    InformationObject_destroy(io);
-                }
-            }
-            IMasterConnection_sendASDU(mConnection, newAsdu);
-            CS101_ASDU_destroy(newAsdu);
-            std::this_thread::sleep_for(std::chrono::seconds(mReversePollRate));
-        }
-        else
-        {
-            // Wait until connected to client
-            while (!mConnected) { std::this_thread::sleep_for(std::chrono::seconds(1)); }
-        }
-    }
+    reportChanges(false);
 }
 
 /*
- * Reverse poll loop that sends local bennu datastore data to
+ * Reverse poll loop that sends local bennu datastore changes to
  * connected clients. Sends indications as double point values
  */
 void Server::reversePollDoublePoint()
 {
+    reportChanges(true);
+}
+
+/*
+ * Send points to the connected client as spontaneous updates as soon as the
+ * datastore reports their value changed. A newly connected client is sent
+ * every point once. The reverse-poll rate is only how often the loop wakes up
+ * to check the connection when nothing is changing.
+ */
+void Server::reportChanges(const bool doublePoint)
+{
+    // Subscription indices: binary points first, then analog points (both in address order)
+    std::vector<field_device::TagHandle> handles;
+    std::vector<std::uint16_t> addresses;
+    for (const auto& kv : mBinaryPoints)
+    {
+        handles.push_back(kv.second.handle);
+        addresses.push_back(kv.first);
+    }
+    for (const auto& kv : mAnalogPoints)
+    {
+        handles.push_back(kv.second.handle);
+        addresses.push_back(kv.first);
+    }
+    const std::size_t numBinary = mBinaryPoints.size();
+
+    auto changes = mDataManager->subscribe(handles);
+    std::vector<std::size_t> changed;
+    bool connected = false;
     while (1)
     {
-        if (mConnected)
+        changes->wait(std::chrono::seconds(std::max<std::uint32_t>(mReversePollRate, 1)));
+        if (!mConnected)
+        {
+            connected = false;
+            continue;
+        }
+        if (!connected)
         {
-            CS101_AppLayerParameters alParams = IMasterConnection_getApplicationLayerParameters(mConnection);
+            connected = true;
+            changes->markAll();
+        }
+        changes->getChanged(changed);
+        if (changed.empty())
+        {
+            continue;
+        }
+
+        CS101_AppLayerParameters alParams = IMasterConnection_getApplicationLayerParameters(mConnection);
+        CS101_ASDU newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_SPONTANEOUS, 0, 1, false, false);
+        auto i = changed.begin();
 
-            // Send binary values
-            // kv = {<address>: {<tag>, eInput}}
-            for (const auto &kv : gServer->mBinaryPoints)
+        // Send binary values
+        for (; i != changed.end() && *i < numBinary; ++i)
+        {
+            bool status = mDataManager->getData<bool>(handles[*i]);
+            if (doublePoint)
             {
-                const std::string tag = kv.second.first;
-                sendSpontaneousUpdate(mConnection, kv.first, convertBoolToDPValue(gServer->mDataManager->getDataByTag<bool>(tag)));
+                sendSpontaneousUpdate(mConnection, addresses[*i], convertBoolToDPValue(status));
+                continue;
             }
-
-            // Send analog values
-            CS101_ASDU newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_PERIODIC, 0, 1, false, false);
-            // kv = {<address>: {<tag>, eInput}}
-            for (const auto &kv : gServer->mAnalogPoints)
+            if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
             {
-                const std::string tag = kv.second.first;
-                if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
-                {
-                    // Send current ASDU and create a new one for the remaining values
-                    IMasterConnection_sendASDU(mConnection, newAsdu);
-                    CS101_ASDU_destroy(newAsdu);
-                    newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_PERIODIC, 0, 1, false, false);
-                }
-
-                if (gServer->mDataManager->hasTag(tag))
-                {
-                    auto val = gServer->mDataManager->getDataByTag<double>(tag);
-                    InformationObject io = (InformationObject)MeasuredValueShort_create(NULL, kv.first, val, IEC60870_QUALITY_GOOD);
-                    CS101_ASDU_addInformationObject(newAsdu, io);
-                    InformationObject_destroy(io);
-                }
+                // Send current ASDU and create a new one for the remaining values
+                IMasterConnection_sendASDU(mConnection, newAsdu);
+                CS101_ASDU_destroy(newAsdu);
+                newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_SPONTANEOUS, 0, 1, false, false);
             }
+            InformationObject io = (InformationObject)SinglePointInformation_create(NULL, addresses[*i], status, IEC60870_QUALITY_GOOD);
+            CS101_ASDU_addInformationObject(newAsdu, io);
+            InformationObject_destroy(io);
+        }
+        if (CS101_ASDU_getNumberOfElements(newAsdu) > 0)
+        {
             IMasterConnection_sendASDU(mConnection, newAsdu);
             CS101_ASDU_destroy(newAsdu);
-            std::this_thread::sleep_for(std::chrono::seconds(mReversePollRate));
+            newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_SPONTANEOUS, 0, 1, false, false);
         }
-        else
+
+        // Send analog values
+        for (; i != changed.end(); ++i)
         {
-            // Wait until connected to client
-            while (!mConnected) { std::this_thread::sleep_for(std::chrono::seconds(1)); }
+            if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
+            {
+                // Send current ASDU and create a new one for the remaining values
+                IMasterConnection_sendASDU(mConnection, newAsdu);
+                CS101_ASDU_destroy(newAsdu);
+                newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_SPONTANEOUS, 0, 1, false, false);
+            }
+            auto val = mDataManager->getData<double>(handles[*i]);
+            InformationObject io = (InformationObject)MeasuredValueShort_create(NULL, addresses[*i], val, IEC60870_QUALITY_GOOD);
+            CS101_ASDU_addInformationObject(newAsdu, io);
+            InformationObject_destroy(io);
+        }
+        if (CS101_ASDU_getNumberOfElements(newAsdu) > 0)
+        {
+            IMasterConnection_sendASDU(mConnection, newAsdu);
         }
+        CS101_ASDU_destroy(newAsdu);
     }
 }
 
@@ -289,6 +282,7 @@ void Server::rawMessageHandler(void *parameter, IMasterConnection con, uint8_t *
 */
 bool Server::interrogationHandlerSinglePoint(void *parameter, IMasterConnection connection, CS101_ASDU asdu, uint8_t qoi)
 {
+    auto server = static_cast<Server*>(parameter);
     std::cout << "Received interrogation for group " << static_cast<int16_t>(qoi) << std::endl;
 
     if (qoi == 20) /* only handle station interrogation */
@@ -299,9 +293,9 @@ bool Server::interrogationHandlerSinglePoint(void *parameter, IMasterConnection
         // Send binary values
         CS101_ASDU newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
         // kv = {<address>: {<tag>, eInput}}
-        for (const auto &kv : gServer->mBinaryPoints)
+        for (const auto &kv : server->mBinaryPoints)
         {
-            const std::string tag = kv.second.first;
+            const std::string tag = kv.second.tag;
             if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
             {
                 // Send current ASDU and create a new one for the remaining values
@@ -310,9 +304,9 @@ bool Server::interrogationHandlerSinglePoint(void *parameter, IMasterConnection
                 newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
             }
 
-            if (gServer->mDataManager->hasTag(tag))
+            if (server->mDataManager->hasTag(tag))
             {
-                auto status = gServer->mDataManager->getDataByTag<bool>(tag);
+                auto status = server->mDataManager->getDataByTag<bool>(tag);
                 InformationObject io = (InformationObject)SinglePointInformation_create(NULL, kv.first, status, IEC60870_QUALITY_GOOD);
                 CS101_ASDU_addInformationObject(newAsdu, io);
                 InformationObject_destroy(io);
@@ -324,9 +318,9 @@ bool Server::interrogationHandlerSinglePoint(void *parameter, IMasterConnection
         // Send analog values
         newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
         // kv = {<address>: {<tag>, eInput}}
-        for (const auto &kv : gServer->mAnalogPoints)
+        for (const auto &kv : server->mAnalogPoints)
         {
-            const std::string tag = kv.second.first;
+            const std::string tag = kv.second.tag;
             if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
             {
                 // Send current ASDU and create a new one for the remaining values
@@ -335,9 +329,9 @@ bool Server::interrogationHandlerSinglePoint(void *parameter, IMasterConnection
                 newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
             }
 
-            if (gServer->mDataManager->hasTag(tag))
+            if (server->mDataManager->hasTag(tag))
             {
-                auto val = gServer->mDataManager->getDataByTag<double>(tag);
+                auto val = server->mDataManager->getDataByTag<double>(tag);
                 InformationObject io = (InformationObject)MeasuredValueShort_create(NULL, kv.first, val, IEC60870_QUALITY_GOOD);
                 CS101_ASDU_addInformationObject(newAsdu, io);
                 InformationObject_destroy(io);
@@ -360,6 +354,7 @@ bool Server::interrogationHandlerSinglePoint(void *parameter, IMasterConnection
 */
 bool Server::interrogationHandlerDoublePoint(void *parameter, IMasterConnection connection, CS101_ASDU asdu, uint8_t qoi)
 {
+    auto server = static_cast<Server*>(parameter);
     std::cout << "Received interrogation for group " << static_cast<int16_t>(qoi) << std::endl;
 
     if (qoi == 20) /* only handle station interrogation */
@@ -370,9 +365,9 @@ bool Server::interrogationHandlerDoublePoint(void *parameter, IMasterConnection
         // Send binary values
         CS101_ASDU newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
         // kv = {<address>: {<tag>, eInput}}
-        for (const auto &kv : gServer->mBinaryPoints)
+        for (const auto &kv : server->mBinaryPoints)
         {
-            const std::string tag = kv.second.first;
+            const std::string tag = kv.second.tag;
             if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
             {
                 // Send current ASDU and create a new one for the remaining values
@@ -381,9 +376,9 @@ bool Server::interrogationHandlerDoublePoint(void *parameter, IMasterConnection
                 newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
             }
 
-            if (gServer->mDataManager->hasTag(tag))
+            if (server->mDataManager->hasTag(tag))
             {
-                auto status = Server::convertBoolToDPValue(gServer->mDataManager->getDataByTag<bool>(tag));
+                auto status = Server::convertBoolToDPValue(server->mDataManager->getDataByTag<bool>(tag));
                 InformationObject io = (InformationObject)DoublePointInformation_create(NULL, kv.first, status, IEC60870_QUALITY_GOOD);
                 CS101_ASDU_addInformationObject(newAsdu, io);
                 InformationObject_destroy(io);
@@ -395,9 +390,9 @@ bool Server::interrogationHandlerDoublePoint(void *parameter, IMasterConnection
         // Send analog values
         newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
         // kv = {<address>: {<tag>, eInput}}
-        for (const auto &kv : gServer->mAnalogPoints)
+        for (const auto &kv : server->mAnalogPoints)
         {
-            const std::string tag = kv.second.first;
+            const std::string tag = kv.second.tag;
             if (CS101_ASDU_getPayloadSize(newAsdu) >= MAX_ASDU_PAYLOAD_SIZE)
             {
                 // Send current ASDU and create a new one for the remaining values
@@ -406,9 +401,9 @@ bool Server::interrogationHandlerDoublePoint(void *parameter, IMasterConnection
                 newAsdu = CS101_ASDU_create(alParams, false, CS101_COT_INTERROGATED_BY_STATION, 0, 1, false, false);
             }
 
-            if (gServer->mDataManager->hasTag(tag))
+            if (server->mDataManager->hasTag(tag))
             {
-                auto val = gServer->mDataManager->getDataByTag<double>(tag);
+                auto val = server->mDataManager->getDataByTag<double>(tag);
                 InformationObject io = (InformationObject)MeasuredValueShort_create(NULL, kv.first, val, IEC60870_QUALITY_GOOD);
                 CS101_ASDU_addInformationObject(newAsdu, io);
                 InformationObject_destroy(io);
@@ -428,6 +423,7 @@ bool Server::interrogationHandlerDoublePoint(void *parameter, IMasterConnection
 
 bool Server::asduHandler(void *parameter, IMasterConnection connection, CS101_ASDU asdu)
 {
+    auto server = static_cast<Server*>(parameter);
     if (CS101_ASDU_getTypeID(asdu) == C_SC_NA_1)
     {
         std::cout << "received single command" << std::endl;
@@ -442,7 +438,7 @@ bool Server::asduHandler(void *parameter, IMasterConnection connection, CS101_AS
                 uint16_t addr = InformationObject_getObjectAddress(io);
                 bool state = SingleCommand_getState(sc);
                 printf("IOA: %i switch to %i\n", addr, state);
-                gServer->writeBinary(addr, state);
+                server->writeBinary(addr, state);
                 CS101_ASDU_setCOT(asdu, CS101_COT_ACTIVATION_CON);
                 InformationObject_destroy(io);
             }
@@ -476,7 +472,7 @@ bool Server::asduHandler(void *parameter, IMasterConnection connection, CS101_AS
                 uint16_t addr = InformationObject_getObjectAddress(io);
                 int state = DoubleCommand_getState(dc);
                 printf("IOA: %i switch to %i\n", addr, state);
-                gServer->writeBinary(addr, state);
+                server->writeBinary(addr, state);
                 // Send activation termination
                 CS101_ASDU_setCOT(asdu, CS101_COT_ACTIVATION_TERMINATION);
                 InformationObject_destroy(io);
@@ -510,7 +506,7 @@ bool Server::asduHandler(void *parameter, IMasterConnection connection, CS101_AS
                 uint16_t addr = InformationObject_getObjectAddress(io);
                 float value = SetpointCommandShort_getValue(sc);
                 printf("IOA: %i switch to %f\n", addr, value);
-                gServer->writeAnalog(addr, value);
+                server->writeAnalog(addr, value);
                 CS101_ASDU_setCOT(asdu, CS101_COT_ACTIVATION_CON);
                 InformationObject_destroy(io);
             }
@@ -539,16 +535,17 @@ bool Server::connectionRequestHandler(void *parameter, const char *ipAddress)
 
 void Server::connectionEventHandler(void *parameter, IMasterConnection con, CS104_PeerConnectionEvent event)
 {
+    auto server = static_cast<Server*>(parameter);
     if (event == CS104_CON_EVENT_CONNECTION_OPENED)
     {
         printf("Connection opened (%p)\n", con);
-        gServer->mConnection = con;
-        gServer->mConnected = true;
+        server->mConnection = con;
+        server->mConnected = true;
     }
     else if (event == CS104_CON_EVENT_CONNECTION_CLOSED)
     {
         printf("Connection closed (%p)\n", con);
-        gServer->mConnected = false;
+        server->mConnected = false;
     }
     else if (event == CS104_CON_EVENT_ACTIVATED)
     {
@@ -576,7 +573,7 @@ void Server::writeBinary(std::uint16_t address, bool value)
         logEvent("binary point command", "error", log_stream.str());
         return;
     }
-    mDataManager->addUpdatedBinaryTag(iter->second.first, value);
+    mDataManager->addUpdatedBinaryTag(iter->second.tag, value);
     log_stream.str("");
     log_stream << "Data successfully written.";
     logEvent("write binary", "info", log_stream.str());
@@ -615,7 +612,7 @@ void Server::writeBinary(std::uint16_t address, int value)
         logEvent("binary point command", "error", log_stream.str());
         bvalue = 0;
     }
-    mDataManager->addUpdatedBinaryTag(iter->second.first, bvalue);
+    mDataManager->addUpdatedBinaryTag(iter->second.tag, bvalue);
     log_stream.str("");
     log_stream << "Data successfully written.";
     logEvent("write binary", "info", log_stream.str());
@@ -637,7 +634,7 @@ void Server::writeAnalog(std::uint16_t address, float value)
         logEvent("analog point command", "error", log_stream.str());
         return;
     }
-    mDataManager->addUpdatedAnalogTag(iter->second.first, value);
+    mDataManager->addUpdatedAnalogTag(iter->second.tag, value);
     log_stream.str("");
     log_stream << "Data successfully written.";
     logEvent("write analog", "info", log_stream.str());
@@ -647,7 +644,7 @@ bool Server::addBinaryInput(const std::uint16_t address, const std::string &tag)
 {
     if (mDataManager->hasTag(tag))
     {
-        mBinaryPoints[address] = std::make_pair(tag, PointType::eInput);
+        mBinaryPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eInput};
         return true;
     }
     return false;
@@ -657,7 +654,7 @@ bool Server::addBinaryOutput(const std::uint16_t address, const std::string &tag
 {
     if (mDataManager->hasTag(tag))
     {
-        mBinaryPoints[address] = std::make_pair(tag, PointType::eOutput);
+        mBinaryPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eOutput};
         return true;
     }
     return false;
@@ -667,7 +664,7 @@ bool Server::addAnalogInput(const std::uint16_t address, const std::string &tag)
 {
     if (mDataManager->hasTag(tag))
     {
-        mAnalogPoints[address] = std::make_pair(tag, PointType::eInput);
+        mAnalogPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eInput};
         return true;
     }
     return false;
@@ -677,7 +674,7 @@ bool Server::addAnalogOutput(const std::uint16_t address, const std::string &tag
 {
     if (mDataManager->hasTag(tag))
     {
-        mAnalogPoints[address] = std::make_pair(tag, PointType::eOutput);
+        mAnalogPoints[address] = Point{tag, mDataManager->getTagHandle(tag), PointType::eOutput};
         return true;
     }
     return false;
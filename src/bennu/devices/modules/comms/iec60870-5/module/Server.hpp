@@ -36,6 +36,13 @@ enum PointType
     eOutput
 };
 
+struct Point
+{
+    std::string tag;
+    field_device::TagHandle handle;
+    PointType type;
+};
+
 class Server : public CommsModule, public utility::DirectLoggable, public std::enable_shared_from_this<Server>
 {
 public:
@@ -74,19 +81,19 @@ public:
     static void sendSpontaneousUpdate(IMasterConnection connection, int ioa, DoublePointValue value);
 
 private:
+    void reportChanges(const bool doublePoint);
+
     bool mConnected;
     uint32_t mReversePollRate;                              // Server reverse-poll rate
     IMasterConnection mConnection;                          // 104 master connection
     std::shared_ptr<std::thread> pServerPollThread;			// Server reverse-poll thread
-    std::map<uint16_t, std::pair<std::string, PointType>> mBinaryPoints;
-    std::map<uint16_t, std::pair<std::string, PointType>> mAnalogPoints;
+    std::map<uint16_t, Point> mBinaryPoints;
+    std::map<uint16_t, Point> mAnalogPoints;
+    std::shared_ptr<Server> mSelf;                          // passed to start(); 104 callbacks get this instance as their parameter
 
 
 };
 
-// Static shared_ptr to server instance so it can be used inside static 104 callback handlers
-static std::shared_ptr<Server> gServer;
-
 } // namespace iec60870
 } // namespace comms
 } // namespace bennu
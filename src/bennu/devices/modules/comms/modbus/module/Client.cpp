@@ -12,6 +12,10 @@ Client::Client() :
 
 Client::~Client()
 {
+    if (mScanner)
+    {
+        mScanner->stop();
+    }
     mTagsToConnection.clear();
 }
 
@@ -50,6 +54,40 @@ StatusMessage Client::readTag(const std::string& tag, comms::RegisterDescriptor&
     return sm;
 }
 
+void Client::readTags(const std::vector<std::string>& tags, std::vector<comms::RegisterDescriptor>& rds) const
+{
+    std::map<std::shared_ptr<ClientConnection>, std::vector<std::string>> byConnection;
+    for (const auto& tag : tags)
+    {
+        auto iter = mTagsToConnection.find(tag);
+        if (iter != mTagsToConnection.end())
+        {
+            byConnection[iter->second].push_back(tag);
+        }
+    }
+
+    std::map<std::string, comms::RegisterDescriptor> read;
+    std::vector<comms::RegisterDescriptor> responses;
+    for (const auto& connection : byConnection)
+    {
+        connection.first->readRegistersByTag(connection.second, responses);
+        for (const auto& rd : responses)
+        {
+            read[rd.mTag] = rd;
+        }
+    }
+
+    rds.assign(tags.size(), comms::RegisterDescriptor());
+    for (std::size_t i = 0; i < tags.size(); ++i)
+    {
+        auto iter = read.find(tags[i]);
+        if (iter != read.end())
+        {
+            rds[i] = iter->second;
+        }
+    }
+}
+
 StatusMessage Client::writeBinaryTag(const std::string& tag, bool status)
 {
     auto iter = mTagsToConnection.find(tag);
@@ -78,6 +116,11 @@ StatusMessage Client::writeAnalogTag(const std::string& tag, double value)
     return sm;
 }
 
+std::string Client::getStatistics() const
+{
+    return mScanner ? mScanner->getStatistics() : "";
+}
+
 } // namespace modbus
 } // namespace comms
 } // namespace bennu
@@ -7,12 +7,14 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
 
 #include "bennu/devices/modules/comms/base/Common.hpp"
 #include "bennu/devices/modules/comms/base/CommsClient.hpp"
 #include "bennu/devices/modules/comms/modbus/module/ClientConnection.hpp"
+#include "bennu/devices/modules/comms/modbus/module/ClientScanner.hpp"
 #include "bennu/utility/DirectLoggable.hpp"
 
 namespace bennu {
@@ -38,11 +40,21 @@ public:
     virtual std::set<std::string> getTags() const;
     virtual bool isValidTag(const std::string& tag) const;
     virtual StatusMessage readTag(const std::string& tag, comms::RegisterDescriptor& rd) const;
+    // Each connection's tags in as few requests as its planner allows
+    virtual void readTags(const std::vector<std::string>& tags, std::vector<comms::RegisterDescriptor>& rds) const;
     virtual StatusMessage writeBinaryTag(const std::string& tag, bool status);
     virtual StatusMessage writeAnalogTag(const std::string& tag, double value);
+    virtual std::string getStatistics() const;
+
+    // Polls the connections into the DataManager (see DataHandler::parseClientTree)
+    void setScanner(std::shared_ptr<ClientScanner> scanner)
+    {
+        mScanner = scanner;
+    }
 
 private:
     std::map<std::string, std::shared_ptr<ClientConnection>> mTagsToConnection;
+    std::shared_ptr<ClientScanner> mScanner;
     std::timed_mutex mLock;
     Client(const Client&);
     Client& operator =(const Client&);
@@ -71,6 +71,7 @@ std::string ClientConnection::logError(error_code_t::type error, const std::stri
 
 StatusMessage ClientConnection::readRegisterByTag(const std::string& tag, comms::RegisterDescriptor& rd)
 {
+    std::scoped_lock<std::mutex> lock(mLock);
     StatusMessage sm = STATUS_INIT;
     auto status = getRegisterDescriptorByTag(tag, rd) ? STATUS_SUCCESS : STATUS_FAIL;
     if (!status)
@@ -80,67 +81,21 @@ StatusMessage ClientConnection::readRegisterByTag(const std::string& tag, comms:
         sm.message = msg.data();
         return sm;
     }
-    switch  (rd.mRegisterType)
+    if (ReadPlanner::maxCount(rd.mRegisterType) == 0)
     {
-        case comms::eStatusReadWrite:
-        {
-            std::vector<bool> data;
-            error_code_t::type error = mProtocolStack->app_layer.read_coils(rd.mRegisterAddress, 1, data);
-            if (!error)
-            {
-                rd.mStatus = data[0];
-                return sm;
-            }
-            break;
-        }
-        case comms::eStatusReadOnly:
-        {
-            std::vector<bool> data;
-            error_code_t::type error = mProtocolStack->app_layer.read_discrete_inputs(rd.mRegisterAddress, 1, data);
-            if (!error)
-            {
-                rd.mStatus = data[0];
-                return sm;
-            }
-            break;
-        }
-        case comms::eValueReadWrite:
-        {
-            std::vector<uint16_t> data;
-            error_code_t::type error = mProtocolStack->app_layer.read_holding_registers(rd.mRegisterAddress, 1, data);
-            if (!error)
-            {
-                std::map<uint16_t, ScaledValue>::iterator svIter = mScaledValues.find(rd.mRegisterAddress);
-                if (svIter != mScaledValues.end())
-                {
-                    rd.mFloatValue = (data[0] - svIter->second.mIntercept) / svIter->second.mSlope;
-                }
-                return sm;
-            }
-            break;
-        }
-        case comms::eValueReadOnly:
-        {
-            std::vector<uint16_t> data;
-            error_code_t::type error = mProtocolStack->app_layer.read_input_registers(rd.mRegisterAddress, 1, data);
-            if (!error)
-            {
-                std::map<uint16_t, ScaledValue>::iterator svIter = mScaledValues.find(rd.mRegisterAddress);
-                if (svIter != mScaledValues.end())
-                {
-                    rd.mFloatValue = (data[0] - svIter->second.mIntercept) / svIter->second.mSlope;
-                }
-                return sm;
-            }
-            break;
-        }
-        default:
-        {
-            std::string msg = "readRegisterByTag(): Unknown reg type -- " + rd.mRegisterType;
-            sm.message = msg.data();
-            sm.status = STATUS_FAIL;
-            return sm;
-        }
+        std::string msg = "readRegisterByTag(): Unknown reg type -- " + rd.mRegisterType;
+        sm.message = msg.data();
+        sm.status = STATUS_FAIL;
+        return sm;
+    }
+
+    std::vector<comms::RegisterDescriptor> responses;
+    std::vector<comms::LogMessage> logMessages;
+    readPlanned({rd.mRegisterType, rd.mRegisterAddress, 1, {rd}}, responses, logMessages);
+    if (!responses.empty())
+    {
+        rd = responses.front();
+        return sm;
     }
     std::string msg = "readRegisterByTag(): Failure";
     sm.message = msg.data();
@@ -148,186 +103,134 @@ StatusMessage ClientConnection::readRegisterByTag(const std::string& tag, comms:
     return sm;
 }
 
-StatusMessage ClientConnection::readRegisters(const std::vector<ConnectionMessage>& messages, std::vector<comms::RegisterDescriptor>& responses, std::vector<comms::LogMessage>& logMessages)
+error_code_t::type ClientConnection::readBlock(comms::RegisterType registerType, std::uint16_t startAddress, std::uint16_t count,
+                                              std::vector<bool>& bits, std::vector<std::uint16_t>& registers)
 {
+    std::scoped_lock<std::mutex> lock(mLock);
     if (!mPersistConnection)
     {
         mClient->connect();
     }
+    return request(registerType, startAddress, count, bits, registers);
+}
 
-    responses.clear();
-
-    size_t expectedResponses = 0;
-
-    for (size_t m = 0; m < messages.size(); ++m)
+error_code_t::type ClientConnection::request(comms::RegisterType registerType, std::uint16_t startAddress, std::uint16_t count,
+                                            std::vector<bool>& bits, std::vector<std::uint16_t>& registers)
+{
+    bits.clear();
+    registers.clear();
+    switch (registerType)
     {
-        expectedResponses += messages[m].mRegisters.size();
-        comms::LogMessage lm;
-        std::ostringstream os;
-
-        switch  (messages[m].mRegisterType)
-        {
-            case comms::eStatusReadWrite:
-            {
-                std::uint16_t startAddress = (*messages[m].mRegisters.begin()).mRegisterAddress;
-                size_t size = messages[m].mRegisters.size();
-                std::vector<bool> data;
-                error_code_t::type error = mProtocolStack->app_layer.read_coils(startAddress, size, data);
-
-                if (error == error_code_t::NO_ERROR)
-                {
-                    std::set<comms::RegisterDescriptor, comms::RegDescComp>::const_iterator regIter;
-                    size_t c = 0;
-                    for(regIter = messages[m].mRegisters.begin(); regIter != messages[m].mRegisters.end(); ++regIter, ++c)
-                    {
-                        comms::RegisterDescriptor response = *regIter;
-                        response.mStatus = data[c];
-
-                        responses.push_back(response);
-                    }
-                    os << "Read coils on " << mName << " from start address " << startAddress << " and read " << size << " registers.";
-                    lm.mEvent = "read coils";
-                    lm.mLevel = "info";
-                    lm.mMessage = os.str();
-                    logMessages.push_back(lm);
-                }
-                else
-                {
-                    lm.mEvent = "read coils";
-                    lm.mLevel = "error";
-                    lm.mMessage = logError(error, "read coils", startAddress, size);
-                    logMessages.push_back(lm);
-                }
-            }
-                break;
+        case comms::eStatusReadWrite:
+            return mProtocolStack->app_layer.read_coils(startAddress, count, bits);
+        case comms::eStatusReadOnly:
+            return mProtocolStack->app_layer.read_discrete_inputs(startAddress, count, bits);
+        case comms::eValueReadWrite:
+            return mProtocolStack->app_layer.read_holding_registers(startAddress, count, registers);
+        case comms::eValueReadOnly:
+            return mProtocolStack->app_layer.read_input_registers(startAddress, count, registers);
+        default:
+            return error_code_t::ILLEGAL_FUNCTION;
+    }
+}
 
-            case comms::eStatusReadOnly:
-            {
-                std::uint16_t startAddress = (*messages[m].mRegisters.begin()).mRegisterAddress;
-                size_t size = messages[m].mRegisters.size();
-                std::vector<bool> data;
-                error_code_t::type error = mProtocolStack->app_layer.read_discrete_inputs(startAddress, size, data);
+void ClientConnection::readPlanned(const ReadBlock& block, std::vector<comms::RegisterDescriptor>& responses, std::vector<comms::LogMessage>& logMessages)
+{
+    std::string type;
+    switch (block.mRegisterType)
+    {
+        case comms::eStatusReadWrite:
+            type = "coils";
+            break;
+        case comms::eStatusReadOnly:
+            type = "discrete inputs";
+            break;
+        case comms::eValueReadWrite:
+            type = "holding registers";
+            break;
+        default:
+            type = "input registers";
+            break;
+    }
 
-                if (error == error_code_t::NO_ERROR)
-                {
-                    std::set<comms::RegisterDescriptor, comms::RegDescComp>::const_iterator regIter;
-                    size_t di = 0;
-                    for(regIter = messages[m].mRegisters.begin(); regIter != messages[m].mRegisters.end(); ++regIter, ++di)
-                    {
-                        comms::RegisterDescriptor response = *regIter;
-                        response.mStatus = data[di];
+    comms::LogMessage lm;
+    lm.mEvent = "read " + type;
+    std::vector<bool> bits;
+    std::vector<uint16_t> registers;
+    error_code_t::type error = request(block.mRegisterType, block.mStart, block.mCount, bits, registers);
 
-                        responses.push_back(response);
-                    }
-                    os << "Read discrete inputs on " << mName << " from start address " << startAddress << " and read " << size << " registers.";
-                    lm.mEvent = "read discrete input";
-                    lm.mLevel = "info";
-                    lm.mMessage = os.str();
-                    logMessages.push_back(lm);
-                }
-                else
-                {
-                    lm.mEvent = "read discrete inputs";
-                    lm.mLevel = "error";
-                    lm.mMessage = logError(error, "read discrete inputs", startAddress, size);
-                    logMessages.push_back(lm);
-                }
+    ReadBlock first, second;
+    if (ReadPlanner::refused(error) && ReadPlanner::split(block, first, second))
+    {
+        // the block spans addresses the device does not have; read around them
+        std::ostringstream os;
+        os << "Splitting read " << type << " on " << mName << " from start address " << block.mStart << " of " << block.mCount
+           << " into " << first.mStart << "+" << first.mCount << " and " << second.mStart << "+" << second.mCount;
+        lm.mLevel = "info";
+        lm.mMessage = os.str();
+        logMessages.push_back(lm);
+        readPlanned(first, responses, logMessages);
+        readPlanned(second, responses, logMessages);
+        return;
+    }
 
-            }
-                break;
+    if (error != error_code_t::NO_ERROR || bits.size() + registers.size() < block.mCount)
+    {
+        lm.mLevel = "error";
+        lm.mMessage = logError(error, "read " + type, block.mStart, block.mCount);
+        logMessages.push_back(lm);
+        return;
+    }
 
-            case comms::eValueReadWrite:
+    for (const auto& reg : block.mRegisters)
+    {
+        comms::RegisterDescriptor response = reg;
+        std::size_t offset = reg.mRegisterAddress - block.mStart;
+        if (!bits.empty())
+        {
+            response.mStatus = bits[offset];
+        }
+        else
+        {
+            auto svIter = mScaledValues.find(scaleKey(response.mRegisterType, response.mRegisterAddress));
+            if (svIter != mScaledValues.end())
             {
-                std::uint16_t startAddress = (*messages[m].mRegisters.begin()).mRegisterAddress;
-                size_t size = messages[m].mRegisters.size();
-                std::vector<uint16_t> data;
-                error_code_t::type error = mProtocolStack->app_layer.read_holding_registers(startAddress, size, data);
-
-                if (error == error_code_t::NO_ERROR)
-                {
-                    std::set<comms::RegisterDescriptor, comms::RegDescComp>::const_iterator regIter;
-                    size_t hr = 0;
-                    for(regIter = messages[m].mRegisters.begin(); regIter != messages[m].mRegisters.end(); ++regIter, ++hr)
-                    {
-                        comms::RegisterDescriptor response = *regIter;
-
-                        std::map<uint16_t, ScaledValue>::iterator svIter = mScaledValues.find(response.mRegisterAddress);
-                        if (svIter != mScaledValues.end())
-                        {
-                            response.mFloatValue = (data[hr] - svIter->second.mIntercept) / svIter->second.mSlope;
-                        }
-
-                        responses.push_back(response);
-                    }
-                    os << "Read holding registers on " << mName << " from start address " << startAddress << " and read " << size << " registers.";
-                    lm.mEvent = "read holding register";
-                    lm.mLevel = "info";
-                    lm.mMessage = os.str();
-                    logMessages.push_back(lm);
-                }
-                else
-                {
-                    lm.mEvent = "read coils";
-                    lm.mLevel = "error";
-                    lm.mMessage = logError(error, "read holding registers", startAddress, size);
-                    logMessages.push_back(lm);
-                }
-
+                response.mFloatValue = (registers[offset] - svIter->second.mIntercept) / svIter->second.mSlope;
             }
-                break;
-
-            case comms::eValueReadOnly:
-            {
-                std::uint16_t startAddress = (*messages[m].mRegisters.begin()).mRegisterAddress;
-                size_t size = messages[m].mRegisters.size();
-                std::vector<uint16_t> data;
-                error_code_t::type error = mProtocolStack->app_layer.read_input_registers(startAddress, size, data);
-
-                if (error == error_code_t::NO_ERROR)
-                {
-                    std::set<comms::RegisterDescriptor, comms::RegDescComp>::const_iterator regIter;
-                    size_t ir = 0;
-                    for(regIter = messages[m].mRegisters.begin(); regIter != messages[m].mRegisters.end(); ++regIter, ++ir)
-                    {
-                        comms::RegisterDescriptor response = *regIter;
-                        std::map<uint16_t, ScaledValue>::iterator svIter = mScaledValues.find(response.mRegisterAddress);
-                        if (svIter != mScaledValues.end())
-                        {
-                            response.mFloatValue = (data[ir] - svIter->second.mIntercept) / svIter->second.mSlope;
-                        }
+        }
+        responses.push_back(response);
+    }
 
-                        responses.push_back(response);
-                    }
-                    os << "Read input registers on " << mName << " from start address " << startAddress << " and read " << size << " registers.";
-                    lm.mEvent = "read input register";
-                    lm.mLevel = "info";
-                    lm.mMessage = os.str();
-                    logMessages.push_back(lm);
+    std::ostringstream os;
+    os << "Read " << type << " on " << mName << " from start address " << block.mStart << " and read " << block.mCount << " registers.";
+    lm.mLevel = "info";
+    lm.mMessage = os.str();
+    logMessages.push_back(lm);
+}
 
-                }
-                else
-                {
-                    lm.mEvent = "read input registers";
-                    lm.mLevel = "error";
-                    lm.mMessage = logError(error, "read registers", startAddress, size);
-                    logMessages.push_back(lm);
-                }
+StatusMessage ClientConnection::readRegisters(const std::vector<ConnectionMessage>& messages, std::vector<comms::RegisterDescriptor>& responses, std::vector<comms::LogMessage>& logMessages)
+{
+    std::scoped_lock<std::mutex> lock(mLock);
+    if (!mPersistConnection)
+    {
+        mClient->connect();
+    }
 
-            }
-                break;
+    responses.clear();
 
-            default:
-            {
-                lm.mEvent = "invalid read";
-                lm.mLevel = "error";
-                lm.mMessage = logError(error_code_t::ILLEGAL_FUNCTION, "read registers", 0, 0);
-                logMessages.push_back(lm);
-            }
-        }
+    // coalesce every message's registers into as few requests as possible
+    std::vector<comms::RegisterDescriptor> registers;
+    for (const auto& message : messages)
+    {
+        registers.insert(registers.end(), message.mRegisters.begin(), message.mRegisters.end());
+    }
+    for (const auto& block : mPlanner.plan(registers))
+    {
+        readPlanned(block, responses, logMessages);
     }
 
     StatusMessage sm = STATUS_INIT;
-    sm.status = expectedResponses == responses.size() ? STATUS_SUCCESS : STATUS_FAIL;
+    sm.status = registers.size() == responses.size() ? STATUS_SUCCESS : STATUS_FAIL;
     if (!sm.status)
     {
         std::string msg = "Failed";
@@ -336,8 +239,35 @@ StatusMessage ClientConnection::readRegisters(const std::vector<ConnectionMessag
     return sm;
 }
 
+void ClientConnection::readRegistersByTag(const std::vector<std::string>& tags, std::vector<comms::RegisterDescriptor>& responses)
+{
+    std::scoped_lock<std::mutex> lock(mLock);
+    if (!mPersistConnection)
+    {
+        mClient->connect();
+    }
+
+    responses.clear();
+
+    std::vector<comms::RegisterDescriptor> registers;
+    for (const auto& tag : tags)
+    {
+        auto iter = mRegisters.find(tag);
+        if (iter != mRegisters.end())
+        {
+            registers.push_back(iter->second);
+        }
+    }
+    std::vector<comms::LogMessage> logMessages;
+    for (const auto& block : mPlanner.plan(registers))
+    {
+        readPlanned(block, responses, logMessages);
+    }
+}
+
 StatusMessage ClientConnection::writeCoil(const std::string& tag, bool value)
 {
+    std::scoped_lock<std::mutex> lock(mLock);
     StatusMessage sm = STATUS_INIT;
     comms::RegisterDescriptor rd;
     auto status = getRegisterDescriptorByTag(tag, rd) ? STATUS_SUCCESS : STATUS_FAIL;
@@ -362,6 +292,7 @@ StatusMessage ClientConnection::writeCoil(const std::string& tag, bool value)
 
 StatusMessage ClientConnection::writeHoldingRegister(const std::string& tag, float value)
 {
+    std::scoped_lock<std::mutex> lock(mLock);
     StatusMessage sm = STATUS_INIT;
     comms::RegisterDescriptor rd;
     auto status = getRegisterDescriptorByTag(tag, rd) ? STATUS_SUCCESS : STATUS_FAIL;
@@ -373,7 +304,7 @@ StatusMessage ClientConnection::writeHoldingRegister(const std::string& tag, flo
         return sm;
     }
     std::uint16_t data = 0;
-    std::map<uint16_t, ScaledValue>::iterator svIter = mScaledValues.find(rd.mRegisterAddress);
+    auto svIter = mScaledValues.find(scaleKey(rd.mRegisterType, rd.mRegisterAddress));
     if (svIter != mScaledValues.end())
     {
         data = (value * svIter->second.mSlope) + svIter->second.mIntercept;
@@ -14,6 +14,7 @@
 #include "bennu/devices/modules/comms/base/Common.hpp"
 #include "bennu/devices/modules/comms/modbus/protocol/error-codes.hpp"
 #include "bennu/devices/modules/comms/modbus/protocol/protocol-stack.hpp"
+#include "bennu/devices/modules/comms/modbus/module/ReadPlanner.hpp"
 #include "bennu/distributed/AbstractClient.hpp"
 #include "bennu/distributed/TcpClient.hpp"
 #include "bennu/distributed/SerialClient.hpp"
@@ -130,13 +131,34 @@ public:
         mName = name;
     }
 
-    void setRange(uint16_t address, const std::pair<double, double>& range)
+    // Holding and input registers are scaled separately even at the same address
+    void setRange(comms::RegisterType registerType, uint16_t address, const std::pair<double, double>& range)
     {
         ScaledValue sv;
         sv.mRange = range;
         sv.mSlope = 65535.0 / (sv.mRange.first - sv.mRange.second);
         sv.mIntercept = -(sv.mSlope * sv.mRange.second);
-        mScaledValues[address] = sv;
+        mScaledValues[scaleKey(registerType, address)] = sv;
+    }
+
+    // False (and slope 1, intercept 0) for registers without a range
+    bool getScale(comms::RegisterType registerType, uint16_t address, double& slope, double& intercept) const
+    {
+        auto iter = mScaledValues.find(scaleKey(registerType, address));
+        slope = iter != mScaledValues.end() ? iter->second.mSlope : 1.0;
+        intercept = iter != mScaledValues.end() ? iter->second.mIntercept : 0.0;
+        return iter != mScaledValues.end();
+    }
+
+    // Unconfigured addresses a read may span between two configured ones
+    void setGap(std::uint16_t gap)
+    {
+        mPlanner.setGap(gap);
+    }
+
+    const ReadPlanner& getPlanner() const
+    {
+        return mPlanner;
     }
 
     const std::pair<double, double>& getRange(const std::pair<double, double>& range) const
@@ -145,7 +167,12 @@ public:
     }
 
     StatusMessage readRegisterByTag(const std::string& tag, comms::RegisterDescriptor& rd);
+    // One request for 'count' coils/discrete inputs ('bits') or holding/input registers ('registers')
+    error_code_t::type readBlock(comms::RegisterType registerType, std::uint16_t startAddress, std::uint16_t count,
+                                 std::vector<bool>& bits, std::vector<std::uint16_t>& registers);
     StatusMessage readRegisters(const std::vector<ConnectionMessage>& messages, std::vector<comms::RegisterDescriptor>& responses, std::vector<comms::LogMessage>& logMessages);
+    // The registers of the tags this connection has, read in as few requests as possible
+    void readRegistersByTag(const std::vector<std::string>& tags, std::vector<comms::RegisterDescriptor>& responses);
 
     StatusMessage writeCoil(const std::string& tag, bool value);
     StatusMessage writeHoldingRegister(const std::string& tag, float value);
@@ -158,6 +185,16 @@ public:
     void readHandler(const boost::system::error_code& error, size_t bytesTransferred);
 
 private:
+    static std::uint32_t scaleKey(comms::RegisterType registerType, uint16_t address)
+    {
+        return (static_cast<std::uint32_t>(registerType) << 16) | address;
+    }
+
+    error_code_t::type request(comms::RegisterType registerType, std::uint16_t startAddress, std::uint16_t count,
+                               std::vector<bool>& bits, std::vector<std::uint16_t>& registers);
+    // Read a planned block, splitting it for as long as the device refuses its addresses
+    void readPlanned(const ReadBlock& block, std::vector<comms::RegisterDescriptor>& responses, std::vector<comms::LogMessage>& logMessages);
+
     std::string mName;
     std::pair<double, double> mRange;
     double mSlope;
@@ -165,7 +202,9 @@ private:
     bool mPersistConnection;
     std::shared_ptr<protocol_stack> mProtocolStack;
     std::map<std::string, comms::RegisterDescriptor> mRegisters;
-    std::map<uint16_t, ScaledValue> mScaledValues;
+    std::map<std::uint32_t, ScaledValue> mScaledValues;   // register type, address ==> scaling
+    ReadPlanner mPlanner;
+    std::mutex mLock;                                       // one transaction at a time (scanner and command interface)
     std::vector<ConnectionMessage> mResponses;
     std::shared_ptr<utility::AbstractClient> mClient;
 
@@ -1,153 +1,138 @@
 #include "ClientScanBlock.hpp"
 
-#include <thread>
+#include <sstream>
+
+#include "bennu/devices/modules/comms/modbus/protocol/codec.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/function-codes.hpp"
 
 namespace bennu {
 namespace comms {
 namespace modbus {
 
-ClientScanBlock::ClientScanBlock() :
-    mIsRunning(false),
-    mScanInterval(5)
+ClientScanBlock::ClientScanBlock(const ReadBlock& block, const std::chrono::milliseconds& rate) :
+    mRegisterType(block.mRegisterType),
+    mStart(block.mStart),
+    mCount(block.mCount),
+    mRate(rate),
+    mRequests(1, block),
+    mRequestCount(1),
+    mErrors(0),
+    mTimeouts(0),
+    mOverruns(0)
 {
 }
 
-ClientScanBlock::~ClientScanBlock()
+void ClientScanBlock::addPoint(std::uint16_t address, const field_device::TagHandle& handle, double slope, double intercept)
 {
-    mReadRequests.clear();
+    mPoints.push_back({address, handle, slope, intercept});
+    mBatch.reserve(mPoints.size());
 }
 
-void ClientScanBlock::addReadRequest(std::shared_ptr<ClientConnection> connection, const std::set<comms::RegisterDescriptor, comms::RegDescComp>& registers)
+bool ClientScanBlock::split(std::size_t request)
 {
-    ConnectionMessage rm;
-    rm.mRegisters = registers;
-    rm.mRegisterType = (*registers.begin()).mRegisterType;
-
-    ReadRequests::iterator iter = mReadRequests.find(connection);
-    if (iter != mReadRequests.end())
+    ReadBlock first, second;
+    if (request >= mRequests.size() || !ReadPlanner::split(mRequests[request], first, second))
     {
-        iter->second.push_back(rm);
-    }
-    else
-    {
-        std::vector<ConnectionMessage> messages;
-        messages.push_back(rm);
-        mReadRequests[connection] = messages;
+        return false;
     }
+    mRequests[request] = first;
+    mRequests.insert(mRequests.begin() + request + 1, second);
+    mRequestCount.store(mRequests.size(), std::memory_order_relaxed);
+    return true;
 }
 
-void ClientScanBlock::run()
+std::uint8_t ClientScanBlock::getFunctionCode() const
 {
-    mIsRunning = true;
-    while (mIsRunning)
+    switch (mRegisterType)
     {
-        scan();
-        std::this_thread::sleep_for(std::chrono::seconds(mScanInterval));
+        case comms::eStatusReadWrite:
+            return function_code_t::READ_COILS;
+        case comms::eStatusReadOnly:
+            return function_code_t::READ_DISCRETE_INPUTS;
+        case comms::eValueReadWrite:
+            return function_code_t::READ_HOLDING_REGS;
+        default:
+            return function_code_t::READ_INPUT_REGS;
     }
 }
 
-void ClientScanBlock::scan()
+void ClientScanBlock::update(const ReadBlock& request, const std::uint8_t* data, std::size_t size)
 {
-    std::set<std::string> tags;
-    mRegisterResponses.clear();
-    std::vector<std::thread> threads;
-    for (ReadRequests::iterator iter = mReadRequests.begin(); iter != mReadRequests.end(); ++iter)
+    if (size < getDataSize(request))
     {
-        threads.push_back(std::thread(std::bind(&ClientScanBlock::scanConnectionRegisters, this, iter->first, iter->second)));
-
-        for (size_t i = 0; i < iter->second.size(); ++i)
-        {
-            for (std::set<comms::RegisterDescriptor, comms::RegDescComp>::iterator regIter = iter->second[i].mRegisters.begin();
-                 regIter != iter->second[i].mRegisters.end(); ++regIter)
-            {
-                tags.insert((*regIter).mTag);
-            }
-        }
+        return;
     }
 
-    std::for_each(threads.begin(),threads.end(), std::mem_fn(&std::thread::join));
-
-    if (!mClient.expired())
+    for (const auto& point : mPoints)
     {
-        if (mRegisterResponses.size() != tags.size())
+        std::size_t offset = point.mAddress - request.mStart;
+        if (point.mAddress < request.mStart || offset >= request.mCount)
         {
-            std::vector<comms::RegisterDescriptor> toAdd;
-            for (auto iter = tags.begin(); iter != tags.end(); ++iter)
-            {
-                bool found = false;
-                for (size_t i = 0; i < mRegisterResponses.size(); ++i)
-                {
-                    if (mRegisterResponses[i].mTag == *iter)
-                    {
-                        found = true;
-                        break;
-                    }
-                }
-
-                if (!found)
-                {
-                    comms::RegisterDescriptor rd;
-                    rd.mTag = *iter;
-                    rd.mRegisterType = comms::eNone;
-                    toAdd.push_back(rd);
-                }
-            }
-
-            mRegisterResponses.insert(mRegisterResponses.begin(), toAdd.begin(), toAdd.end());
+            continue;
+        }
+        if (isBinary())
+        {
+            mBatch.emplace_back(point.mHandle, ((data[offset / 8] >> (offset % 8)) & 1) != 0);
+        }
+        else
+        {
+            std::uint16_t reg = codec::get_u16(&data[offset * 2]);
+            mBatch.emplace_back(point.mHandle, toValue(point, reg));
         }
-
-        //mClient.lock()->report("modbus", mRegisterResponses);
     }
-
 }
 
-std::string ClientScanBlock::specificScan(std::set<std::string>& tagsToRead)
+void ClientScanBlock::update(const ReadBlock& request, const std::vector<bool>& bits, const std::vector<std::uint16_t>& registers)
 {
-    mRegisterResponses.clear();
-    std::vector<std::thread> threads;
-    for (ReadRequests::iterator iter = mReadRequests.begin(); iter != mReadRequests.end(); ++iter)
+    if ((isBinary() ? bits.size() : registers.size()) < request.mCount)
     {
-        threads.push_back(std::thread(std::bind(&ClientScanBlock::scanConnectionRegisters, this, iter->first, iter->second)));
+        return;
+    }
 
-        for (size_t i = 0; i < iter->second.size(); ++i)
+    for (const auto& point : mPoints)
+    {
+        std::size_t offset = point.mAddress - request.mStart;
+        if (point.mAddress < request.mStart || offset >= request.mCount)
+        {
+            continue;
+        }
+        if (isBinary())
+        {
+            mBatch.emplace_back(point.mHandle, static_cast<bool>(bits[offset]));
+        }
+        else
         {
-            for (std::set<comms::RegisterDescriptor, comms::RegDescComp>::iterator regIter = iter->second[i].mRegisters.begin();
-                 regIter != iter->second[i].mRegisters.end(); ++regIter)
-            {
-                tagsToRead.insert((*regIter).mTag);
-            }
+            mBatch.emplace_back(point.mHandle, toValue(point, registers[offset]));
         }
     }
-
-    std::for_each(threads.begin(),threads.end(), std::mem_fn(&std::thread::join));
-
-    return "modbus";
 }
 
-void ClientScanBlock::scanConnectionRegisters(std::shared_ptr<ClientConnection> connection, const std::vector<ConnectionMessage>& messages)
+void ClientScanBlock::publish(const field_device::DataManager& dm, double ts)
 {
-    std::vector<comms::RegisterDescriptor> responses;
-    std::vector<comms::LogMessage> logMessages;
-    auto result = connection->readRegisters(messages, responses, logMessages);
-
-    mLock.lock();
-    mRegisterResponses.insert(mRegisterResponses.end(), responses.begin(), responses.end());
-    mLock.unlock();
-
-    if (!mClient.expired())
+    if (!mBatch.empty())
     {
-        for (auto lm : logMessages)
-        {
-            mClient.lock()->logEvent(lm.mEvent, lm.mLevel, lm.mMessage);
-        }
-
-        if (!result.status)
-        {
-            mClient.lock()->logDebug("error", "A scan block for " + connection->getName() + " failed to read a bank of registers");
-        }
+        dm.setDataByTags(mBatch, ts);
+        mBatch.clear();
     }
 }
 
+std::string ClientScanBlock::report() const
+{
+    // no '=' -- command interface replies are split on it
+    std::ostringstream os;
+    os << "FC" << static_cast<int>(getFunctionCode()) << " " << mStart << "+" << mCount
+       << " every " << mRate.count() << "ms:"
+       << " n:" << mLatency.count()
+       << " p50:" << mLatency.percentile(50) << "us"
+       << " p99:" << mLatency.percentile(99) << "us"
+       << " max:" << mLatency.max() << "us"
+       << " errors:" << mErrors.load(std::memory_order_relaxed)
+       << " timeouts:" << mTimeouts.load(std::memory_order_relaxed)
+       << " overruns:" << mOverruns.load(std::memory_order_relaxed)
+       << " requests:" << mRequestCount.load(std::memory_order_relaxed);
+    return os.str();
+}
+
 } // namespace modbus
 } // namespace comms
 } // namespace bennu
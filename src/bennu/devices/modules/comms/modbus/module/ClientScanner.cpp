@@ -0,0 +1,428 @@
+#include "ClientScanner.hpp"
+
+#include <cstdio>
+#include <sstream>
+
+#include <boost/bind/bind.hpp>
+
+#include "bennu/devices/field-device/LatencyTrace.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/constants.hpp"
+
+namespace bennu {
+namespace comms {
+namespace modbus {
+
+using boost::placeholders::_1;
+
+ClientScanner::ClientScanner(std::shared_ptr<field_device::DataManager> dm) :
+    mDataManager(dm),
+    mThreads(2),
+    mTimeout(1000)
+{
+}
+
+ClientScanner::~ClientScanner()
+{
+    stop();
+}
+
+void ClientScanner::addBlock(std::shared_ptr<ClientConnection> connection, const std::string& endpoint, std::uint8_t unitId,
+                             std::shared_ptr<ClientScanBlock> block)
+{
+    for (auto& session : mSessions)
+    {
+        if (session->mConnection == connection)
+        {
+            session->addBlock(block);
+            return;
+        }
+    }
+    auto session = std::make_shared<Session>(mIOService, mSerialService, mDataManager, connection, endpoint, unitId);
+    session->addBlock(block);
+    mSessions.push_back(session);
+}
+
+void ClientScanner::start()
+{
+    if (mSessions.empty() || !mPool.empty())
+    {
+        return;
+    }
+    mWork.reset(new boost::asio::io_service::work(mIOService));
+    mSerialWork.reset(new boost::asio::io_service::work(mSerialService));
+    for (auto& session : mSessions)
+    {
+        session->start(mTimeout);
+        // each serial session blocks at most one thread at a time (its strand), so none waits on another
+        if (session->isSerial())
+        {
+            mPool.emplace_back([this]() { mSerialService.run(); });
+        }
+    }
+    for (unsigned int i = 0; i < mThreads; ++i)
+    {
+        mPool.emplace_back([this]() { mIOService.run(); });
+    }
+}
+
+void ClientScanner::stop()
+{
+    mWork.reset();
+    mSerialWork.reset();
+    mIOService.stop();
+    mSerialService.stop();
+    for (auto& thread : mPool)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    mPool.clear();
+    // nothing runs anymore; drop the sockets and timers (and the handlers keeping sessions alive)
+    for (auto& session : mSessions)
+    {
+        session->stop();
+    }
+}
+
+std::string ClientScanner::getStatistics() const
+{
+    std::string stats;
+    for (const auto& session : mSessions)
+    {
+        stats += session->getStatistics();
+    }
+    return stats;
+}
+
+ClientScanner::Session::Session(boost::asio::io_service& io_service, boost::asio::io_service& serial_service, std::shared_ptr<field_device::DataManager> dm,
+                                std::shared_ptr<ClientConnection> connection, const std::string& endpoint, std::uint8_t unitId) :
+    mConnection(connection),
+    mStrand(io_service),
+    mSerialStrand(serial_service),
+    mSocket(io_service),
+    mResolver(io_service),
+    mTimer(io_service),
+    mDataManager(dm),
+    mEndpoint(endpoint),
+    mUnitId(unitId),
+    mSerial(true),
+    mTimeout(1000),
+    mBusy(false),
+    mStopped(false),
+    mLogged(false),
+    mCurrent(0),
+    mRequestIndex(0),
+    mTransaction(0),
+    mTransactionId(0),
+    mBodySize(0)
+{
+    // "tcp://<host>:<port>"; anything else is a serial device
+    if (endpoint.compare(0, 6, "tcp://") == 0)
+    {
+        std::string address = endpoint.substr(6);
+        std::size_t colon = address.rfind(':');
+        mHost = address.substr(0, colon);
+        mPort = colon == std::string::npos ? "502" : address.substr(colon + 1);
+        mSerial = false;
+    }
+}
+
+void ClientScanner::Session::start(const std::chrono::milliseconds& timeout)
+{
+    mTimeout = timeout;
+    mQueued.assign(mBlocks.size(), false);
+    auto self = shared_from_this();
+    for (std::size_t i = 0; i < mBlocks.size(); ++i)
+    {
+        mScanTimers.emplace_back(new boost::asio::steady_timer(mStrand.context()));
+        mScanTimers[i]->expires_after(std::chrono::milliseconds(0));
+        boost::asio::post(mStrand, [self, i]() { self->enqueue(i); self->schedule(i); });
+    }
+}
+
+void ClientScanner::Session::stop()
+{
+    mStopped = true;
+    boost::system::error_code error;
+    mSocket.close(error);
+    mTimer.cancel();
+    for (auto& timer : mScanTimers)
+    {
+        timer->cancel();
+    }
+}
+
+std::string ClientScanner::Session::getStatistics() const
+{
+    std::string stats;
+    for (const auto& block : mBlocks)
+    {
+        stats += mConnection->getName() + " " + block->report() + "\n";
+    }
+    return stats;
+}
+
+void ClientScanner::Session::schedule(std::size_t index)
+{
+    // fixed rate; a scan that is late (e.g. a stalled thread) is not caught up
+    auto& timer = *mScanTimers[index];
+    auto due = timer.expiry() + mBlocks[index]->getRate();
+    auto now = std::chrono::steady_clock::now();
+    timer.expires_at(due > now ? due : now + mBlocks[index]->getRate());
+    auto self = shared_from_this();
+    timer.async_wait(boost::asio::bind_executor(mStrand, [self, index](const boost::system::error_code& error) {
+        if (error || self->mStopped)
+        {
+            return;
+        }
+        self->enqueue(index);
+        self->schedule(index);
+    }));
+}
+
+void ClientScanner::Session::enqueue(std::size_t index)
+{
+    if (mQueued[index])
+    {
+        mBlocks[index]->recordOverrun();
+        return;
+    }
+    mQueued[index] = true;
+    mPending.push_back(index);
+    if (!mBusy)
+    {
+        next();
+    }
+}
+
+void ClientScanner::Session::next()
+{
+    if (mPending.empty() || mStopped)
+    {
+        mBusy = false;
+        return;
+    }
+    mBusy = true;
+    mCurrent = mPending.front();
+    mPending.pop_front();
+    mRequestIndex = 0;
+
+    if (mSerial)
+    {
+        boost::asio::post(mSerialStrand, boost::bind(&Session::readSerial, shared_from_this()));
+        return;
+    }
+
+    mTimer.expires_after(mTimeout);
+    mTimer.async_wait(boost::asio::bind_executor(mStrand, boost::bind(&Session::timeoutHandler, shared_from_this(), mTransaction, _1)));
+    if (mSocket.is_open())
+    {
+        send();
+    }
+    else
+    {
+        connect();
+    }
+}
+
+void ClientScanner::Session::connect()
+{
+    auto self = shared_from_this();
+    std::uint32_t transaction = mTransaction;
+    mResolver.async_resolve(mHost, mPort, boost::asio::bind_executor(mStrand,
+        [self, transaction](const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type results) {
+            if (transaction != self->mTransaction)
+            {
+                return;
+            }
+            if (error)
+            {
+                self->fail("unable to resolve " + self->mEndpoint + " -- " + error.message());
+                return;
+            }
+            boost::asio::async_connect(self->mSocket, results, boost::asio::bind_executor(self->mStrand,
+                [self, transaction](const boost::system::error_code& error, const boost::asio::ip::tcp::endpoint&) {
+                    if (transaction != self->mTransaction)
+                    {
+                        return;
+                    }
+                    if (error)
+                    {
+                        self->fail("unable to connect to " + self->mEndpoint + " -- " + error.message());
+                        return;
+                    }
+                    boost::system::error_code ignored;
+                    self->mSocket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+                    if (self->mLogged)
+                    {
+                        printf("modbus scanner: reconnected to %s\n", self->mEndpoint.data());
+                        self->mLogged = false;
+                    }
+                    self->send();
+                }));
+        }));
+}
+
+void ClientScanner::Session::send()
+{
+    const auto& block = *mBlocks[mCurrent];
+    const auto& request = block.getRequests()[mRequestIndex];
+    ++mTransactionId;
+    codec::encode_read_request(mRequest.data(), mTransactionId, mUnitId, block.getFunctionCode(), request.mStart, request.mCount);
+    mSent = std::chrono::steady_clock::now();
+    boost::asio::async_write(mSocket, boost::asio::buffer(mRequest),
+        boost::asio::bind_executor(mStrand, boost::bind(&Session::writeHandler, shared_from_this(), mTransaction, _1)));
+}
+
+void ClientScanner::Session::writeHandler(std::uint32_t transaction, const boost::system::error_code& error)
+{
+    if (transaction != mTransaction)
+    {
+        return;
+    }
+    if (error)
+    {
+        fail("write to " + mEndpoint + " failed -- " + error.message());
+        return;
+    }
+    boost::asio::async_read(mSocket, boost::asio::buffer(mHeader),
+        boost::asio::bind_executor(mStrand, [self = shared_from_this(), transaction](const boost::system::error_code& error, std::size_t) {
+            if (transaction != self->mTransaction)
+            {
+                return;
+            }
+            if (error)
+            {
+                self->fail("read from " + self->mEndpoint + " failed -- " + error.message());
+                return;
+            }
+            std::uint16_t id = codec::get_u16(&self->mHeader[MBAP_HDR_TRANSACTION_ID]);
+            std::uint16_t protocol = codec::get_u16(&self->mHeader[MBAP_HDR_PROTOCOL_ID]);
+            std::uint16_t length = codec::get_u16(&self->mHeader[MBAP_HDR_LENGTH]);
+            if (id != self->mTransactionId || protocol != 0 || length < 3 || length > MB_MAX_PDU_LENGTH + 1)
+            {
+                self->fail("malformed response header from " + self->mEndpoint);
+                return;
+            }
+            self->mBodySize = length - 1;
+            boost::asio::async_read(self->mSocket, boost::asio::buffer(self->mBody, self->mBodySize),
+                boost::asio::bind_executor(self->mStrand, boost::bind(&Session::readHandler, self, transaction, _1)));
+        }));
+}
+
+void ClientScanner::Session::readHandler(std::uint32_t transaction, const boost::system::error_code& error)
+{
+    if (transaction != mTransaction)
+    {
+        return;
+    }
+    if (error)
+    {
+        fail("read from " + mEndpoint + " failed -- " + error.message());
+        return;
+    }
+
+    auto& block = *mBlocks[mCurrent];
+    const auto& request = block.getRequests()[mRequestIndex];
+    if (mBody[0] == (block.getFunctionCode() | 0x80))
+    {
+        // the server answered; the connection is fine
+        if (ReadPlanner::refused(mBody[1]) && block.split(mRequestIndex))
+        {
+            send(); // the first half, in place of the refused request
+            return;
+        }
+        block.recordError();
+        nextRequest();
+        return;
+    }
+    if (mBody[0] != block.getFunctionCode() || mBody[1] != block.getDataSize(request) || mBodySize < 2 + block.getDataSize(request))
+    {
+        fail("malformed response from " + mEndpoint);
+        return;
+    }
+    block.recordLatency(std::chrono::steady_clock::now() - mSent);
+    block.update(request, mBody.data() + 2, mBodySize - 2);
+    nextRequest();
+}
+
+void ClientScanner::Session::nextRequest()
+{
+    if (++mRequestIndex < mBlocks[mCurrent]->getRequests().size())
+    {
+        send();
+        return;
+    }
+    finish();
+}
+
+void ClientScanner::Session::readSerial()
+{
+    // on the serial thread; the session's strand leaves mCurrent alone until finish()
+    auto& block = *mBlocks[mCurrent];
+    for (std::size_t i = 0; i < block.getRequests().size();)
+    {
+        const auto& request = block.getRequests()[i];
+        auto sent = std::chrono::steady_clock::now();
+        auto result = mConnection->readBlock(block.getRegisterType(), request.mStart, request.mCount, mBits, mRegisters);
+        if (result == error_code_t::NO_ERROR)
+        {
+            block.recordLatency(std::chrono::steady_clock::now() - sent);
+            block.update(request, mBits, mRegisters);
+        }
+        else if (ReadPlanner::refused(result) && block.split(i))
+        {
+            continue; // read the first half next
+        }
+        else
+        {
+            block.recordError();
+        }
+        ++i;
+    }
+    boost::asio::post(mStrand, boost::bind(&Session::finish, shared_from_this()));
+}
+
+void ClientScanner::Session::timeoutHandler(std::uint32_t transaction, const boost::system::error_code& error)
+{
+    if (error || transaction != mTransaction)
+    {
+        return;
+    }
+    mBlocks[mCurrent]->recordTimeout();
+    // anything still in flight belongs to this transaction; start over with a new connection
+    boost::system::error_code ignored;
+    mResolver.cancel();
+    mSocket.close(ignored);
+    finish();
+}
+
+void ClientScanner::Session::fail(const std::string& reason)
+{
+    mBlocks[mCurrent]->recordError();
+    if (!mLogged)
+    {
+        printf("E: modbus scanner: %s\n", reason.data());
+        mLogged = true;
+    }
+    boost::system::error_code ignored;
+    mSocket.close(ignored);
+    finish();
+}
+
+void ClientScanner::Session::finish()
+{
+    // stale handlers (e.g. a timeout that fired as the response arrived) see a new transaction
+    ++mTransaction;
+    // whatever was read this scan, even if a request failed
+    mBlocks[mCurrent]->publish(*mDataManager, field_device::LatencyTrace::now());
+    mQueued[mCurrent] = false;
+    mTimer.cancel();
+    next();
+}
+
+} // namespace modbus
+} // namespace comms
+} // namespace bennu
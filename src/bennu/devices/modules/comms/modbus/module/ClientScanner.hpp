@@ -0,0 +1,166 @@
+#ifndef BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_CLIENTSCANNER_HPP
+#define BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_CLIENTSCANNER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "bennu/devices/field-device/DataManager.hpp"
+#include "bennu/devices/modules/comms/modbus/module/ClientConnection.hpp"
+#include "bennu/devices/modules/comms/modbus/module/ClientScanBlock.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/codec.hpp"
+
+namespace bennu {
+namespace comms {
+namespace modbus {
+
+/*
+ * Polls the client's scan blocks into the DataManager. Every connection is
+ * a session on a shared io_service run by a few threads: each block has its
+ * own fixed-rate timer, due blocks queue up on the session, and the session
+ * keeps one transaction outstanding on its socket without ever blocking a
+ * thread, so many slow or dead servers can be scanned at once. A
+ * transaction that outlives the timeout drops the connection, which is
+ * reopened by the next scan.
+ *
+ * Serial connections have no socket to drive asynchronously; their scans
+ * use the connection's synchronous protocol stack on a thread of their own
+ * (one per serial connection), so a slow or silent serial device never
+ * holds up the TCP sessions' timers and transactions.
+ */
+class ClientScanner
+{
+public:
+    ClientScanner(std::shared_ptr<field_device::DataManager> dm);
+
+    ~ClientScanner();
+
+    // Threads running the sessions. Set before start.
+    void setThreads(unsigned int threads)
+    {
+        mThreads = threads > 0 ? threads : 1;
+    }
+
+    // Longest a transaction (including connecting) may take. Set before start.
+    void setTimeout(const std::chrono::milliseconds& timeout)
+    {
+        mTimeout = timeout;
+    }
+
+    // Blocks of the same connection share its session
+    void addBlock(std::shared_ptr<ClientConnection> connection, const std::string& endpoint, std::uint8_t unitId,
+                  std::shared_ptr<ClientScanBlock> block);
+
+    bool empty() const
+    {
+        return mSessions.empty();
+    }
+
+    void start();
+
+    void stop();
+
+    // One line per block, grouped by connection (see ClientScanBlock::report)
+    std::string getStatistics() const;
+
+private:
+    class Session : public std::enable_shared_from_this<Session>
+    {
+    public:
+        Session(boost::asio::io_service& io_service, boost::asio::io_service& serial_service, std::shared_ptr<field_device::DataManager> dm,
+                std::shared_ptr<ClientConnection> connection, const std::string& endpoint, std::uint8_t unitId);
+
+        bool isSerial() const
+        {
+            return mSerial;
+        }
+
+        void addBlock(std::shared_ptr<ClientScanBlock> block)
+        {
+            mBlocks.push_back(block);
+        }
+
+        void start(const std::chrono::milliseconds& timeout);
+
+        void stop();
+
+        std::string getStatistics() const;
+
+        std::shared_ptr<ClientConnection> mConnection;
+
+    private:
+        // MBAP header including the unit id
+        static const std::size_t HEADER_SIZE = 7;
+
+        void schedule(std::size_t index);
+        void enqueue(std::size_t index);
+        void next();
+        void connect();
+        void send();
+        void writeHandler(std::uint32_t transaction, const boost::system::error_code& error);
+        void readHandler(std::uint32_t transaction, const boost::system::error_code& error);
+        void nextRequest();
+        void readSerial();
+        void timeoutHandler(std::uint32_t transaction, const boost::system::error_code& error);
+        void fail(const std::string& reason);
+        void finish();
+
+        boost::asio::io_service::strand mStrand;
+        boost::asio::io_service::strand mSerialStrand;      // blocking serial reads, off the TCP sessions' threads
+        boost::asio::ip::tcp::socket mSocket;
+        boost::asio::ip::tcp::resolver mResolver;
+        boost::asio::steady_timer mTimer;                   // current transaction's timeout
+        std::shared_ptr<field_device::DataManager> mDataManager;
+        std::string mEndpoint;
+        std::string mHost;
+        std::string mPort;
+        std::uint8_t mUnitId;
+        bool mSerial;
+        std::chrono::milliseconds mTimeout;
+        std::vector<std::shared_ptr<ClientScanBlock>> mBlocks;
+        std::vector<std::unique_ptr<boost::asio::steady_timer>> mScanTimers;
+        std::deque<std::size_t> mPending;                   // blocks due, in order
+        std::vector<bool> mQueued;                          // block is in mPending or outstanding
+        bool mBusy;
+        bool mStopped;
+        bool mLogged;                                       // connection failure already reported
+        std::size_t mCurrent;                               // block being read
+        std::size_t mRequestIndex;                          // of the block's requests
+        std::uint32_t mTransaction;                         // ignores handlers of finished transactions
+        std::uint16_t mTransactionId;
+        std::chrono::steady_clock::time_point mSent;
+        std::array<std::uint8_t, codec::READ_REQUEST_SIZE> mRequest;
+        std::array<std::uint8_t, HEADER_SIZE> mHeader;
+        std::array<std::uint8_t, MB_MAX_PDU_LENGTH> mBody;  // function code onward
+        std::size_t mBodySize;
+        std::vector<bool> mBits;                            // serial responses
+        std::vector<std::uint16_t> mRegisters;
+    };
+
+    boost::asio::io_service mIOService;
+    std::unique_ptr<boost::asio::io_service::work> mWork;
+    boost::asio::io_service mSerialService;             // one thread per serial session
+    std::unique_ptr<boost::asio::io_service::work> mSerialWork;
+    std::shared_ptr<field_device::DataManager> mDataManager;
+    unsigned int mThreads;
+    std::chrono::milliseconds mTimeout;
+    std::vector<std::shared_ptr<Session>> mSessions;
+    std::vector<std::thread> mPool;
+    ClientScanner(const ClientScanner&);
+    ClientScanner& operator =(const ClientScanner&);
+
+};
+
+} // namespace modbus
+} // namespace comms
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_CLIENTSCANNER_HPP
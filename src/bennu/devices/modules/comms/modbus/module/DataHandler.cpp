@@ -1,12 +1,17 @@
 #include "DataHandler.hpp"
 
+#include <chrono>
 #include <functional>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "bennu/distributed/Utils.hpp"
 #include "bennu/devices/modules/comms/base/CommandInterface.hpp"
 #include "bennu/devices/modules/comms/base/CommsModuleCreator.hpp"
 #include "bennu/devices/modules/comms/modbus/module/ClientConnection.hpp"
+#include "bennu/devices/modules/comms/modbus/module/ClientScanBlock.hpp"
+#include "bennu/devices/modules/comms/modbus/module/ClientScanner.hpp"
 #include "bennu/parsers/Parser.hpp"
 
 namespace bennu {
@@ -38,7 +43,8 @@ std::shared_ptr<comms::CommsModule> DataHandler::handleClientTreeData(const ptre
     for (auto iter = clients.first; iter != clients.second; ++iter)
     {
         std::shared_ptr<Client> client(new Client);
-        parseClientTree(client, iter->second);
+        client->setDataManager(dm);
+        parseClientTree(client, iter->second, dm);
         return client;
     }
 
@@ -91,6 +97,11 @@ void DataHandler::parseServerTree(std::shared_ptr<Server> server, const ptree& t
             server->addInputRegister(address, tag, range);
         }
 
+        // TCP connection handling (see TcpChannel.hpp)
+        server->setThreads(tree.get<unsigned int>("threads", 4));
+        server->setMaxConnections(tree.get<std::size_t>("max-connections", 256));
+        server->setIdleTimeout(std::chrono::seconds(tree.get<unsigned int>("idle-timeout", 0)));
+
         std::string endpoint = tree.get<std::string>("endpoint");
         server->start(endpoint);
     }
@@ -106,10 +117,51 @@ void DataHandler::parseServerTree(std::shared_ptr<Server> server, const ptree& t
     }
 }
 
-void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &tree)
+/*
+ * Plan each scan rate's registers of a connection into the fewest read
+ * requests (see ReadPlanner) and hand them to the scanner.
+ */
+static void addScanBlocks(std::shared_ptr<ClientScanner> scanner, std::shared_ptr<ClientConnection> connection,
+                          const std::string& endpoint, std::uint8_t unitId,
+                          const std::map<std::chrono::milliseconds, std::vector<comms::RegisterDescriptor>>& rates,
+                          std::shared_ptr<field_device::DataManager> dm)
+{
+    for (const auto& rate : rates)
+    {
+        for (const auto& planned : connection->getPlanner().plan(rate.second))
+        {
+            std::shared_ptr<ClientScanBlock> block(new ClientScanBlock(planned, rate.first));
+            for (const auto& reg : planned.mRegisters)
+            {
+                // scanned tags not mapped to i/o points become internal tags of the device
+                if (!dm->getTagHandle(reg.mTag).valid())
+                {
+                    if (block->isBinary())
+                    {
+                        dm->addInternalData<bool>(reg.mTag, false);
+                    }
+                    else
+                    {
+                        dm->addInternalData<double>(reg.mTag, 0.0);
+                    }
+                }
+                double slope, intercept;
+                connection->getScale(reg.mRegisterType, reg.mRegisterAddress, slope, intercept);
+                block->addPoint(reg.mRegisterAddress, dm->getTagHandle(reg.mTag), slope, intercept);
+            }
+            scanner->addBlock(connection, endpoint, unitId, block);
+        }
+    }
+}
+
+void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &tree, std::shared_ptr<field_device::DataManager> dm)
 {
     try
     {
+        std::shared_ptr<ClientScanner> scanner(new ClientScanner(dm));
+        scanner->setThreads(tree.get<unsigned int>("scan-threads", 2));
+        scanner->setTimeout(std::chrono::milliseconds(static_cast<std::int64_t>(tree.get<double>("scan-timeout", 1.0) * 1000)));
+
         auto connections = tree.equal_range("modbus-connection");
         for (auto iter = connections.first; iter != connections.second; ++iter)
         {
@@ -117,6 +169,20 @@ void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &t
             uint8_t unitId = iter->second.get<uint8_t>("unit-id", 0);
 
             std::shared_ptr<ClientConnection> connection(new ClientConnection(endpoint, unitId));
+            // unconfigured addresses one request may read across to save round trips
+            connection->setGap(iter->second.get<std::uint16_t>("read-gap", 0));
+
+            // Registers are polled into the DataManager every 'scan-rate' seconds (the
+            // connection's, or their own); without one they are only read on request
+            double connectionRate = iter->second.get<double>("scan-rate", 0.0);
+            std::map<std::chrono::milliseconds, std::vector<comms::RegisterDescriptor>> scanRates;
+            auto scan = [&](const ptree& reg, const comms::RegisterDescriptor& rd) {
+                double rate = reg.get<double>("scan-rate", connectionRate);
+                if (rate > 0)
+                {
+                    scanRates[std::chrono::milliseconds(static_cast<std::int64_t>(rate * 1000))].push_back(rd);
+                }
+            };
 
             auto coils = iter->second.equal_range("coil");
             for (auto cIter = coils.first; cIter != coils.second; ++cIter)
@@ -129,6 +195,8 @@ void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &t
                 client->addTagConnection(rd.mTag, connection);
 
                 connection->addRegister(rd.mTag, rd);
+
+                scan(cIter->second, rd);
             }
 
             auto discretes = iter->second.equal_range("discrete-input");
@@ -142,6 +210,8 @@ void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &t
                 client->addTagConnection(rd.mTag, connection);
 
                 connection->addRegister(rd.mTag, rd);
+
+                scan(diIter->second, rd);
             }
 
             auto holdings = iter->second.equal_range("holding-register");
@@ -163,7 +233,9 @@ void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &t
 
                 connection->addRegister(rd.mTag, rd);
 
-                connection->setRange(rd.mRegisterAddress, range);
+                connection->setRange(rd.mRegisterType, rd.mRegisterAddress, range);
+
+                scan(hrIter->second, rd);
             }
 
             auto inputs = iter->second.equal_range("input-register");
@@ -184,8 +256,18 @@ void DataHandler::parseClientTree(std::shared_ptr<Client> client, const ptree &t
                 client->addTagConnection(rd.mTag, connection);
 
                 connection->addRegister(rd.mTag, rd);
-                connection->setRange(rd.mRegisterAddress, range);
+                connection->setRange(rd.mRegisterType, rd.mRegisterAddress, range);
+
+                scan(irIter->second, rd);
             }
+
+            addScanBlocks(scanner, connection, endpoint, unitId, scanRates, dm);
+        }
+
+        if (!scanner->empty())
+        {
+            client->setScanner(scanner);
+            scanner->start();
         }
 
         if (tree.get_child_optional("command-interface"))
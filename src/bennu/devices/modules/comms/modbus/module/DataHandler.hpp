@@ -25,7 +25,7 @@ public:
 protected:
     void parseServerTree(std::shared_ptr<Server> server, const ptree& tree);
 
-    void parseClientTree(std::shared_ptr<Client> client, const ptree& tree);
+    void parseClientTree(std::shared_ptr<Client> client, const ptree& tree, std::shared_ptr<field_device::DataManager> dm);
 
 };
 
@@ -0,0 +1,109 @@
+#include "ReadPlanner.hpp"
+
+#include <algorithm>
+
+#include "bennu/devices/modules/comms/modbus/protocol/constants.hpp"
+
+namespace bennu {
+namespace comms {
+namespace modbus {
+
+std::uint16_t ReadPlanner::maxCount(comms::RegisterType registerType)
+{
+    switch (registerType)
+    {
+        case comms::eStatusReadWrite:
+            return MB_MAX_READ_QTY_COILS;
+        case comms::eStatusReadOnly:
+            return MB_MAX_READ_QTY_DISCRETES;
+        case comms::eValueReadWrite:
+            return MB_MAX_READ_QTY_HOLDING_REGS;
+        case comms::eValueReadOnly:
+            return MB_MAX_READ_QTY_INPUT_REGS;
+        default:
+            return 0;
+    }
+}
+
+std::vector<ReadBlock> ReadPlanner::plan(std::vector<comms::RegisterDescriptor> registers) const
+{
+    std::stable_sort(registers.begin(), registers.end(), [](const comms::RegisterDescriptor& a, const comms::RegisterDescriptor& b) {
+        return a.mRegisterType != b.mRegisterType ? a.mRegisterType < b.mRegisterType : a.mRegisterAddress < b.mRegisterAddress;
+    });
+
+    // Extending the current block as far as it goes is optimal: any request
+    // covering the first register of a block ends no later than it does.
+    std::vector<ReadBlock> blocks;
+    for (const auto& reg : registers)
+    {
+        std::uint16_t max = maxCount(reg.mRegisterType);
+        if (max == 0)
+        {
+            continue;
+        }
+        if (!blocks.empty())
+        {
+            ReadBlock& block = blocks.back();
+            std::uint32_t last = block.mStart + block.mCount - 1u;
+            if (block.mRegisterType == reg.mRegisterType
+                && reg.mRegisterAddress <= last + mGap + 1u
+                && reg.mRegisterAddress - block.mStart < max)
+            {
+                block.mCount = static_cast<std::uint16_t>(std::max<std::uint32_t>(last, reg.mRegisterAddress) - block.mStart + 1u);
+                block.mRegisters.push_back(reg);
+                continue;
+            }
+        }
+        blocks.push_back({reg.mRegisterType, reg.mRegisterAddress, 1, {reg}});
+    }
+    return blocks;
+}
+
+bool ReadPlanner::split(const ReadBlock& block, ReadBlock& first, ReadBlock& second)
+{
+    const auto& regs = block.mRegisters;
+    if (regs.empty() || regs.front().mRegisterAddress == regs.back().mRegisterAddress)
+    {
+        return false;
+    }
+
+    // registers are sorted by address; cut before the register at 'at'
+    std::size_t at = 0;
+    std::uint16_t widest = 0;
+    for (std::size_t i = 1; i < regs.size(); ++i)
+    {
+        std::uint16_t gap = static_cast<std::uint16_t>(regs[i].mRegisterAddress - regs[i - 1].mRegisterAddress);
+        if (gap > widest)
+        {
+            widest = gap;
+            at = i;
+        }
+    }
+    if (widest <= 1)
+    {
+        // no hole; halve, keeping tags of one address together
+        at = regs.size() / 2;
+        while (at < regs.size() && regs[at].mRegisterAddress == regs[at - 1].mRegisterAddress)
+        {
+            ++at;
+        }
+        if (at == regs.size())
+        {
+            at = regs.size() / 2;
+            while (regs[at].mRegisterAddress == regs[at - 1].mRegisterAddress)
+            {
+                --at;
+            }
+        }
+    }
+
+    first = {block.mRegisterType, regs.front().mRegisterAddress, 0, {regs.begin(), regs.begin() + at}};
+    first.mCount = static_cast<std::uint16_t>(regs[at - 1].mRegisterAddress - first.mStart + 1);
+    second = {block.mRegisterType, regs[at].mRegisterAddress, 0, {regs.begin() + at, regs.end()}};
+    second.mCount = static_cast<std::uint16_t>(regs.back().mRegisterAddress - second.mStart + 1);
+    return true;
+}
+
+} // namespace modbus
+} // namespace comms
+} // namespace bennu
@@ -0,0 +1,77 @@
+#ifndef BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_READPLANNER_HPP
+#define BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_READPLANNER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bennu/devices/modules/comms/base/Common.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/constants.hpp"
+
+namespace bennu {
+namespace comms {
+namespace modbus {
+
+// One read request and the configured registers it returns
+struct ReadBlock
+{
+    comms::RegisterType mRegisterType;
+    std::uint16_t mStart;
+    std::uint16_t mCount;
+    std::vector<comms::RegisterDescriptor> mRegisters;  // by address; tags may share an address
+};
+
+/*
+ * Groups registers into the fewest read requests the spec allows (2000
+ * coils/discrete inputs, 125 registers). A request may read across up to
+ * 'gap' unconfigured addresses between two configured ones; devices that
+ * refuse such a read (see refused()) have the block split.
+ */
+class ReadPlanner
+{
+public:
+    ReadPlanner(std::uint16_t gap = 0) :
+        mGap(gap)
+    {
+    }
+
+    void setGap(std::uint16_t gap)
+    {
+        mGap = gap;
+    }
+
+    std::uint16_t getGap() const
+    {
+        return mGap;
+    }
+
+    // Most a request may read of the type
+    static std::uint16_t maxCount(comms::RegisterType registerType);
+
+    // Registers of any mix of types; unknown types are left out
+    std::vector<ReadBlock> plan(std::vector<comms::RegisterDescriptor> registers) const;
+
+    /*
+     * Split a refused block in two: at its widest run of unconfigured
+     * addresses if it has one (the likeliest hole in the device's map),
+     * otherwise between its middle registers. False for a single address.
+     */
+    static bool split(const ReadBlock& block, ReadBlock& first, ReadBlock& second);
+
+    // Exception code of a device refusing a read across addresses it does not have.
+    // Most answer ILLEGAL_DATA_ADDRESS, but some (older bennu outstations among
+    // them) answer ILLEGAL_DATA_VALUE.
+    static bool refused(std::uint8_t exceptionCode)
+    {
+        return exceptionCode == MB_ILLEGAL_DATA_ADDRESS || exceptionCode == MB_ILLEGAL_DATA_VALUE;
+    }
+
+private:
+    std::uint16_t mGap;
+
+};
+
+} // namespace modbus
+} // namespace comms
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_READPLANNER_HPP
@@ -1,5 +1,6 @@
 #include "Server.hpp"
 
+#include <algorithm>
 #include <functional>
 
 #include <boost/fusion/include/has_key.hpp>
@@ -16,7 +17,10 @@ namespace modbus {
 
 Server::Server(std::shared_ptr<field_device::DataManager> dm) :
     bennu::utility::DirectLoggable("modbus-server"),
-    mIOService()
+    mIOService(),
+    mThreads(4),
+    mMaxConnections(256),
+    mIdleTimeout(0)
 {
     setAdditionalFilterInformation("modbus");
     setDataManager(dm);
@@ -24,8 +28,19 @@ Server::Server(std::shared_ptr<field_device::DataManager> dm) :
 
 Server::~Server()
 {
-    mOutstationThread->join();
-    mAcceptor->close();
+    mIOService.stop();
+    if (mOutstationThread)
+    {
+        mOutstationThread->join();
+    }
+    for (auto& thread : mPool)
+    {
+        thread.join();
+    }
+    if (mAcceptor)
+    {
+        mAcceptor->close();
+    }
 
     mOutstationThread.reset();
 
@@ -44,11 +59,11 @@ void Server::accept(const std::string& endpoint)
     // If "tcp://" is in endpoint string, create a TCP channel. Otherwisie, create a serial channel
     if (findResult == std::string::npos)
     {
-        mChannel = std::make_shared<SerialChannel>(SerialChannel(mIOService, endpoint)); 
-        if (mChannel)
+        auto channel = std::make_shared<SerialChannel>(SerialChannel(mIOService, endpoint));
+        if (channel)
         {
-            std::dynamic_pointer_cast<SerialChannel>(mChannel)->connect();
-            setupConnection(error);
+            channel->connect();
+            setupConnection(channel, error);
         }
     }
     else
@@ -72,20 +87,33 @@ void Server::accept(const std::string& endpoint)
         }
 
         // Create a new TcpChannel object to handle additional/multiple connections
-        mChannel.reset(new TcpChannel(mIOService));
-        if (mChannel)
-        {
-            mAcceptor->async_accept(std::dynamic_pointer_cast<TcpChannel>(mChannel)->mSocket, boost::bind(&Server::acceptConnectionHandler, this, boost::asio::placeholders::error));
-        }
+        auto channel = std::make_shared<TcpChannel>(mIOService);
+        mAcceptor->async_accept(channel->mSocket, boost::bind(&Server::acceptConnectionHandler, this, channel, boost::asio::placeholders::error));
     }
 }
 
-void Server::acceptConnectionHandler(const boost::system::error_code& error)
+void Server::acceptConnectionHandler(std::shared_ptr<TcpChannel> channel, const boost::system::error_code& error)
 {
     if (!error)
     {
-        setupConnection(error);
-        std::cerr << "A new incoming connection started." << std::endl;  
+        std::size_t connections;
+        {
+            std::scoped_lock<std::mutex> lock(mConnectionsMutex);
+            connections = mConnections.size();
+        }
+        if (connections >= mMaxConnections)
+        {
+            std::cerr << "Refusing an incoming connection: already serving " << connections << " connections." << std::endl;
+            boost::system::error_code ec;
+            channel->mSocket.close(ec);
+        }
+        else
+        {
+            channel->setIdleTimeout(mIdleTimeout);
+            channel->setCloseHandler(std::bind(&Server::closeHandler, this, std::placeholders::_1));
+            setupConnection(channel, error);
+            std::cerr << "A new incoming connection started." << std::endl;
+        }
     }
     else
     {
@@ -95,6 +123,12 @@ void Server::acceptConnectionHandler(const boost::system::error_code& error)
     accept(mEndpoint);
 }
 
+void Server::closeHandler(TcpChannel* channel)
+{
+    std::scoped_lock<std::mutex> lock(mConnectionsMutex);
+    mConnections.erase(std::remove_if(mConnections.begin(), mConnections.end(),
+        [channel](const std::shared_ptr<Channel>& c) { return c.get() == channel; }), mConnections.end());
+}
 
 void Server::run(std::string endpoint)
 {
@@ -102,15 +136,20 @@ void Server::run(std::string endpoint)
 
     accept(endpoint);
 
+    // each connection serializes its own handlers, so connections are served in parallel
+    for (unsigned int i = 1; i < mThreads; ++i)
+    {
+        mPool.emplace_back([this]() { mIOService.run(); });
+    }
     mIOService.run();
 }
 
-void Server::setupConnection(const boost::system::error_code& error)
+void Server::setupConnection(std::shared_ptr<Channel> channel, const boost::system::error_code& error)
 {
     if (!error)
     {
         session_opts so;
-        so.transmit_fn = std::bind(&Channel::transmit, mChannel, std::placeholders::_1, std::placeholders::_2);
+        so.transmit_fn = std::bind(&Channel::transmit, channel, std::placeholders::_1, std::placeholders::_2);
 
         std::shared_ptr<protocol_stack> protocolStack(new protocol_stack(so));
         // register modbus application layer callbacks
@@ -125,9 +164,11 @@ void Server::setupConnection(const boost::system::error_code& error)
         boost::fusion::at_key<WRITE_MULTI_COIL>(protocolStack->app_layer.callbacks) = std::bind(&Server::writeCoils, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
         boost::fusion::at_key<WRITE_MULTI_REG>(protocolStack->app_layer.callbacks) = std::bind(&Server::writeHoldingRegisters, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 
-        // run the connection in a new thread
-        mChannel->manageSocket(protocolStack);
-        mConnections.push_back(mChannel);
+        {
+            std::scoped_lock<std::mutex> lock(mConnectionsMutex);
+            mConnections.push_back(channel);
+        }
+        channel->manageSocket(protocolStack);
     }
     else
     {
@@ -144,11 +185,31 @@ void Server::start(std::string endpoint)
     }
 }
 
+void Server::RegisterTable::add(const std::uint16_t address, const Register& reg)
+{
+    if (mRegisters.empty())
+    {
+        mBase = address;
+    }
+    else if (address < mBase)
+    {
+        // grow the table downwards
+        mRegisters.insert(mRegisters.begin(), mBase - address, Register());
+        mBase = address;
+    }
+    std::size_t offset = address - mBase;
+    if (offset >= mRegisters.size())
+    {
+        mRegisters.resize(offset + 1);
+    }
+    mRegisters[offset] = reg;
+}
+
 bool Server::addCoil(const uint16_t address, const std::string& tag)
 {
     if (mDataManager->hasTag(tag))
     {
-        mCoils[address] = tag;
+        mCoils.add(address, Register{tag, mDataManager->getTagHandle(tag)});
         return true;
     }
 
@@ -160,7 +221,7 @@ bool Server::addDiscreteInput(const uint16_t address, const std::string& tag)
 {
     if (mDataManager->hasTag(tag))
     {
-        mDiscreteInputs[address] = tag;
+        mDiscreteInputs.add(address, Register{tag, mDataManager->getTagHandle(tag)});
         return true;
     }
 
@@ -171,12 +232,10 @@ bool Server::addHoldingRegister(const uint16_t address, const std::string& tag,
 {
     if (mDataManager->hasTag(tag))
     {
-        mHoldingRegisters[address] = tag;
-        ScaledValue sv;
-        sv.mRange = range;
-        sv.mSlope = c16bitScale / (range.first - range.second);
-        sv.mIntercept = -(sv.mSlope * range.second);
-        mScaledValues[address] = sv;
+        Register reg{tag, mDataManager->getTagHandle(tag)};
+        reg.mSlope = c16bitScale / (range.first - range.second);
+        reg.mIntercept = -(reg.mSlope * range.second);
+        mHoldingRegisters.add(address, reg);
         return true;
     }
 
@@ -188,12 +247,10 @@ bool Server::addInputRegister(const uint16_t address, const std::string& tag, co
 {
     if (mDataManager->hasTag(tag))
     {
-        mInputRegisters[address] = tag;
-        ScaledValue sv;
-        sv.mRange = range;
-        sv.mSlope = c16bitScale / (range.first - range.second);
-        sv.mIntercept = -(sv.mSlope * range.second);
-        mScaledValues[address] = sv;
+        Register reg{tag, mDataManager->getTagHandle(tag)};
+        reg.mSlope = c16bitScale / (range.first - range.second);
+        reg.mIntercept = -(reg.mSlope * range.second);
+        mInputRegisters.add(address, reg);
         return true;
     }
     return false;
@@ -211,29 +268,26 @@ error_code_t::type Server::readCoils(uint16_t startAddress, uint16_t size, std::
         return error_code_t::SLAVE_DEVICE_FAILURE;
     }
 
-    for (size_t i = startAddress; i < startAddress + size; ++i)
+    const Register* registers = mCoils.find(startAddress, size);
+    if (!registers)
     {
-        auto iter = mCoils.find(i);
-        if (iter == mCoils.end())
-        {
-            os.str("");
-            os << "Invalid read coils request address " << i;
-            logEvent("read coils", "error", os.str());
-            return error_code_t::ILLEGAL_DATA_VALUE;
-        }
-        if (mDataManager->hasTag(iter->second))
-        {
-            values.push_back(mDataManager->getDataByTag<bool>(iter->second));
-        }
+        os.str("");
+        os << "Invalid read coils request - addresses starting at " << startAddress << " and reading " << size;
+        logEvent("read coils", "error", os.str());
+        return error_code_t::ILLEGAL_DATA_ADDRESS;
     }
 
-    // We weren't able to find/return all the data asked for, so this is an error.
-    if (values.size() < size)
+    std::size_t first = values.size();
+    values.resize(first + size);
+    mDataManager->readSnapshot([&]() {
+        for (std::uint16_t i = 0; i < size; ++i)
+        {
+            values[first + i] = mDataManager->getData<bool>(registers[i].mHandle);
+        }
+    });
+    for (std::uint16_t i = 0; i < size; ++i)
     {
-        os.str("");
-        os << "Invalid read coils request - too many addresses starting at " << startAddress << " and reading " << size;
-        logEvent("read coils", "error", os.str());
-        return error_code_t::ILLEGAL_DATA_VALUE;
+        mDataManager->traceRead(registers[i].mHandle);
     }
 
     logEvent("read coils", "info", os.str());
@@ -253,27 +307,24 @@ error_code_t::type Server::writeCoils(uint16_t startAddress, uint16_t size, cons
         return error_code_t::SLAVE_DEVICE_FAILURE;
     }
 
-    // Cycle through all addresses that we want to write
-    for (auto i = startAddress; i < startAddress + size; ++i)
+    const Register* registers = mCoils.find(startAddress, size);
+    if (!registers)
     {
-        // If the coil address isn't a "data" value, check to see if it's a configuration value.
-        // If not, output an illegal address error.
-        auto iter = mCoils.find(i);
-        if (iter == mCoils.end())
-        {
-            // If it's not a data or configuration value, then the address does not exist on device.
-            os.str("");
-            os << "Invalid write coils request address: " << i;
-            logEvent("write coils", "error", os.str());
-            return error_code_t::ILLEGAL_DATA_ADDRESS;
-        }
-
-        mDataManager->addUpdatedBinaryTag(iter->second, value[i - startAddress]);
+        // If it's not a data or configuration value, then the address does not exist on device.
         os.str("");
-        os << "Data successfully written.";
-        logEvent("write coils", "info", os.str());
+        os << "Invalid write coils request - addresses starting at " << startAddress << " and writing " << size;
+        logEvent("write coils", "error", os.str());
+        return error_code_t::ILLEGAL_DATA_ADDRESS;
+    }
 
+    // Cycle through all addresses that we want to write
+    for (std::uint16_t i = 0; i < size; ++i)
+    {
+        mDataManager->addUpdatedBinaryTag(registers[i].mTag, value[i]);
     }
+    os.str("");
+    os << "Data successfully written.";
+    logEvent("write coils", "info", os.str());
 
     return error_code_t::NO_ERROR;
 }
@@ -290,31 +341,26 @@ error_code_t::type Server::readDiscreteInputs(uint16_t startAddress, uint16_t si
         return error_code_t::SLAVE_DEVICE_FAILURE;
     }
 
-    for (size_t i = startAddress; i < startAddress + size; ++i)
+    const Register* registers = mDiscreteInputs.find(startAddress, size);
+    if (!registers)
     {
-        auto iter = mDiscreteInputs.find(i);
-        if (iter == mDiscreteInputs.end())
-        {
-            os.str("");
-            os << "Invalid read discrete inputs request address: " << i;
-            logEvent("read discrete inputs", "error", os.str());
-            return error_code_t::ILLEGAL_DATA_ADDRESS;
-        }
-        std::string t = iter->second;
-        if (mDataManager->hasTag(iter->second))
-        {
-            values.push_back(mDataManager->getDataByTag<bool>(iter->second));
-        }
-
+        os.str("");
+        os << "Invalid read discrete inputs request - addresses starting at " << startAddress << " and reading " << size;
+        logEvent("read discrete inputs", "error", os.str());
+        return error_code_t::ILLEGAL_DATA_ADDRESS;
     }
 
-    // We weren't able to find/return all the data asked for, so this is an error.
-    if (values.size() < size)
+    std::size_t first = values.size();
+    values.resize(first + size);
+    mDataManager->readSnapshot([&]() {
+        for (std::uint16_t i = 0; i < size; ++i)
+        {
+            values[first + i] = mDataManager->getData<bool>(registers[i].mHandle);
+        }
+    });
+    for (std::uint16_t i = 0; i < size; ++i)
     {
-        os.str("");
-        os << "Invalid read discete inputs request - too many addresses starting at " << startAddress << " and reading " << size;
-        logEvent("read discrete inputs", "error", os.str());
-        return error_code_t::ILLEGAL_DATA_VALUE;
+        mDataManager->traceRead(registers[i].mHandle);
     }
 
     logEvent("read discrete inputs", "info", os.str());
@@ -334,41 +380,17 @@ error_code_t::type Server::readHoldingRegisters(uint16_t startAddress, uint16_t
         return error_code_t::SLAVE_DEVICE_FAILURE;
     }
 
-    for (size_t i = startAddress; i < startAddress + size; ++i)
-    {
-        auto iter = mHoldingRegisters.find(i);
-        if (iter == mHoldingRegisters.end())
-        {
-            os.str("");
-            os << "Invalid read holding registers request address: " << i;
-            logEvent("read holding registers", "error", os.str());
-            return error_code_t::ILLEGAL_DATA_ADDRESS;
-        }
-
-        if (mDataManager->hasTag(iter->second))
-        {
-            double value = mDataManager->getDataByTag<double>(iter->second);
-            auto svIter = mScaledValues.find(i);
-            if (svIter != mScaledValues.end())
-            {
-                values.push_back((svIter->second.mSlope * value) + svIter->second.mIntercept);
-            }
-            else
-            {
-                values.push_back(value);
-            }
-        }
-    }
-
-    // We weren't able to find/return all the data asked for, so this is an error.
-    if (values.size() < size)
+    const Register* registers = mHoldingRegisters.find(startAddress, size);
+    if (!registers)
     {
         os.str("");
-        os << "Invalid read holding registers request - too many addresses starting at " << startAddress << " and reading " << size;
+        os << "Invalid read holding registers request - addresses starting at " << startAddress << " and reading " << size;
         logEvent("read holding registers", "error", os.str());
-        return error_code_t::ILLEGAL_DATA_VALUE;
+        return error_code_t::ILLEGAL_DATA_ADDRESS;
     }
 
+    readScaled(registers, size, values);
+
     logEvent("read holding registers", "info", os.str());
 
     return error_code_t::NO_ERROR;
@@ -386,33 +408,25 @@ error_code_t::type Server::writeHoldingRegisters(uint16_t startAddress, uint16_t
         return error_code_t::SLAVE_DEVICE_FAILURE;
     }
 
-    // Cycle through all addresses that we want to write
-    for (auto i = startAddress; i < startAddress + size; ++i)
+    const Register* registers = mHoldingRegisters.find(startAddress, size);
+    if (!registers)
     {
-        auto iter = mHoldingRegisters.find(i);
-        if (iter == mHoldingRegisters.end())
-        {
-            // If it's not a data or configuration value, then the address does not exist on device.
-            os.str("");
-            os << "Invalid write holding registers request address: " << i;
-            logEvent("write holding registers", "error", os.str());
-            return error_code_t::ILLEGAL_DATA_ADDRESS;
-
-        }
-
-        double newValue = value[i - startAddress];
-        auto svIter = mScaledValues.find(i);
-        if (svIter != mScaledValues.end())
-        {
-            newValue = (value[i - startAddress] - svIter->second.mIntercept) / svIter->second.mSlope;
-        }
-
-        mDataManager->addUpdatedAnalogTag(iter->second, newValue);
+        // If it's not a data or configuration value, then the address does not exist on device.
         os.str("");
-        os << "Data successfully written.";
-        logEvent("write holding registers", "info", os.str());
+        os << "Invalid write holding registers request - addresses starting at " << startAddress << " and writing " << size;
+        logEvent("write holding registers", "error", os.str());
+        return error_code_t::ILLEGAL_DATA_ADDRESS;
+    }
 
+    // Cycle through all addresses that we want to write
+    for (std::uint16_t i = 0; i < size; ++i)
+    {
+        double newValue = (value[i] - registers[i].mIntercept) / registers[i].mSlope;
+        mDataManager->addUpdatedAnalogTag(registers[i].mTag, newValue);
     }
+    os.str("");
+    os << "Data successfully written.";
+    logEvent("write holding registers", "info", os.str());
 
     return error_code_t::NO_ERROR;
 }
@@ -429,53 +443,47 @@ error_code_t::type Server::readInputRegisters(uint16_t startAddress, uint16_t si
         return error_code_t::SLAVE_DEVICE_FAILURE;
     }
 
-    for (size_t i = startAddress; i < startAddress + size; ++i)
-    {
-        auto iter = mInputRegisters.find(i);
-        if (iter == mInputRegisters.end())
-        {
-            os.str("");
-            os << "Invalid read input registers request address: " << i;
-            logEvent("read input registers", "error", os.str());
-            return error_code_t::ILLEGAL_DATA_ADDRESS;
-        }
-
-        if (mDataManager->hasTag(iter->second))
-        {
-            double value = mDataManager->getDataByTag<double>(iter->second);
-            auto svIter = mScaledValues.find(i);
-            if (svIter != mScaledValues.end())
-            {
-                values.push_back((svIter->second.mSlope * value) + svIter->second.mIntercept);
-            }
-            else
-            {
-                values.push_back(value);
-            }
-        }
-
-    }
-
-    // We weren't able to find/return all the data asked for, so this is an error.
-    if (values.size() < size)
+    const Register* registers = mInputRegisters.find(startAddress, size);
+    if (!registers)
     {
         os.str("");
-        os << mName << " -- invalid read input registers request - too many addresses starting at " << startAddress << " and reading " << size;
+        os << mName << " -- invalid read input registers request - addresses starting at " << startAddress << " and reading " << size;
         logEvent("read input registers", "error", os.str());
-        return error_code_t::ILLEGAL_DATA_VALUE;
+        return error_code_t::ILLEGAL_DATA_ADDRESS;
     }
 
+    readScaled(registers, size, values);
+
     logEvent("read input registers", "info", os.str());
 
     return error_code_t::NO_ERROR;
 }
 
+void Server::readScaled(const Register* registers, const std::uint16_t size, std::vector<std::uint16_t>& values)
+{
+    std::size_t first = values.size();
+    values.resize(first + size);
+    mDataManager->readSnapshot([&]() {
+        for (std::uint16_t i = 0; i < size; ++i)
+        {
+            double value = mDataManager->getData<double>(registers[i].mHandle);
+            values[first + i] = static_cast<std::uint16_t>((registers[i].mSlope * value) + registers[i].mIntercept);
+        }
+    });
+    for (std::uint16_t i = 0; i < size; ++i)
+    {
+        mDataManager->traceRead(registers[i].mHandle);
+    }
+}
+
 Server::Server(const Server& server) : 
     bennu::utility::DirectLoggable("modbus-server"),
-    mIOService()
+    mIOService(),
+    mThreads(server.mThreads),
+    mMaxConnections(server.mMaxConnections),
+    mIdleTimeout(server.mIdleTimeout)
 {
     mAcceptor = server.mAcceptor;
-    mChannel = server.mChannel;
 }
 
 } // namespace modbus
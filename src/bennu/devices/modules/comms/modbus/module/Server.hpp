@@ -1,6 +1,7 @@
 #ifndef BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_SERVER_HPP
 #define BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_SERVER_HPP
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <map>
@@ -29,11 +30,45 @@ namespace modbus {
 class Server : public CommsModule, public utility::DirectLoggable, public std::enable_shared_from_this<Server>
 {
 public:
-    struct ScaledValue
+    // Register tag resolved to its data store slot (and scaling) when the server is configured
+    struct Register
     {
-        std::pair<double, double> mRange;
-        double mSlope;
-        double mIntercept;
+        std::string mTag;
+        field_device::TagHandle mHandle;
+        double mSlope{1.0};         // register = mSlope * value + mIntercept
+        double mIntercept{0.0};
+    };
+
+    /*
+     * One register table indexed by address - mBase, so serving a request is
+     * a bounds check and a loop. Addresses inside the table that were never
+     * configured have an invalid handle.
+     */
+    struct RegisterTable
+    {
+        std::uint16_t mBase{0};
+        std::vector<Register> mRegisters;
+
+        // The 'size' registers from 'address' on, or nullptr if any is not configured
+        const Register* find(const std::uint16_t address, const std::uint16_t size) const
+        {
+            std::size_t offset = address - mBase;
+            if (address < mBase || size == 0 || offset + size > mRegisters.size())
+            {
+                return nullptr;
+            }
+            const Register* first = &mRegisters[offset];
+            for (std::uint16_t i = 0; i < size; ++i)
+            {
+                if (!first[i].mHandle.valid())
+                {
+                    return nullptr;
+                }
+            }
+            return first;
+        }
+
+        void add(const std::uint16_t address, const Register& reg);
     };
 
 public:
@@ -53,6 +88,24 @@ public:
 
     void accept(const std::string& endpoint);
 
+    // Threads running the server's io_service (default 4). Set before start.
+    void setThreads(const unsigned int threads)
+    {
+        mThreads = threads > 0 ? threads : 1;
+    }
+
+    // TCP connections served at once; more are closed as soon as they are accepted
+    void setMaxConnections(const std::size_t connections)
+    {
+        mMaxConnections = connections;
+    }
+
+    // Close TCP connections without a request for 'timeout' (0 = never)
+    void setIdleTimeout(const std::chrono::seconds& timeout)
+    {
+        mIdleTimeout = timeout;
+    }
+
     error_code_t::type readCoils(std::uint16_t startAddress, std::uint16_t size, std::vector<bool>& values);
     error_code_t::type writeCoils(std::uint16_t startAddress, std::uint16_t size, const std::vector<bool>& value);
     error_code_t::type readDiscreteInputs(std::uint16_t startAddress, std::uint16_t size, std::vector<bool>& values);
@@ -61,27 +114,36 @@ public:
     error_code_t::type readInputRegisters(std::uint16_t startAddress, std::uint16_t size, std::vector<std::uint16_t>& values);
 
 protected:
-    void acceptConnectionHandler(const boost::system::error_code& error);
+    void acceptConnectionHandler(std::shared_ptr<TcpChannel> channel, const boost::system::error_code& error);
 
-    void setupConnection(const boost::system::error_code& error);
+    void setupConnection(std::shared_ptr<Channel> channel, const boost::system::error_code& error);
+
+    // A TCP connection went away
+    void closeHandler(TcpChannel* channel);
 
     void run(std::string endpoint);
 
+    // Scaled analog values of 'size' registers, read from one snapshot of the data
+    void readScaled(const Register* registers, const std::uint16_t size, std::vector<std::uint16_t>& values);
+
 private:
     boost::asio::io_service mIOService;
-    std::shared_ptr<Channel> mChannel;
     std::shared_ptr<boost::asio::ip::tcp::acceptor> mAcceptor;
     std::string mEndpoint;
     std::string mAddress;
     unsigned short mPort;
     std::shared_ptr<protocol_stack> mProtocolStack;
     std::shared_ptr<std::thread> mOutstationThread;
-    std::map<std::uint16_t, std::string> mCoils;
-    std::map<std::uint16_t, std::string> mDiscreteInputs;
-    std::map<std::uint16_t, std::string> mHoldingRegisters;
-    std::map<std::uint16_t, std::string> mInputRegisters;
+    std::vector<std::thread> mPool;             // the other io_service threads
+    unsigned int mThreads;
+    std::size_t mMaxConnections;
+    std::chrono::seconds mIdleTimeout;
+    RegisterTable mCoils;
+    RegisterTable mDiscreteInputs;
+    RegisterTable mHoldingRegisters;
+    RegisterTable mInputRegisters;
     const double c16bitScale = 65535.0;
-    std::map<std::uint16_t, ScaledValue> mScaledValues;
+    std::mutex mConnectionsMutex;               // connections come and go on any pool thread
     std::vector<std::shared_ptr<Channel>> mConnections;
     Server(const Server&);
     Server& operator =(const Server&);
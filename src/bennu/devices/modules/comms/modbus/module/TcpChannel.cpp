@@ -15,7 +15,15 @@ namespace comms {
 namespace modbus {
 
 
-TcpChannel::TcpChannel(boost::asio::io_service& io_service) : mSocket(io_service)
+TcpChannel::TcpChannel(boost::asio::io_service& io_service) :
+    mSocket(io_service),
+    mStrand(io_service),
+    mIdleTimer(io_service),
+    mIdleTimeout(0),
+    mData(MB_MAX_ADU_LENGTH),
+    mState(eHeader),
+    mLength(0),
+    mClosed(false)
 {
 }
 
@@ -25,73 +33,159 @@ TcpChannel::~TcpChannel()
 
 void TcpChannel::close()
 {
-    boost::system::error_code ec;
-
-    if (mSocket.is_open())
-    {
-        mSocket.close(ec);
-    }
-
-    if (ec)
-    {
-        std::cerr << "There was a problem closing a connection: " << std::endl;
-    }
+    // may be called from any thread
+    boost::asio::post(mStrand, std::bind(&TcpChannel::shutdown, shared_from_this(), "closed by server"));
 }
 
 void TcpChannel::manageSocket(std::shared_ptr<protocol_stack> protocolStack)
 {
     mProtocolStack = protocolStack;
 
-    mData.resize(1024);
-    boost::asio::async_read(mSocket, boost::asio::buffer(mData, mData.size()), boost::asio::transfer_exactly(4), boost::bind(&TcpChannel::readHandler, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    boost::system::error_code ec;
+    mSocket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+    boost::asio::post(mStrand, std::bind(&TcpChannel::readHeader, shared_from_this()));
+}
 
+void TcpChannel::readHeader()
+{
+    mState = eHeader;
+    restartIdleTimer();
+    boost::asio::async_read(mSocket, boost::asio::buffer(&mData[0], HEADER_SIZE),
+        boost::asio::bind_executor(mStrand, boost::bind(&TcpChannel::readHandler, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
 }
 
 void TcpChannel::readHandler(const boost::system::error_code& error, size_t bytesTransferred)
 {
-    if (!error)
+    if (mClosed)
     {
-        if (bytesTransferred == 4)
-        {
-            boost::system::error_code ec;
-            // Because this is a TCP connection, we should be able to synchronously read message contents after initial read
-            bytesTransferred += boost::asio::read(mSocket, boost::asio::buffer(&mData[4], 2), boost::asio::transfer_exactly(2), ec);
-
-            if (ec)
-            {
-                std::cerr << "Modbus RTU receive message length failed with error: " << ec.message() << std::endl;
-            }
-
-            uint16_t readData;
-            std::memcpy(&readData, &mData[4], 2);
-            uint16_t length = ntohs(readData);
-
-            bytesTransferred += boost::asio::read(mSocket, boost::asio::buffer(&mData[6], length), boost::asio::transfer_exactly(length), ec);
-            if (ec)
-            {
-                std::cerr << "Modbus RTU receive message of length " << length << " failed with error: " << ec.message() << std::endl;
-            }
-            mProtocolStack->data_receive_signal(&mData[0], bytesTransferred);
+        return;
+    }
+    if (error)
+    {
+        // If TCP connection is closed unexpectedly, we'll get this error
+        shutdown("Modbus receive message failed with error: " + error.message());
+        return;
+    }
 
+    if (mState == eHeader)
+    {
+        std::uint16_t protocol = static_cast<std::uint16_t>((mData[MBAP_HDR_PROTOCOL_ID] << 8) | mData[MBAP_HDR_PROTOCOL_ID + 1]);
+        mLength = static_cast<std::uint16_t>((mData[MBAP_HDR_LENGTH] << 8) | mData[MBAP_HDR_LENGTH + 1]);
+        // there is no resynchronizing a TCP stream after a bad header
+        if (protocol != 0 || mLength < 2 || HEADER_SIZE + mLength > MB_MAX_ADU_LENGTH)
+        {
+            std::ostringstream os;
+            os << "Modbus receive message with protocol " << protocol << " and length " << mLength << " is invalid";
+            shutdown(os.str());
+            return;
         }
-
-        boost::asio::async_read(mSocket, boost::asio::buffer(mData, mData.size()), boost::asio::transfer_exactly(4), boost::bind(&TcpChannel::readHandler, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        mState = eBody;
+        boost::asio::async_read(mSocket, boost::asio::buffer(&mData[HEADER_SIZE], mLength),
+            boost::asio::bind_executor(mStrand, boost::bind(&TcpChannel::readHandler, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+        return;
     }
-    else
+
+    // the response comes back through transmit()
+    mProtocolStack->data_receive_signal(&mData[0], HEADER_SIZE + mLength);
+    if (!mClosed)
     {
-        // If TCP connection is closed unexpectedly, we'll get this error, but we should be handling any additional requests
-        std::cerr << "Modbus RTU receive message failed with error: " << error.message() << std::endl;
+        readHeader();
     }
 }
 
 void TcpChannel::transmit(std::uint8_t* buffer, size_t size)
 {
-    boost::system::error_code error;
-    size_t bufferSize = boost::asio::write(mSocket, boost::asio::buffer(buffer, size), error);
+    if (mClosed)
+    {
+        return;
+    }
+    if (mWriteQueue.size() >= MAX_QUEUED)
+    {
+        shutdown("Modbus client is not reading its responses");
+        return;
+    }
+    mWriteQueue.emplace_back(buffer, buffer + size);
+    if (mWriteQueue.size() == 1)
+    {
+        write();
+    }
+}
+
+void TcpChannel::write()
+{
+    auto& response = mWriteQueue.front();
+    boost::asio::async_write(mSocket, boost::asio::buffer(response),
+        boost::asio::bind_executor(mStrand, boost::bind(&TcpChannel::writeHandler, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+}
+
+void TcpChannel::writeHandler(const boost::system::error_code& error, size_t bytesTransferred)
+{
+    if (mClosed)
+    {
+        return;
+    }
     if (error)
     {
-        std::cerr << "Modbus RTUs transmit response failed with sent buffer of " << bufferSize << " and error: " << error.message() << std::endl;
-        close();
+        std::ostringstream os;
+        os << "Modbus transmit response failed with sent buffer of " << bytesTransferred << " and error: " << error.message();
+        shutdown(os.str());
+        return;
+    }
+    mWriteQueue.pop_front();
+    if (!mWriteQueue.empty())
+    {
+        write();
+    }
+}
+
+void TcpChannel::restartIdleTimer()
+{
+    if (mIdleTimeout.count() == 0)
+    {
+        return;
+    }
+    mIdleTimer.expires_after(mIdleTimeout);
+    mIdleTimer.async_wait(boost::asio::bind_executor(mStrand, boost::bind(&TcpChannel::idleHandler, shared_from_this(), boost::asio::placeholders::error)));
+}
+
+void TcpChannel::idleHandler(const boost::system::error_code& error)
+{
+    // a restarted timer cancels the previous wait
+    if (error == boost::asio::error::operation_aborted || mClosed || mIdleTimer.expiry() > std::chrono::steady_clock::now())
+    {
+        return;
+    }
+    shutdown("Modbus connection idle for " + std::to_string(mIdleTimeout.count()) + " seconds");
+}
+
+void TcpChannel::shutdown(const std::string& reason)
+{
+    if (mClosed)
+    {
+        return;
+    }
+    mClosed = true;
+    std::cerr << reason << std::endl;
+
+    boost::system::error_code ec;
+    mIdleTimer.cancel();
+    if (mSocket.is_open())
+    {
+        mSocket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+        mSocket.close(ec);
+    }
+    if (ec)
+    {
+        std::cerr << "There was a problem closing a connection: " << ec.message() << std::endl;
+    }
+    mWriteQueue.clear();
+
+    // the stack's transmit function holds on to this channel; we may be inside the
+    // stack right now, so let go of it once the current handler is done
+    boost::asio::post(mStrand, [self = shared_from_this()]() { self->mProtocolStack.reset(); });
+    if (mCloseHandler)
+    {
+        mCloseHandler(this);
     }
 }
 
@@ -1,7 +1,10 @@
 #ifndef BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_CHANNEL_HPP
 #define BENNU_FIELDDEVICE_COMMS_MODBUS_TCP_CHANNEL_HPP
 
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <map>
 #include <sstream>
@@ -12,6 +15,7 @@
 #include <any>
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include "bennu/devices/modules/comms/base/CommsModule.hpp"
 #include "bennu/devices/modules/comms/modbus/protocol/error-codes.hpp"
@@ -24,9 +28,23 @@ namespace bennu {
 namespace comms {
 namespace modbus {
 
-class TcpChannel : public Channel
+/*
+ * One modbus TCP connection of the server. Requests are read without ever
+ * blocking: the MBAP header up to the length field, then the rest of the
+ * ADU, then it is handed to the protocol stack. Responses are queued and
+ * written asynchronously. Every handler runs on the connection's strand, so
+ * the server's io_service may be run by a pool of threads while each
+ * connection is still served one request at a time.
+ *
+ * Must be owned by a shared_ptr; pending handlers keep the channel alive
+ * until it is closed.
+ */
+class TcpChannel : public Channel, public std::enable_shared_from_this<TcpChannel>
 {
 public:
+    // Called (once) when the connection is gone, from the connection's strand
+    typedef std::function<void (TcpChannel* channel)> CloseHandler;
+
     TcpChannel(boost::asio::io_service& io_service);
 
     ~TcpChannel();
@@ -45,11 +63,48 @@ public:
 
     std::string getChannelType();
 
+    // Close the connection if no request arrives for 'timeout' (0 = never). Set before manageSocket.
+    void setIdleTimeout(const std::chrono::seconds& timeout)
+    {
+        mIdleTimeout = timeout;
+    }
+
+    void setCloseHandler(CloseHandler handler)
+    {
+        mCloseHandler = handler;
+    }
+
     boost::asio::ip::tcp::socket mSocket;
 
 private:
+    // MBAP transaction id, protocol id and length fields
+    static const std::size_t HEADER_SIZE = 6;
+    // Responses a client may leave unread before it is dropped
+    static const std::size_t MAX_QUEUED = 16;
+
+    enum State
+    {
+        eHeader,
+        eBody
+    };
+
+    void readHeader();
+    void writeHandler(const boost::system::error_code& error, size_t bytesTransferred);
+    void write();
+    void restartIdleTimer();
+    void idleHandler(const boost::system::error_code& error);
+    void shutdown(const std::string& reason);
+
+    boost::asio::io_service::strand mStrand;
+    boost::asio::steady_timer mIdleTimer;
+    std::chrono::seconds mIdleTimeout;
     std::shared_ptr<protocol_stack> mProtocolStack;
     std::vector<std::uint8_t> mData;
+    State mState;
+    std::size_t mLength;                                // ADU bytes being read
+    std::deque<std::vector<std::uint8_t>> mWriteQueue;  // front is being written
+    bool mClosed;
+    CloseHandler mCloseHandler;
     TcpChannel& operator =(const TcpChannel&);
 };
 
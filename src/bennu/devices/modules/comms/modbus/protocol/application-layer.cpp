@@ -1,4 +1,3 @@
-#include <arpa/inet.h>
 #include <algorithm>
 #include <iostream>
 
@@ -12,57 +11,18 @@ template <>
 void serialize<Coil>(
         std::vector<typename Coil::value_type> const& values, std::vector<uint8_t>& loc)
 {
-    uint8_t packed_byte = 0x00;
-
-    int i = 0;
-    for ( auto value : values )
-    {
-        if ( value ) // coil is on
-        {
-            packed_byte |= static_cast<uint8_t>(0x01 << (i % 8));
-        }
-        if ( (i + 1) % 8 == 0 && (i != 0) )
-        {
-            loc.push_back( packed_byte );
-            packed_byte = 0x00;
-        }
-
-        ++i;
-    }
-
-    if ( (values.size() % 8) != 0 )
-    {
-        loc.push_back(packed_byte);
-    }
+    size_t size = loc.size();
+    loc.resize(size + codec::packed_size(values.size()));
+    codec::pack_bits(values, &loc[size]);
 }
 
 template <>
 void serialize<Discrete_Input>(
-        std::vector<typename Coil::value_type> const& values, std::vector<uint8_t>& loc)
+        std::vector<typename Discrete_Input::value_type> const& values, std::vector<uint8_t>& loc)
 {
-    uint8_t packed_byte = 0x00;
-
-    int i = 0;
-    for ( auto value : values )
-    {
-        if ( value ) // discrete input is on
-        {
-            packed_byte |= static_cast<uint8_t>(0x01 << (i % 8));
-        }
-
-        if ( (i + 1) % 8 == 0 && (i != 0) )
-        {
-            loc.push_back( packed_byte );
-            packed_byte = 0x00;
-        }
-
-        ++i;
-    }
-
-    if ( (values.size() % 8) != 0 )
-    {
-        loc.push_back(packed_byte);
-    }
+    size_t size = loc.size();
+    loc.resize(size + codec::packed_size(values.size()));
+    codec::pack_bits(values, &loc[size]);
 }
 
 
@@ -70,72 +30,28 @@ template <>
 void deserialize<Coil>(
         uint8_t const* buffer, uint8_t data_offset, uint16_t quantity, std::vector<typename Coil::value_type>& loc_values)
 {
-    uint8_t packed_byte = 0x00;
-
-    for (uint16_t i=0; i < quantity; ++i)
-    {
-        if (i % 8 == 0)
-        {
-            packed_byte = buffer[data_offset + (i / 8)];
-        }
-
-        if ((packed_byte & (0x01 << (i % 8))) != 0)
-        {
-            loc_values.push_back(true);
-        }
-        else
-        {
-            loc_values.push_back(false);
-        }
-    }
+    codec::unpack_bits(&buffer[data_offset], quantity, loc_values);
 }
 
 template <>
 void deserialize<Discrete_Input>(
         uint8_t const* buffer, uint8_t data_offset, uint16_t quantity, std::vector<typename Discrete_Input::value_type>& loc_values)
 {
-    uint8_t packed_byte = 0x00;
-
-    for (uint16_t i=0; i < quantity; ++i)
-    {
-        if (i % 8 == 0)
-        {
-            packed_byte = buffer[data_offset + (i / 8)];
-        }
-
-        if ((packed_byte & (0x01 << (i % 8))) != 0)
-        {
-            loc_values.push_back(true);
-        }
-        else
-        {
-            loc_values.push_back(false);
-        }
-    }
+    codec::unpack_bits(&buffer[data_offset], quantity, loc_values);
 }
 
 template <>
 void deserialize<Holding_Register>(
         uint8_t const* buffer, uint8_t data_offset, uint16_t quantity, std::vector<typename Holding_Register::value_type>& loc_values)
 {
-    typename Holding_Register::value_type packed_short;
-    for (uint16_t i = 0; i < quantity; ++i)
-    {
-        packed_short = ntohs(*reinterpret_cast<typename Holding_Register::value_type const*>( &buffer[data_offset + (2 * i)] ));
-        loc_values.push_back( packed_short );
-    }
+    codec::decode_registers(&buffer[data_offset], quantity, loc_values);
 }
 
 template <>
 void deserialize<Input_Register>(
         uint8_t const* buffer, uint8_t data_offset, uint16_t quantity, std::vector<typename Input_Register::value_type>& loc_values)
 {
-    typename Input_Register::value_type packed_short;
-    for (uint16_t i = 0; i < quantity; ++i)
-    {
-        packed_short = ntohs(*reinterpret_cast<typename Input_Register::value_type const*>( &buffer[data_offset + (2 * i)] ));
-        loc_values.push_back( packed_short );
-    }
+    codec::decode_registers(&buffer[data_offset], quantity, loc_values);
 }
 
 } // namespace detail
@@ -145,9 +61,9 @@ mbap_header_t mbap_header::parse( uint8_t const* pdu )
 {
     mbap_header_t hdr =
     {
-        ntohs(*reinterpret_cast<uint16_t const*>(&pdu[0])),
-        ntohs(*reinterpret_cast<uint16_t const*>(&pdu[2])),
-        ntohs(*reinterpret_cast<uint16_t const*>(&pdu[4])),
+        codec::get_u16(&pdu[MBAP_HDR_TRANSACTION_ID]),
+        codec::get_u16(&pdu[MBAP_HDR_PROTOCOL_ID]),
+        codec::get_u16(&pdu[MBAP_HDR_LENGTH]),
         pdu[6]
     };
     return hdr;
@@ -235,529 +151,137 @@ application::layer::layer(callback_map_t cbmap) :
                                                std::bind(Request_Handler<WRITE_MULTI_REG>(), std::placeholders::_1, std::placeholders::_2, std::ref(callbacks))));
 }
 
-error_code_t::type application::layer::read_coils(uint16_t start_address, uint16_t quantity, std::vector<bool>& values)
+error_code_t::type application::layer::transact(uint8_t* request, size_t size, uint8_t func_code, codec::adu_buffer_t& response)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(READ_COILS::func_code);
-    pdu.push_back(static_cast<uint8_t>(start_address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(start_address)); // start addr LO
-    pdu.push_back(static_cast<uint8_t>(quantity >> 8)); // quantity HI
-    pdu.push_back(static_cast<uint8_t>(quantity)); // quantity LO
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
+    // the encoders refuse quantities the function code does not allow
+    if ( size == 0 )
+    {
+        return error_code_t::ILLEGAL_DATA_VALUE;
+    }
     transaction_id_++;
 
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
     // send the request
-    data_send_signal(&pdu[0], pdu.size());
+    data_send_signal(request, size);
 
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
+    // await the response; a failed receive leaves a zero length header behind
+    response.fill(0);
+    awaiting_data_signal(&response[0], response.size());
 
     /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
+    return codec::check_response(&response[0], response.size(), func_code);
+}
 
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
-    {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
+error_code_t::type application::layer::read_coils(uint16_t start_address, uint16_t quantity, std::vector<bool>& values)
+{
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_read_request(&request[0], transaction_id_, unit_id_, READ_COILS::func_code, start_address, quantity);
 
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != READ_COILS::func_code )
+    error_code_t::type error = transact(&request[0], size, READ_COILS::func_code, response);
+    if ( error != error_code_t::NO_ERROR )
     {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (READ_COILS::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
+        return error;
     }
 
     // extract the requested data
-    uint8_t const DATA_OFFSET = 2 + sizeof(mbap_header_t);
-    detail::deserialize<READ_COILS::register_type>(response, DATA_OFFSET, quantity, values);
-
-    return error_code_t::NO_ERROR;
+    return codec::decode_read_bits_response(&response[0], response.size(), READ_COILS::func_code, quantity, values);
 }
 
 
 error_code_t::type application::layer::read_discrete_inputs(uint16_t start_address, uint16_t quantity, std::vector<bool>& values)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(READ_DISCRETE_INPUTS::func_code);
-    pdu.push_back(static_cast<uint8_t>(start_address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(start_address)); // start addr LO
-    pdu.push_back(static_cast<uint8_t>(quantity >> 8)); // quantity HI
-    pdu.push_back(static_cast<uint8_t>(quantity)); // quantity LO
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_read_request(&request[0], transaction_id_, unit_id_, READ_DISCRETE_INPUTS::func_code, start_address, quantity);
 
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
-
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
+    error_code_t::type error = transact(&request[0], size, READ_DISCRETE_INPUTS::func_code, response);
+    if ( error != error_code_t::NO_ERROR )
     {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
-
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != READ_DISCRETE_INPUTS::func_code )
-    {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (READ_DISCRETE_INPUTS::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
+        return error;
     }
 
     // extract the requested data
-    uint8_t const DATA_OFFSET = 2 + sizeof(mbap_header_t);
-    detail::deserialize<READ_DISCRETE_INPUTS::register_type>(response, DATA_OFFSET, quantity, values);
-
-    return error_code_t::NO_ERROR;
+    return codec::decode_read_bits_response(&response[0], response.size(), READ_DISCRETE_INPUTS::func_code, quantity, values);
 }
 
 
 error_code_t::type application::layer::read_holding_registers(uint16_t start_address, uint16_t quantity, std::vector<uint16_t>& values)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(READ_HOLDING_REGS::func_code);
-    pdu.push_back(static_cast<uint8_t>(start_address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(start_address)); // start addr LO
-    pdu.push_back(static_cast<uint8_t>(quantity >> 8)); // quantity HI
-    pdu.push_back(static_cast<uint8_t>(quantity)); // quantity LO
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_read_request(&request[0], transaction_id_, unit_id_, READ_HOLDING_REGS::func_code, start_address, quantity);
 
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
-
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
-
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
-    {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
-
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != READ_HOLDING_REGS::func_code )
+    error_code_t::type error = transact(&request[0], size, READ_HOLDING_REGS::func_code, response);
+    if ( error != error_code_t::NO_ERROR )
     {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (READ_HOLDING_REGS::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
+        return error;
     }
 
     // extract the requested data
-    uint8_t const DATA_OFFSET = 2 + sizeof(mbap_header_t);
-    detail::deserialize<READ_HOLDING_REGS::register_type>(response, DATA_OFFSET, quantity, values);
-
-    return error_code_t::NO_ERROR;
+    return codec::decode_read_registers_response(&response[0], response.size(), READ_HOLDING_REGS::func_code, quantity, values);
 }
 
 
 error_code_t::type application::layer::read_input_registers(uint16_t start_address, uint16_t quantity, std::vector<uint16_t>& values)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(READ_INPUT_REGS::func_code);
-    pdu.push_back(static_cast<uint8_t>(start_address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(start_address)); // start addr LO
-    pdu.push_back(static_cast<uint8_t>(quantity  >> 8)); // quantity HI
-    pdu.push_back(static_cast<uint8_t>(quantity)); // quantity LO
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
-
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_read_request(&request[0], transaction_id_, unit_id_, READ_INPUT_REGS::func_code, start_address, quantity);
 
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
+    error_code_t::type error = transact(&request[0], size, READ_INPUT_REGS::func_code, response);
+    if ( error != error_code_t::NO_ERROR )
     {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
+        return error;
     }
 
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != READ_INPUT_REGS::func_code )
-    {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (READ_INPUT_REGS::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
-    }
-
-    // extract requested data
-    uint8_t const DATA_OFFSET = 2 + sizeof(mbap_header_t);
-    detail::deserialize<READ_INPUT_REGS::register_type>(response, DATA_OFFSET, quantity, values);
-
-    return error_code_t::NO_ERROR;
+    // extract the requested data
+    return codec::decode_read_registers_response(&response[0], response.size(), READ_INPUT_REGS::func_code, quantity, values);
 }
 
 error_code_t::type application::layer::write_coil(uint16_t address, bool value)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(WRITE_SINGLE_COIL::func_code);
-    pdu.push_back(static_cast<uint8_t>(address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(address)); // start addr LO
-
-    if (value)
-    {
-        pdu.push_back(0xFF); pdu.push_back(0x00);
-    }
-    else
-    {
-        pdu.push_back(0x00); pdu.push_back(0x00);
-    }
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
-
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
-
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
-    {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_write_single_request(&request[0], transaction_id_, unit_id_, WRITE_SINGLE_COIL::func_code, address,
+            value ? MB_MAX_COIL_VALUE : MB_MIN_COIL_VALUE);
 
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != WRITE_SINGLE_COIL::func_code )
-    {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (WRITE_SINGLE_COIL::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
-    }
-
-    return error_code_t::NO_ERROR;
+    return transact(&request[0], size, WRITE_SINGLE_COIL::func_code, response);
 }
 
 
 error_code_t::type application::layer::write_register(uint16_t address, uint16_t value)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(WRITE_SINGLE_REG::func_code);
-    pdu.push_back(static_cast<uint8_t>(address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(address)); // start addr LO
-
-    pdu.push_back(static_cast<uint8_t>(value >> 8)); // value HI
-    pdu.push_back(static_cast<uint8_t>(value)); // value LO
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_write_single_request(&request[0], transaction_id_, unit_id_, WRITE_SINGLE_REG::func_code, address, value);
 
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
-
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
-
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
-    {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
-
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != WRITE_SINGLE_REG::func_code )
-    {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (WRITE_SINGLE_REG::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
-    }
-
-    return error_code_t::NO_ERROR;
+    return transact(&request[0], size, WRITE_SINGLE_REG::func_code, response);
 }
 
 
 error_code_t::type application::layer::write_coils(uint16_t start_address, std::vector<bool> const& values)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
-
-    // create the pdu body
-    pdu.push_back(WRITE_MULTI_COIL::func_code);
-    pdu.push_back(static_cast<uint8_t>(start_address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(start_address)); // start addr LO
-
-    uint16_t quantity = static_cast<uint16_t>(values.size());
-    pdu.push_back(static_cast<uint8_t>(quantity >> 8)); // quantity HI
-    pdu.push_back(static_cast<uint8_t>(quantity)); // quantity LO
-
-    std::vector<uint8_t> serialized_values;
-    detail::serialize<WRITE_MULTI_COIL::register_type>(values, serialized_values);
-
-    uint8_t byte_count = static_cast<uint8_t>(serialized_values.size());
-    pdu.push_back(byte_count);
-
-    for ( uint8_t byte : serialized_values )
-    {
-        pdu.push_back(byte);
-    }
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
-
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
-
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
-    {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
-
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != WRITE_MULTI_COIL::func_code )
-    {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (WRITE_MULTI_COIL::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
-    }
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_write_coils_request(&request[0], transaction_id_, unit_id_, start_address, values);
 
-    return error_code_t::NO_ERROR;
+    return transact(&request[0], size, WRITE_MULTI_COIL::func_code, response);
 }
 
 
 error_code_t::type application::layer::write_registers(uint16_t start_address, std::vector<uint16_t> const& values)
 {
-    // intialize the pdu
-    std::vector<uint8_t> pdu(sizeof(mbap_header_t));
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    size_t size = codec::encode_write_registers_request(&request[0], transaction_id_, unit_id_, start_address, values.data(), values.size());
 
-    // create the pdu body
-    pdu.push_back(WRITE_MULTI_REG::func_code);
-    pdu.push_back(static_cast<uint8_t>(start_address >> 8)); // start addr HI
-    pdu.push_back(static_cast<uint8_t>(start_address)); // start addr LO
-
-    uint16_t quantity = static_cast<uint16_t>(values.size());
-    pdu.push_back(static_cast<uint8_t>(quantity >> 8)); // quantity HI
-    pdu.push_back(static_cast<uint8_t>(quantity)); // quantity LO
-
-    std::vector<uint8_t> serialized_values;
-    detail::serialize<WRITE_MULTI_REG::register_type>(values, serialized_values);
-
-    uint8_t byte_count = static_cast<uint8_t>(serialized_values.size());
-    pdu.push_back(byte_count);
-
-    for ( uint8_t byte : serialized_values )
-    {
-        pdu.push_back(byte);
-    }
-
-    // add in the pdu header
-    mbap_header_t hdr =
-            mbap_header::build(unit_id_, transaction_id_, static_cast<uint16_t>(pdu.size() - sizeof(mbap_header_t)));
-    transaction_id_++;
-
-    std::vector<uint8_t> serialized_hdr(sizeof(mbap_header_t));
-    mbap_header::serialize(hdr, serialized_hdr);
-
-    std::copy(&serialized_hdr[0],
-            &serialized_hdr[0] + sizeof(mbap_header_t), &pdu[0]);
-
-    // send the request
-    data_send_signal(&pdu[0], pdu.size());
-
-    // await the response
-    uint8_t response[100];
-    awaiting_data_signal(response, 100);
-
-    /** verify the response **/
-    mbap_header_t response_hdr = mbap_header::parse(response);
-
-    // ensure the received message meets the ModbusADU length constraints.
-    if ( response_hdr.length > MB_MAX_ADU_LENGTH )
-    {
-        return error_code_t::LENGTH_CONSTRAINT_FAILURE;
-    }
-
-    // check the function code
-    if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] != WRITE_MULTI_REG::func_code )
-    {
-        const uint8_t ERROR_OFFSET = 1;
-
-        if ( response[MB_FUNC_CODE_OFFSET+sizeof(mbap_header_t)] == (WRITE_MULTI_REG::func_code + 0x80) )
-        {
-            // retrieve the error code
-            return (static_cast<error_code_t::type>(response[ERROR_OFFSET+sizeof(mbap_header_t)]));
-        }
-        else
-        {
-            return error_code_t::ERROR;
-        }
-    }
-
-    return error_code_t::NO_ERROR;
+    return transact(&request[0], size, WRITE_MULTI_REG::func_code, response);
 }
 
 void application::layer::handle_data_receive(uint8_t* rx_data, size_t size)
 {
     std::vector<uint8_t> response;
+    response.reserve(MB_MAX_ADU_LENGTH);
     response.assign(sizeof(mbap_header_t), 0x00);
     mbap_header_t response_hdr = mbap_header::parse(rx_data);
 
@@ -816,7 +340,7 @@ void application::Request_Handler<Function_Code>::operator()(
     std::vector<uint8_t> const& request, std::vector<uint8_t>& response, callback_map_t const& cm)
 {
     //Is the request for a legal quantity of registers?
-    uint16_t quantity = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_QTY_PDU_OFFSET] ));
+    uint16_t quantity = codec::get_u16(&request[MB_QTY_PDU_OFFSET]);
     if (quantity < Function_Code::register_type::min_read_quantity ||
             quantity > Function_Code::register_type::max_read_quantity)
     {
@@ -830,7 +354,7 @@ void application::Request_Handler<Function_Code>::operator()(
     }
 
     //Does the request overflow the address space?
-    uint16_t start_address = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_START_ADDR_PDU_OFFSET] ));
+    uint16_t start_address = codec::get_u16(&request[MB_START_ADDR_PDU_OFFSET]);
     if ( static_cast<uint32_t>(start_address + quantity) > MB_MAX_ADDRESS )
     {
         //First byte of an error response is the request function code plus 0x80.
@@ -903,7 +427,7 @@ void application::Request_Handler<WRITE_SINGLE_COIL>::operator()(
     std::vector<uint8_t> const& request, std::vector<uint8_t>& response, callback_map_t const& cm)
 {
     // Does the request overflow the address space
-    uint16_t start_address = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_START_ADDR_PDU_OFFSET] ));
+    uint16_t start_address = codec::get_u16(&request[MB_START_ADDR_PDU_OFFSET]);
 
     //Deserialize the write values
     uint16_t quantity = 1;
@@ -964,7 +488,7 @@ void application::Request_Handler<WRITE_SINGLE_REG>::operator()(
     std::vector<uint8_t> const& request, std::vector<uint8_t>& response, callback_map_t const& cm)
 {
     // Does the request overflow the address space
-    uint16_t start_address = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_START_ADDR_PDU_OFFSET] ));
+    uint16_t start_address = codec::get_u16(&request[MB_START_ADDR_PDU_OFFSET]);
 
     //Deserialize the write values
     uint16_t quantity = 1;
@@ -1017,9 +541,9 @@ template<>
 void application::Request_Handler<WRITE_MULTI_COIL>::operator()(
     std::vector<uint8_t> const& request, std::vector<uint8_t>& response, callback_map_t const& cm)
 {
-    //Is the request for a legal quantity of registers?
-    uint16_t quantity = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_QTY_PDU_OFFSET] ));
-    if (quantity < MB_MIN_READ_QTY_COILS || quantity > MB_MAX_READ_QTY_COILS)
+    //Is the request for a legal quantity of coils?
+    uint16_t quantity = codec::get_u16(&request[MB_QTY_PDU_OFFSET]);
+    if (quantity < MB_MIN_MULT_WRITE_QTY_COILS || quantity > MB_MAX_MULT_WRITE_QTY_COILS)
     {
         //First byte of an error response is the request function code plus 0x80.
         response.push_back(static_cast<uint8_t>(request[MB_FUNC_CODE_OFFSET] + 0x80));
@@ -1031,7 +555,7 @@ void application::Request_Handler<WRITE_MULTI_COIL>::operator()(
     }
 
     //Does the request overflow the address space?
-    uint16_t start_address = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_START_ADDR_PDU_OFFSET] ));
+    uint16_t start_address = codec::get_u16(&request[MB_START_ADDR_PDU_OFFSET]);
     if ( static_cast<uint32_t>(start_address + quantity) > MB_MAX_ADDRESS )
     {
         // First byte of an error response is the request function code plus 0x80.
@@ -1053,8 +577,8 @@ void application::Request_Handler<WRITE_MULTI_COIL>::operator()(
         number_bytes_calculated++;
     }
 
-    // Does the claimed and calculated number of coil data bytes align
-    if (number_bytes_request != number_bytes_calculated)
+    // Does the claimed and calculated number of coil data bytes align, and did they all arrive
+    if (number_bytes_request != number_bytes_calculated || request.size() < 6u + number_bytes_calculated)
     {
         //First byte of an error response is the request function code plus 0x80.
         response.push_back(static_cast<uint8_t>(request[MB_FUNC_CODE_OFFSET] + 0x80));
@@ -1117,8 +641,8 @@ void application::Request_Handler<WRITE_MULTI_REG>::operator()(
     std::vector<uint8_t> const& request, std::vector<uint8_t>& response, callback_map_t const& cm)
 {
     //Is the request for a legal quantity of registers?
-    uint16_t quantity = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_QTY_PDU_OFFSET] ));
-    if (quantity < MB_MIN_READ_QTY_COILS || quantity > MB_MAX_READ_QTY_COILS)
+    uint16_t quantity = codec::get_u16(&request[MB_QTY_PDU_OFFSET]);
+    if (quantity < MB_MIN_MULT_WRITE_QTY_HOLDING_REGS || quantity > MB_MAX_MULT_WRITE_QTY_HOLDING_REGS)
     {
         //First byte of an error response is the request function code plus 0x80.
         response.push_back(static_cast<uint8_t>(request[MB_FUNC_CODE_OFFSET] + 0x80));
@@ -1130,7 +654,7 @@ void application::Request_Handler<WRITE_MULTI_REG>::operator()(
     }
 
     //Does the request overflow the address space?
-    uint16_t start_address = ntohs(*reinterpret_cast<uint16_t const*>( &request[MB_START_ADDR_PDU_OFFSET] ));
+    uint16_t start_address = codec::get_u16(&request[MB_START_ADDR_PDU_OFFSET]);
     if ( static_cast<uint32_t>(start_address + quantity) > MB_MAX_ADDRESS )
     {
         // First byte of an error response is the request function code plus 0x80.
@@ -1148,8 +672,8 @@ void application::Request_Handler<WRITE_MULTI_REG>::operator()(
     //Calculate how many bytes of holding register data should be in the request.
     uint8_t number_bytes_calculated = static_cast<uint8_t>(quantity * sizeof(uint16_t));
 
-    //Does claimed and calculated number of holding register data bytes align
-    if (number_bytes_request != number_bytes_calculated)
+    //Does claimed and calculated number of holding register data bytes align, and did they all arrive
+    if (number_bytes_request != number_bytes_calculated || request.size() < 6u + number_bytes_calculated)
     {
         // First byte of an error response is the request function code plus 0x80.
         response.push_back(static_cast<uint8_t>(request[MB_FUNC_CODE_OFFSET] + 0x80));
@@ -17,6 +17,7 @@
 #include <boost/signals2.hpp>
 
 #include "bennu/devices/modules/comms/modbus/protocol/application-callbacks.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/codec.hpp"
 #include "bennu/devices/modules/comms/modbus/protocol/constants.hpp"
 #include "bennu/devices/modules/comms/modbus/protocol/function-codes.hpp"
 #include "bennu/devices/modules/comms/modbus/protocol/mbap-header.hpp"
@@ -64,6 +65,9 @@ namespace application {
         }
 
     private:
+        // send a request ADU of 'size' bytes (0 if it could not be encoded) and check the response
+        error_code_t::type transact(uint8_t* request, size_t size, uint8_t func_code, codec::adu_buffer_t& response);
+
         // request handler map
         typedef std::function<void (std::vector<uint8_t> const& request, std::vector<uint8_t>& response)> request_handler_fn_t;
         std::map<function_code_t::type, request_handler_fn_t> request_handler_map_;
@@ -119,11 +123,9 @@ namespace detail
     template <typename REGISTER_T>
     void serialize(std::vector<typename REGISTER_T::value_type> const& values, std::vector<uint8_t>& loc)
     {
-        for ( auto value : values )
-        {
-            loc.push_back(static_cast<uint8_t>(value >> 8));
-            loc.push_back(static_cast<uint8_t>(value));
-        }
+        size_t size = loc.size();
+        loc.resize(size + values.size() * 2);
+        codec::encode_registers(values.data(), values.size(), &loc[size]);
     }
 
     template <typename REGISTER_T>
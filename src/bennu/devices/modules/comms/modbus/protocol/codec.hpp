@@ -0,0 +1,384 @@
+/**
+   @brief In-place encoding and decoding of Modbus TCP requests and responses
+
+   Everything here reads from and writes to caller-provided buffers (a whole
+   ADU, MBAP header included) and never allocates. Coils and discrete inputs
+   are packed and unpacked eight at a time and registers are byte-swapped in
+   bulk, so the application layer, the scanner and the benchmark share one
+   implementation of the wire format.
+*/
+#ifndef __MODBUS_CODEC_HPP__
+#define __MODBUS_CODEC_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "bennu/devices/modules/comms/modbus/protocol/constants.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/error-codes.hpp"
+#include "bennu/devices/modules/comms/modbus/protocol/mbap-header.hpp"
+
+namespace bennu {
+namespace comms {
+namespace modbus {
+namespace codec {
+
+    // Large enough for any request or response
+    typedef std::array<uint8_t, MB_MAX_ADU_LENGTH> adu_buffer_t;
+
+    const size_t HEADER_SIZE        = sizeof(mbap_header_t);
+    const size_t READ_REQUEST_SIZE  = HEADER_SIZE + 5;      // also the size of write single and write multiple responses
+
+    // --------------------------------
+    // Field helpers
+    // --------------------------------
+
+    inline uint16_t get_u16(uint8_t const* p)
+    {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    inline void put_u16(uint8_t* p, uint16_t value)
+    {
+        p[0] = static_cast<uint8_t>(value >> 8);
+        p[1] = static_cast<uint8_t>(value);
+    }
+
+    // Bytes holding 'quantity' packed coils or discrete inputs
+    inline size_t packed_size(size_t quantity)
+    {
+        return (quantity + 7) / 8;
+    }
+
+    namespace detail
+    {
+        // 64-bit words with the first byte in memory as the least significant
+        inline uint64_t load_le64(void const* p)
+        {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            word = __builtin_bswap64(word);
+#endif
+            return word;
+        }
+
+        inline void store_le64(void* p, uint64_t word)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            word = __builtin_bswap64(word);
+#endif
+            std::memcpy(p, &word, sizeof(word));
+        }
+
+        // Eight bools (0 or 1 bytes) to one byte, the first in bit 0
+        inline uint8_t pack8(bool const* values)
+        {
+            return static_cast<uint8_t>((load_le64(values) * 0x0102040810204080ULL) >> 56);
+        }
+
+        // One byte to eight bools, bit 0 first
+        inline void unpack8(uint8_t byte, bool* values)
+        {
+            uint64_t word = (byte * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+            store_le64(values, ((word + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL);
+        }
+    } // namespace detail
+
+    // --------------------------------
+    // Bits and registers
+    // --------------------------------
+
+    // Pack 'quantity' values into packed_size(quantity) bytes, the first value in bit 0
+    inline void pack_bits(bool const* values, size_t quantity, uint8_t* packed)
+    {
+        size_t whole = quantity / 8;
+        for (size_t i = 0; i < whole; ++i)
+        {
+            packed[i] = detail::pack8(&values[i * 8]);
+        }
+        if (quantity % 8)
+        {
+            bool tail[8] = {};
+            std::memcpy(tail, &values[whole * 8], quantity % 8);
+            packed[whole] = detail::pack8(tail);
+        }
+    }
+
+    // std::vector<bool> keeps no bool array to load from; pack it through a small one
+    inline void pack_bits(std::vector<bool> const& values, uint8_t* packed)
+    {
+        bool chunk[64];
+        for (size_t done = 0; done < values.size(); done += 64)
+        {
+            size_t count = std::min<size_t>(64, values.size() - done);
+            std::copy(values.begin() + done, values.begin() + done + count, chunk);
+            pack_bits(chunk, count, &packed[done / 8]);
+        }
+    }
+
+    inline void unpack_bits(uint8_t const* packed, size_t quantity, bool* values)
+    {
+        size_t whole = quantity / 8;
+        for (size_t i = 0; i < whole; ++i)
+        {
+            detail::unpack8(packed[i], &values[i * 8]);
+        }
+        if (quantity % 8)
+        {
+            bool tail[8];
+            detail::unpack8(packed[whole], tail);
+            std::memcpy(&values[whole * 8], tail, quantity % 8);
+        }
+    }
+
+    // Appends to 'values'. Bits are written one at a time in a std::vector<bool>, so only set the ones that are on.
+    inline void unpack_bits(uint8_t const* packed, size_t quantity, std::vector<bool>& values)
+    {
+        size_t size = values.size();
+        values.resize(size + quantity, false);
+        for (size_t i = 0; i < packed_size(quantity); ++i)
+        {
+            unsigned byte = packed[i];
+            if (i == quantity / 8)
+            {
+                byte &= (1u << (quantity % 8)) - 1;
+            }
+            while (byte)
+            {
+                values[size + i * 8 + __builtin_ctz(byte)] = true;
+                byte &= byte - 1;
+            }
+        }
+    }
+
+    // Host order registers to big-endian bytes; a plain loop the compiler vectorizes
+    inline void encode_registers(uint16_t const* values, size_t quantity, uint8_t* data)
+    {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        std::memcpy(data, values, quantity * 2);
+#else
+        for (size_t i = 0; i < quantity; ++i)
+        {
+            uint16_t swapped = __builtin_bswap16(values[i]);
+            std::memcpy(&data[i * 2], &swapped, 2);
+        }
+#endif
+    }
+
+    inline void decode_registers(uint8_t const* data, size_t quantity, uint16_t* values)
+    {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        std::memcpy(values, data, quantity * 2);
+#else
+        for (size_t i = 0; i < quantity; ++i)
+        {
+            uint16_t raw;
+            std::memcpy(&raw, &data[i * 2], 2);
+            values[i] = __builtin_bswap16(raw);
+        }
+#endif
+    }
+
+    // Appends to 'values'
+    inline void decode_registers(uint8_t const* data, size_t quantity, std::vector<uint16_t>& values)
+    {
+        size_t size = values.size();
+        values.resize(size + quantity);
+        decode_registers(data, quantity, &values[size]);
+    }
+
+    // --------------------------------
+    // ADUs
+    // --------------------------------
+
+    // MBAP header for a 'pdu_size' byte PDU
+    inline void put_header(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id, size_t pdu_size)
+    {
+        put_u16(&adu[MBAP_HDR_TRANSACTION_ID], transaction_id);
+        put_u16(&adu[MBAP_HDR_PROTOCOL_ID], 0x0000);
+        put_u16(&adu[MBAP_HDR_LENGTH], static_cast<uint16_t>(pdu_size + 1));
+        adu[MABAP_HDR_UNIT_ID] = unit_id;
+    }
+
+    /*
+     * Request encoders write a whole ADU to 'adu' and return its size, or 0
+     * if the quantity is outside what the function code allows. 'adu' must
+     * hold READ_REQUEST_SIZE bytes for reads and single writes, and
+     * MB_MAX_ADU_LENGTH for multiple writes.
+     */
+
+    // FC 1-4
+    inline size_t encode_read_request(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id,
+        uint8_t func_code, uint16_t start_address, uint16_t quantity)
+    {
+        uint16_t max = func_code <= 0x02 ? MB_MAX_READ_QTY_COILS : MB_MAX_READ_QTY_HOLDING_REGS;
+        if (quantity == 0 || quantity > max)
+        {
+            return 0;
+        }
+        put_header(adu, transaction_id, unit_id, 5);
+        uint8_t* pdu = &adu[HEADER_SIZE];
+        pdu[MB_FUNC_CODE_OFFSET] = func_code;
+        put_u16(&pdu[MB_START_ADDR_PDU_OFFSET], start_address);
+        put_u16(&pdu[MB_QTY_PDU_OFFSET], quantity);
+        return READ_REQUEST_SIZE;
+    }
+
+    // FC 5 and 6; 'value' is the raw field (MB_MAX_COIL_VALUE turns a coil on)
+    inline size_t encode_write_single_request(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id,
+        uint8_t func_code, uint16_t address, uint16_t value)
+    {
+        put_header(adu, transaction_id, unit_id, 5);
+        uint8_t* pdu = &adu[HEADER_SIZE];
+        pdu[MB_FUNC_CODE_OFFSET] = func_code;
+        put_u16(&pdu[MB_START_ADDR_PDU_OFFSET], address);
+        put_u16(&pdu[MB_QTY_PDU_OFFSET], value);
+        return READ_REQUEST_SIZE;
+    }
+
+    namespace detail
+    {
+        // Header and fixed fields of FC 15 and 16; returns where the values go
+        inline uint8_t* put_write_multiple(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id,
+            uint8_t func_code, uint16_t start_address, uint16_t quantity, size_t bytes)
+        {
+            put_header(adu, transaction_id, unit_id, 6 + bytes);
+            uint8_t* pdu = &adu[HEADER_SIZE];
+            pdu[MB_FUNC_CODE_OFFSET] = func_code;
+            put_u16(&pdu[MB_START_ADDR_PDU_OFFSET], start_address);
+            put_u16(&pdu[MB_QTY_PDU_OFFSET], quantity);
+            pdu[5] = static_cast<uint8_t>(bytes);
+            return &pdu[6];
+        }
+    } // namespace detail
+
+    // FC 15 (write multiple coils)
+    inline size_t encode_write_coils_request(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id,
+        uint16_t start_address, bool const* values, size_t quantity)
+    {
+        if (quantity < MB_MIN_MULT_WRITE_QTY_COILS || quantity > MB_MAX_MULT_WRITE_QTY_COILS)
+        {
+            return 0;
+        }
+        size_t bytes = packed_size(quantity);
+        pack_bits(values, quantity, detail::put_write_multiple(adu, transaction_id, unit_id, 0x0F, start_address,
+            static_cast<uint16_t>(quantity), bytes));
+        return HEADER_SIZE + 6 + bytes;
+    }
+
+    inline size_t encode_write_coils_request(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id,
+        uint16_t start_address, std::vector<bool> const& values)
+    {
+        if (values.size() < MB_MIN_MULT_WRITE_QTY_COILS || values.size() > MB_MAX_MULT_WRITE_QTY_COILS)
+        {
+            return 0;
+        }
+        uint16_t quantity = static_cast<uint16_t>(values.size());
+        size_t bytes = packed_size(quantity);
+        pack_bits(values, detail::put_write_multiple(adu, transaction_id, unit_id, 0x0F, start_address, quantity, bytes));
+        return HEADER_SIZE + 6 + bytes;
+    }
+
+    // FC 16 (write multiple registers)
+    inline size_t encode_write_registers_request(uint8_t* adu, uint16_t transaction_id, uint8_t unit_id,
+        uint16_t start_address, uint16_t const* values, size_t quantity)
+    {
+        if (quantity < MB_MIN_MULT_WRITE_QTY_HOLDING_REGS || quantity > MB_MAX_MULT_WRITE_QTY_HOLDING_REGS)
+        {
+            return 0;
+        }
+        size_t bytes = quantity * 2u;
+        encode_registers(values, quantity, detail::put_write_multiple(adu, transaction_id, unit_id, 0x10, start_address,
+            static_cast<uint16_t>(quantity), bytes));
+        return HEADER_SIZE + 6 + bytes;
+    }
+
+    /*
+     * Check a response ADU of 'size' bytes to a 'func_code' request: the
+     * exception code if the server sent one, LENGTH_CONSTRAINT_FAILURE if the
+     * header's length does not fit the ADU, ERROR for another function code.
+     */
+    inline error_code_t::type check_response(uint8_t const* adu, size_t size, uint8_t func_code)
+    {
+        if (size < HEADER_SIZE + 2)
+        {
+            return error_code_t::LENGTH_CONSTRAINT_FAILURE;
+        }
+        size_t length = get_u16(&adu[MBAP_HDR_LENGTH]);
+        if (length < 3 || HEADER_SIZE - 1 + length > size || HEADER_SIZE - 1 + length > MB_MAX_ADU_LENGTH)
+        {
+            return error_code_t::LENGTH_CONSTRAINT_FAILURE;
+        }
+
+        uint8_t const* pdu = &adu[HEADER_SIZE];
+        if (pdu[MB_FUNC_CODE_OFFSET] == func_code)
+        {
+            return error_code_t::NO_ERROR;
+        }
+        if (pdu[MB_FUNC_CODE_OFFSET] == (func_code | 0x80))
+        {
+            return static_cast<error_code_t::type>(pdu[1]);
+        }
+        return error_code_t::ERROR;
+    }
+
+    /*
+     * Checked access to the data of a read response (FC 1-4) carrying
+     * 'data_size' bytes. Null, and the reason in 'error', if the response is
+     * an exception or does not hold that much.
+     */
+    inline uint8_t const* read_response_data(uint8_t const* adu, size_t size, uint8_t func_code, size_t data_size,
+        error_code_t::type& error)
+    {
+        error = check_response(adu, size, func_code);
+        if (error != error_code_t::NO_ERROR)
+        {
+            return nullptr;
+        }
+        uint8_t const* pdu = &adu[HEADER_SIZE];
+        if (pdu[1] != data_size || get_u16(&adu[MBAP_HDR_LENGTH]) < 3 + data_size)
+        {
+            error = error_code_t::LENGTH_CONSTRAINT_FAILURE;
+            return nullptr;
+        }
+        return &pdu[2];
+    }
+
+    // FC 1 and 2; 'values' is a bool array or std::vector<bool> (appended to)
+    template <typename VALUES_T>
+    inline error_code_t::type decode_read_bits_response(uint8_t const* adu, size_t size, uint8_t func_code,
+        uint16_t quantity, VALUES_T&& values)
+    {
+        error_code_t::type error;
+        uint8_t const* data = read_response_data(adu, size, func_code, packed_size(quantity), error);
+        if (data)
+        {
+            unpack_bits(data, quantity, values);
+        }
+        return error;
+    }
+
+    // FC 3 and 4; 'values' is a uint16_t array or std::vector<uint16_t> (appended to)
+    template <typename VALUES_T>
+    inline error_code_t::type decode_read_registers_response(uint8_t const* adu, size_t size, uint8_t func_code,
+        uint16_t quantity, VALUES_T&& values)
+    {
+        error_code_t::type error;
+        uint8_t const* data = read_response_data(adu, size, func_code, quantity * 2u, error);
+        if (data)
+        {
+            decode_registers(data, quantity, values);
+        }
+        return error;
+    }
+
+} // namespace codec
+} // namespace modbus
+} // namespace comms
+} // namespace bennu
+
+#endif /* __MODBUS_CODEC_HPP__ */
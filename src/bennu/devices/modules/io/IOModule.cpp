@@ -15,6 +15,8 @@ bool IOModule::handleTreeData(const ptree& tree)
     {
         bool success = true;
         distributed::Endpoint ep{tree.get<std::string>("endpoint")};
+        // the provider's server endpoint, for its point dictionary and (should it keep a repair history) lost fragments
+        mServerEndpoint.str = tree.get<std::string>("server-endpoint", "");
 
         auto binaryAddresses = tree.equal_range("binary");
         for (auto binIter = binaryAddresses.first; binIter != binaryAddresses.second; ++binIter)
@@ -22,6 +24,7 @@ bool IOModule::handleTreeData(const ptree& tree)
             std::string id = binIter->second.get<std::string>("id");
             std::string point = binIter->second.get<std::string>("name");
             mDataManager->addExternalData<bool>(id, point);
+            mPoints.push_back(point);
             std::cout << "add binary " << id << std::endl;
             continue;
         }
@@ -32,6 +35,7 @@ bool IOModule::handleTreeData(const ptree& tree)
             std::string id = analIter->second.get<std::string>("id");
             std::string point = analIter->second.get<std::string>("name");
             mDataManager->addExternalData<double>(id, point);
+            mPoints.push_back(point);
             std::cout << "add analog " << id << std::endl;
             continue;
         }
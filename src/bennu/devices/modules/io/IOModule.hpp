@@ -2,6 +2,7 @@
 #define BENNU_FIELDDEVICE_IO_IOMODULE_HPP
 
 #include <string>
+#include <vector>
 
 #include <boost/property_tree/ptree.hpp>
 
@@ -29,6 +30,8 @@ public:
 
 protected:
     std::shared_ptr<field_device::DataManager> mDataManager;
+    std::vector<std::string> mPoints;   // i/o points configured for this module
+    distributed::Endpoint mServerEndpoint; // provider's server: dictionary queries and fragment NACKs ("" = none)
 
 };
 
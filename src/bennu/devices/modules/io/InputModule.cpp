@@ -1,83 +1,237 @@
 #include "InputModule.hpp"
 
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 
+#include "bennu/distributed/PublishFrame.hpp"
+
 namespace bennu {
 namespace io {
 
 InputModule::InputModule() :
-    IOModule()
+    IOModule(),
+    mDictionaryVersion(0),
+    mQuerying(false),
+    mTable(nullptr),
+    mTableResolved(0)
 {
 }
 
 void InputModule::start(const distributed::Endpoint &endpoint)
 {
-    mSubscriber.reset(new distributed::Subscriber(endpoint));
-    mSubscriber->setHandler(std::bind(&InputModule::subscriptionHandler, this, std::placeholders::_1));
+    // Index only our own points so frames are matched without touching the data store's name index
+    for (auto& point : mPoints)
+    {
+        mParser.addPoint(point, mDataManager->getPointHandle(point));
+    }
+    mParser.build();
+
+    if (distributed::SharedMemoryTable::isSharedMemory(endpoint))
+    {
+        mTableSubscriber.reset(new distributed::SharedMemorySubscriber(endpoint,
+            std::bind(&InputModule::tableHandler, this, std::placeholders::_1)));
+        return;
+    }
+
+    if (!mServerEndpoint.str.empty())
+    {
+        distributed::Subscriber::setRepairEndpoint(endpoint, mServerEndpoint);
+        // binary frames are useless until we know the provider's point IDs, so
+        // ask for them now rather than wait for its next dictionary frames
+        mClient.reset(new distributed::AsyncClient(mServerEndpoint));
+        queryDictionary();
+    }
+    // only the partitions holding our points, should the provider partition its publishes
+    mSubscriber.reset(new distributed::Subscriber(endpoint, mPoints));
+    mSubscriber->setFrameHandler(std::bind(&InputModule::frameHandler, this, std::placeholders::_1));
+}
+
+void InputModule::queryDictionary()
+{
+    if (!mClient || mQuerying)
+    {
+        return;
+    }
+    mQuerying = true;
+    mClient->send("QUERY=dictionary", std::bind(&InputModule::dictionaryHandler, this, std::placeholders::_1, std::placeholders::_2));
 }
 
-void InputModule::subscriptionHandler(std::string& data)
+void InputModule::dictionaryHandler(const bool ok, const std::string& reply)
 {
-    try {
-        // Ex: "load-1_bus-101.mw:999.000,load-1_bus-101.active:true,"
-        std::string pointDelimiter{","};
-        std::string valueDelimiter{":"};
-        std::vector<std::string> points;
-        try {
-            points = distributed::split(data, pointDelimiter);
-        } catch (std::exception& e) {
-            return;
+    std::scoped_lock<std::mutex> lock(mDictionaryMutex);
+    mQuerying = false;
+    if (!ok)
+    {
+        printf("E: InputModule dictionary query failed -- %s\n", reply.data());
+        return;
+    }
+
+    std::string_view entries(reply);
+    auto pos = entries.find(';');
+    if (pos == std::string_view::npos)
+    {
+        printf("E: InputModule dictionary query: malformed reply -- %s\n", reply.data());
+        return;
+    }
+    std::uint32_t version = static_cast<std::uint32_t>(std::strtoul(reply.data(), nullptr, 10));
+    if (version == mDictionaryVersion)
+    {
+        return; // the dictionary frames got here first
+    }
+    entries.remove_prefix(pos + 1);
+
+    mDictionaryVersion = version;
+    mPointHandles.clear();
+    while (!entries.empty())
+    {
+        // "<id>:<name>,"
+        auto end = entries.find(',');
+        std::string_view entry = entries.substr(0, end);
+        entries.remove_prefix(end == std::string_view::npos ? entries.size() : end + 1);
+        auto colon = entry.find(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
         }
-        
-        for (auto& t : points)
+        std::uint32_t id = static_cast<std::uint32_t>(std::strtoul(std::string(entry.substr(0, colon)).data(), nullptr, 10));
+        if (id >= mPointHandles.size())
         {
-            if (t.length() == 0) { continue; } //Checks if point is empty
-
-            if (t.find(":")==std::string::npos && (
-                t.find("bus")==std::string::npos ||
-                t.find("branch")==std::string::npos ||
-                t.find("load")==std::string::npos ||
-                t.find("shunt")==std::string::npos ||
-                t.find("gen")==std::string::npos))
-            {
-                continue;
-            }
-            std::vector<std::string> parts;
-            try {
-                parts = distributed::split(t, valueDelimiter);
-            } catch (std::exception& e) {
-                continue;
-            }
+            mPointHandles.resize(id + 1, field_device::INVALID_HANDLE);
+        }
+        mPointHandles[id] = mParser.find(entry.substr(colon + 1));
+    }
+}
 
-	    //Checks if point was cutoff/malformed
-	    if (parts.size() < 2) { continue; }
+void InputModule::frameHandler(const std::string& frame)
+{
+    if (distributed::frame::isBinary(frame.data(), frame.size()))
+    {
+        binaryHandler(frame);
+    }
+    else
+    {
+        subscriptionHandler(frame);
+    }
+}
 
-            std::string name, value;
-            name = parts[0];
-            value = parts[1];
+void InputModule::binaryHandler(const std::string& frame)
+{
+    distributed::FrameReader reader(frame.data(), frame.size());
+    if (!reader.valid())
+    {
+        return;
+    }
+    const auto& header = reader.getHeader();
 
-            if (mDataManager->hasPoint(name))
+    std::scoped_lock<std::mutex> lock(mDictionaryMutex);
+    if (header.type == distributed::frame::eDictionary)
+    {
+        // a new dictionary replaces the old one; its entries may span several frames
+        if (header.dictionary != mDictionaryVersion)
+        {
+            mDictionaryVersion = header.dictionary;
+            mPointHandles.clear();
+        }
+        std::uint32_t id;
+        std::string_view name;
+        while (reader.next(id, name))
+        {
+            if (id >= mPointHandles.size())
             {
-                if (value == "true" || value == "false")
-                {
-                    bool val = value == "true" ? true : false;
-                    mDataManager->setDataByPoint<bool>(name, val);
-                }
-                else
-                {
-                    try {
-                        double val = std::stod(value);
-                        mDataManager->setDataByPoint<double>(name, val);
-                    } catch (std::exception& e) {
-                        std::cout << "E: InputModule::subscriptionHandler -- value=" << value << " -- " << e.what() << std::endl;
-                    }
-                }
+                mPointHandles.resize(id + 1, field_device::INVALID_HANDLE);
             }
+            mPointHandles[id] = mParser.find(name);
         }
-    } catch (std::exception& e) {
-        std::cout << e.what() << std::endl;
+        return;
     }
+
+    if (header.type != distributed::frame::eData && header.type != distributed::frame::eDelta)
+    {
+        return;
+    }
+    if (header.dictionary != mDictionaryVersion)
+    {
+        // IDs we cannot resolve: joined late, missed the dictionary frames or
+        // the provider's dictionary changed. Fetch it rather than wait for the next.
+        queryDictionary();
+        return;
+    }
+
+    // publish the whole frame as one update so readers never see half of it
+    mBatch.clear();
+    distributed::PointValue point;
+    while (reader.next(point))
+    {
+        if (point.id >= mPointHandles.size() || mPointHandles[point.id] == field_device::INVALID_HANDLE)
+        {
+            continue;
+        }
+        if (point.binary)
+        {
+            mBatch.emplace_back(mPointHandles[point.id], point.value != 0.0);
+        }
+        else
+        {
+            mBatch.emplace_back(mPointHandles[point.id], point.value);
+        }
+    }
+    // points keep the provider's publish time
+    mDataManager->setDataByPoints(mBatch, header.timestamp / 1e9);
+}
+
+void InputModule::tableHandler(const distributed::SharedMemoryTable& table)
+{
+    if (&table != mTable)
+    {
+        // the provider restarted with a new table
+        mTable = &table;
+        mTableResolved = 0;
+        mTablePoints.clear();
+    }
+    // look up only the slots added since last time
+    std::uint32_t size = table.size();
+    for (; mTableResolved < size; ++mTableResolved)
+    {
+        auto handle = mParser.find(table.name(mTableResolved));
+        if (handle != field_device::INVALID_HANDLE)
+        {
+            mTablePoints.push_back({mTableResolved, handle, 0});
+        }
+    }
+
+    // publish the changes as one update so readers never see half of them
+    mBatch.clear();
+    distributed::PointValue point;
+    std::uint32_t sequence;
+    for (auto& p : mTablePoints)
+    {
+        if (!table.read(p.slot, point, sequence) || sequence == p.sequence)
+        {
+            continue;
+        }
+        p.sequence = sequence;
+        if (point.binary)
+        {
+            mBatch.emplace_back(p.handle, point.value != 0.0);
+        }
+        else
+        {
+            mBatch.emplace_back(p.handle, point.value);
+        }
+    }
+    if (!mBatch.empty())
+    {
+        mDataManager->setDataByPoints(mBatch, table.getPublished() / 1e9);
+    }
+}
+
+void InputModule::subscriptionHandler(const std::string_view& data)
+{
+    // publish the whole frame as one update so readers never see half of it
+    mBatch.clear();
+    mParser.parse(data, mBatch);
+    mDataManager->setDataByPoints(mBatch);
 }
 
 } // namespace io
@@ -1,7 +1,15 @@
 #ifndef BENNU_FIELDDEVICE_IO_INPUTMODULE_HPP
 #define BENNU_FIELDDEVICE_IO_INPUTMODULE_HPP
 
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
 #include "bennu/devices/modules/io/IOModule.hpp"
+#include "bennu/devices/modules/io/TextFrameParser.hpp"
+#include "bennu/distributed/AsyncClient.hpp"
+#include "bennu/distributed/SharedMemoryTable.hpp"
 #include "bennu/distributed/Utils.hpp"
 #include "bennu/distributed/Subscriber.hpp"
 
@@ -18,9 +26,39 @@ public:
     virtual void start(const distributed::Endpoint& endpoint);
 
 private:
-    void subscriptionHandler(std::string& data);
+    // Frames are either "name:value,..." text or binary (see distributed/PublishFrame.hpp)
+    void frameHandler(const std::string& frame);
+    void subscriptionHandler(const std::string_view& data);
+    void binaryHandler(const std::string& frame);
+    // Ask the provider's server for its dictionary, unless already asking
+    void queryDictionary();
+    // "<version>;<id>:<name>,..." reply to QUERY=dictionary
+    void dictionaryHandler(const bool ok, const std::string& reply);
+    // "shm://" endpoints: read our points straight out of the provider's table
+    void tableHandler(const distributed::SharedMemoryTable& table);
+
+    struct TablePoint
+    {
+        std::uint32_t slot;
+        field_device::PointHandle handle;
+        std::uint32_t sequence;                         // slot sequence last applied
+    };
+
+    TextFrameParser mParser;                            // this module's points
+    field_device::DataManager::PointBatch mBatch;       // reused for every frame
+    std::mutex mDictionaryMutex;                        // guards the dictionary state below (replies come on mClient's thread)
+    std::uint32_t mDictionaryVersion;                   // provider dictionary mPointHandles is built from
+    std::vector<field_device::PointHandle> mPointHandles; // provider point ID ==> our handle
+    bool mQuerying;                                     // a QUERY=dictionary is waiting for its reply
+    // after the state their handlers use, so they go away first
+    std::shared_ptr<distributed::AsyncClient> mClient;  // to mServerEndpoint, if set
     std::shared_ptr<distributed::Subscriber> mSubscriber;
 
+    std::shared_ptr<distributed::SharedMemorySubscriber> mTableSubscriber;
+    const distributed::SharedMemoryTable* mTable;       // table mTablePoints refers to
+    std::uint32_t mTableResolved;                       // table slots looked up so far
+    std::vector<TablePoint> mTablePoints;
+
 };
 
 } // namespace io
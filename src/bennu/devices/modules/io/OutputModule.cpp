@@ -1,43 +1,101 @@
 #include "OutputModule.hpp"
 
+#include <functional>
+#include <utility>
+#include <vector>
+
 namespace bennu {
 namespace io {
 
 OutputModule::OutputModule() :
-    IOModule()
+    IOModule(),
+    mWriting(false)
 {
 }
 
 void OutputModule::start(const distributed::Endpoint& endpoint)
 {
-    mClient.reset(new distributed::Client(endpoint));
+    mClient.reset(new distributed::AsyncClient(endpoint));
+}
+
+void OutputModule::writeHandler(const bool ok, const std::string& reply)
+{
+    if (!ok)
+    {
+        printf("E: OutputModule write failed -- %s\n", reply.data());
+    }
+    // runs on the client's i/o thread; send whatever was merged while this was in flight
+    std::scoped_lock<std::mutex> lock(mWriteMutex);
+    mWriting = false;
+    flushWrites();
+}
+
+void OutputModule::flushWrites()
+{
+    if (mWriting || mPendingWrites.empty())
+    {
+        return;
+    }
+    // "WRITE=point:value,point:value,..."
+    std::string msg = "WRITE=";
+    for (auto& w : mPendingWrites)
+    {
+        msg += w.first + ":" + w.second + ",";
+    }
+    msg.pop_back(); // trailing ','
+    mPendingWrites.clear();
+    mWriting = true;
+    mClient->send(msg, std::bind(&OutputModule::writeHandler, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 void OutputModule::scanOutputs()
 {
-    auto bTags = mDataManager->getUpdatedBinaryTags();
+    // rtu datastore writes for this scan, published together at the end
+    field_device::DataManager::PointBatch batch;
+    // provider writes for this scan
+    std::vector<std::pair<std::string, std::string>> points;
+    const auto& bTags = mDataManager->getUpdatedBinaryTags();
     for (auto& t : bTags)
     {
         std::string point;
         if (mDataManager->getPointByTag(t.first, point))
         {
             // write to provider
-            mClient->writePoint(point, t.second);
+            points.emplace_back(point, t.second ? "true" : "false");
             // write to rtu datastore
-            mDataManager->setDataByTag<bool>(t.first, t.second);
+            auto handle = mDataManager->getTagHandle(t.first);
+            if (handle.external)
+            {
+                batch.emplace_back(handle.point, t.second);
+            }
         }
     }
-    auto aTags = mDataManager->getUpdatedAnalogTags();
+    const auto& aTags = mDataManager->getUpdatedAnalogTags();
     for (auto& t : aTags)
     {
         std::string point;
         if (mDataManager->getPointByTag(t.first, point))
         {
             // write to provider
-            mClient->writePoint(point, t.second);
+            points.emplace_back(point, std::to_string(t.second));
             // write to rtu datastore
-            mDataManager->setDataByTag<double>(t.first, t.second);
+            auto handle = mDataManager->getTagHandle(t.first);
+            if (handle.external)
+            {
+                batch.emplace_back(handle.point, t.second);
+            }
+        }
+    }
+    mDataManager->setDataByPoints(batch);
+
+    if (!points.empty())
+    {
+        std::scoped_lock<std::mutex> lock(mWriteMutex);
+        for (auto& p : points)
+        {
+            mPendingWrites[p.first] = std::move(p.second);
         }
+        flushWrites();
     }
 }
 
@@ -1,9 +1,13 @@
 #ifndef BENNU_FIELDDEVICE_IO_OUTPUTMODULE_HPP
 #define BENNU_FIELDDEVICE_IO_OUTPUTMODULE_HPP
 
+#include <map>
+#include <mutex>
+#include <string>
+
 #include "bennu/devices/modules/io/IOModule.hpp"
 #include "bennu/distributed/Utils.hpp"
-#include "bennu/distributed/Client.hpp"
+#include "bennu/distributed/AsyncClient.hpp"
 
 namespace bennu {
 namespace io {
@@ -17,10 +21,27 @@ public:
 
     virtual void start(const distributed::Endpoint& endpoint);
 
+    /*
+     * Send this scan's updated tags to the provider as one WRITE (never
+     * blocks on the network). Only one WRITE is in flight at a time: while
+     * one waits for its reply (and any retries of it), later scans' values
+     * are merged behind it, newest per point, and go out as the next WRITE.
+     * A retry of an older WRITE can then never land after a newer one.
+     */
     void scanOutputs();
 
 private:
-    std::shared_ptr<distributed::Client> mClient;
+    void writeHandler(const bool ok, const std::string& reply);
+
+    // Send the merged pending writes, if any; caller holds mWriteMutex
+    void flushWrites();
+
+    std::mutex mWriteMutex;                             // guards mWriting and mPendingWrites
+    bool mWriting;                                      // a WRITE is waiting for its reply
+    std::map<std::string, std::string> mPendingWrites;  // point ==> latest value not yet sent
+
+    // last, so it (and its i/o thread) goes away before the state its callbacks use
+    std::shared_ptr<distributed::AsyncClient> mClient;
 
 };
 
@@ -0,0 +1,91 @@
+#include "TextFrameParser.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <limits>
+
+namespace bennu {
+namespace io {
+
+TextFrameParser::TextFrameParser() :
+    mMinLength(std::numeric_limits<std::size_t>::max()),
+    mMaxLength(0)
+{
+}
+
+void TextFrameParser::addPoint(const std::string& name, const field_device::PointHandle handle)
+{
+    mPoints.emplace_back(name, handle);
+    mMinLength = std::min(mMinLength, name.size());
+    mMaxLength = std::max(mMaxLength, name.size());
+}
+
+void TextFrameParser::build()
+{
+    std::sort(mPoints.begin(), mPoints.end());
+    mPoints.erase(std::unique(mPoints.begin(), mPoints.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), mPoints.end());
+}
+
+field_device::PointHandle TextFrameParser::find(const std::string_view& name) const
+{
+    if (name.size() < mMinLength || name.size() > mMaxLength)
+    {
+        return field_device::INVALID_HANDLE;
+    }
+    auto iter = std::lower_bound(mPoints.begin(), mPoints.end(), name,
+        [](const std::pair<std::string, field_device::PointHandle>& point, const std::string_view& key) { return std::string_view(point.first) < key; });
+    return iter != mPoints.end() && iter->first == name ? iter->second : field_device::INVALID_HANDLE;
+}
+
+std::size_t TextFrameParser::parse(const std::string_view& frame, field_device::DataManager::PointBatch& batch) const
+{
+    // Ex: "load-1_bus-101.mw:999.000,load-1_bus-101.active:true,"
+    std::size_t count = 0;
+    const char* pos = frame.data();
+    const char* end = pos + frame.size();
+    while (pos < end)
+    {
+        const char* next = std::find(pos, end, ',');
+        const char* colon = std::find(pos, next, ':');
+        // points without a value (empty or cut off) are skipped
+        if (colon != next)
+        {
+            auto handle = find(std::string_view(pos, colon - pos));
+            if (handle != field_device::INVALID_HANDLE)
+            {
+                std::string_view value(colon + 1, next - colon - 1);
+                if (value == "true" || value == "false")
+                {
+                    batch.emplace_back(handle, value == "true");
+                    ++count;
+                }
+                else
+                {
+                    const char* first = value.data();
+                    const char* last = first + value.size();
+                    if (first != last && *first == '+')
+                    {
+                        ++first;
+                    }
+                    double val;
+                    auto result = std::from_chars(first, last, val);
+                    if (result.ec == std::errc() && first != last)
+                    {
+                        batch.emplace_back(handle, val);
+                        ++count;
+                    }
+                    else
+                    {
+                        std::cout << "E: InputModule::subscriptionHandler -- value=" << value << " -- invalid number" << std::endl;
+                    }
+                }
+            }
+        }
+        pos = next == end ? end : next + 1;
+    }
+    return count;
+}
+
+} // namespace io
+} // namespace bennu
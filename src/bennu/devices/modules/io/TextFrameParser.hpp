@@ -0,0 +1,51 @@
+#ifndef BENNU_FIELDDEVICE_IO_TEXTFRAMEPARSER_HPP
+#define BENNU_FIELDDEVICE_IO_TEXTFRAMEPARSER_HPP
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "bennu/devices/field-device/DataManager.hpp"
+
+namespace bennu {
+namespace io {
+
+/*
+ * Single pass parser for "name:value,name:value," publish frames. Only the
+ * points indexed with addPoint() are looked up (binary search over a sorted
+ * index, names outside its length range are rejected without one), values
+ * are parsed with std::from_chars straight out of the frame, and matches are
+ * appended to a caller owned batch, so a parse allocates nothing once the
+ * batch has grown to size.
+ */
+class TextFrameParser
+{
+public:
+    TextFrameParser();
+
+    void addPoint(const std::string& name, const field_device::PointHandle handle);
+
+    // Sort the index; call after the last addPoint()
+    void build();
+
+    std::size_t size() const
+    {
+        return mPoints.size();
+    }
+
+    field_device::PointHandle find(const std::string_view& name) const;
+
+    // Append the values of indexed points in 'frame' to 'batch'; returns the number appended
+    std::size_t parse(const std::string_view& frame, field_device::DataManager::PointBatch& batch) const;
+
+private:
+    std::vector<std::pair<std::string, field_device::PointHandle>> mPoints; // sorted by name
+    std::size_t mMinLength;
+    std::size_t mMaxLength;
+};
+
+} // namespace io
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_IO_TEXTFRAMEPARSER_HPP
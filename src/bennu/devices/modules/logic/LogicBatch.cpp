@@ -0,0 +1,46 @@
+#include "LogicBatch.hpp"
+
+#include <algorithm>
+
+namespace bennu {
+namespace logic {
+
+LogicBatch::LogicBatch(std::shared_ptr<const LogicProgram> program) :
+    mProgram(program),
+    mStride(0),
+    mLanes(0),
+    mRequested(program->getNumLines(), 0),
+    mPending(false)
+{
+}
+
+std::size_t LogicBatch::addLane()
+{
+    if (mLanes == mStride)
+    {
+        // keep each register's lanes contiguous (and a multiple of 8 for the vector loops)
+        std::size_t stride = std::max<std::size_t>(8, mStride * 2);
+        std::vector<double> registers(mProgram->getNumRegisters() * stride, 0.0);
+        for (std::size_t r = 0; r < mProgram->getNumRegisters(); ++r)
+        {
+            std::copy_n(mRegisters.begin() + r * mStride, mLanes, registers.begin() + r * stride);
+        }
+        mRegisters.swap(registers);
+        mStride = stride;
+    }
+    return mLanes++;
+}
+
+void LogicBatch::evaluate()
+{
+    if (!mPending)
+    {
+        return;
+    }
+    mProgram->evaluate(mRegisters.data(), mStride, mLanes, mRequested);
+    std::fill(mRequested.begin(), mRequested.end(), 0);
+    mPending = false;
+}
+
+} // namespace logic
+} // namespace bennu
@@ -0,0 +1,72 @@
+#ifndef BENNU_FIELDDEVICE_LOGIC_LOGICBATCH_HPP
+#define BENNU_FIELDDEVICE_LOGIC_LOGICBATCH_HPP
+
+#include <memory>
+#include <vector>
+
+#include "bennu/devices/modules/logic/LogicProgram.hpp"
+
+namespace bennu {
+namespace logic {
+
+/*
+ * Register file for running one LogicProgram over many instances ("lanes",
+ * one per device) in a single pass. Each instance writes its inputs into its
+ * lane and requests the lines it needs; evaluate() then runs every requested
+ * line across all lanes at once.
+ *
+ * Not thread safe: one scan (a device's, or a ScanGroup's for all its
+ * devices) owns the batch and must serialize addLane(), request() and
+ * evaluate(). Only at() on different lanes may be called concurrently.
+ */
+class LogicBatch
+{
+public:
+    explicit LogicBatch(std::shared_ptr<const LogicProgram> program);
+
+    const std::shared_ptr<const LogicProgram>& getProgram() const
+    {
+        return mProgram;
+    }
+
+    // Add an instance and return its lane
+    std::size_t addLane();
+
+    std::size_t size() const
+    {
+        return mLanes;
+    }
+
+    double& at(const std::size_t reg, const std::size_t lane)
+    {
+        return mRegisters[reg * mStride + lane];
+    }
+
+    // Have 'line' run by the next evaluate()
+    void request(const std::size_t line)
+    {
+        mRequested[line] = 1;
+        mPending = true;
+    }
+
+    // Run the requested lines for all lanes
+    void evaluate();
+
+    double getResult(const std::size_t lane, const std::size_t line) const
+    {
+        return mRegisters[mProgram->getOutput(line) * mStride + lane];
+    }
+
+private:
+    std::shared_ptr<const LogicProgram> mProgram;
+    std::vector<double> mRegisters;     // register r of lane i at [r * mStride + i]
+    std::size_t mStride;                // lane capacity
+    std::size_t mLanes;
+    std::vector<char> mRequested;       // per line
+    bool mPending;
+};
+
+} // namespace logic
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_LOGIC_LOGICBATCH_HPP
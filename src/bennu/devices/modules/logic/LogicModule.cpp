@@ -15,11 +15,26 @@
 //   the total delay before that tag is checked for change
 //   and updated will be 10 seconds
 //
+//   The delay is timed on the monotonic clock, so it is not stretched
+//   by late or overrunning scans. A new result is only written if it
+//   still differs from the tag when the delay runs out; if the logic
+//   goes back to the current value first, the delay is cancelled.
+//
+// NOTE: Logic is compiled once when the module is configured, so every
+//       tag used in it must be defined before the <logic> element is
+//       handled. Tags may contain characters cparse does not allow in
+//       variable names (e.g. 'load-power'); they are bound to generated
+//       variable names at compile time.
+//
 
 #include "LogicModule.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <numeric>
+#include <type_traits>
+#include <sstream>
 
 #include <boost/algorithm/string.hpp>
 
@@ -29,7 +44,10 @@
 namespace bennu {
 namespace logic {
 
-LogicModule::LogicModule()
+LogicModule::LogicModule() :
+    mLane(0),
+    mOwnBatch(true),
+    mVerbose(false)
 {
     // Initialize cparse
     cparse_startup();
@@ -41,6 +59,8 @@ bool LogicModule::handleTreeData(const boost::property_tree::ptree& tree)
     try {
         mLogic = tree.get<std::string>("logic", "");
         boost::algorithm::trim(mLogic);
+        mVerbose = tree.get<bool>("diagnostics.print-logic", false);
+        success = compile();
     } catch (boost::property_tree::ptree_bad_path& e) {
         std::cerr << "ERROR: Format was incorrect in the Logic module XML: " << e.what() << std::endl;
         success = false;
@@ -51,116 +71,406 @@ bool LogicModule::handleTreeData(const boost::property_tree::ptree& tree)
     return success;
 }
 
-void LogicModule::scanInputs()
+bool LogicModule::compile()
 {
-    // Replace strings in RHS logic with corresponding boolean or analog data
-    mCurrentLogic = mLogic;
-    for (auto& tag : mSortByLargest(mDataManager->getBinaryTags()))
-    {
-        bool status = mDataManager->getDataByTag<bool>(tag);
-        mReplaceAllRhs(mCurrentLogic, tag, status ? "True" : "False");
-    }
-    for (auto& tag : mSortByLargest(mDataManager->getAnalogTags()))
+    mRules.clear();
+    mOrder.clear();
+    mDirty.clear();
+    mBindings.clear();
+    mVariables.clear();
+    mVars = TokenMap();
+    mProgram.reset();
+    mBatch.reset();
+
+    // Longest first so a tag is never matched as a prefix of a longer one
+    std::vector<std::string> tags = mDataManager->getBinaryTags();
+    for (auto& tag : mDataManager->getAnalogTags())
     {
-        double value = mDataManager->getDataByTag<double>(tag);
-        mReplaceAllRhs(mCurrentLogic, tag, std::to_string(value));
+        tags.push_back(tag);
     }
-}
+    tags = mSortByLargest(tags);
 
-void LogicModule::scanLogic(unsigned int cycleTime)
-{
-    TokenMap vars;
-    std::stringstream ss(mCurrentLogic);
+    bool success = true;
+    std::stringstream ss(mLogic);
     std::string line;
-    std::vector<std::string> exprParts;
-    std::string logic;
     while (std::getline(ss, line, '\n'))
     {
+        boost::algorithm::trim(line);
         if (line == "") { continue; } // ignore blank lines
 
-        exprParts = mSplitExpression(line, "="); // e.g. line = 'foo = (((bar - baz) >= 90) || ((bar - baz) <= -90)),delay:5000'
+        auto exprParts = mSplitExpression(line, "="); // e.g. line = 'foo = (((bar - baz) >= 90) || ((bar - baz) <= -90)),delay:5000'
+        if (exprParts.size() != 2)
+        {
+            std::cout << "ERROR: [ " << line << " ] Logic line is not an assignment" << std::endl;
+            success = false;
+            continue;
+        }
         std::string lhs = exprParts[0];
         std::string rhs = exprParts[1];
         boost::algorithm::trim(lhs); // e.g. lhs = 'foo'
         boost::algorithm::trim(rhs); // e.g. rhs = '(((bar - baz) >= 90) || ((bar - baz) <= -90)),delay:5000'
 
         auto rhsParts = mSplitStr(rhs, ",");
-        std::string logic = rhsParts[0]; // e.g. rhsParts[0] = '(((bar - baz) >= 90) || ((bar - baz) <= -90))'
+
+        Rule rule;
+        rule.lhs = lhs;
+        rule.logic = rhsParts[0]; // e.g. rhsParts[0] = '(((bar - baz) >= 90) || ((bar - baz) <= -90))'
         // check if there is a 'delay' in the right hand side of the expression
-        int delay = mGetDelay(rhsParts);
+        rule.delay = mGetDelay(rhsParts);
+        rule.due = false;
+        rule.handle = mDataManager->getTagHandle(lhs);
+        if (mDataManager->isBinary(lhs))
+        {
+            rule.binary = true;
+        }
+        else if (mDataManager->isAnalog(lhs))
+        {
+            rule.binary = false;
+        }
+        else
+        {
+            std::cout << "WARN: [ " << line << " ] Logic assigns to unknown tag " << lhs << ", ignoring" << std::endl;
+            continue;
+        }
 
-        // skip tags that are currently being delayed
-        if (isDelayedTag(lhs))
+        try {
+            rule.bound = bindTags(rule.logic, tags, rule.reads);
+            rule.expression.compile(rule.bound.data());
+        } catch (std::exception& e) {
+            std::cout << "ERROR: [ " << rule.logic << " ] Failed to parse logic: " << e.what() << std::endl;
+            success = false;
+            continue;
+        }
+        // a line also re-runs when something else changes the tag it writes
+        bindVariable(lhs);
+        mRules.push_back(rule);
+    }
+
+    // The map nodes never move, so each binding can keep a pointer to its variable
+    std::map<std::string, std::size_t> bindingIndex;
+    for (auto& kv : mVariables)
+    {
+        Binding binding;
+        binding.handle = mDataManager->getTagHandle(kv.first);
+        binding.binary = mDataManager->isBinary(kv.first);
+        binding.value = &mVars[kv.second];
+        binding.variable = std::stoul(kv.second.substr(2));
+        binding.last = 0.0;
+        binding.seen = false;
+        bindingIndex[kv.first] = mBindings.size();
+        mBindings.push_back(binding);
+    }
+    for (std::size_t i = 0; i < mRules.size(); ++i)
+    {
+        for (auto& tag : mRules[i].reads)
+        {
+            mBindings[bindingIndex[tag]].rules.push_back(i);
+        }
+        auto& writers = mBindings[bindingIndex[mRules[i].lhs]].rules;
+        if (std::find(writers.begin(), writers.end(), i) == writers.end())
         {
-            int newDelay = getDelayedTag(lhs) - static_cast<int>(cycleTime);
-            if (newDelay > 0)
+            writers.push_back(i);
+        }
+    }
+
+    sortRules();
+    mDirty.assign(mRules.size(), 1);
+    mTimers = TimerWheel(mRules.size());
+
+    // Try the bytecode path; identical logic over identically typed tags compiles once per process
+    std::vector<std::string> lines;
+    std::vector<LogicProgram::Type> types(mVariables.size(), LogicProgram::eNumber);
+    std::string key;
+    for (auto& rule : mRules)
+    {
+        lines.push_back(rule.bound);
+        key += rule.bound + "\n";
+    }
+    for (auto& binding : mBindings)
+    {
+        types[binding.variable] = binding.binary ? LogicProgram::eBool : LogicProgram::eNumber;
+    }
+    for (auto type : types)
+    {
+        key += type == LogicProgram::eBool ? 'b' : 'n';
+    }
+    mProgram = LogicProgram::get(key, lines, types);
+    if (mProgram)
+    {
+        mBatch.reset(new LogicBatch(mProgram));
+        mLane = mBatch->addLane();
+        mOwnBatch = true;
+    }
+
+    return success;
+}
+
+void LogicModule::sortRules()
+{
+    // Kahn's algorithm over 'rule A writes a tag rule B reads' edges
+    std::vector<std::vector<std::size_t>> readers(mRules.size());
+    std::vector<std::size_t> inDegree(mRules.size(), 0);
+    for (std::size_t a = 0; a < mRules.size(); ++a)
+    {
+        for (std::size_t b = 0; b < mRules.size(); ++b)
+        {
+            if (mRules[b].reads.count(mRules[a].lhs))
             {
-                setDelayedTag(lhs, newDelay);
-                std::cout << "LOGIC (" << delay << "): " + lhs <<
-                             " = " << logic << " ----> [ DELAYED " << newDelay << "ms ]" << std::endl;
-                continue;
+                readers[a].push_back(b);
+                ++inDegree[b];
             }
         }
+    }
 
-        // evaluate logic expression
-        try {
-            if (mDataManager->isBinary(lhs))
+    // lowest line first among ready rules keeps the order stable for independent lines
+    std::set<std::size_t> ready;
+    for (std::size_t i = 0; i < mRules.size(); ++i)
+    {
+        if (inDegree[i] == 0)
+        {
+            ready.insert(i);
+        }
+    }
+    while (!ready.empty())
+    {
+        std::size_t a = *ready.begin();
+        ready.erase(ready.begin());
+        mOrder.push_back(a);
+        for (auto b : readers[a])
+        {
+            if (--inDegree[b] == 0)
             {
-                bool result = calculator::calculate(logic.data(), &vars).asBool();
-                std::cout << "LOGIC (" << delay << "): " + lhs <<
-                             " = " << logic << " ----> " << result << std::endl;
-                // if new evaluated data has changed from the datastore, update the tag
-                if (result != mDataManager->getDataByTag<bool>(lhs) && !mDataManager->isUpdatedBinaryTag(lhs))
-                {
-                    if (delay > 0 && !isDelayedTag(lhs))
-                    {
-                        delay = delay * static_cast<int>(cycleTime); // delay (ms) = # of cycles * scan cycle time (ms)
-                        setDelayedTag(lhs, delay);
-                        std::cout << "\nI: Delaying tag: " << lhs << " for " << delay << "ms" << std::endl;
-                    }
-                    else
-                    {
-                        mDataManager->addUpdatedBinaryTag(lhs, result);
-                        removeDelayedTag(lhs);
-                    }
-                }
-                else if (isDelayedTag(lhs))
+                ready.insert(b);
+            }
+        }
+    }
+
+    // Whatever is left is on (or downstream of) a cycle. Those lines still work, each one
+    // seeing the others' results a scan later through the data store, but flag them.
+    if (mOrder.size() < mRules.size())
+    {
+        std::string tags;
+        for (std::size_t i = 0; i < mRules.size(); ++i)
+        {
+            if (inDegree[i] > 0)
+            {
+                mOrder.push_back(i);
+                tags += (tags.empty() ? "" : ", ") + mRules[i].lhs;
+            }
+        }
+        std::cout << "WARN: Logic has a dependency cycle through tags: " << tags << std::endl;
+    }
+}
+
+const std::string& LogicModule::bindVariable(const std::string& tag)
+{
+    auto iter = mVariables.find(tag);
+    if (iter == mVariables.end())
+    {
+        iter = mVariables.emplace(tag, "_t" + std::to_string(mVariables.size())).first;
+    }
+    return iter->second;
+}
+
+std::string LogicModule::bindTags(const std::string& rhs, const std::vector<std::string>& tags, std::set<std::string>& reads)
+{
+    // e.g. rhs = '! load-power > 500' ==> '! _t0 > 500' with _t0 bound to tag 'load-power'
+    auto isNameChar = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    std::string bound;
+    std::size_t pos = 0;
+    while (pos < rhs.size())
+    {
+        if (pos == 0 || !isNameChar(rhs[pos-1]))
+        {
+            for (auto& tag : tags)
+            {
+                std::size_t end = pos + tag.size();
+                if (rhs.compare(pos, tag.size(), tag) == 0 && (end == rhs.size() || !isNameChar(rhs[end])))
                 {
-                    removeDelayedTag(lhs);
+                    bound += bindVariable(tag);
+                    reads.insert(tag);
+                    pos = end;
+                    break;
                 }
             }
-            else if (mDataManager->isAnalog(lhs))
+        }
+        if (pos < rhs.size())
+        {
+            bound += rhs[pos++];
+        }
+    }
+    return bound;
+}
+
+void LogicModule::joinBatch(std::shared_ptr<LogicBatch> batch)
+{
+    mBatch = batch;
+    mLane = mBatch->addLane();
+    mOwnBatch = false;
+    // the new lane starts empty, so load every input and run every line on the next scan
+    for (auto& binding : mBindings)
+    {
+        binding.seen = false;
+    }
+    mDirty.assign(mRules.size(), 1);
+}
+
+void LogicModule::scanInputs()
+{
+    // Refresh the expression variables that changed and mark the lines depending on them
+    for (auto& binding : mBindings)
+    {
+        double value = binding.binary ? mDataManager->getData<bool>(binding.handle) : mDataManager->getData<double>(binding.handle);
+        if (binding.seen && value == binding.last)
+        {
+            continue;
+        }
+        binding.seen = true;
+        binding.last = value;
+        if (mBatch)
+        {
+            mBatch->at(binding.variable, mLane) = value;
+        }
+        else if (binding.binary)
+        {
+            *binding.value = packToken(value != 0.0);
+        }
+        else
+        {
+            *binding.value = packToken(value);
+        }
+        for (auto rule : binding.rules)
+        {
+            mDirty[rule] = 1;
+        }
+    }
+
+    // Lines whose delay ran out get another look this scan
+    mNow = TimerWheel::Clock::now();
+    mExpired.clear();
+    mTimers.advance(mNow, mExpired);
+    for (auto index : mExpired)
+    {
+        mRules[index].due = true;
+        mDirty[index] = 1;
+    }
+
+    if (mBatch && mOwnBatch)
+    {
+        requestLines();
+    }
+}
+
+void LogicModule::requestLines()
+{
+    for (std::size_t i = 0; i < mRules.size(); ++i)
+    {
+        if (mDirty[i])
+        {
+            mBatch->request(i);
+        }
+    }
+}
+
+void LogicModule::scanLogic(unsigned int cycleTime)
+{
+    if (mBatch && mOwnBatch)
+    {
+        mBatch->evaluate();
+    }
+
+    for (auto index : mOrder)
+    {
+        if (!mDirty[index])
+        {
+            continue; // nothing it depends on changed, so it would produce the same result
+        }
+        auto& rule = mRules[index];
+
+        // evaluate logic expression
+        try {
+            if (mBatch)
             {
-                double result = calculator::calculate(logic.data(), &vars).asDouble();
-                std::cout << "LOGIC (" << delay << "): " + lhs <<
-                             " = " << logic << " ----> " << result << std::endl;
-                // if new evaluated data has changed from the datastore, update the tag
-                if (result != mDataManager->getDataByTag<double>(lhs) && !mDataManager->isUpdatedAnalogTag(lhs))
+                double result = mBatch->getResult(mLane, index);
+                if (rule.binary)
                 {
-                    if (delay > 0 && !isDelayedTag(lhs))
-                    {
-                        delay = delay * static_cast<int>(cycleTime); // delay (ms) = # of cycles * scan cycle time (ms)
-                        setDelayedTag(lhs, delay);
-                        std::cout << "\nI: Delaying tag: " << lhs << " for " << delay << "ms" << std::endl;
-                    }
-                    else
-                    {
-                        mDataManager->addUpdatedAnalogTag(lhs, result);
-                        removeDelayedTag(lhs);
-                    }
+                    applyResult<bool>(index, result != 0.0, cycleTime, mNow);
                 }
-                else if (isDelayedTag(lhs))
+                else
                 {
-                    removeDelayedTag(lhs);
+                    applyResult<double>(index, result, cycleTime, mNow);
                 }
             }
+            else if (rule.binary)
+            {
+                applyResult<bool>(index, rule.expression.eval(mVars).asBool(), cycleTime, mNow);
+            }
+            else
+            {
+                applyResult<double>(index, rule.expression.eval(mVars).asDouble(), cycleTime, mNow);
+            }
         } catch (std::exception& e) {
-            std::cout << "ERROR: [ " << logic << " ] Failed to parse logic: " << e.what() << std::endl;
+            std::cout << "ERROR: [ " << rule.logic << " ] Failed to evaluate logic: " << e.what() << std::endl;
+            mDirty[index] = 0; // retried once its inputs change
             continue;
         }
     }
 }
 
+template<typename T>
+void LogicModule::applyResult(const std::size_t index, const T& result, const unsigned int cycleTime, const TimerWheel::Clock::time_point& now)
+{
+    auto& rule = mRules[index];
+    const bool binary = std::is_same<T, bool>::value;
+    T stored = mDataManager->getData<T>(rule.handle);
+
+    if (mVerbose && mTimers.armed(index))
+    {
+        std::cout << "LOGIC (" << rule.delay << "): " + rule.lhs << " = " << rule.logic << " ----> " << result
+                  << " [ DELAYED " << mTimers.remaining(index, now).count() << "ms ]" << std::endl;
+    }
+    else if (mVerbose)
+    {
+        std::cout << "LOGIC (" << rule.delay << "): " + rule.lhs << " = " << rule.logic << " ----> " << result << std::endl;
+    }
+
+    // if new evaluated data has changed from the datastore, update the tag
+    bool updated = binary ? mDataManager->isUpdatedBinaryTag(rule.lhs) : mDataManager->isUpdatedAnalogTag(rule.lhs);
+    if (result != stored && !updated)
+    {
+        if (rule.delay > 0 && !rule.due)
+        {
+            if (!mTimers.armed(index))
+            {
+                auto delay = std::chrono::milliseconds(rule.delay * static_cast<int>(cycleTime)); // delay (ms) = # of cycles * scan cycle time (ms)
+                mTimers.arm(index, delay, now);
+                std::cout << "\nI: Delaying tag: " << rule.lhs << " for " << delay.count() << "ms" << std::endl;
+            }
+        }
+        else
+        {
+            if (binary)
+            {
+                mDataManager->addUpdatedBinaryTag(rule.lhs, result);
+            }
+            else
+            {
+                mDataManager->addUpdatedAnalogTag(rule.lhs, result);
+            }
+            rule.due = false;
+        }
+    }
+    else if (result == stored)
+    {
+        // back at the stored value before the delay ran out
+        mTimers.cancel(index);
+        rule.due = false;
+    }
+
+    // a running delay wakes the line up when it expires; otherwise keep running until the result has reached the data store
+    mDirty[index] = !mTimers.armed(index) && result != stored;
+}
+
 int LogicModule::mGetDelay(std::vector<std::string> rhsParts)
 {
     int delay = 0;
@@ -189,37 +499,6 @@ int LogicModule::mGetDelay(std::vector<std::string> rhsParts)
     return delay;
 }
 
-void LogicModule::mReplaceAllRhs(std::string& data, std::string toSearch, std::string replaceStr)
-{
-    // Example data (i.e. logic):
-    //    "load-breaker-toggle = ! load-power > 500 ;\n        gen-power = load-breaker-toggle ;"
-    // Example data (after being replaced. note the extra '\n' at the end):
-    //    "load-breaker-toggle = ! 400.55 > 500 ;\ngen-power = True ;\n"
-    std::stringstream ss(data);
-    std::string line;
-    std::string replaced;
-    while (std::getline(ss, line, '\n'))
-    {
-        boost::algorithm::trim(line);
-        // Get the first occurrence
-        size_t pos = line.find(toSearch);
-        // Repeat till end is reached
-        while(pos != std::string::npos) {
-            // Replace this occurrence, only if it is RHS of expression. Also check pos+1 to make
-            // sure this isn't a substring of a different variable.
-            //   e.g. 'var_O1' vs 'var_O12'
-            if (pos != 0 && !std::isalnum(line[pos+toSearch.size()]))
-            {
-                line.replace(pos, toSearch.size(), replaceStr);
-            }
-            // Get the next occurrence from the current position
-            pos = line.find(toSearch, pos + toSearch.size());
-        }
-        replaced += line + "\n";
-    }
-    data = replaced;
-}
-
 std::vector<std::string> LogicModule::mSplitExpression(std::string phrase, std::string delimiter)
 {
     std::vector<std::string> list;
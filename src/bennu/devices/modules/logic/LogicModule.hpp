@@ -3,16 +3,41 @@
 
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 #include <boost/property_tree/ptree.hpp>
 
 #include "bennu/devices/field-device/DataManager.hpp"
+#include "bennu/devices/modules/logic/LogicBatch.hpp"
+#include "bennu/devices/modules/logic/LogicProgram.hpp"
+#include "bennu/devices/modules/logic/TimerWheel.hpp"
+#include "bennu/devices/modules/logic/cparse/shunting-yard.h" // calculator, TokenMap
 
 namespace bennu {
 namespace logic {
 
+/*
+ * Logic lines are parsed and compiled once by handleTreeData (tags must
+ * already be defined in the data manager). Every tag used on the right hand
+ * side is bound to a variable in mVars, so a scan only refreshes those
+ * variables from the data store and evaluates the compiled expressions.
+ *
+ * Evaluation is incremental: a line only runs when a tag it reads (or the
+ * tag it writes) changed since it last ran, or while its result has not yet
+ * reached the data store (pending write or delay). Lines run in dependency
+ * order (writers before readers); dependency cycles are reported at load.
+ *
+ * Delays are on-delay/off-delay timers on a TimerWheel keyed by line: a
+ * changed result is only written once it has held for the whole delay, and
+ * the timer is cancelled if the result goes back to the stored value first.
+ *
+ * When every line fits the LogicProgram bytecode subset, the lines run as
+ * bytecode in a LogicBatch lane instead of through cparse. Devices running
+ * the same logic share one compiled program, and a ScanGroup can put them
+ * all in one batch (joinBatch) so each scan evaluates every device at once.
+ */
 class LogicModule : public std::enable_shared_from_this<LogicModule>
 {
 public:
@@ -29,35 +54,74 @@ public:
 
     void scanLogic(unsigned int cycleTime);
 
-    bool isDelayedTag(std::string& tag)
+    // Compiled bytecode shared by every module with the same logic (nullptr when cparse is used)
+    std::shared_ptr<const LogicProgram> getProgram() const
     {
-        return mDelayedTags.count(tag);
+        return mProgram;
     }
 
-    void setDelayedTag(std::string& tag, int delayMillis)
-    {
-        mDelayedTags[tag] = delayMillis;
-    }
+    // Move this module into a batch shared with other modules running the same program.
+    // The batch owner calls requestLines() and LogicBatch::evaluate() between scanInputs()
+    // and scanLogic(); scanInputs() of modules sharing a batch may run concurrently.
+    void joinBatch(std::shared_ptr<LogicBatch> batch);
 
-    int getDelayedTag(std::string& tag)
-    {
-        return mDelayedTags[tag];
-    }
-
-    void removeDelayedTag(std::string& tag)
-    {
-        mDelayedTags.erase(tag);
-    }
+    // Request the lines this scan needs from a shared batch (done by scanInputs() otherwise)
+    void requestLines();
 
 private:
-    void mReplaceAllRhs(std::string & data, std::string toSearch, std::string replaceStr);
+    // Compiled 'lhs = rhs[,delay:N]' line
+    struct Rule
+    {
+        std::string lhs;
+        std::string logic;                      // rhs expression as written (for logging)
+        field_device::TagHandle handle;         // lhs tag
+        bool binary;
+        int delay;                              // in scan cycles
+        bool due;                               // delay timer expired; write the result if it still differs
+        calculator expression;
+        std::string bound;                      // rhs in terms of the _t<N> variables
+        std::set<std::string> reads;            // rhs tags
+    };
+
+    // Tag read into an expression variable each scan
+    struct Binding
+    {
+        field_device::TagHandle handle;
+        bool binary;
+        packToken* value;                       // mVars entry
+        std::size_t variable;                   // N of _t<N> (bytecode register)
+        double last;                            // value seen by the previous scan
+        bool seen;
+        std::vector<std::size_t> rules;         // rules to re-run when this tag changes
+    };
+
+    bool compile();
+    void sortRules();
+
+    template<typename T>
+    void applyResult(const std::size_t index, const T& result, const unsigned int cycleTime, const TimerWheel::Clock::time_point& now);
+
+    const std::string& bindVariable(const std::string& tag);
+    std::string bindTags(const std::string& rhs, const std::vector<std::string>& tags, std::set<std::string>& reads);
     std::vector<std::string> mSplitExpression(std::string phrase, std::string delimiter);
     std::vector<std::string> mSplitStr(std::string phrase, std::string delimiter);
     std::vector<std::string> mSortByLargest(std::vector<std::string> vector);
     int mGetDelay(std::vector<std::string> rhsParts);
-    std::map<std::string, int> mDelayedTags;
+    TimerWheel mTimers;                                 // delay timers, keyed by rule index
+    std::vector<std::size_t> mExpired;
     std::string mLogic;
-    std::string mCurrentLogic;
+    std::vector<Rule> mRules;
+    std::vector<std::size_t> mOrder;                    // rule indexes in evaluation order
+    std::vector<char> mDirty;                           // per rule: needs to run this scan
+    std::vector<Binding> mBindings;
+    std::map<std::string, std::string> mVariables;      // tag ==> expression variable name
+    TokenMap mVars;
+    std::shared_ptr<const LogicProgram> mProgram;
+    std::shared_ptr<LogicBatch> mBatch;
+    std::size_t mLane;
+    bool mOwnBatch;                                     // evaluate mBatch ourselves (not shared with a ScanGroup)
+    bool mVerbose;                                      // print every evaluated line (<diagnostics><print-logic>)
+    TimerWheel::Clock::time_point mNow;                 // time of the current scan
     std::shared_ptr<field_device::DataManager> mDataManager;
 
 };
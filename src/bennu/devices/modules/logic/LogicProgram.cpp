@@ -0,0 +1,442 @@
+#include "LogicProgram.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+namespace bennu {
+namespace logic {
+
+/*
+ * Shunting-yard over the same operator table cparse uses (lower binds
+ * tighter, everything left associative, left unary operators pushed without
+ * popping) followed by code generation from the RPN with a typed stack.
+ */
+class LogicProgram::Compiler
+{
+public:
+    Compiler(LogicProgram& program, const std::vector<Type>& variables) :
+        mProgram(program),
+        mVariables(variables)
+    {
+    }
+
+    bool compileLine(const std::string& expr)
+    {
+        std::vector<Token> rpn;
+        if (!toRPN(expr, rpn))
+        {
+            return false;
+        }
+
+        Line line;
+        line.begin = mProgram.mCode.size();
+        std::vector<Operand> stack;
+        for (auto& token : rpn)
+        {
+            if (!emit(token, stack))
+            {
+                return false;
+            }
+        }
+        if (stack.size() != 1)
+        {
+            return false;
+        }
+        line.end = mProgram.mCode.size();
+        line.output = stack.back().reg;
+        mProgram.mLines.push_back(line);
+        return true;
+    }
+
+private:
+    enum Kind
+    {
+        eNumberToken,
+        eVariableToken,
+        eOperatorToken,
+        eFunctionToken,
+        eLeftParen
+    };
+
+    struct Token
+    {
+        Kind kind;
+        std::string text;       // operator ("L" prefix for left unary) or function name
+        double value;
+        std::size_t variable;
+        bool boolean;
+    };
+
+    struct Operand
+    {
+        std::uint32_t reg;
+        Type type;
+    };
+
+    static int precedence(const std::string& op)
+    {
+        static const std::map<std::string, int> table = {
+            {"**", 3}, {"L+", 3}, {"L-", 3}, {"L!", 4},
+            {"*", 5}, {"/", 5}, {"%", 5},
+            {"+", 6}, {"-", 6},
+            {"<<", 7}, {">>", 7},
+            {"<", 8}, {"<=", 8}, {">=", 8}, {">", 8},
+            {"==", 9}, {"!=", 9},
+            {"&&", 13},
+            {"||", 14}
+        };
+        auto iter = table.find(op);
+        return iter == table.end() ? -1 : iter->second;
+    }
+
+    bool toRPN(const std::string& expr, std::vector<Token>& rpn)
+    {
+        std::vector<Token> ops;
+        bool lastWasOp = true;
+        std::size_t pos = 0;
+        while (pos < expr.size())
+        {
+            char c = expr[pos];
+            if (std::isspace(static_cast<unsigned char>(c)))
+            {
+                ++pos;
+            }
+            else if (std::isdigit(static_cast<unsigned char>(c)))
+            {
+                if (!lastWasOp)
+                {
+                    return false;
+                }
+                char* end;
+                double value = std::strtod(expr.data() + pos, &end);
+                pos = end - expr.data();
+                rpn.push_back(Token{eNumberToken, "", value, 0, false});
+                lastWasOp = false;
+            }
+            else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                if (!lastWasOp)
+                {
+                    return false;
+                }
+                std::size_t start = pos;
+                while (pos < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[pos])) || expr[pos] == '_'))
+                {
+                    ++pos;
+                }
+                std::string name = expr.substr(start, pos - start);
+                if (name == "True" || name == "False")
+                {
+                    rpn.push_back(Token{eNumberToken, "", name == "True" ? 1.0 : 0.0, 0, true});
+                    lastWasOp = false;
+                }
+                else if (name == "sin" || name == "cos" || name == "tan" || name == "abs" || name == "sqrt")
+                {
+                    while (pos < expr.size() && std::isspace(static_cast<unsigned char>(expr[pos])))
+                    {
+                        ++pos;
+                    }
+                    if (pos == expr.size() || expr[pos] != '(')
+                    {
+                        return false;
+                    }
+                    ++pos;
+                    ops.push_back(Token{eFunctionToken, name, 0, 0, false});
+                    ops.push_back(Token{eLeftParen, "(", 0, 0, false});
+                }
+                else if (name.size() > 2 && name[0] == '_' && name[1] == 't' &&
+                         name.find_first_not_of("0123456789", 2) == std::string::npos)
+                {
+                    std::size_t index = std::strtoul(name.c_str() + 2, nullptr, 10);
+                    if (index >= mVariables.size())
+                    {
+                        return false;
+                    }
+                    rpn.push_back(Token{eVariableToken, "", 0, index, false});
+                    lastWasOp = false;
+                }
+                else
+                {
+                    return false; // unbound name or unsupported function
+                }
+            }
+            else if (c == '(')
+            {
+                if (!lastWasOp)
+                {
+                    return false; // call on an expression
+                }
+                ops.push_back(Token{eLeftParen, "(", 0, 0, false});
+                ++pos;
+            }
+            else if (c == ')')
+            {
+                while (!ops.empty() && ops.back().kind != eLeftParen)
+                {
+                    rpn.push_back(ops.back());
+                    ops.pop_back();
+                }
+                if (ops.empty() || lastWasOp)
+                {
+                    return false;
+                }
+                ops.pop_back();
+                if (!ops.empty() && ops.back().kind == eFunctionToken)
+                {
+                    rpn.push_back(ops.back());
+                    ops.pop_back();
+                }
+                ++pos;
+                lastWasOp = false;
+            }
+            else
+            {
+                // longest operator first
+                std::string op;
+                for (std::size_t len = 2; len > 0 && op.empty(); --len)
+                {
+                    std::string candidate = expr.substr(pos, len);
+                    if (precedence(candidate) >= 0 || (lastWasOp && precedence("L" + candidate) >= 0))
+                    {
+                        op = candidate;
+                    }
+                }
+                if (op.empty())
+                {
+                    return false;
+                }
+                pos += op.size();
+
+                if (lastWasOp)
+                {
+                    if (precedence("L" + op) < 0)
+                    {
+                        return false;
+                    }
+                    ops.push_back(Token{eOperatorToken, "L" + op, 0, 0, false});
+                }
+                else
+                {
+                    if (precedence(op) < 0)
+                    {
+                        return false; // '!' is unary only
+                    }
+                    while (!ops.empty() && ops.back().kind == eOperatorToken && precedence(op) >= precedence(ops.back().text))
+                    {
+                        rpn.push_back(ops.back());
+                        ops.pop_back();
+                    }
+                    ops.push_back(Token{eOperatorToken, op, 0, 0, false});
+                }
+                lastWasOp = true;
+            }
+        }
+
+        if (lastWasOp)
+        {
+            return false;
+        }
+        while (!ops.empty())
+        {
+            if (ops.back().kind != eOperatorToken)
+            {
+                return false; // unbalanced parenthesis
+            }
+            rpn.push_back(ops.back());
+            ops.pop_back();
+        }
+        return !rpn.empty();
+    }
+
+    std::uint32_t temporary()
+    {
+        return static_cast<std::uint32_t>(mProgram.mNumRegisters++);
+    }
+
+    void instruction(const Op op, const std::uint32_t dst, const std::uint32_t a, const std::uint32_t b, const double k = 0)
+    {
+        mProgram.mCode.push_back(Instruction{op, dst, a, b, k});
+    }
+
+    bool emit(const Token& token, std::vector<Operand>& stack)
+    {
+        switch (token.kind)
+        {
+            case eNumberToken:
+            {
+                std::uint32_t dst = temporary();
+                instruction(eConst, dst, 0, 0, token.value);
+                stack.push_back(Operand{dst, token.boolean ? eBool : eNumber});
+                return true;
+            }
+            case eVariableToken:
+            {
+                stack.push_back(Operand{static_cast<std::uint32_t>(token.variable), mVariables[token.variable]});
+                return true;
+            }
+            case eFunctionToken:
+            {
+                if (stack.empty())
+                {
+                    return false;
+                }
+                Operand arg = stack.back();
+                stack.pop_back();
+                Op op = token.text == "sin" ? eSin : token.text == "cos" ? eCos : token.text == "tan" ? eTan :
+                        token.text == "abs" ? eAbs : eSqrt;
+                std::uint32_t dst = temporary();
+                instruction(op, dst, arg.reg, 0);
+                stack.push_back(Operand{dst, eNumber});
+                return true;
+            }
+            case eOperatorToken:
+                break;
+            default:
+                return false;
+        }
+
+        const std::string& op = token.text;
+        if (op[0] == 'L')
+        {
+            if (stack.empty())
+            {
+                return false;
+            }
+            Operand arg = stack.back();
+            stack.pop_back();
+            if (op == "L+")
+            {
+                stack.push_back(arg);
+                return true;
+            }
+            if (op == "L!" && arg.type != eBool)
+            {
+                return false; // cparse only defines '!' for booleans
+            }
+            std::uint32_t dst = temporary();
+            instruction(op == "L-" ? eNeg : eNot, dst, arg.reg, 0);
+            stack.push_back(Operand{dst, op == "L-" ? eNumber : eBool});
+            return true;
+        }
+
+        if (stack.size() < 2)
+        {
+            return false;
+        }
+        Operand right = stack.back();
+        stack.pop_back();
+        Operand left = stack.back();
+        stack.pop_back();
+
+        static const std::map<std::string, std::pair<Op, Type>> binary = {
+            {"+", {eAdd, eNumber}}, {"-", {eSub, eNumber}}, {"*", {eMul, eNumber}}, {"/", {eDiv, eNumber}},
+            {"%", {eMod, eNumber}}, {"**", {ePow, eNumber}}, {"<<", {eShl, eNumber}}, {">>", {eShr, eNumber}},
+            {"<", {eLt, eBool}}, {">", {eGt, eBool}}, {"<=", {eLe, eBool}}, {">=", {eGe, eBool}},
+            {"==", {eEq, eBool}}, {"!=", {eNe, eBool}}, {"&&", {eAnd, eBool}}, {"||", {eOr, eBool}}
+        };
+        auto iter = binary.find(op);
+        if (iter == binary.end())
+        {
+            return false;
+        }
+        std::uint32_t dst = temporary();
+        instruction(iter->second.first, dst, left.reg, right.reg);
+        stack.push_back(Operand{dst, iter->second.second});
+        return true;
+    }
+
+    LogicProgram& mProgram;
+    const std::vector<Type>& mVariables;
+};
+
+std::shared_ptr<const LogicProgram> LogicProgram::compile(const std::vector<std::string>& lines, const std::vector<Type>& variables)
+{
+    std::shared_ptr<LogicProgram> program(new LogicProgram);
+    program->mNumVariables = variables.size();
+    program->mNumRegisters = variables.size();
+    Compiler compiler(*program, variables);
+    for (auto& line : lines)
+    {
+        if (!compiler.compileLine(line))
+        {
+            return nullptr;
+        }
+    }
+    return program;
+}
+
+std::shared_ptr<const LogicProgram> LogicProgram::get(const std::string& key, const std::vector<std::string>& lines, const std::vector<Type>& variables)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::shared_ptr<const LogicProgram>> programs;
+
+    std::scoped_lock<std::mutex> lock(mutex);
+    auto iter = programs.find(key);
+    if (iter == programs.end())
+    {
+        // unsupported programs are cached too (as nullptr) so they are only tried once
+        iter = programs.emplace(key, compile(lines, variables)).first;
+    }
+    return iter->second;
+}
+
+void LogicProgram::evaluate(double* regs, const std::size_t stride, const std::size_t count, const std::vector<char>& lines) const
+{
+    for (std::size_t l = 0; l < mLines.size(); ++l)
+    {
+        if (!lines.empty() && !lines[l])
+        {
+            continue;
+        }
+        for (std::size_t pc = mLines[l].begin; pc < mLines[l].end; ++pc)
+        {
+            const Instruction& in = mCode[pc];
+            double* __restrict d = regs + in.dst * stride;
+            const double* __restrict a = regs + in.a * stride;
+            const double* __restrict b = regs + in.b * stride;
+            std::size_t i = 0;
+
+            // numeric semantics follow cparse's NumeralOperation: '%', '<<', '>>', '&&' and '||'
+            // work on the operands truncated to integers, everything else on doubles
+            switch (in.op)
+            {
+                case eConst: for (; i < count; ++i) { d[i] = in.k; } break;
+                case eNeg:   for (; i < count; ++i) { d[i] = -a[i]; } break;
+                case eNot:   for (; i < count; ++i) { d[i] = a[i] == 0.0 ? 1.0 : 0.0; } break;
+                case eSin:   for (; i < count; ++i) { d[i] = std::sin(a[i]); } break;
+                case eCos:   for (; i < count; ++i) { d[i] = std::cos(a[i]); } break;
+                case eTan:   for (; i < count; ++i) { d[i] = std::tan(a[i]); } break;
+                case eAbs:   for (; i < count; ++i) { d[i] = std::abs(a[i]); } break;
+                case eSqrt:  for (; i < count; ++i) { d[i] = std::sqrt(a[i]); } break;
+                case eAdd:   for (; i < count; ++i) { d[i] = a[i] + b[i]; } break;
+                case eSub:   for (; i < count; ++i) { d[i] = a[i] - b[i]; } break;
+                case eMul:   for (; i < count; ++i) { d[i] = a[i] * b[i]; } break;
+                case eDiv:   for (; i < count; ++i) { d[i] = a[i] / b[i]; } break;
+                case ePow:   for (; i < count; ++i) { d[i] = std::pow(a[i], b[i]); } break;
+                case eMod:
+                    for (; i < count; ++i)
+                    {
+                        auto y = static_cast<std::int64_t>(b[i]);
+                        d[i] = y == 0 ? NAN : static_cast<double>(static_cast<std::int64_t>(a[i]) % y);
+                    }
+                    break;
+                case eShl:   for (; i < count; ++i) { d[i] = static_cast<double>(static_cast<std::int64_t>(a[i]) << static_cast<std::int64_t>(b[i])); } break;
+                case eShr:   for (; i < count; ++i) { d[i] = static_cast<double>(static_cast<std::int64_t>(a[i]) >> static_cast<std::int64_t>(b[i])); } break;
+                case eLt:    for (; i < count; ++i) { d[i] = a[i] < b[i]; } break;
+                case eGt:    for (; i < count; ++i) { d[i] = a[i] > b[i]; } break;
+                case eLe:    for (; i < count; ++i) { d[i] = a[i] <= b[i]; } break;
+                case eGe:    for (; i < count; ++i) { d[i] = a[i] >= b[i]; } break;
+                case eEq:    for (; i < count; ++i) { d[i] = a[i] == b[i]; } break;
+                case eNe:    for (; i < count; ++i) { d[i] = a[i] != b[i]; } break;
+                case eAnd:   for (; i < count; ++i) { d[i] = static_cast<std::int64_t>(a[i]) && static_cast<std::int64_t>(b[i]); } break;
+                case eOr:    for (; i < count; ++i) { d[i] = static_cast<std::int64_t>(a[i]) || static_cast<std::int64_t>(b[i]); } break;
+            }
+        }
+    }
+}
+
+} // namespace logic
+} // namespace bennu
@@ -0,0 +1,107 @@
+#ifndef BENNU_FIELDDEVICE_LOGIC_LOGICPROGRAM_HPP
+#define BENNU_FIELDDEVICE_LOGIC_LOGICPROGRAM_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bennu {
+namespace logic {
+
+/*
+ * A logic program (the right hand sides of a <logic> block) compiled to a
+ * typed, register based bytecode that is evaluated over many instances at
+ * once. Registers are stored struct-of-arrays: register r of instance i is
+ * at regs[r * stride + i], so every instruction is one tight loop over
+ * doubles (booleans are 0.0/1.0 masks) the compiler can vectorize.
+ *
+ * Registers [0, variables) are the bound tags, the rest are temporaries.
+ * The expression grammar, operator precedence and numeric behaviour follow
+ * cparse's so results match the calculator path; anything outside that
+ * subset (strings, unknown names, other functions, ...) fails to compile
+ * and the caller keeps using cparse.
+ *
+ * Programs are immutable once built and shared between all devices running
+ * the same logic (see get()).
+ */
+class LogicProgram
+{
+public:
+    enum Type
+    {
+        eBool,
+        eNumber
+    };
+
+    // Compile the lines (rhs expressions written in terms of variables
+    // "_t<index>", see LogicModule) for variables of the given types.
+    // Returns nullptr if any line is not supported.
+    static std::shared_ptr<const LogicProgram> compile(const std::vector<std::string>& lines, const std::vector<Type>& variables);
+
+    // As compile(), but returns the already compiled program for an identical key
+    static std::shared_ptr<const LogicProgram> get(const std::string& key, const std::vector<std::string>& lines, const std::vector<Type>& variables);
+
+    std::size_t getNumRegisters() const
+    {
+        return mNumRegisters;
+    }
+
+    std::size_t getNumVariables() const
+    {
+        return mNumVariables;
+    }
+
+    std::size_t getNumLines() const
+    {
+        return mLines.size();
+    }
+
+    // Register holding the result of a line
+    std::size_t getOutput(const std::size_t line) const
+    {
+        return mLines[line].output;
+    }
+
+    // Run the lines flagged in 'lines' (all of them if empty) for instances [0, count)
+    void evaluate(double* regs, const std::size_t stride, const std::size_t count, const std::vector<char>& lines) const;
+
+private:
+    enum Op : std::uint8_t
+    {
+        eConst,
+        eNeg, eNot, eSin, eCos, eTan, eAbs, eSqrt,
+        eAdd, eSub, eMul, eDiv, eMod, ePow, eShl, eShr,
+        eLt, eGt, eLe, eGe, eEq, eNe, eAnd, eOr
+    };
+
+    struct Instruction
+    {
+        Op op;
+        std::uint32_t dst;
+        std::uint32_t a;
+        std::uint32_t b;
+        double k;               // eConst value
+    };
+
+    struct Line
+    {
+        std::size_t begin;      // instruction range
+        std::size_t end;
+        std::size_t output;
+    };
+
+    class Compiler;
+
+    LogicProgram() : mNumRegisters(0), mNumVariables(0) {}
+
+    std::vector<Instruction> mCode;
+    std::vector<Line> mLines;
+    std::size_t mNumRegisters;
+    std::size_t mNumVariables;
+};
+
+} // namespace logic
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_LOGIC_LOGICPROGRAM_HPP
@@ -0,0 +1,197 @@
+#include "TimerWheel.hpp"
+
+namespace bennu {
+namespace logic {
+
+TimerWheel::TimerWheel(const std::size_t ids) :
+    mEpoch(Clock::now()),
+    mCurrent(0),
+    mArmed(0)
+{
+    for (auto& level : mSlots)
+    {
+        level.fill(NIL);
+    }
+    mOccupied.fill(0);
+    resize(ids);
+}
+
+void TimerWheel::resize(const std::size_t ids)
+{
+    if (ids > mNodes.size())
+    {
+        mNodes.resize(ids);
+    }
+}
+
+void TimerWheel::arm(const std::size_t id, const Clock::duration& delay, const Clock::time_point& now)
+{
+    resize(id + 1);
+    cancel(id);
+    // round up so a timer never fires early
+    auto ticks = std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+    std::uint64_t expiry = toTick(now) + static_cast<std::uint64_t>(ticks > 0 ? ticks : 0);
+    mNodes[id].expiry = expiry > mCurrent ? expiry : mCurrent + 1;
+    mNodes[id].armed = true;
+    ++mArmed;
+    insert(id);
+}
+
+void TimerWheel::cancel(const std::size_t id)
+{
+    if (armed(id))
+    {
+        unlink(id);
+        mNodes[id].armed = false;
+        --mArmed;
+    }
+}
+
+std::chrono::milliseconds TimerWheel::remaining(const std::size_t id, const Clock::time_point& now) const
+{
+    if (!armed(id))
+    {
+        return std::chrono::milliseconds(0);
+    }
+    std::uint64_t tick = toTick(now);
+    return std::chrono::milliseconds(mNodes[id].expiry > tick ? mNodes[id].expiry - tick : 0);
+}
+
+void TimerWheel::advance(const Clock::time_point& now, std::vector<std::size_t>& expired)
+{
+    std::uint64_t target = toTick(now);
+    while (mCurrent < target)
+    {
+        // nothing expires or cascades on the ticks in between
+        std::uint64_t next = mArmed == 0 ? target : nextEvent();
+        if (next > target)
+        {
+            mCurrent = target;
+            break;
+        }
+        mCurrent = next;
+        // entering a new block of a lower level pulls the matching slot of the level above down
+        for (unsigned int level = 1; level < LEVELS; ++level)
+        {
+            if ((mCurrent & ((std::uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0)
+            {
+                break;
+            }
+            cascade(level);
+        }
+
+        std::size_t& head = mSlots[0][mCurrent & (SLOTS - 1)];
+        while (head != NIL)
+        {
+            std::size_t id = head;
+            unlink(id);
+            mNodes[id].armed = false;
+            --mArmed;
+            expired.push_back(id);
+        }
+    }
+}
+
+std::uint64_t TimerWheel::toTick(const Clock::time_point& t) const
+{
+    if (t <= mEpoch)
+    {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(t - mEpoch).count());
+}
+
+std::uint64_t TimerWheel::nextEvent() const
+{
+    std::uint64_t next = static_cast<std::uint64_t>(-1);
+    for (unsigned int level = 0; level < LEVELS; ++level)
+    {
+        std::uint64_t occupied = mOccupied[level];
+        if (occupied == 0)
+        {
+            continue;
+        }
+        // a slot is handled once the tick's index at its level reaches it with all the bits below zero
+        unsigned int shift = SLOT_BITS * level;
+        unsigned int slot = (mCurrent >> shift) & (SLOTS - 1);
+        std::uint64_t block = (mCurrent >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+        std::uint64_t later = slot + 1 < SLOTS ? occupied & (~std::uint64_t(0) << (slot + 1)) : 0;
+        std::uint64_t tick = later != 0
+            ? block + (std::uint64_t(__builtin_ctzll(later)) << shift)
+            // only slots at or before the current one: they come round in the next block
+            : block + (std::uint64_t(1) << (shift + SLOT_BITS)) + (std::uint64_t(__builtin_ctzll(occupied)) << shift);
+        next = tick < next ? tick : next;
+    }
+    return next;
+}
+
+void TimerWheel::insert(const std::size_t id)
+{
+    Node& node = mNodes[id];
+    std::uint64_t delta = node.expiry - mCurrent;
+    // timers beyond the wheel's range park in the top level and are re-cascaded until due
+    std::uint64_t expiry = node.expiry;
+    std::uint64_t range = std::uint64_t(1) << (SLOT_BITS * LEVELS);
+    if (delta >= range)
+    {
+        expiry = mCurrent + range - 1;
+        delta = range - 1;
+    }
+
+    unsigned int level = 0;
+    while (level + 1 < LEVELS && delta >= (std::uint64_t(1) << (SLOT_BITS * (level + 1))))
+    {
+        ++level;
+    }
+    node.level = static_cast<std::uint8_t>(level);
+    node.slot = static_cast<std::uint8_t>((expiry >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    std::size_t& head = mSlots[level][node.slot];
+    node.prev = NIL;
+    node.next = head;
+    if (head != NIL)
+    {
+        mNodes[head].prev = id;
+    }
+    head = id;
+    mOccupied[level] |= std::uint64_t(1) << node.slot;
+}
+
+void TimerWheel::unlink(const std::size_t id)
+{
+    Node& node = mNodes[id];
+    if (node.prev != NIL)
+    {
+        mNodes[node.prev].next = node.next;
+    }
+    else
+    {
+        mSlots[node.level][node.slot] = node.next;
+        if (node.next == NIL)
+        {
+            mOccupied[node.level] &= ~(std::uint64_t(1) << node.slot);
+        }
+    }
+    if (node.next != NIL)
+    {
+        mNodes[node.next].prev = node.prev;
+    }
+    node.prev = node.next = NIL;
+}
+
+void TimerWheel::cascade(const unsigned int level)
+{
+    unsigned int slot = (mCurrent >> (SLOT_BITS * level)) & (SLOTS - 1);
+    std::size_t id = mSlots[level][slot];
+    mSlots[level][slot] = NIL;
+    mOccupied[level] &= ~(std::uint64_t(1) << slot);
+    while (id != NIL)
+    {
+        std::size_t next = mNodes[id].next;
+        insert(id);
+        id = next;
+    }
+}
+
+} // namespace logic
+} // namespace bennu
@@ -0,0 +1,87 @@
+#ifndef BENNU_FIELDDEVICE_LOGIC_TIMERWHEEL_HPP
+#define BENNU_FIELDDEVICE_LOGIC_TIMERWHEEL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace bennu {
+namespace logic {
+
+/*
+ * Hierarchical timer wheel (4 levels of 64 slots, 1ms ticks, ~4.6 hours
+ * before a timer has to be re-cascaded) for logic delays. Timers are keyed
+ * by a small integer id (the compiled logic line), so arm/cancel are O(1)
+ * list operations. Each level keeps a bitmap of its non-empty slots, so
+ * advance() jumps straight to the next tick with a slot to expire or
+ * cascade instead of stepping through every millisecond in between. Time
+ * comes from steady_clock, so delays do not depend on how regular the scan is.
+ */
+class TimerWheel
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit TimerWheel(const std::size_t ids = 0);
+
+    // Make room for ids [0, ids)
+    void resize(const std::size_t ids);
+
+    // (Re)start timer 'id' to expire 'delay' from 'now'
+    void arm(const std::size_t id, const Clock::duration& delay, const Clock::time_point& now);
+
+    void cancel(const std::size_t id);
+
+    bool armed(const std::size_t id) const
+    {
+        return id < mNodes.size() && mNodes[id].armed;
+    }
+
+    // Time left on an armed timer (zero if not armed or already due)
+    std::chrono::milliseconds remaining(const std::size_t id, const Clock::time_point& now) const;
+
+    // Move time forward to 'now' and append the ids of timers that expired.
+    // Costs O(expired timers + cascades), however long it has been since the last call.
+    void advance(const Clock::time_point& now, std::vector<std::size_t>& expired);
+
+    std::size_t size() const
+    {
+        return mArmed;
+    }
+
+private:
+    static constexpr unsigned int LEVELS = 4;
+    static constexpr unsigned int SLOT_BITS = 6;
+    static constexpr unsigned int SLOTS = 1u << SLOT_BITS;
+    static constexpr std::size_t NIL = static_cast<std::size_t>(-1);
+
+    struct Node
+    {
+        std::uint64_t expiry{0};    // tick
+        std::size_t prev{NIL};
+        std::size_t next{NIL};
+        std::uint8_t level{0};
+        std::uint8_t slot{0};
+        bool armed{false};
+    };
+
+    std::uint64_t toTick(const Clock::time_point& t) const;
+    // Earliest tick after mCurrent at which a slot expires or cascades (call with timers armed)
+    std::uint64_t nextEvent() const;
+    void insert(const std::size_t id);
+    void unlink(const std::size_t id);
+    void cascade(const unsigned int level);
+
+    Clock::time_point mEpoch;
+    std::uint64_t mCurrent;         // last tick processed
+    std::size_t mArmed;
+    std::vector<Node> mNodes;
+    std::array<std::array<std::size_t, SLOTS>, LEVELS> mSlots;    // list heads
+    std::array<std::uint64_t, LEVELS> mOccupied;                  // per level: bit N set if slot N is not empty
+};
+
+} // namespace logic
+} // namespace bennu
+
+#endif // BENNU_FIELDDEVICE_LOGIC_TIMERWHEEL_HPP
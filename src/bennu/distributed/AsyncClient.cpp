@@ -0,0 +1,240 @@
+#include "AsyncClient.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace bennu {
+namespace distributed {
+
+AsyncClient::AsyncClient(const Endpoint& endpoint, const std::chrono::milliseconds& timeout, const unsigned int retries) :
+    mEndpoint(endpoint),
+    mTimeout(timeout),
+    mMaxRetries(retries),
+    mSocket(zmq::socket_t(Context::the()->getContext(), ZMQ_DEALER)),
+    mWakeIn(zmq::socket_t(Context::the()->getContext(), ZMQ_PAIR)),
+    mWakeOut(zmq::socket_t(Context::the()->getContext(), ZMQ_PAIR)),
+    mNextId(1),
+    mRunning(true),
+    mPending(0),
+    mRetries(0),
+    mFailed(0)
+{
+    printf("I: Client connect (%s): Connecting to provider\n", mEndpoint.str.data());
+    try
+    {
+        mSocket.connect(mEndpoint.str);
+    }
+    catch (zmq::error_t& e)
+    {
+        printf("E: Client connect (%s): %s\n", mEndpoint.str.data(), e.what());
+        exit(1);
+    }
+    int linger = 0; // configure socket to not wait at close time
+    mSocket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+    std::string wake = "inproc://bennu-async-client-" + std::to_string(reinterpret_cast<std::uintptr_t>(this));
+    mWakeIn.bind(wake);
+    mWakeOut.connect(wake);
+
+    mThread.reset(new std::thread(std::bind(&AsyncClient::run, this)));
+}
+
+AsyncClient::~AsyncClient()
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mRunning = false;
+        mWakeOut.send("", 0);
+    }
+    if (mThread && mThread->joinable())
+    {
+        mThread->join();
+    }
+    mWakeOut.close();
+    mWakeIn.close();
+    mSocket.close();
+}
+
+std::uint64_t AsyncClient::send(const std::string& msg, Callback callback)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    Request request;
+    request.id = mNextId++;
+    request.msg = msg;
+    request.callback = callback;
+    request.retriesLeft = mMaxRetries;
+    mQueue.push_back(std::move(request));
+    mPending.fetch_add(1, std::memory_order_relaxed);
+    // only the first request queued since the i/o thread last looked needs to wake it
+    if (mQueue.size() == 1)
+    {
+        mWakeOut.send("", 0, ZMQ_DONTWAIT);
+    }
+    return mQueue.back().id;
+}
+
+void AsyncClient::run()
+{
+    std::vector<Request> queued;
+    while (true)
+    {
+        // sleep until a reply, a new request or the earliest retry deadline
+        long timeout = -1;
+        auto now = std::chrono::steady_clock::now();
+        for (auto& kv : mInFlight)
+        {
+            long left = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(kv.second.deadline - now).count());
+            left = left > 0 ? left : 0;
+            timeout = timeout < 0 || left < timeout ? left : timeout;
+        }
+
+        zmq::pollitem_t items[] = { { mSocket, 0, ZMQ_POLLIN, 0 }, { mWakeIn, 0, ZMQ_POLLIN, 0 } };
+        try
+        {
+            zmq::poll(&items[0], 2, timeout);
+        }
+        catch (zmq::error_t& e)
+        {
+            printf("E: Client poll (%s): %s\n", mEndpoint.str.data(), e.what());
+            break;
+        }
+
+        if (items[1].revents & ZMQ_POLLIN)
+        {
+            zmq::message_t wake;
+            while (mWakeIn.recv(&wake, ZMQ_DONTWAIT)) {}
+
+            {
+                std::scoped_lock<std::mutex> lock(mMutex);
+                if (!mRunning)
+                {
+                    break;
+                }
+                queued.assign(std::make_move_iterator(mQueue.begin()), std::make_move_iterator(mQueue.end()));
+                mQueue.clear();
+            }
+            for (auto& request : queued)
+            {
+                request.deadline = std::chrono::steady_clock::now() + mTimeout;
+                transmit(request);
+                mInFlight.emplace(request.id, std::move(request));
+            }
+            queued.clear();
+        }
+
+        if (items[0].revents & ZMQ_POLLIN)
+        {
+            receive();
+        }
+
+        // retry or give up on requests past their deadline
+        now = std::chrono::steady_clock::now();
+        for (auto iter = mInFlight.begin(); iter != mInFlight.end();)
+        {
+            auto& request = iter->second;
+            if (request.deadline > now)
+            {
+                ++iter;
+                continue;
+            }
+            if (request.retriesLeft > 0)
+            {
+                --request.retriesLeft;
+                mRetries.fetch_add(1, std::memory_order_relaxed);
+                printf("I: Client send: no response from server, retrying...\n");
+                request.deadline = now + mTimeout;
+                transmit(request);
+                ++iter;
+                continue;
+            }
+            printf("E: Client send: server seems to be offline, abandoning\n");
+            mFailed.fetch_add(1, std::memory_order_relaxed);
+            auto callback = request.callback;
+            iter = mInFlight.erase(iter);
+            mPending.fetch_sub(1, std::memory_order_relaxed);
+            if (callback)
+            {
+                callback(false, "timeout");
+            }
+        }
+    }
+}
+
+void AsyncClient::transmit(const Request& request)
+{
+    zmq::message_t id(&request.id, sizeof(request.id));
+    zmq::message_t empty;
+    zmq::message_t body(request.msg + '\0'); // must include null byte
+    try
+    {
+        mSocket.send(id, ZMQ_SNDMORE);
+        mSocket.send(empty, ZMQ_SNDMORE);
+        mSocket.send(body);
+    }
+    catch (zmq::error_t& e)
+    {
+        printf("E: Client send (%s): %s\n", mEndpoint.str.data(), e.what());
+    }
+}
+
+void AsyncClient::receive()
+{
+    zmq::message_t part;
+    while (mSocket.recv(&part, ZMQ_DONTWAIT))
+    {
+        // [request id][empty][reply]
+        std::vector<zmq::message_t> parts;
+        parts.push_back(std::move(part));
+        while (parts.back().more())
+        {
+            parts.emplace_back();
+            mSocket.recv(&parts.back());
+        }
+        if (parts.size() != 3 || parts[0].size() != sizeof(std::uint64_t))
+        {
+            printf("E: Client send: malformed reply from server\n");
+            continue;
+        }
+
+        std::uint64_t id;
+        std::memcpy(&id, parts[0].data(), sizeof(id));
+        std::string reply(parts[2].data<char>(), strnlen(parts[2].data<char>(), parts[2].size()));
+        auto pos = reply.find('=');
+        std::string status = reply.substr(0, pos);
+        std::string data = pos == std::string::npos ? "" : reply.substr(pos + 1);
+
+        if (status == "ACK" || status == "ack")
+        {
+            complete(id, true, data);
+        }
+        else if (status == "ERR" || status == "err")
+        {
+            printf("I: ERR -- %s\n", data.data());
+            complete(id, false, data);
+        }
+        else
+        {
+            printf("E: Client send: malformed reply from server -- %s\n", reply.data());
+            complete(id, false, reply);
+        }
+    }
+}
+
+void AsyncClient::complete(const std::uint64_t id, const bool ok, const std::string& reply)
+{
+    auto iter = mInFlight.find(id);
+    if (iter == mInFlight.end())
+    {
+        return; // reply to an attempt we already had an answer for
+    }
+    auto callback = iter->second.callback;
+    mInFlight.erase(iter);
+    mPending.fetch_sub(1, std::memory_order_relaxed);
+    if (callback)
+    {
+        callback(ok, reply);
+    }
+}
+
+} // namespace distributed
+} // namespace bennu
@@ -0,0 +1,103 @@
+#ifndef BENNU_DISTRIBUTED_ASYNCCLIENT_HPP
+#define BENNU_DISTRIBUTED_ASYNCCLIENT_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional> // std::function
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "zmq/zmq.hpp"
+
+#include "bennu/distributed/Utils.hpp"
+
+namespace bennu {
+namespace distributed {
+
+/*
+ * Non-blocking request client. send() queues the request and returns; an
+ * i/o thread sends it on a DEALER socket as [request id][empty][body], so
+ * the id comes back in the reply envelope from REP and ROUTER servers alike
+ * and replies are matched to requests however they are ordered. A request
+ * without a reply within the timeout is re-sent (same id, so a late reply
+ * to an earlier attempt still completes it) until it runs out of retries.
+ */
+class AsyncClient
+{
+public:
+    // ok is false for ERR replies and abandoned requests; reply is the text after "ACK="/"ERR="
+    typedef std::function<void (const bool ok, const std::string& reply)> Callback;
+
+    AsyncClient(const Endpoint& endpoint,
+                const std::chrono::milliseconds& timeout = std::chrono::milliseconds(1000),
+                const unsigned int retries = 3);
+
+    ~AsyncClient();
+
+    // Queue a request; the callback runs on the i/o thread. Returns the request id.
+    std::uint64_t send(const std::string& msg, Callback callback = nullptr);
+
+    // Requests queued or waiting for a reply
+    std::size_t getPending() const
+    {
+        return mPending.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getRetries() const
+    {
+        return mRetries.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getFailed() const
+    {
+        return mFailed.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Request
+    {
+        std::uint64_t id;
+        std::string msg;
+        Callback callback;
+        std::chrono::steady_clock::time_point deadline;
+        unsigned int retriesLeft;
+    };
+
+    void run();
+    void transmit(const Request& request);
+    void receive();
+    void complete(const std::uint64_t id, const bool ok, const std::string& reply);
+
+    Endpoint mEndpoint;
+    std::chrono::milliseconds mTimeout;
+    unsigned int mMaxRetries;
+
+    zmq::socket_t mSocket;                  // DEALER, i/o thread only
+    zmq::socket_t mWakeIn;                  // PAIR, i/o thread only
+    zmq::socket_t mWakeOut;                 // PAIR, under mMutex
+
+    std::mutex mMutex;                      // guards mQueue, mNextId, mWakeOut, mRunning
+    std::deque<Request> mQueue;             // not yet sent
+    std::uint64_t mNextId;
+    bool mRunning;
+
+    std::map<std::uint64_t, Request> mInFlight; // i/o thread only
+    std::atomic<std::size_t> mPending;
+    std::atomic<std::uint64_t> mRetries;
+    std::atomic<std::uint64_t> mFailed;
+    std::unique_ptr<std::thread> mThread;
+
+    AsyncClient(const AsyncClient&);
+    AsyncClient& operator =(const AsyncClient&);
+
+};
+
+} // namespace distributed
+} // namespace bennu
+
+#endif // BENNU_DISTRIBUTED_ASYNCCLIENT_HPP
@@ -0,0 +1,164 @@
+#include "BulkRequest.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
+#include "bennu/distributed/PublishFrame.hpp"
+#include "bennu/distributed/Utils.hpp"
+
+namespace bennu {
+namespace distributed {
+
+BulkRequest::BulkRequest(const std::string& payload, const bool snapshot) :
+    mOffset(0),
+    mNext(0),
+    mBinary(false),
+    mSnapshot(snapshot)
+{
+    std::string_view text(payload);
+    std::size_t semicolon = text.find(';');
+    std::string_view list = text.substr(0, semicolon);
+    std::string_view options = semicolon == std::string_view::npos ? std::string_view() : text.substr(semicolon + 1);
+
+    while (!list.empty())
+    {
+        std::size_t comma = list.find(',');
+        std::string_view tag = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        if (tag.empty())
+        {
+            continue;
+        }
+        if (isGlob(tag))
+        {
+            mPatterns.emplace_back(tag);
+        }
+        else
+        {
+            mTags.emplace_back(tag);
+        }
+    }
+
+    while (!options.empty())
+    {
+        std::size_t end = options.find(';');
+        std::string option(options.substr(0, end));
+        options = end == std::string_view::npos ? std::string_view() : options.substr(end + 1);
+        if (option == "binary")
+        {
+            mBinary = true;
+        }
+        else if (!option.empty())
+        {
+            mOffset = std::strtoul(option.data(), nullptr, 10);
+        }
+    }
+
+    // a SNAPSHOT of named tags is a filter like any pattern
+    if (mSnapshot)
+    {
+        mPatterns.insert(mPatterns.end(), mTags.begin(), mTags.end());
+        mTags.clear();
+    }
+}
+
+bool BulkRequest::select(const std::vector<std::string>& names)
+{
+    for (const auto& name : names)
+    {
+        bool match = mSnapshot && mPatterns.empty();
+        for (std::size_t i = 0; !match && i < mPatterns.size(); ++i)
+        {
+            match = globMatch(mPatterns[i], name);
+        }
+        if (match)
+        {
+            mTags.push_back(name);
+        }
+    }
+    std::sort(mTags.begin(), mTags.end());
+    mTags.erase(std::unique(mTags.begin(), mTags.end()), mTags.end());
+    if (mTags.empty())
+    {
+        return false;
+    }
+
+    if (!mBinary)
+    {
+        std::size_t begin = std::min(mOffset, mTags.size());
+        std::size_t end = std::min(begin + PAGE_SIZE, mTags.size());
+        mNext = end < mTags.size() ? end : 0;
+        mTags.erase(mTags.begin() + end, mTags.end());
+        mTags.erase(mTags.begin(), mTags.begin() + begin);
+    }
+    return true;
+}
+
+zmq::message_t BulkRequest::reply(const std::string& result) const
+{
+    if (!mBinary || result.compare(0, 4, "ACK=") != 0)
+    {
+        std::string text = result;
+        if (mNext && text.compare(0, 4, "ACK=") == 0)
+        {
+            text += ";" + std::to_string(mNext);
+        }
+        return zmq::message_t(text + '\0'); // must include null byte
+    }
+
+    // names first, then values, with IDs numbering the points of this reply
+    std::vector<std::string> names;
+    std::vector<PointValue> points;
+    std::string_view text(result);
+    text.remove_prefix(4);
+    while (!text.empty())
+    {
+        std::size_t comma = text.find(',');
+        std::string_view point = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+
+        std::size_t colon = point.rfind(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
+        }
+        std::uint32_t id = static_cast<std::uint32_t>(names.size());
+        std::string value(point.substr(colon + 1));
+        if (value == "true" || value == "false")
+        {
+            points.emplace_back(id, value == "true");
+        }
+        else
+        {
+            char* parsed = nullptr;
+            double val = std::strtod(value.data(), &parsed);
+            if (parsed == value.data())
+            {
+                continue;
+            }
+            points.emplace_back(id, val);
+        }
+        names.emplace_back(point.substr(0, colon));
+    }
+
+    std::string frames;
+    auto sink = [&frames](const char* data, const std::size_t size) { frames.append(data, size); };
+    FrameWriter dictionary(frame::eDictionary, 0, FRAME_SIZE, sink);
+    dictionary.begin(0);
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        dictionary.add(static_cast<std::uint32_t>(i), names[i]);
+    }
+    FrameWriter data(frame::eData, 0, FRAME_SIZE, sink);
+    data.begin(dictionary.finish());
+    for (const auto& point : points)
+    {
+        data.add(point);
+    }
+    data.finish();
+    return zmq::message_t(frames.data(), frames.size());
+}
+
+} // namespace distributed
+} // namespace bennu
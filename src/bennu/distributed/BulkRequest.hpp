@@ -0,0 +1,70 @@
+#ifndef BENNU_DISTRIBUTED_BULKREQUEST_HPP
+#define BENNU_DISTRIBUTED_BULKREQUEST_HPP
+
+#include <string>
+#include <vector>
+
+#include "zmq/zmq.hpp"
+
+namespace bennu {
+namespace distributed {
+
+/*
+ * Payload of a many-tag "READ=" or a "SNAPSHOT=" request:
+ *
+ *   READ=<tag|pattern>[,<tag|pattern>...][;binary][;<offset>]
+ *   SNAPSHOT=[<pattern>[,<pattern>...]][;binary][;<offset>]
+ *
+ * Patterns may use '*' and '?'. SNAPSHOT without patterns selects every
+ * tag. Text replies are "ACK=<tag>:<value>,<tag>:<value>,..." holding at
+ * most PAGE_SIZE tags that matched patterns (in name order); when more remain
+ * the reply ends in ";<offset>" and the client repeats the request with that
+ * offset. Binary replies carry everything in one message as a sequence of
+ * frames of at most FRAME_SIZE bytes (see PublishFrame.hpp).
+ */
+class BulkRequest
+{
+public:
+    static const std::size_t PAGE_SIZE = 1000;
+    static const std::size_t FRAME_SIZE = 65536;
+
+    BulkRequest(const std::string& payload, const bool snapshot);
+
+    // A plain "READ=<tag>", to be answered the way it always was
+    bool isSingle() const
+    {
+        return !mSnapshot && !mBinary && !mOffset && mTags.size() == 1 && mPatterns.empty();
+    }
+
+    // True if select() must be given every tag before getTags() is final
+    bool hasPatterns() const
+    {
+        return mSnapshot || !mPatterns.empty();
+    }
+
+    // Add the tags matching the patterns (from "QUERY" order, any order) and
+    // cut out the requested page; false if nothing matched
+    bool select(const std::vector<std::string>& names);
+
+    // The tags to read
+    const std::vector<std::string>& getTags() const
+    {
+        return mTags;
+    }
+
+    // Final reply for "ACK=<tag>:<value>,..." (or "ERR=...") result text
+    zmq::message_t reply(const std::string& result) const;
+
+private:
+    std::vector<std::string> mTags;
+    std::vector<std::string> mPatterns;
+    std::size_t mOffset;
+    std::size_t mNext;          // offset of the next page (0 = last page)
+    bool mBinary;
+    bool mSnapshot;
+};
+
+} // namespace distributed
+} // namespace bennu
+
+#endif // BENNU_DISTRIBUTED_BULKREQUEST_HPP
@@ -4,6 +4,7 @@
 #include <functional>
 #include <thread>
 
+#include "bennu/distributed/PublishFrame.hpp"
 #include "bennu/distributed/Utils.hpp"
 
 namespace bennu {
@@ -59,7 +60,6 @@ void Client::send(const std::string& msg)
     {
         zmq::message_t message(msg+'\0'); // must include null byte
         mSocket.send(message);
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
         bool expectReply = true;
         while (expectReply)
         {
@@ -71,6 +71,18 @@ void Client::send(const std::string& msg)
             {
                 zmq::message_t repMsg;
                 mSocket.recv(&repMsg);
+                if (frame::isBinary(repMsg.data<char>(), repMsg.size()) || repMsg.size() == 0)
+                {
+                    // only binary requests are answered with frames (or nothing, if no point had a value)
+                    printf("I: ACK\n");
+                    if (mFrameHandler)
+                    {
+                        mFrameHandler(repMsg.data<char>(), repMsg.size());
+                    }
+                    expectReply = false;
+                    retriesLeft = 0;
+                    break;
+                }
                 std::string reply(repMsg.data<char>());
                 std::string delim{"="}, status, data;
                 try
@@ -1,6 +1,8 @@
 #ifndef BENNU_DISTRIBUTED_CLIENT_HPP
 #define BENNU_DISTRIBUTED_CLIENT_HPP
 
+#include <cstddef>
+#include <functional>
 #include <string>
 
 #include "zmq/zmq.hpp"
@@ -15,6 +17,9 @@ class Client
 public:
     typedef std::function<void (const std::string& reply)> ReplyHandler;
 
+    // Binary replies (frames, see PublishFrame.hpp) to "READ=...;binary" and "SNAPSHOT=...;binary"
+    typedef std::function<void (const char* data, const std::size_t size)> FrameHandler;
+
     Client(const Endpoint& endpoint);
 
     ~Client();
@@ -26,6 +31,11 @@ public:
         mHandler = handler;
     }
 
+    void setFrameHandler(FrameHandler handler)
+    {
+        mFrameHandler = handler;
+    }
+
     void defaultHandler(const std::string& reply);
 
     void writePoint(const std::string& tag, const double value)
@@ -46,6 +56,7 @@ private:
 
     zmq::socket_t mSocket;
     ReplyHandler mHandler;
+    FrameHandler mFrameHandler;
     Endpoint mEndpoint;
 
 };
@@ -1,18 +1,27 @@
 #include "Provider.hpp"
 
+#include <cmath>
+#include <cstdlib>
 #include <functional>
+#include <string_view>
 
+#include "bennu/distributed/BulkRequest.hpp"
 #include "bennu/distributed/Utils.hpp"
 
 namespace bennu {
 namespace distributed {
 
-Provider::Provider(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint)
+Provider::Provider(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint, const unsigned int workers) :
+    mFormat(eText),
+    mDelta(false),
+    mKeyframeInterval(10),
+    mSinceKeyframe(0),
+    mKeyframeVersion(0)
 {
     mPublisher.reset(new Publisher(publishEndpoint));
-    mServer.reset(new Server(serverEndpoint));
+    mServer.reset(new Server(serverEndpoint, workers));
     mServer->setHandler(std::bind(&Provider::messageHandler, this, std::placeholders::_1));
-    printf("Server running on %s\n", serverEndpoint.str.data());
+    printf("Server running on %s (%u workers)\n", serverEndpoint.str.data(), mServer->getWorkers());
     printf("Publisher running on %s\n", publishEndpoint.str.data());
     fflush(stdout);
 }
@@ -23,10 +32,152 @@ void Provider::run()
     mServer->run();
 }
 
+void Provider::publish(std::string& msg)
+{
+    if (mFormat == eText)
+    {
+        mPublisher->publish(msg);
+        return;
+    }
+
+    // Convert once here instead of having every subscriber parse the text
+    mPoints.clear();
+    std::string_view text(msg);
+    while (!text.empty())
+    {
+        std::size_t end = text.find(',');
+        std::string_view point = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+
+        std::size_t colon = point.find(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
+        }
+        std::string name(point.substr(0, colon));
+        std::string value(point.substr(colon + 1));
+        if (value == "true" || value == "false")
+        {
+            mPoints.emplace_back(pointId(name), value == "true");
+        }
+        else
+        {
+            char* parsed = nullptr;
+            double val = std::strtod(value.data(), &parsed);
+            if (parsed != value.data())
+            {
+                mPoints.emplace_back(pointId(name), val);
+            }
+        }
+    }
+    publish(mPoints);
+}
+
+std::uint32_t Provider::pointId(const std::string& name)
+{
+    std::uint32_t id = mDictionary.add(name);
+    if (id >= mPointDeadbands.size())
+    {
+        std::size_t dot = name.rfind('.');
+        auto iter = mDeadbands.find(dot == std::string::npos ? "" : name.substr(dot + 1));
+        if (iter == mDeadbands.end())
+        {
+            iter = mDeadbands.find("");
+        }
+        mPointDeadbands.resize(id + 1, 0.0);
+        mPointDeadbands[id] = iter != mDeadbands.end() ? iter->second : 0.0;
+    }
+    return id;
+}
+
+void Provider::publish(const std::vector<PointValue>& points)
+{
+    if (!mDelta)
+    {
+        mPublisher->publish(mDictionary, points);
+        return;
+    }
+
+    // new points always go out in a keyframe, so subscribers never need a delta against a value they never had
+    std::uint32_t version = mDictionary.getVersion();
+    bool keyframe = mSinceKeyframe == 0 || version != mKeyframeVersion;
+    mChanged.clear();
+    for (const auto& point : points)
+    {
+        if (point.id >= mPublished.size())
+        {
+            mPublished.resize(point.id + 1, 0.0);
+            mHasPublished.resize(point.id + 1, 0);
+        }
+        double deadband = !point.binary && point.id < mPointDeadbands.size() ? mPointDeadbands[point.id] : 0.0;
+        bool changed = !mHasPublished[point.id]
+            || (deadband > 0.0 ? std::fabs(point.value - mPublished[point.id]) > deadband : point.value != mPublished[point.id]);
+        if (keyframe || changed)
+        {
+            mPublished[point.id] = point.value;
+            mHasPublished[point.id] = 1;
+            mChanged.push_back(point);
+        }
+    }
+
+    if (keyframe)
+    {
+        mPublisher->publish(mDictionary, mChanged, frame::eData);
+        mKeyframeVersion = version;
+        mSinceKeyframe = 0;
+    }
+    else if (!mChanged.empty())
+    {
+        mPublisher->publish(mDictionary, mChanged, frame::eDelta);
+    }
+    if (++mSinceKeyframe >= mKeyframeInterval)
+    {
+        mSinceKeyframe = 0;
+    }
+}
+
+std::string Provider::readTags(const std::vector<std::string>& tags)
+{
+    std::string result = "ACK=";
+    bool found = false;
+    for (const auto& tag : tags)
+    {
+        std::string value = read(tag);
+        if (value.compare(0, 4, "ACK=") == 0)
+        {
+            result.append(tag).append(":").append(value, 4, std::string::npos).append(",");
+            found = true;
+        }
+    }
+    return found ? result : "ERR=Tags not found";
+}
+
+zmq::message_t Provider::bulkRead(const std::string& payload, const bool snapshot)
+{
+    BulkRequest request(payload, snapshot);
+    if (request.hasPatterns())
+    {
+        std::string tags = query();
+        if (tags.compare(0, 4, "ACK=") != 0)
+        {
+            return request.reply(tags);
+        }
+        std::string list = tags.substr(4), delim{","};
+        if (!request.select(distributed::split(list, delim)))
+        {
+            return request.reply("ERR=No tags match '" + payload + "'");
+        }
+    }
+    return request.reply(readTags(request.getTags()));
+}
+
 // message requests should be in the form:
 // "QUERY="
+// "QUERY=dictionary" (point IDs used by binary frames: "ACK=<version>;<id>:<name>,...")
 // "READ=<tag name>"
+// "READ=<tag name|pattern>,...[;binary][;<offset>]" and "SNAPSHOT=[<pattern>,...][;binary][;<offset>]" (BulkRequest.hpp)
 // "WRITE=<tag name>:<value>[,<tag name>:<value>...]"
+// "STATS=" (request server statistics: "ACK=workers:<n>,requests:<n>,...", see Server::report)
 zmq::message_t Provider::messageHandler(const zmq::message_t& request)
 {
     std::string req(request.data<char>());
@@ -37,21 +188,41 @@ zmq::message_t Provider::messageHandler(const zmq::message_t& request)
         auto split = distributed::split(req, opDelim);
         op = split[0];
         payload = split[1];
-        printf("Received %s request for payload %s\n", op.data(), payload.data());
     }
     catch (std::exception& e)
     {
         printf("Err: %s", e.what());
     }
 
-    if (op == "QUERY" || op == "query")
+    if ((op == "QUERY" || op == "query") && payload == "dictionary")
+    {
+        reply += "ACK=" + mDictionary.toString();
+    }
+    else if (op == "QUERY" || op == "query")
     {
         reply += query();
     }
     else if (op == "READ" || op == "read")
     {
+        if (!BulkRequest(payload, false).isSingle())
+        {
+            return bulkRead(payload, false);
+        }
         reply += read(payload);
     }
+    else if (op == "SNAPSHOT" || op == "snapshot")
+    {
+        return bulkRead(payload, true);
+    }
+    else if (op == "STATS" || op == "stats")
+    {
+        reply += "ACK=" + mServer->report();
+    }
+    else if (op == "NACK" || op == "nack")
+    {
+        // a subscriber lost fragments of a publish (see PublishFrame.hpp)
+        reply += mPublisher->repair(payload);
+    }
     else if (op == "WRITE" || op == "write")
     {
         std::unordered_map<std::string,std::string> tags;
@@ -86,7 +257,6 @@ zmq::message_t Provider::messageHandler(const zmq::message_t& request)
     {
         reply += "ERR=Unknown command type '" + op + "'";
     }
-    printf("Sending reply for payload %s -- %s\n", payload.data(), reply.data());
     zmq::message_t repMsg(reply+'\0'); // must include null byte
     return repMsg;
 }
@@ -1,12 +1,15 @@
 #ifndef BENNU_DISTRIBUTED_PROVIDER_HPP
 #define BENNU_DISTRIBUTED_PROVIDER_HPP
 
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "zmq/zmq.hpp"
 
+#include "bennu/distributed/PublishFrame.hpp"
 #include "bennu/distributed/Publisher.hpp"
 #include "bennu/distributed/Server.hpp"
 #include "bennu/distributed/Utils.hpp"
@@ -17,17 +20,74 @@ namespace distributed {
 class Provider
 {
 public:
-    Provider(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint);
+    // Wire format of published updates
+    enum Format
+    {
+        eText,      // "name:value,name:value,..."
+        eBinary     // PublishFrame.hpp
+    };
+
+    // With workers > 1 requests are served concurrently, so query/read/write
+    // must be safe to call from several threads at once
+    Provider(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint, const unsigned int workers = 1);
 
     virtual ~Provider() = default;
 
     void run();
 
-    void publish(std::string& msg)
+    void setFormat(const Format format)
     {
-        mPublisher->publish(msg);
+        mFormat = format;
     }
 
+    // Publish each point on its partition's group (see Publisher.hpp)
+    void setPartitioned(const bool partitioned)
+    {
+        mPublisher->setPartitioned(partitioned);
+    }
+
+    // Largest publish datagram; bigger publishes are split (see Publisher.hpp)
+    void setMTU(const std::size_t mtu)
+    {
+        mPublisher->setMTU(mtu);
+    }
+
+    // Send publishes bigger than the MTU as fragments of one frame
+    void setFragmented(const bool fragmented)
+    {
+        mPublisher->setFragmented(fragmented);
+    }
+
+    // Keep the last 'frames' fragmented frames so subscribers can NACK lost fragments (0 = off)
+    void setRepairHistory(const std::size_t frames)
+    {
+        mPublisher->setRepairHistory(frames);
+    }
+
+    // Publish "name:value,..." text; converted to binary frames if the format is eBinary
+    void publish(std::string& msg);
+
+    // Binary only: publish just the points that changed, with a full keyframe every 'keyframeInterval' publishes
+    void setDelta(const bool delta, const unsigned int keyframeInterval = 10)
+    {
+        mDelta = delta;
+        mKeyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+        mSinceKeyframe = 0;
+    }
+
+    // Analog points whose name ends in ".<type>" ("" for all others) only count as changed
+    // once they move more than 'deadband' from the value last published. Set before publishing.
+    void setDeadband(const std::string& type, const double deadband)
+    {
+        mDeadbands[type] = deadband;
+    }
+
+    // ID to publish 'name' under in binary frames
+    std::uint32_t pointId(const std::string& name);
+
+    // Publish values by point ID (binary frames, whatever the format)
+    void publish(const std::vector<PointValue>& points);
+
     void publish(zmq::message_t& msg)
     {
         mPublisher->publish(msg);
@@ -39,6 +99,9 @@ protected:
     virtual std::string query() = 0;
     // Must return "ACK=<value>" or "ERR=<error message>"
     virtual std::string read(const std::string& tag) = 0;
+    // Must return "ACK=<tag>:<value>,<tag>:<value>,..." or "ERR=<error message>", leaving out
+    // tags that cannot be read. Calls read() for each tag unless overridden (e.g. to lock once).
+    virtual std::string readTags(const std::vector<std::string>& tags);
     // Must return "ACK=<success message>" or "ERR=<error message>"
     virtual std::string write(const std::unordered_map<std::string,std::string>& tags) = 0;
     /* Method to periodically publish data. Inheriting providers must implement */
@@ -46,10 +109,25 @@ protected:
 
 private:
     zmq::message_t messageHandler(const zmq::message_t& request);
+    zmq::message_t bulkRead(const std::string& payload, const bool snapshot);
 
     std::shared_ptr<Server> mServer;
     std::shared_ptr<Publisher> mPublisher;
     std::shared_ptr<std::thread> mPublishThread;
+    Format mFormat;
+    PointDictionary mDictionary;
+    std::vector<PointValue> mPoints;   // reused by the text to binary conversion
+
+    // Delta publishing
+    bool mDelta;
+    unsigned int mKeyframeInterval;
+    unsigned int mSinceKeyframe;                   // publishes since the last keyframe (0 = next is one)
+    std::uint32_t mKeyframeVersion;                 // dictionary version of the last keyframe
+    std::map<std::string, double> mDeadbands;       // point type ==> deadband
+    std::vector<double> mPointDeadbands;            // point ID ==> deadband
+    std::vector<double> mPublished;                 // point ID ==> value last published
+    std::vector<char> mHasPublished;
+    std::vector<PointValue> mChanged;
 
 };
 
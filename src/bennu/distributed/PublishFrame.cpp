@@ -0,0 +1,292 @@
+#include "PublishFrame.hpp"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+namespace bennu {
+namespace distributed {
+
+namespace {
+
+template <typename T>
+void put(char* out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+    {
+        out[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+}
+
+template <typename T>
+T get(const char* in)
+{
+    T value = 0;
+    for (std::size_t i = sizeof(T); i > 0; --i)
+    {
+        value = static_cast<T>((value << 8) | static_cast<std::uint8_t>(in[i - 1]));
+    }
+    return value;
+}
+
+void putDouble(char* out, const double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put<std::uint64_t>(out, bits);
+}
+
+double getDouble(const char* in)
+{
+    std::uint64_t bits = get<std::uint64_t>(in);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+namespace frame {
+
+bool readFragment(const char* data, const std::size_t size, Fragment& fragment)
+{
+    if (!isFragment(data, size))
+    {
+        return false;
+    }
+    fragment.id = get<std::uint32_t>(data + 4);
+    fragment.index = get<std::uint16_t>(data + 8);
+    fragment.count = get<std::uint16_t>(data + 10);
+    fragment.total = get<std::uint32_t>(data + 12);
+    fragment.offset = get<std::uint32_t>(data + 16);
+    fragment.length = get<std::uint32_t>(data + 20);
+    fragment.data = data + FRAGMENT_HEADER_SIZE;
+    return fragment.count > 0 && fragment.index < fragment.count
+        && fragment.total <= MAX_FRAME_SIZE
+        && fragment.length == size - FRAGMENT_HEADER_SIZE
+        && fragment.offset <= fragment.total && fragment.length <= fragment.total - fragment.offset;
+}
+
+void writeFragmentHeader(char* out, const Fragment& fragment)
+{
+    out[0] = static_cast<char>(MAGIC);
+    out[1] = static_cast<char>(FRAGMENT_TAG);
+    out[2] = static_cast<char>(VERSION);
+    out[3] = 0;
+    put<std::uint32_t>(out + 4, fragment.id);
+    put<std::uint16_t>(out + 8, fragment.index);
+    put<std::uint16_t>(out + 10, fragment.count);
+    put<std::uint32_t>(out + 12, fragment.total);
+    put<std::uint32_t>(out + 16, fragment.offset);
+    put<std::uint32_t>(out + 20, fragment.length);
+}
+
+} // namespace frame
+
+PointDictionary::PointDictionary() :
+    // start from the clock so a restarted provider never reuses the version of its previous run
+    mVersion(static_cast<std::uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()))
+{
+}
+
+std::uint32_t PointDictionary::add(const std::string& name)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    auto iter = mIds.find(name);
+    if (iter != mIds.end())
+    {
+        return iter->second;
+    }
+    std::uint32_t id = static_cast<std::uint32_t>(mNames.size());
+    mNames.push_back(name);
+    mIds.emplace(name, id);
+    ++mVersion;
+    return id;
+}
+
+std::uint32_t PointDictionary::getVersion() const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    return mVersion;
+}
+
+std::size_t PointDictionary::size() const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    return mNames.size();
+}
+
+std::uint32_t PointDictionary::getNames(std::vector<std::string>& names) const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    names = mNames;
+    return mVersion;
+}
+
+std::string PointDictionary::toString() const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    std::string result = std::to_string(mVersion) + ";";
+    for (std::size_t i = 0; i < mNames.size(); ++i)
+    {
+        result += std::to_string(i) + ":" + mNames[i] + ",";
+    }
+    return result;
+}
+
+FrameWriter::FrameWriter(const frame::Type type, const std::uint32_t dictionary, const std::size_t mtu, Sink sink) :
+    mType(type),
+    mDictionary(dictionary),
+    mMTU(mtu > frame::HEADER_SIZE + 64 ? mtu : frame::HEADER_SIZE + 64),
+    mSink(sink),
+    mSequence(0),
+    mTimestamp(0),
+    mCount(0)
+{
+    // frames meant for fragmenting may be far larger than they usually get
+    mBuffer.reserve(std::min<std::size_t>(mMTU, 65536));
+}
+
+void FrameWriter::begin(const std::uint64_t sequence)
+{
+    mSequence = sequence;
+    mTimestamp = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    mBuffer.assign(frame::HEADER_SIZE, '\0');
+    mCount = 0;
+}
+
+void FrameWriter::add(const PointValue& point)
+{
+    std::size_t size = point.binary ? 5 : 12;
+    reserve(size);
+    std::size_t offset = mBuffer.size();
+    mBuffer.resize(offset + size);
+    char* out = &mBuffer[offset];
+    put<std::uint32_t>(out, point.binary ? (point.id | frame::BINARY_FLAG) : point.id);
+    if (point.binary)
+    {
+        out[4] = point.value != 0.0 ? 1 : 0;
+    }
+    else
+    {
+        putDouble(out + 4, point.value);
+    }
+    ++mCount;
+}
+
+void FrameWriter::add(const std::uint32_t id, const std::string& name)
+{
+    // names longer than a frame can hold are cut (point names are nowhere near that long)
+    std::size_t length = std::min<std::size_t>(name.size(), mMTU - frame::HEADER_SIZE - 6);
+    reserve(6 + length);
+    std::size_t offset = mBuffer.size();
+    mBuffer.resize(offset + 6 + length);
+    char* out = &mBuffer[offset];
+    put<std::uint32_t>(out, id);
+    put<std::uint16_t>(out + 4, static_cast<std::uint16_t>(length));
+    std::memcpy(out + 6, name.data(), length);
+    ++mCount;
+}
+
+std::uint64_t FrameWriter::finish()
+{
+    if (mCount > 0)
+    {
+        flush();
+    }
+    return mSequence;
+}
+
+void FrameWriter::reserve(const std::size_t bytes)
+{
+    if (mBuffer.size() + bytes > mMTU && mCount > 0)
+    {
+        flush();
+        mBuffer.assign(frame::HEADER_SIZE, '\0');
+        mCount = 0;
+    }
+}
+
+void FrameWriter::flush()
+{
+    char* out = &mBuffer[0];
+    out[0] = static_cast<char>(frame::MAGIC);
+    out[1] = static_cast<char>(frame::TAG);
+    out[2] = static_cast<char>(frame::VERSION);
+    out[3] = static_cast<char>(mType);
+    put<std::uint32_t>(out + 4, mDictionary);
+    put<std::uint64_t>(out + 8, mSequence);
+    put<std::uint64_t>(out + 16, mTimestamp);
+    put<std::uint32_t>(out + 24, mCount);
+    mSink(mBuffer.data(), mBuffer.size());
+    ++mSequence;
+}
+
+FrameReader::FrameReader(const char* data, const std::size_t size) :
+    mData(data),
+    mSize(size),
+    mOffset(frame::HEADER_SIZE),
+    mRemaining(0),
+    mHeader(),
+    mValid(frame::isBinary(data, size))
+{
+    if (mValid)
+    {
+        mHeader.type = static_cast<frame::Type>(static_cast<std::uint8_t>(data[3]));
+        mHeader.dictionary = get<std::uint32_t>(data + 4);
+        mHeader.sequence = get<std::uint64_t>(data + 8);
+        mHeader.timestamp = get<std::uint64_t>(data + 16);
+        mHeader.count = get<std::uint32_t>(data + 24);
+        mRemaining = mHeader.count;
+    }
+}
+
+bool FrameReader::next(PointValue& point)
+{
+    if (!mValid || mRemaining == 0 || (mHeader.type != frame::eData && mHeader.type != frame::eDelta) || mOffset + 5 > mSize)
+    {
+        return false;
+    }
+    std::uint32_t id = get<std::uint32_t>(mData + mOffset);
+    point.id = id & ~frame::BINARY_FLAG;
+    point.binary = (id & frame::BINARY_FLAG) != 0;
+    if (point.binary)
+    {
+        point.value = mData[mOffset + 4] != 0 ? 1.0 : 0.0;
+        mOffset += 5;
+    }
+    else
+    {
+        if (mOffset + 12 > mSize)
+        {
+            return false;
+        }
+        point.value = getDouble(mData + mOffset + 4);
+        mOffset += 12;
+    }
+    --mRemaining;
+    return true;
+}
+
+bool FrameReader::next(std::uint32_t& id, std::string_view& name)
+{
+    if (!mValid || mRemaining == 0 || mHeader.type != frame::eDictionary || mOffset + 6 > mSize)
+    {
+        return false;
+    }
+    id = get<std::uint32_t>(mData + mOffset);
+    std::size_t length = get<std::uint16_t>(mData + mOffset + 4);
+    if (mOffset + 6 + length > mSize)
+    {
+        return false;
+    }
+    name = std::string_view(mData + mOffset + 6, length);
+    mOffset += 6 + length;
+    --mRemaining;
+    return true;
+}
+
+} // namespace distributed
+} // namespace bennu
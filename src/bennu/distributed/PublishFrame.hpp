@@ -0,0 +1,253 @@
+#ifndef BENNU_DISTRIBUTED_PUBLISHFRAME_HPP
+#define BENNU_DISTRIBUTED_PUBLISHFRAME_HPP
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace bennu {
+namespace distributed {
+
+/*
+ * Binary publish frames (the alternative to "name:value,name:value," text).
+ *
+ * Every frame starts with a fixed header (all integers little endian):
+ *
+ *   0  u8   0x7f (never the first byte of a text frame)
+ *   1  u8   'B'
+ *   2  u8   format version (1)
+ *   3  u8   frame type (eData / eDelta / eDictionary)
+ *   4  u32  dictionary version the point IDs refer to
+ *   8  u64  sequence number (per publisher, shared by all frame types)
+ *   16 u64  timestamp (ns since the UNIX epoch)
+ *   24 u32  number of entries
+ *
+ * followed by the entries:
+ *
+ *   eData/eDelta: u32 id (top bit set for binary points), then u8 (0/1) or f64
+ *   eDictionary:  u32 id, u16 name length, name bytes
+ *
+ * eData frames carry every point (a keyframe), eDelta frames only the
+ * points that changed since the previous publish. A subscriber that misses
+ * a sequence number must ignore deltas until the next keyframe.
+ *
+ * Point IDs are assigned by the provider's PointDictionary. Subscribers learn
+ * them from the dictionary frames sent whenever the dictionary changes (and
+ * periodically, for late joiners) or from the provider's "QUERY=dictionary".
+ *
+ * Binary replies to the provider's bulk "READ=" and "SNAPSHOT=" requests
+ * reuse the format: eDictionary frames naming the points, then eData frames
+ * with their values, back to back in one message. IDs in such a reply are
+ * local to it (dictionary version 0); FrameReader::getOffset() gives the
+ * length of each frame once its entries have been read.
+ */
+namespace frame {
+
+const std::uint8_t MAGIC = 0x7f;
+const std::uint8_t TAG = 'B';
+const std::uint8_t VERSION = 1;
+const std::size_t HEADER_SIZE = 28;
+const std::uint32_t BINARY_FLAG = 0x80000000u;
+
+enum Type : std::uint8_t
+{
+    eData = 1,
+    eDictionary = 2,
+    eDelta = 3
+};
+
+struct Header
+{
+    Type type;
+    std::uint32_t dictionary;
+    std::uint64_t sequence;
+    std::uint64_t timestamp;
+    std::uint32_t count;
+};
+
+// True if the bytes are a binary frame of a version this build understands
+inline bool isBinary(const char* data, const std::size_t size)
+{
+    return size >= HEADER_SIZE
+        && static_cast<std::uint8_t>(data[0]) == MAGIC
+        && static_cast<std::uint8_t>(data[1]) == TAG
+        && static_cast<std::uint8_t>(data[2]) == VERSION;
+}
+
+/*
+ * Frames larger than the publisher's MTU (text or binary) are sent as
+ * fragments, each datagram starting with:
+ *
+ *   0  u8   0x7f
+ *   1  u8   'F'
+ *   2  u8   format version (1)
+ *   3  u8   0
+ *   4  u32  fragmented frame ID (per publisher)
+ *   8  u16  fragment index
+ *   10 u16  fragment count
+ *   12 u32  size of the whole frame
+ *   16 u32  offset of this fragment's bytes in the frame
+ *   20 u32  number of bytes that follow
+ *
+ * Subscribers reassemble the frame before handing it on, so a publish is
+ * applied whole or not at all. A provider keeping a repair history re-sends
+ * fragments on "NACK=<frame id>:<index>,<index>,..." requests.
+ */
+const std::uint8_t FRAGMENT_TAG = 'F';
+const std::size_t FRAGMENT_HEADER_SIZE = 24;
+const std::size_t MAX_FRAGMENTS = 0xffff;
+const std::size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;   // largest frame sent as fragments
+
+struct Fragment
+{
+    std::uint32_t id;
+    std::uint16_t index;
+    std::uint16_t count;
+    std::uint32_t total;
+    std::uint32_t offset;
+    std::uint32_t length;
+    const char* data;           // the fragment's bytes (not a copy)
+};
+
+inline bool isFragment(const char* data, const std::size_t size)
+{
+    return size >= FRAGMENT_HEADER_SIZE
+        && static_cast<std::uint8_t>(data[0]) == MAGIC
+        && static_cast<std::uint8_t>(data[1]) == FRAGMENT_TAG
+        && static_cast<std::uint8_t>(data[2]) == VERSION;
+}
+
+// False if the datagram is not a fragment or its header does not add up
+bool readFragment(const char* data, const std::size_t size, Fragment& fragment);
+
+// Writes FRAGMENT_HEADER_SIZE bytes ('fragment.data' is not used)
+void writeFragmentHeader(char* out, const Fragment& fragment);
+
+} // namespace frame
+
+struct PointValue
+{
+    std::uint32_t id;
+    bool binary;
+    double value;               // 0.0/1.0 for binary points
+
+    PointValue() : id(0), binary(false), value(0.0) {}
+
+    PointValue(const std::uint32_t i, const bool v) : id(i), binary(true), value(v ? 1.0 : 0.0) {}
+
+    PointValue(const std::uint32_t i, const double v) : id(i), binary(false), value(v) {}
+};
+
+/*
+ * Point name <==> ID mapping of one provider. IDs are dense and never
+ * reused; the version changes whenever a point is added, so subscribers can
+ * tell that their copy is stale.
+ */
+class PointDictionary
+{
+public:
+    PointDictionary();
+
+    // ID of 'name', adding it if needed
+    std::uint32_t add(const std::string& name);
+
+    std::uint32_t getVersion() const;
+
+    std::size_t size() const;
+
+    // Copy the names (indexed by ID) and return the version they belong to
+    std::uint32_t getNames(std::vector<std::string>& names) const;
+
+    // "<version>;<id>:<name>,<id>:<name>,..." (for QUERY=dictionary)
+    std::string toString() const;
+
+private:
+    mutable std::mutex mMutex;
+    std::uint32_t mVersion;
+    std::vector<std::string> mNames;
+    std::unordered_map<std::string, std::uint32_t> mIds;
+};
+
+/*
+ * Encodes entries into frames of at most 'mtu' bytes. Frames are built in a
+ * reusable buffer and handed to the sink as soon as they are full, so large
+ * publishes never need the whole message in memory at once.
+ */
+class FrameWriter
+{
+public:
+    typedef std::function<void(const char* data, const std::size_t size)> Sink;
+
+    FrameWriter(const frame::Type type, const std::uint32_t dictionary, const std::size_t mtu, Sink sink);
+
+    void begin(const std::uint64_t sequence);
+
+    void add(const PointValue& point);
+
+    void add(const std::uint32_t id, const std::string& name);
+
+    // Send the last (partial) frame; returns the next sequence number
+    std::uint64_t finish();
+
+private:
+    void reserve(const std::size_t bytes);
+    void flush();
+
+    frame::Type mType;
+    std::uint32_t mDictionary;
+    std::size_t mMTU;
+    Sink mSink;
+    std::string mBuffer;
+    std::uint64_t mSequence;
+    std::uint64_t mTimestamp;
+    std::uint32_t mCount;
+};
+
+/*
+ * Reads a binary frame in place; names are returned as views into the frame.
+ */
+class FrameReader
+{
+public:
+    FrameReader(const char* data, const std::size_t size);
+
+    // False if the frame is truncated or not a supported binary frame
+    bool valid() const
+    {
+        return mValid;
+    }
+
+    const frame::Header& getHeader() const
+    {
+        return mHeader;
+    }
+
+    // Next eData/eDelta entry; false at the end (or on a malformed entry)
+    bool next(PointValue& point);
+
+    // Next eDictionary entry
+    bool next(std::uint32_t& id, std::string_view& name);
+
+    // Bytes of the frame read so far (the frame size once every entry was read)
+    std::size_t getOffset() const
+    {
+        return mOffset;
+    }
+
+private:
+    const char* mData;
+    std::size_t mSize;
+    std::size_t mOffset;
+    std::uint32_t mRemaining;
+    frame::Header mHeader;
+    bool mValid;
+};
+
+} // namespace distributed
+} // namespace bennu
+
+#endif // BENNU_DISTRIBUTED_PUBLISHFRAME_HPP
@@ -1,5 +1,10 @@
 #include "Publisher.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
 #include "bennu/distributed/Utils.hpp"
 
 namespace bennu {
@@ -8,8 +13,35 @@ namespace distributed {
 Publisher::Publisher(const Endpoint& endpoint) :
     mSocket(zmq::socket_t(Context::the()->getContext(), ZMQ_RADIO)),
     mGroup(endpoint.hash()),
-    mMTU(1500)
+    mMTU(1500),
+    mSequence(0),
+    mDictionaryVersion(0),
+    mSinceDictionary(0),
+    mSlotsVersion(0),
+    mPartitioned(false),
+    mFragmented(false),
+    mPartitionSequences(PARTITIONS, 0),
+    mPartitionsVersion(0),
+    mPartitionText(PARTITIONS),
+    mPartitionPoints(PARTITIONS),
+    // start from the clock so subscribers never mix up fragments of a restarted provider
+    mFragmentId(static_cast<std::uint32_t>(std::chrono::system_clock::now().time_since_epoch().count())),
+    mRepairHistory(0)
 {
+    for (unsigned int i = 0; i < PARTITIONS; ++i)
+    {
+        mPartitionGroups.push_back(endpoint.group(i));
+    }
+
+    if (SharedMemoryTable::isSharedMemory(endpoint))
+    {
+        mTable = SharedMemoryTable::create(endpoint);
+        if (!mTable)
+        {
+            exit(1);
+        }
+        return;
+    }
     mSocket.connect(endpoint.str);
 }
 
@@ -20,43 +52,330 @@ Publisher::~Publisher()
 
 void Publisher::publish(std::string& msg)
 {
-    uint size = msg.length();
-    if (size > mMTU)
-    {
-	std::string delim{","}, temp, message;
-        auto parts = distributed::split(msg, delim);
-	uint count = 0;
-        for (const auto& p : parts)
-        {
-	    std::string part{p + ","};
-	    count += part.length();
-	    temp = message + part;
-	    // If adding the part is smaller the MTU and we haven't consumed all the msg...
-	    if (temp.length() < mMTU && count <= size)
-	    {
-                message = temp;
+    if (mTable)
+    {
+        writeText(msg);
+        mTable->ring();
+        return;
+    }
+
+    if (!mPartitioned)
+    {
+        publishText(msg, mGroup);
+        return;
+    }
+
+    for (auto& text : mPartitionText)
+    {
+        text.clear();
+    }
+    std::string_view text(msg);
+    while (!text.empty())
+    {
+        std::size_t end = text.find(',');
+        std::string_view point = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        if (!point.empty())
+        {
+            mPartitionText[partitionOf(point.substr(0, point.find(':')))].append(point).append(",");
+        }
+    }
+    for (unsigned int i = 0; i < PARTITIONS; ++i)
+    {
+        if (!mPartitionText[i].empty())
+        {
+            publishText(mPartitionText[i], mPartitionGroups[i]);
+        }
+    }
+}
+
+void Publisher::publishText(const std::string& msg, const std::string& group)
+{
+    if (mFragmented || msg.size() + 1 <= mMTU)
+    {
+        send(msg.c_str(), msg.size() + 1, group); // must include null byte
+        return;
+    }
+
+    // whole "name:value," points per datagram, so plain DISH subscribers can read every one
+    std::string_view text(msg);
+    std::string part;
+    while (!text.empty())
+    {
+        std::size_t end = text.find(',');
+        std::string_view point = end == std::string_view::npos ? text : text.substr(0, end + 1);
+        text.remove_prefix(point.size());
+        if (!part.empty() && part.size() + point.size() + 1 > mMTU)
+        {
+            zmq::message_t partMsg(part.c_str(), part.size() + 1);
+            send(partMsg, group);
+            part.clear();
+        }
+        part.append(point);
+    }
+    if (!part.empty())
+    {
+        zmq::message_t partMsg(part.c_str(), part.size() + 1);
+        send(partMsg, group);
+    }
+}
+
+void Publisher::publish(const PointDictionary& dictionary, const std::vector<PointValue>& points, const frame::Type type)
+{
+    std::uint32_t version = dictionary.getVersion();
+    if (mTable)
+    {
+        if (version != mSlotsVersion || mSlots.empty())
+        {
+            std::vector<std::string> names;
+            mSlotsVersion = dictionary.getNames(names);
+            mSlots.resize(names.size());
+            for (std::size_t i = 0; i < names.size(); ++i)
+            {
+                mSlots[i] = mTable->add(names[i]);
             }
-	    // Otherwise, send the message without 'part' and reset message
-            else
+        }
+        for (const auto& point : points)
+        {
+            if (point.id < mSlots.size())
             {
-		zmq::message_t partMsg(message+'\0'); // must include null byte
-		publish(partMsg);
-            	message = part;
-	    }
+                mTable->write(mSlots[point.id], point.binary, point.value);
+            }
+        }
+        mTable->ring();
+        return;
+    }
+
+    if (version != mDictionaryVersion || ++mSinceDictionary >= DICTIONARY_INTERVAL)
+    {
+        publishDictionary(dictionary);
+    }
+
+    if (!mPartitioned)
+    {
+        FrameWriter writer(type, version, frameSize(), std::bind(&Publisher::sendFrame, this, std::placeholders::_1, std::placeholders::_2));
+        writer.begin(mSequence);
+        for (const auto& point : points)
+        {
+            writer.add(point);
         }
+        mSequence = writer.finish();
+        return;
     }
-    else
+
+    if (version != mPartitionsVersion || mPartitions.empty())
     {
-        zmq::message_t message(msg+'\0'); // must include null byte
-        publish(message);
+        std::vector<std::string> names;
+        mPartitionsVersion = dictionary.getNames(names);
+        mPartitions.resize(names.size());
+        for (std::size_t i = 0; i < names.size(); ++i)
+        {
+            mPartitions[i] = static_cast<std::uint16_t>(partitionOf(names[i]));
+        }
+    }
+    for (auto& bucket : mPartitionPoints)
+    {
+        bucket.clear();
+    }
+    for (const auto& point : points)
+    {
+        if (point.id < mPartitions.size())
+        {
+            mPartitionPoints[mPartitions[point.id]].push_back(point);
+        }
+    }
+    for (unsigned int i = 0; i < PARTITIONS; ++i)
+    {
+        if (mPartitionPoints[i].empty())
+        {
+            continue;
+        }
+        const std::string& group = mPartitionGroups[i];
+        FrameWriter writer(type, version, frameSize(), [this, &group](const char* data, const std::size_t size) {
+            send(data, size, group);
+        });
+        writer.begin(mPartitionSequences[i]);
+        for (const auto& point : mPartitionPoints[i])
+        {
+            writer.add(point);
+        }
+        mPartitionSequences[i] = writer.finish();
     }
 }
 
+void Publisher::publishDictionary(const PointDictionary& dictionary)
+{
+    if (mTable)
+    {
+        return; // the table carries the names
+    }
+
+    std::vector<std::string> names;
+    std::uint32_t version = dictionary.getNames(names);
+
+    FrameWriter writer(frame::eDictionary, version, frameSize(), std::bind(&Publisher::sendFrame, this, std::placeholders::_1, std::placeholders::_2));
+    writer.begin(mSequence);
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        writer.add(static_cast<std::uint32_t>(i), names[i]);
+    }
+    mSequence = writer.finish();
+    mDictionaryVersion = version;
+    mSinceDictionary = 0;
+}
+
+void Publisher::sendFrame(const char* data, const std::size_t size)
+{
+    send(data, size, mGroup);
+}
+
 void Publisher::publish(zmq::message_t& msg)
 {
-    msg.set_group(mGroup.data());
+    if (mTable)
+    {
+        writeText(std::string_view(msg.data<char>(), strnlen(msg.data<char>(), msg.size())));
+        mTable->ring();
+        return;
+    }
+    send(msg.data<char>(), msg.size(), mGroup);
+}
+
+void Publisher::send(const char* data, const std::size_t size, const std::string& group)
+{
+    if (size <= mMTU || !mFragmented)
+    {
+        zmq::message_t msg(data, size);
+        send(msg, group);
+        return;
+    }
+
+    std::size_t chunk = mMTU - frame::FRAGMENT_HEADER_SIZE;
+    std::size_t count = (size + chunk - 1) / chunk;
+    if (size > frame::MAX_FRAME_SIZE || count > frame::MAX_FRAGMENTS)
+    {
+        printf("E: Publisher: %zu byte frame is too large to send\n", size);
+        return;
+    }
+
+    std::uint32_t id = mFragmentId++;
+    std::string_view frame(data, size);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sendFragment(id, static_cast<std::uint16_t>(i), static_cast<std::uint16_t>(count), frame, chunk, group);
+    }
+
+    std::scoped_lock<std::mutex> lock(mSentMutex);
+    if (mRepairHistory > 0)
+    {
+        if (mSent.size() >= mRepairHistory)
+        {
+            mSent.pop_front();
+        }
+        mSent.push_back({id, group, std::string(frame), chunk});
+    }
+}
+
+void Publisher::send(zmq::message_t& msg, const std::string& group)
+{
+    msg.set_group(group.data());
     mSocket.send(msg);
 }
 
+void Publisher::sendFragment(const std::uint32_t id, const std::uint16_t index, const std::uint16_t count,
+                             const std::string_view& frame, const std::size_t chunk, const std::string& group)
+{
+    frame::Fragment fragment;
+    fragment.id = id;
+    fragment.index = index;
+    fragment.count = count;
+    fragment.total = static_cast<std::uint32_t>(frame.size());
+    fragment.offset = static_cast<std::uint32_t>(index * chunk);
+    fragment.length = static_cast<std::uint32_t>(std::min(chunk, frame.size() - fragment.offset));
+
+    zmq::message_t msg(frame::FRAGMENT_HEADER_SIZE + fragment.length);
+    frame::writeFragmentHeader(msg.data<char>(), fragment);
+    std::memcpy(msg.data<char>() + frame::FRAGMENT_HEADER_SIZE, frame.data() + fragment.offset, fragment.length);
+    send(msg, group); // RADIO is thread safe, so repair() may send while a publish is going out
+}
+
+void Publisher::setRepairHistory(const std::size_t frames)
+{
+    std::scoped_lock<std::mutex> lock(mSentMutex);
+    mRepairHistory = frames;
+    while (mSent.size() > mRepairHistory)
+    {
+        mSent.pop_front();
+    }
+}
+
+std::string Publisher::repair(const std::string& request)
+{
+    std::size_t colon = request.find(':');
+    std::uint32_t id;
+    auto result = std::from_chars(request.data(), request.data() + (colon == std::string::npos ? request.size() : colon), id);
+    if (result.ec != std::errc() || colon == std::string::npos)
+    {
+        return "ERR=Malformed NACK '" + request + "'";
+    }
+
+    std::scoped_lock<std::mutex> lock(mSentMutex);
+    auto sent = std::find_if(mSent.begin(), mSent.end(), [id](const Sent& s) { return s.id == id; });
+    if (sent == mSent.end())
+    {
+        return "ERR=Frame " + std::to_string(id) + " is no longer available";
+    }
+
+    std::size_t count = (sent->frame.size() + sent->chunk - 1) / sent->chunk;
+    unsigned int resent = 0;
+    const char* pos = request.data() + colon + 1;
+    const char* end = request.data() + request.size();
+    while (pos < end)
+    {
+        std::size_t index;
+        result = std::from_chars(pos, end, index);
+        if (result.ec == std::errc() && index < count)
+        {
+            sendFragment(id, static_cast<std::uint16_t>(index), static_cast<std::uint16_t>(count), sent->frame, sent->chunk, sent->group);
+            ++resent;
+        }
+        pos = std::find(result.ptr, end, ',');
+        if (pos < end)
+        {
+            ++pos;
+        }
+    }
+    return "ACK=Resent " + std::to_string(resent) + " fragments";
+}
+
+void Publisher::writeText(const std::string_view& text)
+{
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        std::size_t end = text.find(',', pos);
+        end = end == std::string_view::npos ? text.size() : end;
+        std::string_view point = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        std::size_t colon = point.find(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
+        }
+        std::string_view value = point.substr(colon + 1);
+        if (value == "true" || value == "false")
+        {
+            mTable->write(mTable->add(point.substr(0, colon)), true, value == "true" ? 1.0 : 0.0);
+            continue;
+        }
+        double val;
+        auto result = std::from_chars(value.data(), value.data() + value.size(), val);
+        if (result.ec == std::errc())
+        {
+            mTable->write(mTable->add(point.substr(0, colon)), false, val);
+        }
+    }
+}
+
 } // namespace distributed
 } // namespace bennu
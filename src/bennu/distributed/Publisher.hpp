@@ -1,15 +1,44 @@
 #ifndef BENNU_DISTRIBUTED_PUBLISHER_HPP
 #define BENNU_DISTRIBUTED_PUBLISHER_HPP
 
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "zmq/zmq.hpp"
 
+#include "bennu/distributed/PublishFrame.hpp"
+#include "bennu/distributed/SharedMemoryTable.hpp"
 #include "bennu/distributed/Utils.hpp"
 
 namespace bennu {
 namespace distributed {
 
+/*
+ * Publishes over a ZMQ RADIO socket, or, for "shm://<name>" endpoints, into a
+ * shared memory point table (see SharedMemoryTable.hpp) that co-located
+ * field devices read directly. Text and binary publishes both end up as
+ * table writes there; dictionary frames are not needed since the table holds
+ * the names.
+ *
+ * A partitioned publisher sends each point on its partition's group (see
+ * partitionOf in Utils.hpp) with its own frame sequence per group, so field
+ * devices receive only the partitions holding their points. Dictionary frames
+ * still go to the endpoint's own group, which every subscriber joins.
+ *
+ * Publishes larger than the MTU are split into datagrams of at most the MTU:
+ * text at commas, so every datagram is a complete "name:value,..." list any
+ * DISH subscriber can read, and binary publishes into several frames. With
+ * fragmenting on (off by default) they are instead sent as fragments (see
+ * PublishFrame.hpp) that bennu subscribers reassemble, so every publish goes
+ * out as one frame per group however many points it carries. With a repair
+ * history the last fragmented frames are kept for re-sending fragments
+ * subscribers lost.
+ */
 class Publisher
 {
 public:
@@ -21,10 +50,95 @@ public:
 
     void publish(zmq::message_t& msg);
 
+    // Publish as binary frames (see PublishFrame.hpp). The dictionary goes out
+    // first whenever it changed, and every DICTIONARY_INTERVAL publishes.
+    void publish(const PointDictionary& dictionary, const std::vector<PointValue>& points, const frame::Type type = frame::eData);
+
+    void publishDictionary(const PointDictionary& dictionary);
+
+    void setPartitioned(const bool partitioned)
+    {
+        mPartitioned = partitioned;
+    }
+
+    // Send publishes larger than the MTU as fragments of one frame rather than
+    // as separate datagrams. Only bennu's C++ subscribers reassemble fragments.
+    void setFragmented(const bool fragmented)
+    {
+        mFragmented = fragmented;
+    }
+
+    // Largest datagram sent unfragmented (default 1500)
+    void setMTU(const std::size_t mtu)
+    {
+        mMTU = mtu > frame::FRAGMENT_HEADER_SIZE + 64 ? mtu : frame::FRAGMENT_HEADER_SIZE + 64;
+    }
+
+    // Keep the last 'frames' fragmented frames for repair() (0 = off)
+    void setRepairHistory(const std::size_t frames);
+
+    // Re-send the fragments named by a subscriber's "<frame id>:<index>,<index>,..."
+    // NACK. Safe to call from other threads; returns "ACK=..." or "ERR=...".
+    std::string repair(const std::string& request);
+
 private:
+    static const unsigned int DICTIONARY_INTERVAL = 50;
+
+    void sendFrame(const char* data, const std::size_t size);
+
+    // Unfragmented text: split at commas into datagrams of at most the MTU
+    void publishText(const std::string& msg, const std::string& group);
+
+    // Largest frame a FrameWriter may build
+    std::size_t frameSize() const
+    {
+        return mFragmented ? frame::MAX_FRAME_SIZE : mMTU;
+    }
+
+    // As one datagram, or as fragments if larger than the MTU
+    void send(const char* data, const std::size_t size, const std::string& group);
+
+    void send(zmq::message_t& msg, const std::string& group);
+
+    void sendFragment(const std::uint32_t id, const std::uint16_t index, const std::uint16_t count,
+                      const std::string_view& frame, const std::size_t chunk, const std::string& group);
+
+    // A fragmented frame kept for repair()
+    struct Sent
+    {
+        std::uint32_t id;
+        std::string group;
+        std::string frame;
+        std::size_t chunk;              // bytes per fragment
+    };
+
+    // "name:value,..." into the shared memory table
+    void writeText(const std::string_view& text);
+
     zmq::socket_t mSocket;
     std::string mGroup;
-    uint mMTU;
+    std::size_t mMTU;
+    std::uint64_t mSequence;            // next binary frame
+    std::uint32_t mDictionaryVersion;   // last dictionary sent
+    unsigned int mSinceDictionary;      // publishes since then
+
+    std::shared_ptr<SharedMemoryTable> mTable;  // set for shm:// endpoints
+    std::vector<std::uint32_t> mSlots;          // point ID ==> table slot
+    std::uint32_t mSlotsVersion;                // dictionary version mSlots was built from
+
+    bool mPartitioned;
+    bool mFragmented;
+    std::vector<std::string> mPartitionGroups;
+    std::vector<std::uint64_t> mPartitionSequences;     // next binary frame per partition
+    std::vector<std::uint16_t> mPartitions;             // point ID ==> partition
+    std::uint32_t mPartitionsVersion;                   // dictionary version mPartitions was built from
+    std::vector<std::string> mPartitionText;            // reused by every text publish
+    std::vector<std::vector<PointValue>> mPartitionPoints; // reused by every binary publish
+
+    std::uint32_t mFragmentId;          // next fragmented frame
+    std::size_t mRepairHistory;
+    std::deque<Sent> mSent;             // newest last
+    std::mutex mSentMutex;              // guards mRepairHistory and mSent
 
 };
 
@@ -79,12 +79,12 @@ public:
         }
     }
 
-    void receive(uint8_t* buffer, size_t)
+    void receive(uint8_t* buffer, size_t maxSize)
     {
         if (connect())
         {
             mService.reset();
-            boost::asio::async_read(*mSerialPort, boost::asio::buffer(buffer, 6), boost::bind(&SerialClient::receiveHandler, this, buffer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+            boost::asio::async_read(*mSerialPort, boost::asio::buffer(buffer, 6), boost::bind(&SerialClient::receiveHandler, this, buffer, maxSize, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 
             // Setup deadline time
             mTimer.expires_from_now(boost::posix_time::milliseconds(mTimeout));
@@ -95,7 +95,7 @@ public:
         }
     }
 
-    void receiveHandler(uint8_t* buffer, const boost::system::error_code& error, size_t bytesTransferred)
+    void receiveHandler(uint8_t* buffer, size_t maxSize, const boost::system::error_code& error, size_t bytesTransferred)
     {
         if (error)
         {
@@ -109,6 +109,12 @@ public:
                 std::memcpy(&readData, &buffer[4], 2);
 
                 uint16_t length = ntohs(readData);
+                if (6u + length > maxSize)
+                {
+                    std::cerr << "ERROR: receive message of length " << length << " does not fit in " << maxSize << " bytes" << std::endl;
+                    mTimer.cancel();
+                    return;
+                }
                 boost::system::error_code ec;
                 boost::asio::read(*mSerialPort, boost::asio::buffer(&buffer[6], length), boost::asio::transfer_exactly(length), ec);
                 if (error)
@@ -1,13 +1,21 @@
 #include "Server.hpp"
 
+#include <chrono>
 #include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 namespace bennu {
 namespace distributed {
 
-Server::Server(const Endpoint& endpoint) :
-    mSocket(zmq::socket_t(Context::the()->getContext(), ZMQ_REP)),
-    mHandler(std::bind(&Server::defaultHandler, this, std::placeholders::_1))
+Server::Server(const Endpoint& endpoint, const unsigned int workers) :
+    mSocket(zmq::socket_t(Context::the()->getContext(), workers > 1 ? ZMQ_ROUTER : ZMQ_REP)),
+    mWorkers(workers > 1 ? workers : 1),
+    mBackend("inproc://bennu-server-" + std::to_string(reinterpret_cast<std::uintptr_t>(this))),
+    mHandler(std::bind(&Server::defaultHandler, this, std::placeholders::_1)),
+    mRequests(0),
+    mErrors(0)
 {
     try
     {
@@ -27,38 +35,93 @@ Server::~Server()
 
 zmq::message_t Server::defaultHandler(const zmq::message_t& request)
 {
-    // TODO: add default handler
+    return zmq::message_t(std::string("ERR=No request handler\0", 23));
 }
 
 void Server::run()
 {
-    while (mSocket.connected())
+    if (mWorkers == 1)
+    {
+        serve(mSocket, mHandler);
+        return;
+    }
+
+    zmq::socket_t backend(Context::the()->getContext(), ZMQ_DEALER);
+    backend.bind(mBackend);
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < mWorkers; ++i)
+    {
+        workers.emplace_back(&Server::worker, this);
+    }
+
+    try
+    {
+        zmq::proxy(static_cast<void*>(mSocket), static_cast<void*>(backend), nullptr);
+    }
+    catch (zmq::error_t& e)
+    {
+        printf("E: Server proxy: %s\n", e.what());
+    }
+
+    // the proxy only returns once the context shuts down (ETERM), which ends the workers' receives too
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+}
+
+void Server::worker()
+{
+    zmq::socket_t socket(Context::the()->getContext(), ZMQ_REP);
+    socket.connect(mBackend);
+    serve(socket, mHandler);
+}
+
+void Server::serve(zmq::socket_t& socket, RequestHandler handler)
+{
+    while (socket.connected())
     {
         zmq::message_t request;
         try
         {
-            mSocket.recv(&request);
+            socket.recv(&request);
         }
         catch (zmq::error_t& e)
         {
-            printf("E: Server recv: %s", e.what());
+            printf("E: Server recv: %s\n", e.what());
             break;
         }
-        printf("Server ---- Received request\n");
 
-        zmq::message_t reply(mHandler(request));
+        auto start = std::chrono::steady_clock::now();
+        zmq::message_t reply(handler(request));
+        mLatency.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        mRequests.fetch_add(1, std::memory_order_relaxed);
+
         try
         {
-            mSocket.send(reply);
+            socket.send(reply);
         }
         catch (zmq::error_t& e)
         {
-            printf("E: Server send: %s", e.what());
+            mErrors.fetch_add(1, std::memory_order_relaxed);
+            printf("E: Server send: %s\n", e.what());
             break;
         }
-        printf("Server ---- Sent reply\n");
     }
 }
 
+std::string Server::report() const
+{
+    std::stringstream ss;
+    ss << "workers:" << mWorkers
+       << ",requests:" << getRequests()
+       << ",errors:" << mErrors.load(std::memory_order_relaxed)
+       << ",latency_avg:" << static_cast<std::uint64_t>(mLatency.mean())
+       << ",latency_p99:" << mLatency.percentile(99)
+       << ",latency_max:" << mLatency.max();
+    return ss.str();
+}
+
 } // namespace distributed
 } // namespace bennu
@@ -1,22 +1,37 @@
 #ifndef BENNU_DISTRIBUTED_SERVER_HPP
 #define BENNU_DISTRIBUTED_SERVER_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <functional> // std::function
 #include <string>
 
 #include "zmq/zmq.hpp"
 
 #include "bennu/distributed/Utils.hpp"
+#include "bennu/utility/Histogram.hpp"
 
 namespace bennu {
 namespace distributed {
 
+/*
+ * Request/reply server. With one worker (the default) requests are handled
+ * one at a time on a REP socket by the thread calling run(). With more, run()
+ * binds a ROUTER front end and proxies requests over inproc to a pool of
+ * worker threads, each with its own REP socket, so clients are served
+ * concurrently. Request envelopes pass through untouched, so REQ and DEALER
+ * clients (see AsyncClient) work the same in both modes.
+ *
+ * Reentrancy: a worker handles one request at a time, so a handler is never
+ * re-entered by the same worker, but with several workers the handler runs
+ * concurrently and must be thread safe.
+ */
 class Server
 {
 public:
     typedef std::function<zmq::message_t (const zmq::message_t& request)> RequestHandler;
 
-    Server(const Endpoint& endpoint);
+    Server(const Endpoint& endpoint, const unsigned int workers = 1);
 
     ~Server();
 
@@ -29,9 +44,38 @@ public:
 
     void run();
 
+    unsigned int getWorkers() const
+    {
+        return mWorkers;
+    }
+
+    std::uint64_t getRequests() const
+    {
+        return mRequests.load(std::memory_order_relaxed);
+    }
+
+    // Time spent in the handler per request (microseconds)
+    const utility::Histogram& getLatency() const
+    {
+        return mLatency;
+    }
+
+    // Comma separated "key:value" pairs (times in microseconds)
+    std::string report() const;
+
 private:
-    zmq::socket_t mSocket;
+    // Receive, handle and reply until the socket fails
+    void serve(zmq::socket_t& socket, RequestHandler handler);
+
+    void worker();
+
+    zmq::socket_t mSocket;                  // REP with one worker, ROUTER otherwise
+    unsigned int mWorkers;
+    std::string mBackend;                   // inproc address the workers connect to
     RequestHandler mHandler;
+    std::atomic<std::uint64_t> mRequests;
+    std::atomic<std::uint64_t> mErrors;
+    utility::Histogram mLatency;
 
 };
 
@@ -0,0 +1,366 @@
+#include "SharedMemoryTable.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bennu {
+namespace distributed {
+
+namespace {
+
+const std::uint32_t MAGIC = 0x4d485342;  // "BSHM"
+const std::uint32_t LAYOUT = 2;
+
+// "shm://<name>" ==> "/bennu-<name>"
+std::string segmentName(const Endpoint& endpoint)
+{
+    std::string name = endpoint.str.substr(6);
+    for (auto& c : name)
+    {
+        c = c == '/' ? '_' : c;
+    }
+    return "/bennu-" + name;
+}
+
+void futexWake(std::atomic<std::uint32_t>* word)
+{
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace
+
+struct alignas(64) SharedMemoryTable::Header
+{
+    std::uint32_t magic;
+    std::uint32_t layout;
+    std::uint32_t capacity;
+    std::uint32_t slotSize;
+    std::atomic<std::uint32_t> count;       // slots added (names written before it moves)
+    std::atomic<std::uint32_t> doorbell;    // futex word, bumped after each publish
+    std::atomic<std::uint32_t> closed;
+    std::atomic<std::uint64_t> published;   // ns since the UNIX epoch of the last ring
+};
+
+struct SharedMemoryTable::Slot
+{
+    std::atomic<std::uint32_t> sequence;    // odd while the writer is updating the value
+    std::atomic<std::uint32_t> binary;
+    std::atomic<std::uint64_t> value;       // bits of a double
+    char name[NAME_SIZE];
+};
+
+std::shared_ptr<SharedMemoryTable> SharedMemoryTable::create(const Endpoint& endpoint, const std::uint32_t capacity)
+{
+    std::string name = segmentName(endpoint);
+
+    // tell readers of a previous table (even one left by a crashed writer) to remap
+    int old = shm_open(name.data(), O_RDWR, 0);
+    if (old >= 0)
+    {
+        struct stat st;
+        if (fstat(old, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(Header))
+        {
+            void* memory = mmap(nullptr, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, old, 0);
+            if (memory != MAP_FAILED)
+            {
+                auto header = static_cast<Header*>(memory);
+                shm_unlink(name.data());
+                if (header->magic == MAGIC)
+                {
+                    header->closed.store(1, std::memory_order_release);
+                    header->doorbell.fetch_add(1, std::memory_order_release);
+                    futexWake(&header->doorbell);
+                }
+                munmap(memory, sizeof(Header));
+            }
+        }
+        close(old);
+        shm_unlink(name.data());
+    }
+
+    int fd = shm_open(name.data(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        printf("E: SharedMemoryTable create (%s): %s\n", endpoint.str.data(), strerror(errno));
+        return nullptr;
+    }
+    std::size_t size = sizeof(Header) + static_cast<std::size_t>(capacity) * sizeof(Slot);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        printf("E: SharedMemoryTable create (%s): %s\n", endpoint.str.data(), strerror(errno));
+        close(fd);
+        shm_unlink(name.data());
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        printf("E: SharedMemoryTable create (%s): %s\n", endpoint.str.data(), strerror(errno));
+        shm_unlink(name.data());
+        return nullptr;
+    }
+
+    // the segment starts out zeroed, which is a valid empty table apart from the header fields
+    auto header = static_cast<Header*>(memory);
+    header->capacity = capacity;
+    header->slotSize = sizeof(Slot);
+    header->layout = LAYOUT;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+
+    return std::shared_ptr<SharedMemoryTable>(new SharedMemoryTable(name, memory, size, true));
+}
+
+std::shared_ptr<SharedMemoryTable> SharedMemoryTable::open(const Endpoint& endpoint)
+{
+    std::string name = segmentName(endpoint);
+    int fd = shm_open(name.data(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header))
+    {
+        close(fd);
+        return nullptr;
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    auto header = static_cast<const Header*>(memory);
+    if (header->magic != MAGIC || header->layout != LAYOUT || header->slotSize != sizeof(Slot)
+        || size < sizeof(Header) + static_cast<std::size_t>(header->capacity) * sizeof(Slot))
+    {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return std::shared_ptr<SharedMemoryTable>(new SharedMemoryTable(name, memory, size, false));
+}
+
+SharedMemoryTable::SharedMemoryTable(const std::string& name, void* memory, const std::size_t size, const bool writer) :
+    mName(name),
+    mMemory(memory),
+    mSize(size),
+    mWriter(writer),
+    mHeader(static_cast<Header*>(memory))
+{
+}
+
+SharedMemoryTable::~SharedMemoryTable()
+{
+    if (mWriter)
+    {
+        // unlink first so woken readers cannot map this table again
+        shm_unlink(mName.data());
+        mHeader->closed.store(1, std::memory_order_release);
+        ring();
+    }
+    munmap(mMemory, mSize);
+}
+
+SharedMemoryTable::Slot* SharedMemoryTable::slot(const std::uint32_t index) const
+{
+    return reinterpret_cast<Slot*>(static_cast<char*>(mMemory) + sizeof(Header)) + index;
+}
+
+std::uint32_t SharedMemoryTable::add(const std::string_view& name)
+{
+    mScratch.assign(name);
+    auto iter = mSlots.find(mScratch);
+    if (iter != mSlots.end())
+    {
+        return iter->second;
+    }
+
+    std::uint32_t index = mHeader->count.load(std::memory_order_relaxed);
+    if (index >= mHeader->capacity)
+    {
+        if (index == mHeader->capacity)
+        {
+            printf("E: SharedMemoryTable add: table full (%u points), dropping %s\n", mHeader->capacity, mScratch.data());
+        }
+        return INVALID_SLOT;
+    }
+    std::size_t length = std::min(name.size(), NAME_SIZE - 1);
+    std::memcpy(slot(index)->name, name.data(), length);
+    slot(index)->name[length] = '\0';
+    mHeader->count.store(index + 1, std::memory_order_release);
+    mSlots.emplace(mScratch, index);
+    return index;
+}
+
+void SharedMemoryTable::write(const std::uint32_t index, const bool binary, const double value)
+{
+    if (index >= mHeader->count.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    Slot* s = slot(index);
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    std::uint32_t sequence = s->sequence.load(std::memory_order_relaxed);
+    // unchanged values keep their sequence, so readers only pick up real changes
+    if (sequence != 0 && s->value.load(std::memory_order_relaxed) == bits && s->binary.load(std::memory_order_relaxed) == binary)
+    {
+        return;
+    }
+    s->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s->binary.store(binary ? 1 : 0, std::memory_order_relaxed);
+    s->value.store(bits, std::memory_order_relaxed);
+    s->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SharedMemoryTable::ring()
+{
+    mHeader->published.store(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()), std::memory_order_relaxed);
+    mHeader->doorbell.fetch_add(1, std::memory_order_release);
+    futexWake(&mHeader->doorbell);
+}
+
+std::uint32_t SharedMemoryTable::size() const
+{
+    return std::min(mHeader->count.load(std::memory_order_acquire), mHeader->capacity);
+}
+
+std::string_view SharedMemoryTable::name(const std::uint32_t index) const
+{
+    if (index >= size())
+    {
+        return std::string_view();
+    }
+    const char* name = slot(index)->name;
+    return std::string_view(name, strnlen(name, NAME_SIZE));
+}
+
+bool SharedMemoryTable::read(const std::uint32_t index, PointValue& point, std::uint32_t& sequence) const
+{
+    if (index >= size())
+    {
+        return false;
+    }
+    const Slot* s = slot(index);
+    // the writer holds a slot odd only for a few stores; give up rather than spin on a writer that died there
+    for (int attempt = 0; attempt < 1000; ++attempt)
+    {
+        std::uint32_t before = s->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue; // the writer is in the middle of it
+        }
+        std::uint32_t binary = s->binary.load(std::memory_order_relaxed);
+        std::uint64_t bits = s->value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->sequence.load(std::memory_order_relaxed) != before)
+        {
+            continue;
+        }
+        if (before == 0)
+        {
+            return false; // never written
+        }
+        point.id = index;
+        point.binary = binary != 0;
+        std::memcpy(&point.value, &bits, sizeof(bits));
+        sequence = before;
+        return true;
+    }
+    return false;
+}
+
+std::uint32_t SharedMemoryTable::getDoorbell() const
+{
+    return mHeader->doorbell.load(std::memory_order_acquire);
+}
+
+void SharedMemoryTable::wait(const std::uint32_t seen, const std::chrono::milliseconds& timeout) const
+{
+    if (getDoorbell() != seen)
+    {
+        return;
+    }
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(seconds.count());
+    ts.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds).count());
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&mHeader->doorbell), FUTEX_WAIT, seen, &ts, nullptr, 0);
+}
+
+std::uint64_t SharedMemoryTable::getPublished() const
+{
+    return mHeader->published.load(std::memory_order_relaxed);
+}
+
+bool SharedMemoryTable::isClosed() const
+{
+    return mHeader->closed.load(std::memory_order_acquire) != 0;
+}
+
+SharedMemorySubscriber::SharedMemorySubscriber(const Endpoint& endpoint, Handler handler) :
+    mEndpoint(endpoint),
+    mHandler(handler),
+    mRunning(true)
+{
+    mThread.reset(new std::thread(std::bind(&SharedMemorySubscriber::run, this)));
+}
+
+SharedMemorySubscriber::~SharedMemorySubscriber()
+{
+    mRunning = false;
+    if (mThread && mThread->joinable())
+    {
+        mThread->join();
+    }
+}
+
+void SharedMemorySubscriber::run()
+{
+    std::shared_ptr<SharedMemoryTable> table;
+    bool waiting = false;
+    while (mRunning)
+    {
+        if (!table || table->isClosed())
+        {
+            // keep the old table mapped until there is a new one, so handlers can tell them apart by address
+            auto fresh = SharedMemoryTable::open(mEndpoint);
+            if (!fresh || fresh->isClosed())
+            {
+                if (!waiting)
+                {
+                    printf("I: Waiting for shared memory table %s\n", mEndpoint.str.data());
+                    waiting = true;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            table = fresh;
+            printf("I: Mapped shared memory table %s\n", mEndpoint.str.data());
+            waiting = false;
+        }
+
+        // a ring while the handler runs moves the doorbell past 'seen', so wait() returns at once
+        std::uint32_t seen = table->getDoorbell();
+        mHandler(*table);
+        table->wait(seen, std::chrono::milliseconds(1000));
+    }
+}
+
+} // namespace distributed
+} // namespace bennu
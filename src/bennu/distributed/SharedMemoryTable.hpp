@@ -0,0 +1,134 @@
+#ifndef BENNU_DISTRIBUTED_SHAREDMEMORYTABLE_HPP
+#define BENNU_DISTRIBUTED_SHAREDMEMORYTABLE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "bennu/distributed/PublishFrame.hpp"
+#include "bennu/distributed/Utils.hpp"
+
+namespace bennu {
+namespace distributed {
+
+/*
+ * Point table in POSIX shared memory, for publishing to field devices on the
+ * same host ("shm://<name>" endpoints) without sockets or parsing.
+ *
+ * One process (the provider's Publisher) creates and writes the table; any
+ * number map it read only. Each slot holds a point name, written once when
+ * the slot is added, and a value guarded by a per-slot sequence counter
+ * (seqlock): the writer makes it odd while updating and even after, and a
+ * reader retries if it was odd or moved. A reader also keeps the counter it
+ * last saw to tell whether the point changed at all.
+ *
+ * After each publish the writer increments the doorbell word and wakes
+ * futex waiters on it. A writer that starts over marks any previous table
+ * closed (and rings it) before replacing it, so readers know to remap.
+ */
+class SharedMemoryTable
+{
+public:
+    static const std::size_t NAME_SIZE = 64;
+    static const std::uint32_t DEFAULT_CAPACITY = 65536;
+
+    // "shm://<name>" endpoints select this transport
+    static bool isSharedMemory(const Endpoint& endpoint)
+    {
+        return endpoint.str.compare(0, 6, "shm://") == 0;
+    }
+
+    // Writer: create the table named by an "shm://<name>" endpoint (replacing an old one)
+    static std::shared_ptr<SharedMemoryTable> create(const Endpoint& endpoint, const std::uint32_t capacity = DEFAULT_CAPACITY);
+
+    // Reader: map an existing table; nullptr if there is none (yet)
+    static std::shared_ptr<SharedMemoryTable> open(const Endpoint& endpoint);
+
+    ~SharedMemoryTable();
+
+    // Writer: slot of 'name', adding it if needed (INVALID_SLOT when full)
+    std::uint32_t add(const std::string_view& name);
+
+    // Writer: set a slot's value
+    void write(const std::uint32_t slot, const bool binary, const double value);
+
+    // Writer: tell readers a publish is complete
+    void ring();
+
+    // Slots added so far
+    std::uint32_t size() const;
+
+    std::string_view name(const std::uint32_t slot) const;
+
+    // Reader: current value of a slot and its sequence counter
+    bool read(const std::uint32_t slot, PointValue& point, std::uint32_t& sequence) const;
+
+    std::uint32_t getDoorbell() const;
+
+    // When the writer last rang (ns since the UNIX epoch)
+    std::uint64_t getPublished() const;
+
+    // Reader: block until the doorbell moves past 'seen' or the timeout expires
+    void wait(const std::uint32_t seen, const std::chrono::milliseconds& timeout) const;
+
+    // Reader: true once the writer replaced (or removed) this table
+    bool isClosed() const;
+
+    static const std::uint32_t INVALID_SLOT = 0xffffffffu;
+
+private:
+    struct Header;
+    struct Slot;
+
+    SharedMemoryTable(const std::string& name, void* memory, const std::size_t size, const bool writer);
+
+    Slot* slot(const std::uint32_t index) const;
+
+    std::string mName;
+    void* mMemory;
+    std::size_t mSize;
+    bool mWriter;
+    Header* mHeader;
+    std::unordered_map<std::string, std::uint32_t> mSlots; // writer only
+    std::string mScratch;                                   // writer only, reused for lookups
+
+    SharedMemoryTable(const SharedMemoryTable&);
+    SharedMemoryTable& operator =(const SharedMemoryTable&);
+
+};
+
+/*
+ * Reads a shared memory table as the writer rings it. The handler runs on the
+ * subscriber's own thread after every doorbell (and at least once a second),
+ * with the table currently mapped; it is handed a new table if the writer
+ * restarted. Until the table exists the subscriber keeps trying to map it.
+ */
+class SharedMemorySubscriber
+{
+public:
+    typedef std::function<void (const SharedMemoryTable& table)> Handler;
+
+    SharedMemorySubscriber(const Endpoint& endpoint, Handler handler);
+
+    ~SharedMemorySubscriber();
+
+private:
+    void run();
+
+    Endpoint mEndpoint;
+    Handler mHandler;
+    std::atomic<bool> mRunning;
+    std::unique_ptr<std::thread> mThread;
+
+};
+
+} // namespace distributed
+} // namespace bennu
+
+#endif // BENNU_DISTRIBUTED_SHAREDMEMORYTABLE_HPP
@@ -1,28 +1,382 @@
 #include "Subscriber.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <vector>
+
+#include "bennu/distributed/AsyncClient.hpp"
+#include "bennu/distributed/PublishFrame.hpp"
+
 namespace bennu {
 namespace distributed {
 
-Subscriber::Subscriber(const Endpoint& endpoint) :
-    mSocket(zmq::socket_t(Context::the()->getContext(), ZMQ_DISH)),
-    mHandler(std::bind(&Subscriber::defaultHandler, this, std::placeholders::_1))
+/*
+ * Process wide receive side for all Subscribers: one DISH socket bound to
+ * every endpoint anyone subscribed to, joined to each endpoint's group, and a
+ * single thread fanning frames out to the subscribers of that group (after
+ * putting fragmented frames back together).
+ */
+class SubscriberHub
 {
-    try
+public:
+    static SubscriberHub& the()
+    {
+        static SubscriberHub hub;
+        return hub;
+    }
+
+    // Join the endpoint's own group and the given partitions' groups
+    void add(const Endpoint& endpoint, const std::set<unsigned int>& partitions, Subscriber* subscriber)
+    {
+        std::scoped_lock<std::shared_mutex> lock(mMutex);
+        if (mEndpoints.insert(endpoint.str).second)
+        {
+            try
+            {
+                mSocket.bind(endpoint.str);
+            }
+            catch (zmq::error_t& e)
+            {
+                printf("E: Server bind (%s): %s\n", endpoint.str.data(), e.what());
+                exit(1);
+            }
+        }
+        join(endpoint, endpoint.hash(), Subscriber::BASE_STREAM, subscriber);
+        for (auto partition : partitions)
+        {
+            join(endpoint, endpoint.group(partition), partition, subscriber);
+        }
+        if (!mThread)
+        {
+            mThread.reset(new std::thread(std::bind(&SubscriberHub::run, this)));
+        }
+    }
+
+    void remove(Subscriber* subscriber)
+    {
+        std::scoped_lock<std::shared_mutex> lock(mMutex);
+        for (auto& kv : mSubscribers)
+        {
+            auto& subs = kv.second.subscribers;
+            subs.erase(std::remove(subs.begin(), subs.end(), subscriber), subs.end());
+        }
+    }
+
+    void setExecutor(Subscriber::Executor executor)
+    {
+        std::scoped_lock<std::mutex> lock(mExecutorMutex);
+        mExecutor = executor;
+    }
+
+    Subscriber::Executor getExecutor()
+    {
+        // separate lock: called from run() while mMutex is already held shared
+        std::scoped_lock<std::mutex> lock(mExecutorMutex);
+        return mExecutor;
+    }
+
+    void setRepair(const Endpoint& endpoint, const Endpoint& repair)
+    {
+        std::scoped_lock<std::shared_mutex> lock(mMutex);
+        mRepair[endpoint.str].reset(new AsyncClient(repair, NACK_DELAY, 0));
+    }
+
+    std::uint64_t getIncomplete() const
+    {
+        return mIncomplete.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getRepairRequests() const
+    {
+        return mRepairRequests.load(std::memory_order_relaxed);
+    }
+
+private:
+    // how long a fragmented frame may take to arrive, and to wait before NACKing what is missing
+    static constexpr std::chrono::milliseconds REASSEMBLY_TIMEOUT{500};
+    static constexpr std::chrono::milliseconds NACK_DELAY{20};
+    static const unsigned int MAX_NACKS = 3;
+    static const std::size_t MAX_PARTIALS = 1024;
+    static const std::size_t COMPLETED_HISTORY = 256;
+
+    struct Group
+    {
+        unsigned int stream;                // partition, or Subscriber::BASE_STREAM
+        std::string endpoint;               // publish endpoint the group belongs to
+        std::vector<Subscriber*> subscribers;
+    };
+
+    // A fragmented frame being reassembled
+    struct Partial
     {
-        mSocket.bind(endpoint.str);
+        std::string frame;
+        std::vector<bool> received;         // per fragment
+        std::size_t missing;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point nacked;
+        unsigned int nacks;
+    };
+
+    typedef std::pair<std::string, std::uint32_t> FrameKey;    // group, fragmented frame ID
+
+    void join(const Endpoint& endpoint, const std::string& group, const unsigned int stream, Subscriber* subscriber)
+    {
+        auto iter = mSubscribers.find(group);
+        if (iter == mSubscribers.end())
+        {
+            mSocket.join(group.data());
+            iter = mSubscribers.emplace(group, Group{stream, endpoint.str, {}}).first;
+        }
+        iter->second.subscribers.push_back(subscriber);
     }
-    catch (zmq::error_t& e)
+
+    SubscriberHub() :
+        mSocket(zmq::socket_t(Context::the()->getContext(), ZMQ_DISH)),
+        mIncomplete(0),
+        mRepairRequests(0)
     {
-        printf("E: Server bind (%s): %s\n", endpoint.str.data(), e.what());
-        exit(1);
+        // wake up now and then to time out (and NACK) fragmented frames
+        mSocket.setsockopt(ZMQ_RCVTIMEO, static_cast<int>(NACK_DELAY.count()));
     }
-    mSocket.join(endpoint.hash().data());
-    mSubscriberThread.reset(new std::thread(std::bind(&Subscriber::run, this)));
+
+    ~SubscriberHub()
+    {
+        // the receive thread lives as long as the process
+        if (mThread && mThread->joinable())
+        {
+            mThread->detach();
+        }
+    }
+
+    void run()
+    {
+        auto checked = std::chrono::steady_clock::now();
+        while (mSocket.connected())
+        {
+            zmq::message_t msg;
+            bool received;
+            try
+            {
+                received = mSocket.recv(&msg);
+            }
+            catch (zmq::error_t& e)
+            {
+                printf("E: Server: %s\n", e.what());
+                break;
+            }
+            if (received)
+            {
+                const char* group = msg.group();
+                if (frame::isFragment(msg.data<char>(), msg.size()))
+                {
+                    reassemble(group ? group : "", msg.data<char>(), msg.size());
+                }
+                else
+                {
+                    dispatch(group ? group : "", msg.data<char>(), msg.size());
+                }
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (!mPartials.empty() && now - checked >= NACK_DELAY)
+            {
+                expire(now);
+                checked = now;
+            }
+        }
+    }
+
+    void dispatch(const std::string& group, const char* data, const std::size_t size)
+    {
+        // text frames carry a terminating null byte, binary frames are taken whole
+        auto frame = std::make_shared<const std::string>(data, frame::isBinary(data, size) ? size : strnlen(data, size));
+
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        auto iter = mSubscribers.find(group);
+        if (iter != mSubscribers.end())
+        {
+            for (auto subscriber : iter->second.subscribers)
+            {
+                subscriber->deliver(frame, iter->second.stream);
+            }
+        }
+    }
+
+    void reassemble(const std::string& group, const char* data, const std::size_t size)
+    {
+        frame::Fragment fragment;
+        if (!frame::readFragment(data, size, fragment))
+        {
+            return;
+        }
+        FrameKey key{group, fragment.id};
+        if (mCompleted.count(key))
+        {
+            return; // a repaired fragment someone else asked for
+        }
+
+        auto iter = mPartials.find(key);
+        if (iter == mPartials.end())
+        {
+            if (mPartials.size() >= MAX_PARTIALS)
+            {
+                mIncomplete.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            iter = mPartials.emplace(key, Partial{std::string(fragment.total, '\0'),
+                std::vector<bool>(fragment.count, false), fragment.count, now, now, 0}).first;
+        }
+        auto& partial = iter->second;
+        if (fragment.total != partial.frame.size() || fragment.count != partial.received.size() || partial.received[fragment.index])
+        {
+            return;
+        }
+        std::memcpy(&partial.frame[fragment.offset], fragment.data, fragment.length);
+        partial.received[fragment.index] = true;
+        if (--partial.missing > 0)
+        {
+            return;
+        }
+
+        std::string frame(std::move(partial.frame));
+        mPartials.erase(iter);
+        mCompleted.insert(key);
+        mCompletedOrder.push_back(key);
+        if (mCompletedOrder.size() > COMPLETED_HISTORY)
+        {
+            mCompleted.erase(mCompletedOrder.front());
+            mCompletedOrder.pop_front();
+        }
+        dispatch(group, frame.data(), frame.size());
+    }
+
+    void expire(const std::chrono::steady_clock::time_point& now)
+    {
+        for (auto iter = mPartials.begin(); iter != mPartials.end();)
+        {
+            auto& partial = iter->second;
+            if (now - partial.started > REASSEMBLY_TIMEOUT)
+            {
+                mIncomplete.fetch_add(1, std::memory_order_relaxed);
+                iter = mPartials.erase(iter);
+                continue;
+            }
+            if (now - partial.nacked >= NACK_DELAY && partial.nacks < MAX_NACKS)
+            {
+                requestRepair(iter->first, partial);
+                partial.nacked = now;
+                ++partial.nacks;
+            }
+            ++iter;
+        }
+    }
+
+    void requestRepair(const FrameKey& key, const Partial& partial)
+    {
+        std::shared_ptr<AsyncClient> client;
+        {
+            std::shared_lock<std::shared_mutex> lock(mMutex);
+            auto group = mSubscribers.find(key.first);
+            auto repair = group == mSubscribers.end() ? mRepair.end() : mRepair.find(group->second.endpoint);
+            if (repair == mRepair.end())
+            {
+                return;
+            }
+            client = repair->second;
+        }
+
+        std::string nack = "NACK=" + std::to_string(key.second) + ":";
+        for (std::size_t i = 0; i < partial.received.size(); ++i)
+        {
+            if (!partial.received[i])
+            {
+                nack += std::to_string(i) + ",";
+            }
+        }
+        client->send(nack);
+        mRepairRequests.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    zmq::socket_t mSocket; // DISH is thread safe, so binds/joins may happen while run() is receiving
+    std::set<std::string> mEndpoints;
+    std::map<std::string, Group> mSubscribers; // group ==> subscribers
+    std::map<std::string, std::shared_ptr<AsyncClient>> mRepair; // publish endpoint ==> where to send NACKs
+    std::map<FrameKey, Partial> mPartials;     // receive thread only
+    std::set<FrameKey> mCompleted;             // recently reassembled (receive thread only)
+    std::deque<FrameKey> mCompletedOrder;
+    Subscriber::Executor mExecutor;
+    std::mutex mExecutorMutex;
+    std::shared_mutex mMutex;
+    std::unique_ptr<std::thread> mThread;
+    std::atomic<std::uint64_t> mIncomplete;
+    std::atomic<std::uint64_t> mRepairRequests;
+};
+
+Subscriber::Subscriber(const Endpoint& endpoint) :
+    mGroup(endpoint.hash()),
+    mHandler(std::bind(&Subscriber::defaultHandler, this, std::placeholders::_1)),
+    mScheduled(false),
+    mGaps(0),
+    mDroppedDeltas(0)
+{
+    SubscriberHub::the().add(endpoint, {}, this);
+}
+
+Subscriber::Subscriber(const Endpoint& endpoint, const std::vector<std::string>& points) :
+    mGroup(endpoint.hash()),
+    mHandler(std::bind(&Subscriber::defaultHandler, this, std::placeholders::_1)),
+    mScheduled(false),
+    mGaps(0),
+    mDroppedDeltas(0)
+{
+    std::set<unsigned int> partitions;
+    for (const auto& point : points)
+    {
+        partitions.insert(partitionOf(point));
+    }
+    SubscriberHub::the().add(endpoint, partitions, this);
 }
 
 Subscriber::~Subscriber()
 {
-    mSocket.close();
+    SubscriberHub::the().remove(this);
+    // wait for a handler that is already queued/running
+    while (true)
+    {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            if (!mScheduled)
+            {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Subscriber::setExecutor(Executor executor)
+{
+    SubscriberHub::the().setExecutor(executor);
+}
+
+void Subscriber::setRepairEndpoint(const Endpoint& endpoint, const Endpoint& repair)
+{
+    SubscriberHub::the().setRepair(endpoint, repair);
+}
+
+std::uint64_t Subscriber::getIncompleteFrames()
+{
+    return SubscriberHub::the().getIncomplete();
+}
+
+std::uint64_t Subscriber::getRepairRequests()
+{
+    return SubscriberHub::the().getRepairRequests();
 }
 
 void Subscriber::defaultHandler(std::string& data)
@@ -31,23 +385,104 @@ void Subscriber::defaultHandler(std::string& data)
     return;
 }
 
-void Subscriber::run()
+void Subscriber::deliver(const std::shared_ptr<const std::string>& frame, const unsigned int stream)
+{
+    auto executor = SubscriberHub::the().getExecutor();
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mPending.size() >= MAX_PENDING)
+        {
+            mPending.pop_front();
+        }
+        mPending.emplace_back(frame, stream);
+        if (mScheduled)
+        {
+            // the queued task will pick it up
+            return;
+        }
+        mScheduled = true;
+    }
+
+    if (executor)
+    {
+        executor(std::bind(&Subscriber::drain, this));
+    }
+    else
+    {
+        drain();
+    }
+}
+
+void Subscriber::drain()
 {
-    while (mSocket.connected())
+    while (true)
     {
-        zmq::message_t msg;
-        try
+        std::shared_ptr<const std::string> frame;
+        unsigned int stream;
+        SubscriptionHandler handler;
+        FrameHandler frameHandler;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            if (mPending.empty())
+            {
+                mScheduled = false;
+                return;
+            }
+            frame = mPending.front().first;
+            stream = mPending.front().second;
+            mPending.pop_front();
+            handler = mHandler;
+            frameHandler = mFrameHandler;
+        }
+        if (!checkSequence(*frame, stream))
         {
-            mSocket.recv(&msg);
+            continue;
         }
-        catch (zmq::error_t& e)
+        if (frameHandler)
         {
-            printf("E: Server: %s\n", e.what());
-            break;
+            frameHandler(*frame);
+            continue;
         }
-        std::string data(msg.data<char>());
-        mHandler(data);
+        // handlers may modify the data, so each one gets its own copy
+        std::string data(*frame);
+        handler(data);
+    }
+}
+
+bool Subscriber::checkSequence(const std::string& frame, const unsigned int stream)
+{
+    if (!frame::isBinary(frame.data(), frame.size()))
+    {
+        return true; // text frames have no sequence numbers
+    }
+    FrameReader reader(frame.data(), frame.size());
+    const auto& header = reader.getHeader();
+
+    // each provider (dictionary version) numbers its frames on its own, per group
+    std::uint64_t key = (static_cast<std::uint64_t>(header.dictionary) << 32) | stream;
+    if (mStreams.size() > 16 * (PARTITIONS + 1) && mStreams.find(key) == mStreams.end())
+    {
+        mStreams.clear();
+    }
+    auto& state = mStreams[key];
+    if (state.seen && header.sequence != state.next)
+    {
+        mGaps.fetch_add(1, std::memory_order_relaxed);
+        state.synced = false;
+    }
+    state.seen = true;
+    state.next = header.sequence + 1;
+
+    if (header.type == frame::eData)
+    {
+        state.synced = true;
+    }
+    else if (header.type == frame::eDelta && !state.synced)
+    {
+        mDroppedDeltas.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
+    return true;
 }
 
 } // namespace distributed
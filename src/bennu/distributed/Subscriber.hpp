@@ -1,10 +1,17 @@
 #ifndef BENNU_DISTRIBUTED_SUBSCRIBER_HPP
 #define BENNU_DISTRIBUTED_SUBSCRIBER_HPP
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <functional> // std::function
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "zmq/zmq.hpp"
 
@@ -13,28 +20,112 @@
 namespace bennu {
 namespace distributed {
 
+/*
+ * Subscriber to a publish endpoint. All subscribers in a process share one
+ * DISH socket and one receive thread (see SubscriberHub in Subscriber.cpp),
+ * so hosting many field devices on the same endpoint costs one socket, not
+ * one per device. Handlers run on the receive thread unless an executor is
+ * set, in which case each subscriber's handler is posted to the executor.
+ * A subscriber never runs its handler concurrently with itself. Frames are
+ * handled in order (a large publish spans several frames, so none can be
+ * skipped); if it falls more than MAX_PENDING frames behind the oldest are
+ * dropped.
+ *
+ * Subscribers given their points also join the groups of those points'
+ * partitions (see partitionOf in Utils.hpp), for partitioned publishers.
+ *
+ * Binary frames are checked for lost sequence numbers (per group). After a gap, delta
+ * frames are dropped until the next keyframe brings the points up to date.
+ *
+ * Fragmented frames (see PublishFrame.hpp) are reassembled on the receive
+ * thread and delivered whole. One not complete within REASSEMBLY_TIMEOUT is
+ * dropped; if a repair endpoint was set for its publish endpoint (usually
+ * the provider's server), the missing fragments are NACKed first.
+ */
 class Subscriber
 {
 public:
     typedef std::function<void (std::string& data)> SubscriptionHandler;
 
+    // Gets the received frame itself (text or binary, see PublishFrame.hpp) without a copy
+    typedef std::function<void (const std::string& frame)> FrameHandler;
+
+    typedef std::function<void (std::function<void()> task)> Executor;
+
     Subscriber(const Endpoint& endpoint);
 
+    // Receive only the partitions holding 'points' (plus the endpoint's own group)
+    Subscriber(const Endpoint& endpoint, const std::vector<std::string>& points);
+
     ~Subscriber();
 
     void setHandler(SubscriptionHandler handler)
     {
+        std::scoped_lock<std::mutex> lock(mMutex);
         mHandler = handler;
     }
 
-    void run();
+    // Used instead of the SubscriptionHandler when set
+    void setFrameHandler(FrameHandler handler)
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mFrameHandler = handler;
+    }
+
+    // Where subscription handlers run from now on (process wide)
+    static void setExecutor(Executor executor);
+
+    // Ask 'repair' to re-send fragments lost from 'endpoint's publishes (process wide)
+    static void setRepairEndpoint(const Endpoint& endpoint, const Endpoint& repair);
+
+    // Fragmented frames dropped incomplete, and NACKs sent for them (process wide)
+    static std::uint64_t getIncompleteFrames();
+    static std::uint64_t getRepairRequests();
+
+    // Stream of frames from the endpoint's own group (partitions are numbered from 0)
+    static const unsigned int BASE_STREAM = 0xffff;
+
+    // Called by the receive thread with every frame published to a group this subscriber joined
+    void deliver(const std::shared_ptr<const std::string>& frame, const unsigned int stream);
+
+    // Sequence gaps seen in binary frames
+    std::uint64_t getGaps() const
+    {
+        return mGaps.load(std::memory_order_relaxed);
+    }
+
+    // Delta frames dropped while waiting for a keyframe after a gap
+    std::uint64_t getDroppedDeltas() const
+    {
+        return mDroppedDeltas.load(std::memory_order_relaxed);
+    }
 
 private:
+    struct Stream
+    {
+        std::uint64_t next{0};      // expected sequence number
+        bool seen{false};
+        bool synced{false};         // have a keyframe since the last gap
+    };
+
     void defaultHandler(std::string& data);
-    zmq::socket_t mSocket;
+
+    void drain();
+
+    // False if the frame is a delta that cannot be applied
+    bool checkSequence(const std::string& frame, const unsigned int stream);
+
     const std::string mGroup;
     SubscriptionHandler mHandler;
-    std::shared_ptr<std::thread> mSubscriberThread;
+    FrameHandler mFrameHandler;
+    std::mutex mMutex;
+    static const std::size_t MAX_PENDING = 4096;
+
+    std::deque<std::pair<std::shared_ptr<const std::string>, unsigned int>> mPending; // frames (and streams) not yet handled
+    bool mScheduled;                             // a drain() task is queued or running
+    std::unordered_map<std::uint64_t, Stream> mStreams; // dictionary version, stream ==> stream state (only touched by drain())
+    std::atomic<std::uint64_t> mGaps;
+    std::atomic<std::uint64_t> mDroppedDeltas;
 };
 
 } // namespace distributed
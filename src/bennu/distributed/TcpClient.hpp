@@ -99,7 +99,7 @@ public:
         }
     }
 
-    void receive(uint8_t* buffer, size_t)
+    void receive(uint8_t* buffer, size_t maxSize)
     {
         if (mSocket)
         {
@@ -116,6 +116,12 @@ public:
             std::memcpy(&readData, &buffer[4], 2);
 
             uint16_t length = ntohs(readData);
+            if (6u + length > maxSize)
+            {
+                std::cerr << "ERROR: receive message of length " << length << " does not fit in " << maxSize << " bytes" << std::endl;
+                disconnect();
+                return;
+            }
 
             boost::asio::read(*mSocket, boost::asio::buffer(&buffer[6], length), boost::asio::transfer_exactly(length), error);
             if (error)
@@ -1,9 +1,11 @@
 #ifndef BENNU_DISTRIBUTED_UTILS_HPP
 #define BENNU_DISTRIBUTED_UTILS_HPP
 
+#include <cstdint>
 #include <functional> // std::hash
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "zmq/zmq.hpp"
@@ -65,8 +67,39 @@ struct Endpoint
         ss << std::hex << hash;
         return ss.str().substr(0, ss.str().length()-1);
     }
+
+    /*
+     *  Group of one partition (see partitionOf) of a partitioned publisher:
+     *  11 characters of the endpoint hash, '.', then the partition in hex.
+     */
+    std::string group(const unsigned int partition) const
+    {
+        std::stringstream ss;
+        ss << hash().substr(0, 11) << "." << std::hex << partition;
+        return ss.str();
+    }
 };
 
+/*
+ * Partitioned publishers send each point on one of PARTITIONS groups chosen
+ * by the point name's prefix (the text before the first '.', e.g. "bus-1" in
+ * "bus-1.voltage"), so subscribers join only the groups holding their own
+ * points. FNV-1a rather than std::hash so every build agrees on the groups.
+ */
+const unsigned int PARTITIONS = 256;
+
+inline unsigned int partitionOf(std::string_view name)
+{
+    std::size_t dot = name.find('.');
+    std::string_view prefix = dot == std::string_view::npos ? name : name.substr(0, dot);
+    std::uint32_t hash = 2166136261u;
+    for (char c : prefix)
+    {
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * 16777619u;
+    }
+    return hash % PARTITIONS;
+}
+
 /*
  * Split a string using delimiter. Returns vector of strings.
  */
@@ -85,6 +118,48 @@ inline std::vector<std::string> split(std::string& phrase, std::string& delimite
     return list;
 }
 
+/*
+ * Shell style wildcard match: '*' matches any run of characters, '?' any one.
+ */
+inline bool globMatch(std::string_view pattern, std::string_view name)
+{
+    std::size_t p = 0, n = 0;
+    std::size_t star = std::string_view::npos, resume = 0;
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            ++p;
+            ++n;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            star = p++;
+            resume = n;
+        }
+        else if (star != std::string_view::npos)
+        {
+            // let the last '*' swallow one more character and try again
+            p = star + 1;
+            n = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+inline bool isGlob(std::string_view pattern)
+{
+    return pattern.find_first_of("*?") != std::string_view::npos;
+}
+
 } // namespace distributed
 } // namespace bennu
 
@@ -7,6 +7,7 @@
 #include <boost/program_options.hpp>
 
 #include "bennu/parsers/Parser.hpp"
+#include "bennu/utility/WorkerPool.hpp"
 
 namespace po = boost::program_options;
 
@@ -33,11 +34,12 @@ int main(int argc, char** argv)
 
     try
     {
-        std::string program = "A simulation startup for bennu field devices.";
+        std::string program = "A simulation startup for bennu field devices. The configuration file may define any number of <field-device> elements, which are all hosted in this process.";
         po::options_description desc(program);
         desc.add_options()
             ("help", "show this help menu")
-            ("file", po::value<std::string>(), "Configuration file to load");
+            ("file", po::value<std::string>(), "Configuration file to load")
+            ("workers", po::value<unsigned int>()->default_value(0), "Worker threads shared by all hosted field devices (0 = one per hardware thread)");
 
         po::store(po::parse_command_line(argc, argv, desc), vm);
         po::notify(vm);
@@ -58,6 +60,9 @@ int main(int argc, char** argv)
 
     bennu::parsers::Parser::the()->registerTagForDynamicLibrary("field-device", "bennu-field-device-base");
 
+    // Must be running before the devices are created so they schedule their scans on it
+    bennu::utility::WorkerPool::the()->start(vm["workers"].as<unsigned int>());
+
     if (vm.count("file"))
     {
         if (!bennu::parsers::Parser::the()->load(vm["file"].as<std::string>()))
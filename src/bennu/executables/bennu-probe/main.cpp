@@ -1,10 +1,15 @@
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <sstream>
+#include <string_view>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
 #include "bennu/distributed/Client.hpp"
+#include "bennu/distributed/PublishFrame.hpp"
 #include "bennu/distributed/Utils.hpp"
 
 namespace po = boost::program_options;
@@ -13,14 +18,30 @@ class Probe : public bennu::distributed::Client
 {
 public:
     Probe(const bennu::distributed::Endpoint& endpoint) :
-        bennu::distributed::Client(endpoint)
+        bennu::distributed::Client(endpoint),
+        mNext(0)
     {
         setHandler(std::bind(&Probe::handler, this, std::placeholders::_1));
+        setFrameHandler(std::bind(&Probe::frameHandler, this, std::placeholders::_1, std::placeholders::_2));
+    }
+
+    // Offset of the next page of a many-tag read (0 = none)
+    std::size_t next() const
+    {
+        return mNext;
     }
 
     void handler(const std::string& reply)
     {
         auto response = reply;
+        mNext = 0;
+        auto pos = response.rfind(';');
+        if (pos != std::string::npos && pos + 1 < response.size()
+            && response.find_first_not_of("0123456789", pos + 1) == std::string::npos)
+        {
+            mNext = std::stoul(response.substr(pos + 1));
+            response.erase(pos);
+        }
         std::string delim{","}, status, msg;
         try
         {
@@ -41,6 +62,47 @@ public:
             printf("Err: %s", e.what());
         }
     }
+
+    void frameHandler(const char* data, const std::size_t size)
+    {
+        using namespace bennu::distributed;
+        mNext = 0;
+        std::vector<std::string> names;
+        std::cout << "Reply:" << std::endl;
+        for (std::size_t offset = 0; offset < size;)
+        {
+            FrameReader reader(data + offset, size - offset);
+            if (!reader.valid())
+            {
+                printf("Err: malformed binary reply\n");
+                return;
+            }
+            std::uint32_t id;
+            std::string_view name;
+            while (reader.next(id, name))
+            {
+                names.resize(std::max<std::size_t>(names.size(), id + 1));
+                names[id] = std::string(name);
+            }
+            PointValue point;
+            while (reader.next(point))
+            {
+                std::cout << "\t" << (point.id < names.size() ? names[point.id] : std::to_string(point.id)) << ":";
+                if (point.binary)
+                {
+                    std::cout << (point.value != 0.0 ? "true" : "false") << std::endl;
+                }
+                else
+                {
+                    std::cout << point.value << std::endl;
+                }
+            }
+            offset += reader.getOffset();
+        }
+    }
+
+private:
+    std::size_t mNext;
 };
 
 int main(int argc, char** argv)
@@ -50,8 +112,9 @@ int main(int argc, char** argv)
     desc.add_options()
         ("help", "show this help menu")
         ("endpoint", po::value<std::string>()->default_value("tcp://127.0.0.1:1330"), "FEP (:1330) or Provider (:5555) endpoint")
-        ("command", po::value<std::string>(), "Command: query|read|write")
-        ("tag", po::value<std::string>(), "Full name of the tag, e.g. bus1.active")
+        ("command", po::value<std::string>(), "Command: query|read|snapshot|stats|write")
+        ("tag", po::value<std::string>(), "Full name of the tag, e.g. bus1.active (read: a,b,c or patterns like bus*.active; snapshot: patterns)")
+        ("binary", "ask for a binary reply to a many-tag read or a snapshot")
         ("value", po::value<float>(), "Value for a analog write")
         ("status", po::value<bool>(), "Status for a boolean write");
 
@@ -87,11 +150,11 @@ int main(int argc, char** argv)
     }
 
     std::string tag;
-    if (vm.count("tag") && (command == "read" || command == "write"))
+    if (vm.count("tag") && (command == "read" || command == "write" || command == "snapshot"))
     {
         tag = vm["tag"].as<std::string>();
     }
-    else if (command != "query")
+    else if (command != "query" && command != "snapshot" && command != "stats")
     {
         std::cout << "Error: you must define a tag for the read/write command." << std::endl;
         return -1;
@@ -104,11 +167,11 @@ int main(int argc, char** argv)
     std::ostringstream ss;
     ss << command << "=";
 
-    if (command == "query")
+    if (command == "query" || command == "stats")
     {
         if (vm.count("tag") || vm.count("value") || vm.count("status"))
         {
-            std::cout << "You cannot specify a tag, or set a value or a status for a query command." << std::endl;
+            std::cout << "You cannot specify a tag, or set a value or a status for a " << command << " command." << std::endl;
             return -1;
         }
     }
@@ -121,6 +184,15 @@ int main(int argc, char** argv)
         }
         ss << tag;
     }
+    else if (command == "snapshot")
+    {
+        if (vm.count("value") || vm.count("status"))
+        {
+            std::cout << "You cannot set a value or a status for a snapshot command." << std::endl;
+            return -1;
+        }
+        ss << tag;
+    }
     else if (command == "write")
     {
         if (vm.count("value") && vm.count("status"))
@@ -150,12 +222,28 @@ int main(int argc, char** argv)
     }
     else
     {
-        std::cout << "ERROR: command needs to be query, read, or write!" << std::endl;
+        std::cout << "ERROR: command needs to be query, read, snapshot, stats, or write!" << std::endl;
         return -1;
     }
 
+    if (vm.count("binary"))
+    {
+        if (command != "read" && command != "snapshot")
+        {
+            std::cout << "Binary replies are only available for read and snapshot commands." << std::endl;
+            return -1;
+        }
+        ss << ";binary";
+    }
+
     fflush(stdout);
     std::string msg{ss.str()};
     probe.send(msg);
+    // large many-tag reads come back a page at a time
+    while (probe.next())
+    {
+        std::string page{msg + ";" + std::to_string(probe.next())};
+        probe.send(page);
+    }
     return 0;
 }
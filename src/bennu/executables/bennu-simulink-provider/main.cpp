@@ -4,11 +4,14 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/fcntl.h>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <shared_mutex>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/date_time.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -129,8 +132,8 @@ class BennuSimulinkProvider : public Provider
 public:
     double publishRate_setting;
     
-    BennuSimulinkProvider(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint, bool debug, double publishRate) :
-        Provider(serverEndpoint, publishEndpoint),
+    BennuSimulinkProvider(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint, bool debug, double publishRate, unsigned int workers) :
+        Provider(serverEndpoint, publishEndpoint, workers),
         mLock(),
         mDebug(debug)
     {
@@ -179,10 +182,9 @@ public:
     std::string query()
     {
         if (mDebug) { std::cout << "BennuSimulinkProvider::query ---- received query request" << std::endl; }
-        std::scoped_lock<std::shared_mutex> lock(mLock);
-        sem_wait(mPublishSemaphore);
+        std::shared_lock<std::shared_mutex> lock(mLock);
         std::string result = "ACK=";
-        char* shmPtr = mPublishPointsShmAddress;
+        const char* shmPtr = copyPublishPoints();
         for (int i = 0; i < mNumPublishPoints; i++)
         {
             Dto dto{shmPtr};
@@ -193,7 +195,6 @@ public:
             result += tag + ",";
             shmPtr += MAX_MSG_LEN;
         }
-        sem_post(mPublishSemaphore);
         return result;
     }
 
@@ -201,10 +202,9 @@ public:
     std::string read(const std::string& tag)
     {
         if (mDebug) { std::cout << "BennuSimulinkProvider::read ---- received read for tag: " << tag << std::endl; }
-        std::scoped_lock<std::shared_mutex> lock(mLock);
-        sem_wait(mPublishSemaphore);
+        std::shared_lock<std::shared_mutex> lock(mLock);
         std::string result{""};
-        char* shmPtr = mPublishPointsShmAddress;
+        const char* shmPtr = copyPublishPoints();
         for (int i = 0; i < mNumPublishPoints; i++)
         {
             Dto dto{shmPtr};
@@ -223,7 +223,6 @@ public:
                 shmPtr += MAX_MSG_LEN;
             }
         }
-        sem_post(mPublishSemaphore);
 
         if (result == "")
         {
@@ -232,6 +231,46 @@ public:
         return result;
     }
 
+    // Must return "ACK=<tag>:<value>,<tag>:<value>,..." or "ERR=<error message>". One pass over
+    // the PublishPoints for the whole request, rather than read()'s search per tag.
+    std::string readTags(const std::vector<std::string>& tags)
+    {
+        if (mDebug) { std::cout << "BennuSimulinkProvider::readTags ---- received read for " << tags.size() << " tags" << std::endl; }
+        std::unordered_map<std::string, std::string> values; // requested tag ==> value ("" until found)
+        for (const auto& tag : tags)
+        {
+            values.emplace(tag, "");
+        }
+
+        {
+            std::shared_lock<std::shared_mutex> lock(mLock);
+            const char* shmPtr = copyPublishPoints();
+            for (int i = 0; i < mNumPublishPoints; i++)
+            {
+                Dto dto{shmPtr};
+                shmPtr += MAX_MSG_LEN;
+                auto iter = values.find(dto.field == "processModelIO" ? dto.tag : dto.tag + "." + dto.field);
+                if (iter != values.end())
+                {
+                    iter->second = dto.getDataString();
+                }
+            }
+        }
+
+        std::string result = "ACK=";
+        bool found = false;
+        for (const auto& tag : tags)
+        {
+            const auto& value = values[tag];
+            if (!value.empty())
+            {
+                result.append(tag).append(":").append(value).append(",");
+                found = true;
+            }
+        }
+        return found ? result : "ERR=Tags not found";
+    }
+
     // Must return "ACK=<success message>" or "ERR=<error message>"
     std::string write(const std::unordered_map<std::string,std::string>& tags)
     {
@@ -300,10 +339,9 @@ public:
 
     void publishData()
     {
-        std::scoped_lock<std::shared_mutex> lock(mLock);
-        sem_wait(mPublishSemaphore);
+        std::shared_lock<std::shared_mutex> lock(mLock);
         std::string message;
-        char* shmPtr = mPublishPointsShmAddress;
+        const char* shmPtr = copyPublishPoints();
         for (int i = 0; i < mNumPublishPoints; i++)
         {
             Dto dto{shmPtr};
@@ -314,12 +352,28 @@ public:
             message += tag + ":" + dto.getDataString() + ",";
             shmPtr += MAX_MSG_LEN;
         }
-        sem_post(mPublishSemaphore);
         if (mDebug) { std::cout << "BennuSimulinkProvider::publishData ---- publishing: " << message << std::endl; }
         publish(message);
     }
 
 private:
+    /*
+     * Copy the PublishPoints out of shared memory and return the copy (valid
+     * until this thread's next call). The solver is only held off for the
+     * copy, so readers on several server workers parse their copies, under
+     * a shared mLock, at the same time; writes and updates take mLock
+     * exclusively.
+     */
+    const char* copyPublishPoints()
+    {
+        thread_local std::vector<char> points;
+        points.resize(mPublishPointsShmSize);
+        sem_wait(mPublishSemaphore);
+        std::memcpy(points.data(), mPublishPointsShmAddress, mPublishPointsShmSize);
+        sem_post(mPublishSemaphore);
+        return points.data();
+    }
+
     int mNumPublishPoints;
     int mPublishPointsShmSize;
     int mPublishPointsShmId;
@@ -336,11 +390,24 @@ int main(int argc, char** argv)
 {
     std::cout.precision(PRECISION);
     bool debug{false};
+    bool binary{false};
+    bool delta{false};
+    bool partition{false};
+    bool fragment{false};
     po::options_description desc("Simulink Provider");
     desc.add_options()
         ("help",  "show this help menu")
         ("debug", po::bool_switch(&debug), "print debugging information")
+        ("binary", po::bool_switch(&binary), "publish binary frames instead of text")
+        ("delta", po::bool_switch(&delta), "only publish points that changed (implies --binary)")
+        ("keyframe-interval", po::value<unsigned int>()->default_value(10), "with --delta, publish every point every N publishes")
+        ("deadband", po::value<double>()->default_value(0.0), "with --delta, minimum change for an analog point to be published")
+        ("partition", po::bool_switch(&partition), "publish each point on its partition's group so field devices receive only their own points")
+        ("mtu", po::value<std::size_t>()->default_value(1500), "largest publish datagram; larger publishes are split across several")
+        ("fragment", po::bool_switch(&fragment), "send publishes larger than the MTU as fragments of one frame (C++ field devices only)")
+        ("repair-history", po::value<std::size_t>()->default_value(0), "with --fragment, fragmented publishes kept for re-sending fragments field devices lost (0 = none)")
         ("server-endpoint", po::value<std::string>()->default_value("tcp://127.0.0.1:5555"), "server listening endpoint")
+        ("server-workers", po::value<unsigned int>()->default_value(1), "number of threads serving READ/WRITE/QUERY requests")
         ("publish-endpoint", po::value<std::string>()->default_value("udp://239.0.0.1:40000"), "publishing endpoint")
         ("publish-rate", po::value<double>()->default_value(0.1), "rate at which updates are published from the provider to the simulation");
 
@@ -358,7 +425,20 @@ int main(int argc, char** argv)
     sEndpoint.str = vm["server-endpoint"].as<std::string>();
     pEndpoint.str = vm["publish-endpoint"].as<std::string>();
     double publishRate = vm["publish-rate"].as<double>();
-    BennuSimulinkProvider bsp(sEndpoint, pEndpoint, debug, publishRate);
+    BennuSimulinkProvider bsp(sEndpoint, pEndpoint, debug, publishRate, vm["server-workers"].as<unsigned int>());
+    if (binary || delta)
+    {
+        bsp.setFormat(Provider::eBinary);
+    }
+    if (delta)
+    {
+        bsp.setDeadband("", vm["deadband"].as<double>());
+        bsp.setDelta(true, vm["keyframe-interval"].as<unsigned int>());
+    }
+    bsp.setPartitioned(partition);
+    bsp.setMTU(vm["mtu"].as<std::size_t>());
+    bsp.setFragmented(fragment);
+    bsp.setRepairHistory(vm["repair-history"].as<std::size_t>());
     bsp.run();
     return 0;
 }
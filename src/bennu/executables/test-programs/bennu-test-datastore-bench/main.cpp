@@ -0,0 +1,148 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "bennu/devices/field-device/DataManager.hpp"
+
+namespace po = boost::program_options;
+
+using namespace bennu::field_device;
+
+/*
+ * Contention benchmark for the field device data store. A writer thread
+ * publishes whole frames the same way InputModule::subscriptionHandler does
+ * while N reader threads hammer the store through tag handles the same way
+ * the protocol servers do. Reports reader throughput and writer frame times.
+ */
+int main(int argc, char** argv)
+{
+    std::string program = "Field device data store contention benchmark";
+    po::options_description desc(program);
+    desc.add_options()
+        ("help",  "show this help menu")
+        ("readers", po::value<unsigned>()->default_value(4), "number of reader threads")
+        ("points", po::value<unsigned>()->default_value(10000), "number of i/o points")
+        ("block", po::value<unsigned>()->default_value(1), "points per reader request (>1 reads a consistent snapshot)")
+        ("rate", po::value<unsigned>()->default_value(0), "writer frames per second (0 = as fast as possible)")
+        ("seconds", po::value<unsigned>()->default_value(5), "benchmark duration");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    const unsigned numReaders = vm["readers"].as<unsigned>();
+    const unsigned numPoints = std::max(1u, vm["points"].as<unsigned>());
+    const unsigned block = std::max(1u, std::min(vm["block"].as<unsigned>(), numPoints));
+    const unsigned rate = vm["rate"].as<unsigned>();
+    const unsigned seconds = vm["seconds"].as<unsigned>();
+
+    DataManager dm;
+    std::vector<PointHandle> points;
+    std::vector<TagHandle> tags;
+    for (unsigned i = 0; i < numPoints; ++i)
+    {
+        std::string id = "point-" + std::to_string(i);
+        std::string name = "load-" + std::to_string(i) + "_bus-" + std::to_string(i) + ".mw";
+        dm.addExternalData<double>(id, name);
+        dm.addTagToPointMapping("tag-" + std::to_string(i), id);
+        points.push_back(dm.getPointHandle(name));
+        tags.push_back(dm.getTagHandle("tag-" + std::to_string(i)));
+    }
+
+    std::atomic<bool> running{true};
+    std::vector<unsigned long long> reads(numReaders, 0);
+    std::vector<std::thread> readers;
+    auto store = dm.getExternalData();
+
+    for (unsigned r = 0; r < numReaders; ++r)
+    {
+        readers.emplace_back([&, r]()
+        {
+            unsigned long long count = 0;
+            unsigned next = r * 7919 % numPoints;
+            double sink = 0;
+            while (running.load(std::memory_order_relaxed))
+            {
+                if (block == 1)
+                {
+                    sink += dm.getData<double>(tags[next]);
+                }
+                else
+                {
+                    unsigned start = next > numPoints - block ? 0 : next;
+                    store->readSnapshot([&]()
+                    {
+                        for (unsigned i = start; i < start + block; ++i)
+                        {
+                            sink += dm.getData<double>(tags[i]);
+                        }
+                    });
+                }
+                count += block;
+                next = (next + 4099) % numPoints;
+            }
+            reads[r] = count;
+            if (sink == -1) { std::cout << sink; } // keep the reads from being optimized away
+        });
+    }
+
+    unsigned long long frames = 0;
+    double maxFrame = 0, totalFrame = 0;
+    DataManager::PointBatch batch;
+    batch.reserve(numPoints);
+
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::seconds(seconds);
+    auto next = start;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        batch.clear();
+        for (unsigned i = 0; i < numPoints; ++i)
+        {
+            batch.emplace_back(points[i], static_cast<double>(frames + i));
+        }
+        dm.setDataByPoints(batch);
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        maxFrame = std::max(maxFrame, elapsed);
+        totalFrame += elapsed;
+        ++frames;
+
+        if (rate)
+        {
+            next += std::chrono::microseconds(1000000 / rate);
+            std::this_thread::sleep_until(next);
+        }
+    }
+    running = false;
+    for (auto& t : readers)
+    {
+        t.join();
+    }
+    double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long long totalReads = 0;
+    for (auto r : reads)
+    {
+        totalReads += r;
+    }
+
+    printf("readers=%u points=%u block=%u duration=%.2fs\n", numReaders, numPoints, block, duration);
+    printf("reads:  %llu total, %.0f/s total, %.0f/s per reader\n",
+           totalReads, totalReads / duration, numReaders ? totalReads / duration / numReaders : 0.0);
+    printf("writes: %llu frames, %.1f frames/s, %.1fus avg, %.1fus max per frame\n",
+           frames, frames / duration, frames ? totalFrame / frames : 0.0, maxFrame);
+    return 0;
+}
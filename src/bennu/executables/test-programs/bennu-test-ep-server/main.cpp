@@ -15,8 +15,8 @@ using namespace bennu::distributed;
 class ElectricPowerService : public Provider
 {
 public:
-    ElectricPowerService(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint, bool debug) :
-        Provider(serverEndpoint, publishEndpoint),
+    ElectricPowerService(const Endpoint& serverEndpoint, const Endpoint& publishEndpoint, bool debug, unsigned int workers) :
+        Provider(serverEndpoint, publishEndpoint, workers),
         mLock(),
         mDebug(debug)
     {
@@ -69,6 +69,7 @@ public:
     std::string query()
     {
         if (mDebug) { std::cout << "ElectricPowerService::query ---- received query request" << std::endl; }
+        std::shared_lock<std::shared_mutex> lock(mLock);
         std::string result = "ACK=";
         for (const auto& kv : mPS)
         {
@@ -81,12 +82,13 @@ public:
     std::string read(const std::string& tag)
     {
         if (mDebug) { std::cout << "ElectricPowerService::read ---- received read for tag: " << tag << std::endl; }
-        std::scoped_lock<std::shared_mutex> lock(mLock);
+        std::shared_lock<std::shared_mutex> lock(mLock);
         std::string result;
-        if (mPS.count(tag))
+        auto iter = mPS.find(tag);
+        if (iter != mPS.end())
         {
             result += "ACK=";
-            result += mPS[tag];
+            result += iter->second;
         }
         else
         {
@@ -159,6 +161,7 @@ int main(int argc, char** argv)
         ("help",  "show this help menu")
         ("debug", po::value<bool>()->default_value(false), "print debugging information")
         ("server-endpoint", po::value<std::string>()->default_value("tcp://127.0.0.1:5555"), "server listening endpoint")
+        ("server-workers", po::value<unsigned int>()->default_value(1), "number of threads serving READ/WRITE/QUERY requests")
         ("publish-endpoint", po::value<std::string>()->default_value("udp://239.0.0.1:40000"), "publishing endpoint");
 
     po::variables_map vm;
@@ -174,7 +177,7 @@ int main(int argc, char** argv)
     Endpoint sEndpoint, pEndpoint;
     sEndpoint.str = vm["server-endpoint"].as<std::string>();
     pEndpoint.str = vm["publish-endpoint"].as<std::string>();
-    ElectricPowerService ep(sEndpoint, pEndpoint, vm["debug"].as<bool>());
+    ElectricPowerService ep(sEndpoint, pEndpoint, vm["debug"].as<bool>(), vm["server-workers"].as<unsigned int>());
     ep.run();
     return 0;
 }
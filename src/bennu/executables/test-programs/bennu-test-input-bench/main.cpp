@@ -0,0 +1,184 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "bennu/devices/field-device/DataManager.hpp"
+#include "bennu/devices/modules/io/TextFrameParser.hpp"
+#include "bennu/distributed/Utils.hpp"
+
+namespace po = boost::program_options;
+
+using namespace bennu;
+using namespace bennu::field_device;
+
+/*
+ * Parse cost of a text publish frame on the field device side. Runs the
+ * frame through the previous InputModule parser (split into strings, stod
+ * every value, look every point up in the data store) and through
+ * io::TextFrameParser, applying the matches to the store in one batch the
+ * same way InputModule does. Uses a recorded publish (--frame) or generates
+ * one shaped like a provider's: "load-N_bus-N.mw:<value>,...", cut into
+ * MTU sized frames at point boundaries the way Publisher sends it.
+ */
+static std::size_t legacyParse(std::string data, const DataManager& dm, DataManager::PointBatch& batch)
+{
+    std::string pointDelimiter{","};
+    std::string valueDelimiter{":"};
+    auto points = distributed::split(data, pointDelimiter);
+    for (auto& t : points)
+    {
+        if (t.length() == 0 || t.find(":") == std::string::npos)
+        {
+            continue;
+        }
+        auto parts = distributed::split(t, valueDelimiter);
+        if (parts.size() < 2)
+        {
+            continue;
+        }
+        auto handle = dm.getPointHandle(parts[0]);
+        if (handle != INVALID_HANDLE)
+        {
+            if (parts[1] == "true" || parts[1] == "false")
+            {
+                batch.emplace_back(handle, parts[1] == "true");
+            }
+            else
+            {
+                try {
+                    batch.emplace_back(handle, std::stod(parts[1]));
+                } catch (std::exception&) {}
+            }
+        }
+    }
+    return batch.size();
+}
+
+int main(int argc, char** argv)
+{
+    std::string program = "Field device text frame parsing benchmark";
+    po::options_description desc(program);
+    desc.add_options()
+        ("help",  "show this help menu")
+        ("frame", po::value<std::string>(), "file holding a recorded publish frame (default: generate one)")
+        ("points", po::value<unsigned>()->default_value(50000), "points in a generated frame")
+        ("subscribed", po::value<unsigned>()->default_value(500), "points the device subscribes to (every Nth point of the frame)")
+        ("mtu", po::value<unsigned>()->default_value(1500), "publisher MTU the publish is split at")
+        ("iterations", po::value<unsigned>()->default_value(10), "times the whole publish is parsed per parser");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    const unsigned iterations = std::max(1u, vm["iterations"].as<unsigned>());
+
+    const unsigned mtu = std::max(64u, vm["mtu"].as<unsigned>());
+
+    std::string frame;
+    if (vm.count("frame"))
+    {
+        std::ifstream file(vm["frame"].as<std::string>());
+        if (!file)
+        {
+            std::cout << "ERROR: Cannot read " << vm["frame"].as<std::string>() << std::endl;
+            return 1;
+        }
+        std::stringstream ss;
+        ss << file.rdbuf();
+        frame = ss.str();
+    }
+    else
+    {
+        for (unsigned i = 0; i < vm["points"].as<unsigned>(); ++i)
+        {
+            std::string name = "load-" + std::to_string(i) + "_bus-" + std::to_string(i);
+            frame += name + ".mw:" + std::to_string(i * 1.25) + "," + name + ".active:" + (i % 2 ? "true" : "false") + ",";
+        }
+    }
+
+    // Split into frames and subscribe to an even spread of the points
+    std::vector<std::string> frames(1);
+    std::vector<std::string> names;
+    std::stringstream ss(frame);
+    std::string point;
+    while (std::getline(ss, point, ','))
+    {
+        auto colon = point.find(':');
+        if (colon != std::string::npos)
+        {
+            names.push_back(point.substr(0, colon));
+        }
+        if (frames.back().size() + point.size() + 1 >= mtu && !frames.back().empty())
+        {
+            frames.emplace_back();
+        }
+        frames.back() += point + ",";
+    }
+    const unsigned subscribed = std::max(1u, std::min<unsigned>(vm["subscribed"].as<unsigned>(), names.size()));
+    const std::size_t stride = std::max<std::size_t>(1, names.size() / subscribed);
+
+    DataManager dm;
+    io::TextFrameParser parser;
+    for (std::size_t i = 0; i < names.size(); i += stride)
+    {
+        if (names[i].find(".active") != std::string::npos)
+        {
+            dm.addExternalData<bool>(names[i], names[i]);
+        }
+        else
+        {
+            dm.addExternalData<double>(names[i], names[i]);
+        }
+        parser.addPoint(names[i], dm.getPointHandle(names[i]));
+    }
+    parser.build();
+
+    DataManager::PointBatch batch;
+    std::size_t legacyMatches = 0, parserMatches = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        legacyMatches = 0;
+        for (auto& f : frames)
+        {
+            batch.clear();
+            legacyMatches += legacyParse(f, dm, batch);
+            dm.setDataByPoints(batch);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        parserMatches = 0;
+        for (auto& f : frames)
+        {
+            batch.clear();
+            parserMatches += parser.parse(f, batch);
+            dm.setDataByPoints(batch);
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double legacyUs = std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations;
+    double parserUs = std::chrono::duration<double, std::micro>(t2 - t1).count() / iterations;
+    double mb = frame.size() / 1e6;
+
+    printf("publish=%zu bytes frames=%zu points=%zu subscribed=%zu iterations=%u\n", frame.size(), frames.size(), names.size(), parser.size(), iterations);
+    printf("legacy: %.1fus per publish, %.1f MB/s, %zu matches\n", legacyUs, mb / (legacyUs / 1e6), legacyMatches);
+    printf("parser: %.1fus per publish, %.1f MB/s, %zu matches\n", parserUs, mb / (parserUs / 1e6), parserMatches);
+    printf("speedup: %.1fx\n", legacyUs / parserUs);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "bennu/devices/modules/comms/modbus/protocol/codec.hpp"
+
+namespace po = boost::program_options;
+
+using namespace bennu::comms::modbus;
+
+/*
+ * Throughput benchmark for the modbus PDU codec. For each supported function
+ * code, encodes the request ADU a client sends and decodes the response ADU
+ * it gets back, the same calls the application layer and the client scanner
+ * make, at the largest quantity the function code allows (or --quantity).
+ */
+
+static unsigned long long gSink = 0;   // keeps the work from being optimized away
+
+template <typename F>
+static double time(unsigned iterations, F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        f(i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+static void report(const char* name, unsigned quantity, std::size_t requestSize, std::size_t responseSize, double encode, double decode)
+{
+    printf("%-26s qty=%-5u encode %4zuB %7.1fns (%6.2f Mreq/s)   decode %4zuB %7.1fns (%6.2f Mresp/s, %7.1f MB/s)\n",
+           name, quantity, requestSize, encode, 1e3 / encode, responseSize, decode, 1e3 / decode, responseSize * 1e3 / decode);
+}
+
+// Response to a read: header, function code, byte count, then the data
+static std::size_t readResponse(codec::adu_buffer_t& adu, std::uint8_t fc, std::size_t bytes)
+{
+    codec::put_header(&adu[0], 0, 1, 2 + bytes);
+    adu[codec::HEADER_SIZE] = fc;
+    adu[codec::HEADER_SIZE + 1] = static_cast<std::uint8_t>(bytes);
+    for (std::size_t i = 0; i < bytes; ++i)
+    {
+        adu[codec::HEADER_SIZE + 2 + i] = static_cast<std::uint8_t>(i * 37 + 11);
+    }
+    return codec::HEADER_SIZE + 2 + bytes;
+}
+
+int main(int argc, char** argv)
+{
+    std::string program = "Modbus PDU codec throughput benchmark";
+    po::options_description desc(program);
+    desc.add_options()
+        ("help",  "show this help menu")
+        ("iterations", po::value<unsigned>()->default_value(2000000), "requests and responses per function code")
+        ("quantity", po::value<unsigned>()->default_value(0), "coils/registers per request (0 = the most each function code allows)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    const unsigned iterations = std::max(1u, vm["iterations"].as<unsigned>());
+    const unsigned quantity = vm["quantity"].as<unsigned>();
+    auto qty = [quantity](unsigned max) { return static_cast<std::uint16_t>(quantity ? std::min(quantity, max) : max); };
+
+    codec::adu_buffer_t request;
+    codec::adu_buffer_t response;
+    bool bits[MB_MAX_READ_QTY_COILS];
+    std::uint16_t registers[MB_MAX_READ_QTY_HOLDING_REGS];
+    for (unsigned i = 0; i < MB_MAX_READ_QTY_COILS; ++i)
+    {
+        bits[i] = (i * 7919) % 3 == 0;
+    }
+    for (unsigned i = 0; i < MB_MAX_READ_QTY_HOLDING_REGS; ++i)
+    {
+        registers[i] = static_cast<std::uint16_t>(i * 40503u);
+    }
+
+    // round trip once before timing anything
+    {
+        bool decodedBits[MB_MAX_MULT_WRITE_QTY_COILS];
+        std::uint16_t decodedRegisters[MB_MAX_MULT_WRITE_QTY_HOLDING_REGS];
+        std::size_t size = codec::encode_write_coils_request(&request[0], 1, 1, 0, bits, qty(MB_MAX_MULT_WRITE_QTY_COILS));
+        codec::unpack_bits(&request[codec::HEADER_SIZE + 6], qty(MB_MAX_MULT_WRITE_QTY_COILS), decodedBits);
+        bool ok = size != 0 && std::equal(bits, bits + qty(MB_MAX_MULT_WRITE_QTY_COILS), decodedBits);
+        size = codec::encode_write_registers_request(&request[0], 1, 1, 0, registers, qty(MB_MAX_MULT_WRITE_QTY_HOLDING_REGS));
+        codec::decode_registers(&request[codec::HEADER_SIZE + 6], qty(MB_MAX_MULT_WRITE_QTY_HOLDING_REGS), decodedRegisters);
+        ok = ok && size != 0 && std::equal(registers, registers + qty(MB_MAX_MULT_WRITE_QTY_HOLDING_REGS), decodedRegisters);
+        if (!ok)
+        {
+            std::cerr << "ERROR: codec round trip failed" << std::endl;
+            return 1;
+        }
+    }
+
+    printf("iterations=%u\n", iterations);
+
+    // FC 1-4: a read request out, packed bits or registers back
+    struct Read { const char* name; std::uint8_t fc; bool binary; unsigned max; };
+    const Read reads[] = {
+        {"FC1  read coils", 0x01, true, MB_MAX_READ_QTY_COILS},
+        {"FC2  read discrete inputs", 0x02, true, MB_MAX_READ_QTY_DISCRETES},
+        {"FC3  read holding regs", 0x03, false, MB_MAX_READ_QTY_HOLDING_REGS},
+        {"FC4  read input regs", 0x04, false, MB_MAX_READ_QTY_INPUT_REGS},
+    };
+    for (const auto& read : reads)
+    {
+        std::uint16_t count = qty(read.max);
+        std::size_t size = readResponse(response, read.fc, read.binary ? codec::packed_size(count) : count * 2u);
+        double encode = time(iterations, [&](unsigned i) {
+            gSink += codec::encode_read_request(&request[0], static_cast<std::uint16_t>(i), 1, read.fc, static_cast<std::uint16_t>(i), count);
+            gSink += request[codec::HEADER_SIZE + 2];
+        });
+        double decode = time(iterations, [&](unsigned i) {
+            response[codec::HEADER_SIZE + 2] = static_cast<std::uint8_t>(i);
+            if (read.binary)
+            {
+                gSink += codec::decode_read_bits_response(&response[0], size, read.fc, count, bits);
+                gSink += bits[i % count];
+            }
+            else
+            {
+                gSink += codec::decode_read_registers_response(&response[0], size, read.fc, count, registers);
+                gSink += registers[i % count];
+            }
+        });
+        report(read.name, count, codec::READ_REQUEST_SIZE, size, encode, decode);
+    }
+
+    // FC 5, 6, 15, 16: a write request out, its echo back
+    struct Write { const char* name; std::uint8_t fc; unsigned max; };
+    const Write writes[] = {
+        {"FC5  write single coil", 0x05, 1},
+        {"FC6  write single reg", 0x06, 1},
+        {"FC15 write multi coils", 0x0F, MB_MAX_MULT_WRITE_QTY_COILS},
+        {"FC16 write multi regs", 0x10, MB_MAX_MULT_WRITE_QTY_HOLDING_REGS},
+    };
+    for (const auto& write : writes)
+    {
+        std::uint16_t count = qty(write.max);
+        std::size_t size = 0;
+        double encode = time(iterations, [&](unsigned i) {
+            std::uint16_t address = static_cast<std::uint16_t>(i);
+            switch (write.fc)
+            {
+                case 0x05:
+                    size = codec::encode_write_single_request(&request[0], address, 1, write.fc, address, i & 1 ? MB_MAX_COIL_VALUE : MB_MIN_COIL_VALUE);
+                    break;
+                case 0x06:
+                    size = codec::encode_write_single_request(&request[0], address, 1, write.fc, address, registers[i % MB_MAX_READ_QTY_HOLDING_REGS]);
+                    break;
+                case 0x0F:
+                    bits[i % count] = !bits[i % count];
+                    size = codec::encode_write_coils_request(&request[0], address, 1, address, bits, count);
+                    break;
+                default:
+                    registers[i % count] = address;
+                    size = codec::encode_write_registers_request(&request[0], address, 1, address, registers, count);
+                    break;
+            }
+            gSink += size + request[size - 1];
+        });
+
+        // the response to every write is the request's first five PDU bytes
+        std::copy(&request[0], &request[codec::READ_REQUEST_SIZE], &response[0]);
+        codec::put_header(&response[0], 0, 1, 5);
+        double decode = time(iterations, [&](unsigned i) {
+            response[codec::HEADER_SIZE + 4] = static_cast<std::uint8_t>(i);
+            gSink += codec::check_response(&response[0], codec::READ_REQUEST_SIZE, write.fc);
+        });
+        report(write.name, count, size, codec::READ_REQUEST_SIZE, encode, decode);
+    }
+
+    if (gSink == 1)
+    {
+        std::cout << gSink;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef BENNU_UTILITY_HISTOGRAM_HPP
+#define BENNU_UTILITY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace bennu {
+namespace utility {
+
+/*
+ * Lock-free histogram of non-negative samples (typically microseconds) with
+ * power-of-two buckets: bucket 0 counts samples of 0, bucket i counts samples
+ * in [2^(i-1), 2^i). One thread (or many) records while others read it.
+ * Percentiles are reported as the upper bound of the bucket they fall in.
+ */
+class Histogram
+{
+public:
+    static const std::size_t cBuckets = 40;
+
+    Histogram()
+    {
+        reset();
+    }
+
+    void add(std::int64_t sample)
+    {
+        std::uint64_t value = sample < 0 ? 0 : static_cast<std::uint64_t>(sample);
+        std::size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        if (bucket >= cBuckets)
+        {
+            bucket = cBuckets - 1;
+        }
+        mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        mSum.fetch_add(value, std::memory_order_relaxed);
+        std::uint64_t max = mMax.load(std::memory_order_relaxed);
+        while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+    }
+
+    void reset()
+    {
+        for (auto& b : mBuckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+        mCount.store(0, std::memory_order_relaxed);
+        mSum.store(0, std::memory_order_relaxed);
+        mMax.store(0, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const
+    {
+        return mCount.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t max() const
+    {
+        return mMax.load(std::memory_order_relaxed);
+    }
+
+    double mean() const
+    {
+        std::uint64_t n = count();
+        return n ? static_cast<double>(mSum.load(std::memory_order_relaxed)) / n : 0;
+    }
+
+    // Upper bound of the bucket holding the p-th percentile (0 < p <= 100)
+    std::uint64_t percentile(const double p) const
+    {
+        std::uint64_t n = count();
+        if (n == 0)
+        {
+            return 0;
+        }
+        std::uint64_t target = static_cast<std::uint64_t>(n * p / 100.0 + 0.5);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < cBuckets; ++i)
+        {
+            seen += mBuckets[i].load(std::memory_order_relaxed);
+            if (seen >= target && seen > 0)
+            {
+                return i == 0 ? 0 : std::min<std::uint64_t>((std::uint64_t(1) << i) - 1, max());
+            }
+        }
+        return max();
+    }
+
+    std::uint64_t bucket(const std::size_t i) const
+    {
+        return i < cBuckets ? mBuckets[i].load(std::memory_order_relaxed) : 0;
+    }
+
+    // Ex: "n=100 mean=12.5 p50=15 p99=27 max=27"
+    std::string summary() const
+    {
+        std::ostringstream ss;
+        ss << "n=" << count() << " mean=" << mean() << " p50=" << percentile(50)
+           << " p99=" << percentile(99) << " max=" << max();
+        return ss.str();
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, cBuckets> mBuckets;
+    std::atomic<std::uint64_t> mCount;
+    std::atomic<std::uint64_t> mSum;
+    std::atomic<std::uint64_t> mMax;
+};
+
+} // namespace utility
+} // namespace bennu
+
+#endif // BENNU_UTILITY_HISTOGRAM_HPP
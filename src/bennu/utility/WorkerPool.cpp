@@ -0,0 +1,136 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace bennu {
+namespace utility {
+
+WorkerPool::WorkerPool() :
+    mOrder(0),
+    mCompleted(0),
+    mRunning(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(unsigned int workers)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    if (mRunning || !mWorkers.empty())
+    {
+        return;
+    }
+    if (workers == 0)
+    {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mRunning = true;
+    for (unsigned int i = 0; i < workers; ++i)
+    {
+        mWorkers.emplace_back(std::bind(&WorkerPool::run, this));
+    }
+    std::cout << "I: WorkerPool started with " << workers << " workers" << std::endl;
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_all();
+    for (auto& t : mWorkers)
+    {
+        if (t.joinable())
+        {
+            t.join();
+        }
+    }
+}
+
+void WorkerPool::post(Task task)
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mReady.push_back(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void WorkerPool::postAt(const Clock::time_point& when, Task task)
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mTimed.push(Timed{when, mOrder++, std::move(task)});
+    }
+    // a worker may be sleeping until a later deadline
+    mCondition.notify_one();
+}
+
+std::uint64_t WorkerPool::getCompleted() const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    return mCompleted;
+}
+
+std::size_t WorkerPool::getBacklog() const
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    return mReady.size();
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mRunning)
+    {
+        // move due timers onto the ready queue
+        auto now = Clock::now();
+        while (!mTimed.empty() && mTimed.top().when <= now)
+        {
+            mReady.push_back(std::move(const_cast<Timed&>(mTimed.top()).task));
+            mTimed.pop();
+        }
+
+        if (mReady.empty())
+        {
+            if (mTimed.empty())
+            {
+                mCondition.wait(lock);
+            }
+            else
+            {
+                Clock::time_point next = mTimed.top().when;
+                mCondition.wait_until(lock, next);
+            }
+            continue;
+        }
+
+        Task task = std::move(mReady.front());
+        mReady.pop_front();
+        // more work may be waiting than this worker can take
+        if (!mReady.empty())
+        {
+            mCondition.notify_one();
+        }
+        lock.unlock();
+        try
+        {
+            task();
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "ERROR: WorkerPool task threw: " << e.what() << std::endl;
+        }
+        lock.lock();
+        ++mCompleted;
+    }
+}
+
+} // namespace utility
+} // namespace bennu
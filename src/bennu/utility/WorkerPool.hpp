@@ -0,0 +1,96 @@
+#ifndef BENNU_UTILITY_WORKERPOOL_HPP
+#define BENNU_UTILITY_WORKERPOOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "bennu/utility/Singleton.hpp"
+
+namespace bennu {
+namespace utility {
+
+/*
+ * Fixed-size pool of worker threads shared by everything hosted in the
+ * process (device scan cycles, subscription handlers, comms update tasks).
+ * Tasks are either run as soon as a worker is free (post) or no earlier than
+ * a steady_clock deadline (postAt). Tasks must not block for long; anything
+ * periodic should re-post itself instead of sleeping.
+ *
+ * The pool is idle until start() is called, so code that finds size() == 0
+ * should fall back to using its own thread.
+ */
+class WorkerPool : public Singleton<WorkerPool>
+{
+public:
+    friend class Singleton<WorkerPool>;
+
+    typedef std::function<void()> Task;
+    typedef std::chrono::steady_clock Clock;
+
+    ~WorkerPool();
+
+    // Start 'workers' threads (0 = one per hardware thread). Only the first call has any effect.
+    void start(unsigned int workers = 0);
+
+    void stop();
+
+    // Number of worker threads (0 until started)
+    std::size_t size() const
+    {
+        return mWorkers.size();
+    }
+
+    void post(Task task);
+
+    void postAt(const Clock::time_point& when, Task task);
+
+    // Tasks run so far
+    std::uint64_t getCompleted() const;
+
+    // Tasks waiting for a worker (not counting ones scheduled in the future)
+    std::size_t getBacklog() const;
+
+protected:
+    WorkerPool();
+
+    WorkerPool(const WorkerPool&);
+
+    WorkerPool& operator =(const WorkerPool&);
+
+private:
+    struct Timed
+    {
+        Clock::time_point when;
+        std::uint64_t order;     // keeps tasks with the same deadline in posting order
+        Task task;
+
+        bool operator>(const Timed& other) const
+        {
+            return when != other.when ? when > other.when : order > other.order;
+        }
+    };
+
+    void run();
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<Task> mReady;
+    std::priority_queue<Timed, std::vector<Timed>, std::greater<Timed>> mTimed;
+    std::vector<std::thread> mWorkers;
+    std::uint64_t mOrder;
+    std::uint64_t mCompleted;
+    bool mRunning;
+};
+
+} // namespace utility
+} // namespace bennu
+
+#endif // BENNU_UTILITY_WORKERPOOL_HPP
@@ -0,0 +1,325 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zmq/zmq.hpp"
+
+#include "bennu/distributed/PublishFrame.hpp"
+#include "bennu/distributed/Publisher.hpp"
+#include "bennu/distributed/Subscriber.hpp"
+#include "bennu/distributed/Utils.hpp"
+
+using namespace bennu::distributed;
+
+namespace {
+
+typedef std::vector<std::string> fragments_t;
+
+/*
+ * Sits between a Publisher and the subscribers: receives the fragments
+ * published to 'in', and once it has all of a frame's forwards them to 'out'
+ * as 'policy' rearranges them (dropped, reordered, duplicated). Fragments of
+ * a frame already forwarded (repairs) are passed straight on.
+ */
+class Relay
+{
+public:
+    typedef std::function<fragments_t (const fragments_t& fragments)> Policy;
+
+    Relay(const std::string& in, const std::string& out, Policy policy) :
+        mDish(Context::the()->getContext(), ZMQ_DISH),
+        mRadio(Context::the()->getContext(), ZMQ_RADIO),
+        mGroup(Endpoint{out}.hash()),
+        mPolicy(policy),
+        mRunning(true)
+    {
+        mDish.bind(in);
+        mDish.join(Endpoint{in}.hash().data());
+        mDish.setsockopt(ZMQ_RCVTIMEO, 10);
+        mRadio.connect(out);
+        mThread = std::thread(&Relay::run, this);
+    }
+
+    ~Relay()
+    {
+        mRunning = false;
+        mThread.join();
+        mDish.close();
+        mRadio.close();
+    }
+
+    // IDs of the fragmented frames forwarded so far
+    std::vector<std::uint32_t> getFrames()
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mFrames;
+    }
+
+private:
+    void run()
+    {
+        std::map<std::uint32_t, fragments_t> partials;
+        std::set<std::uint32_t> forwarded;
+        while (mRunning)
+        {
+            zmq::message_t msg;
+            if (!mDish.recv(&msg))
+            {
+                continue;
+            }
+            std::string data(msg.data<char>(), msg.size());
+            frame::Fragment fragment;
+            if (!frame::readFragment(data.data(), data.size(), fragment) || forwarded.count(fragment.id))
+            {
+                forward(data);
+                continue;
+            }
+            auto& fragments = partials[fragment.id];
+            fragments.resize(fragment.count);
+            fragments[fragment.index] = data;
+            if (std::any_of(fragments.begin(), fragments.end(), [](const std::string& f) { return f.empty(); }))
+            {
+                continue;
+            }
+            for (const auto& f : mPolicy(fragments))
+            {
+                forward(f);
+            }
+            forwarded.insert(fragment.id);
+            partials.erase(fragment.id);
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mFrames.push_back(fragment.id);
+        }
+    }
+
+    void forward(const std::string& data)
+    {
+        zmq::message_t msg(data.data(), data.size());
+        msg.set_group(mGroup.data());
+        mRadio.send(msg);
+    }
+
+    zmq::socket_t mDish;
+    zmq::socket_t mRadio;
+    const std::string mGroup;
+    Policy mPolicy;
+    std::atomic<bool> mRunning;
+    std::mutex mMutex;
+    std::vector<std::uint32_t> mFrames;
+    std::thread mThread;
+};
+
+// Text publish of 'points' points, large enough to take a dozen fragments at a 200 byte MTU
+std::string publishText(const unsigned int frame, const unsigned int points = 100)
+{
+    std::string text;
+    for (unsigned int i = 0; i < points; ++i)
+    {
+        text += "frame" + std::to_string(frame) + ".point" + std::to_string(i) + ":" + std::to_string(i * 1.5) + ",";
+    }
+    return text;
+}
+
+// Subscriber collecting what it receives
+struct Collector
+{
+    explicit Collector(const std::string& endpoint) :
+        subscriber(Endpoint{endpoint})
+    {
+        subscriber.setHandler([this](std::string& data) {
+            std::scoped_lock<std::mutex> lock(mutex);
+            received.push_back(data);
+        });
+    }
+
+    std::vector<std::string> get()
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        return received;
+    }
+
+    // Wait up to 'timeout' for 'count' frames
+    std::vector<std::string> wait(const std::size_t count, const std::chrono::milliseconds& timeout)
+    {
+        auto until = std::chrono::steady_clock::now() + timeout;
+        while (get().size() < count && std::chrono::steady_clock::now() < until)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return get();
+    }
+
+    Subscriber subscriber;
+    std::mutex mutex;
+    std::vector<std::string> received;
+};
+
+} // namespace
+
+TEST_CASE("testing fragments -- reordered and duplicated fragments are reassembled once")
+{
+    const std::string in("udp://127.0.0.1:59961");
+    const std::string out("udp://127.0.0.1:59962");
+    Collector collector(out);
+    // every fragment twice, last first, then the whole frame again once it is complete
+    Relay relay(in, out, [](const fragments_t& fragments) {
+        fragments_t result;
+        for (auto f = fragments.rbegin(); f != fragments.rend(); ++f)
+        {
+            result.push_back(*f);
+            result.push_back(*f);
+        }
+        result.insert(result.end(), fragments.begin(), fragments.end());
+        return result;
+    });
+    Publisher publisher(Endpoint{in});
+    publisher.setMTU(200);
+    publisher.setFragmented(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::uint64_t incomplete = Subscriber::getIncompleteFrames();
+    std::vector<std::string> sent;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        sent.push_back(publishText(i));
+        publisher.publish(sent.back());
+    }
+
+    auto received = collector.wait(3, std::chrono::milliseconds(400));
+    // nothing more turns up from the duplicates
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    CHECK(collector.get() == received);
+    CHECK(received == sent);
+    CHECK(relay.getFrames().size() == 3);
+    CHECK(Subscriber::getIncompleteFrames() == incomplete);
+}
+
+TEST_CASE("testing fragments -- a frame missing a fragment is dropped after the timeout")
+{
+    const std::string in("udp://127.0.0.1:59963");
+    const std::string out("udp://127.0.0.1:59964");
+    Collector collector(out);
+    // the first frame loses its second fragment; no repair endpoint is set for 'out'
+    std::atomic<unsigned int> frames(0);
+    Relay relay(in, out, [&frames](const fragments_t& fragments) {
+        fragments_t result(fragments);
+        if (frames++ == 0)
+        {
+            result.erase(result.begin() + 1);
+        }
+        return result;
+    });
+    Publisher publisher(Endpoint{in});
+    publisher.setMTU(200);
+    publisher.setFragmented(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::uint64_t incomplete = Subscriber::getIncompleteFrames();
+    std::uint64_t nacks = Subscriber::getRepairRequests();
+    std::string lost(publishText(0));
+    std::string whole(publishText(1));
+    publisher.publish(lost);
+    publisher.publish(whole);
+
+    // later frames are not held up by the incomplete one
+    CHECK(collector.wait(1, std::chrono::milliseconds(400)) == std::vector<std::string>{whole});
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    CHECK(collector.get() == std::vector<std::string>{whole});
+    CHECK(Subscriber::getIncompleteFrames() == incomplete + 1);
+    CHECK(Subscriber::getRepairRequests() == nacks);
+}
+
+TEST_CASE("testing fragments -- lost fragments are NACKed and repaired")
+{
+    const std::string in("udp://127.0.0.1:59965");
+    const std::string out("udp://127.0.0.1:59966");
+    const std::string repair("tcp://127.0.0.1:5994");
+    Collector collector(out);
+    // fragments 2 and 5 are lost, the rest arrive out of order
+    Relay relay(in, out, [](const fragments_t& fragments) {
+        fragments_t result;
+        for (std::size_t i = 0; i < fragments.size(); ++i)
+        {
+            if (i != 2 && i != 5)
+            {
+                result.insert(i % 2 ? result.begin() : result.end(), fragments[i]);
+            }
+        }
+        return result;
+    });
+    Publisher publisher(Endpoint{in});
+    publisher.setMTU(200);
+    publisher.setFragmented(true);
+    publisher.setRepairHistory(4);
+
+    // the provider's side of repair: NACK=<frame id>:<index>,... answered by Publisher::repair
+    std::mutex mutex;
+    std::vector<std::string> nacks;
+    std::atomic<bool> running(true);
+    zmq::socket_t router(Context::the()->getContext(), ZMQ_ROUTER);
+    router.bind(repair);
+    std::thread provider([&]() {
+        while (running)
+        {
+            zmq::pollitem_t items[] = { { router, 0, ZMQ_POLLIN, 0 } };
+            zmq::poll(&items[0], 1, 10);
+            if (!(items[0].revents & ZMQ_POLLIN))
+            {
+                continue;
+            }
+            // [identity][request id][empty][body]
+            std::vector<zmq::message_t> parts(1);
+            router.recv(&parts.back());
+            while (parts.back().more())
+            {
+                parts.emplace_back();
+                router.recv(&parts.back());
+            }
+            std::string request(parts.back().data<char>(), strnlen(parts.back().data<char>(), parts.back().size()));
+            {
+                std::scoped_lock<std::mutex> lock(mutex);
+                nacks.push_back(request);
+            }
+            std::string reply = publisher.repair(request.substr(request.find('=') + 1));
+            zmq::message_t ack(reply + '\0');
+            router.send(parts[0], ZMQ_SNDMORE);
+            router.send(parts[1], ZMQ_SNDMORE);
+            router.send(parts[2], ZMQ_SNDMORE);
+            router.send(ack);
+        }
+    });
+    Subscriber::setRepairEndpoint(Endpoint{out}, Endpoint{repair});
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::uint64_t incomplete = Subscriber::getIncompleteFrames();
+    std::uint64_t requests = Subscriber::getRepairRequests();
+    std::string sent(publishText(0));
+    publisher.publish(sent);
+
+    // repaired well within the reassembly timeout, and delivered once however many NACKs went out
+    CHECK(collector.wait(1, std::chrono::milliseconds(400)) == std::vector<std::string>{sent});
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    CHECK(collector.get() == std::vector<std::string>{sent});
+    CHECK(Subscriber::getIncompleteFrames() == incomplete);
+    CHECK(Subscriber::getRepairRequests() > requests);
+
+    running = false;
+    provider.join();
+    router.close();
+
+    auto frames = relay.getFrames();
+    REQUIRE(frames.size() == 1);
+    std::scoped_lock<std::mutex> lock(mutex);
+    REQUIRE_FALSE(nacks.empty());
+    CHECK(nacks[0] == "NACK=" + std::to_string(frames[0]) + ":2,5,");
+}
@@ -0,0 +1,135 @@
+#include "doctest.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "bennu/devices/modules/logic/LogicProgram.hpp"
+#include "bennu/devices/modules/logic/cparse/shunting-yard.h" // calculator, TokenMap
+
+// Defined with cparse's built-in operations and functions in bennu-logic (see LogicModule)
+void cparse_startup();
+
+using namespace bennu::logic;
+
+namespace {
+
+// _t0.._t5 as LogicModule binds them: tags read into bool or number variables
+const std::vector<LogicProgram::Type> TYPES = {
+    LogicProgram::eBool, LogicProgram::eBool,
+    LogicProgram::eNumber, LogicProgram::eNumber, LogicProgram::eNumber, LogicProgram::eNumber
+};
+const std::vector<double> VALUES = {1.0, 0.0, 7.5, -2.25, 0.0, 3.0};
+
+TokenMap variables()
+{
+    TokenMap vars;
+    for (std::size_t i = 0; i < TYPES.size(); ++i)
+    {
+        const std::string name = "_t" + std::to_string(i);
+        if (TYPES[i] == LogicProgram::eBool)
+        {
+            vars[name] = packToken(VALUES[i] != 0.0);
+        }
+        else
+        {
+            vars[name] = packToken(VALUES[i]);
+        }
+    }
+    return vars;
+}
+
+// Result of 'expr' as the bytecode computes it for one instance
+double evaluate(const LogicProgram& program)
+{
+    std::vector<double> regs(program.getNumRegisters(), 0.0);
+    std::copy(VALUES.begin(), VALUES.end(), regs.begin());
+    program.evaluate(regs.data(), 1, 1, {});
+    return regs[program.getOutput(0)];
+}
+
+} // namespace
+
+TEST_CASE("testing logic program -- results match cparse")
+{
+    cparse_startup();
+    TokenMap vars = variables();
+
+    const std::vector<std::string> expressions = {
+        // precedence and associativity
+        "_t2 + _t5 * 2",
+        "(_t2 + _t5) * 2",
+        "_t2 - _t5 - 1",
+        "_t2 / _t5 / 2",
+        "2 ** 3 ** 2",
+        "-_t5 ** 2",
+        "_t3 * -2",
+        "+_t3 - -_t5",
+        "_t5 << 1 + 1",
+        "_t2 + 1 < _t5 * 3",
+        "_t2 > _t5 && _t4 == 0",
+        "_t0 || _t1 && _t1",
+        "(_t0 || _t1) && _t1",
+        "_t2 >= 7.5 || _t3 <= -3",
+        "_t2 != _t3 == _t0",
+        "abs(_t3) + sqrt(16) * 2",
+        "sin(_t4) + cos(_t4) - tan(_t4)",
+
+        // '!' on booleans
+        "!_t0",
+        "!_t1 && _t0",
+        "!(_t2 > _t5)",
+        "!(!_t0)",
+
+        // integer truncation of '%', '<<', '>>', '&&' and '||'
+        "_t2 % _t5",
+        "_t3 % 2",
+        "-7.9 % 3",
+        "_t2 << 1",
+        "_t2 >> 1",
+        "_t3 >> 1",
+        "_t2 && 0.5",
+        "_t3 || _t4",
+        "0.9 || 0",
+        "_t5 && _t2",
+
+        // mod by zero
+        "_t2 % _t4",
+        "_t2 % 0.5",
+    };
+
+    for (const auto& expr : expressions)
+    {
+        INFO(expr);
+        auto program = LogicProgram::compile({expr}, TYPES);
+        REQUIRE(program);
+
+        calculator calc;
+        calc.compile(expr.c_str());
+        packToken expected = calc.eval(vars);
+        double result = evaluate(*program);
+        if (expected->type == BOOL)
+        {
+            CHECK((result != 0.0) == expected.asBool());
+            CHECK((result == 0.0 || result == 1.0));
+        }
+        else if (std::isnan(expected.asDouble()))
+        {
+            CHECK(std::isnan(result));
+        }
+        else
+        {
+            CHECK(result == doctest::Approx(expected.asDouble()));
+        }
+    }
+}
+
+TEST_CASE("testing logic program -- lines left to cparse")
+{
+    // cparse only defines '!' for booleans, and names must be bound variables
+    for (const std::string expr : {"!_t2", "!(_t2 + 1)", "_t9 + 1", "max(_t2, _t3)", "_t2 !", "(_t2 + 1", "_t2 +"})
+    {
+        INFO(expr);
+        CHECK_FALSE(LogicProgram::compile({expr}, TYPES));
+    }
+}
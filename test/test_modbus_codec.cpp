@@ -0,0 +1,230 @@
+#include "doctest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "bennu/devices/modules/comms/modbus/protocol/codec.hpp"
+
+using namespace bennu::comms::modbus;
+
+namespace {
+
+typedef std::vector<std::uint8_t> bytes_t;
+
+// Response ADU around 'pdu', its MBAP length field counting the unit id and the PDU
+bytes_t response(const bytes_t& pdu, std::uint16_t transaction_id = 0x0001)
+{
+    bytes_t adu(codec::HEADER_SIZE);
+    codec::put_header(adu.data(), transaction_id, 0x11, pdu.size());
+    adu.insert(adu.end(), pdu.begin(), pdu.end());
+    return adu;
+}
+
+// The examples of the Modbus Application Protocol Specification V1.1b3, section 6
+const std::vector<bool> COILS_20_38 = {
+    1, 0, 1, 1, 0, 0, 1, 1,   // 0xCD
+    1, 1, 0, 1, 0, 1, 1, 0,   // 0x6B
+    1, 0, 1                   // 0x05
+};
+
+const std::vector<bool> INPUTS_197_218 = {
+    0, 0, 1, 1, 0, 1, 0, 1,   // 0xAC
+    1, 1, 0, 1, 1, 0, 1, 1,   // 0xDB
+    1, 0, 1, 0, 1, 1          // 0x35
+};
+
+} // namespace
+
+TEST_CASE("testing modbus codec -- packing eight bits at a time")
+{
+    for (unsigned byte = 0; byte < 256; ++byte)
+    {
+        bool values[8];
+        codec::detail::unpack8(static_cast<std::uint8_t>(byte), values);
+        for (unsigned bit = 0; bit < 8; ++bit)
+        {
+            REQUIRE(values[bit] == static_cast<bool>((byte >> bit) & 1));
+        }
+        REQUIRE(codec::detail::pack8(values) == byte);
+    }
+
+    // quantities around and past the 64 bit chunks of the std::vector<bool> path
+    for (std::size_t quantity : {1, 7, 8, 9, 19, 63, 64, 65, 70, 1968})
+    {
+        std::vector<bool> values(quantity);
+        bool array[2000];
+        for (std::size_t i = 0; i < quantity; ++i)
+        {
+            values[i] = array[i] = (i * 7 + quantity) % 3 == 0;
+        }
+        bytes_t fromVector(codec::packed_size(quantity), 0xEE), fromArray(codec::packed_size(quantity), 0xEE);
+        codec::pack_bits(values, fromVector.data());
+        codec::pack_bits(array, quantity, fromArray.data());
+        CHECK(fromVector == fromArray);
+        // unused high bits of the last byte are zero
+        CHECK((fromArray.back() >> (quantity % 8 ? quantity % 8 : 8)) == 0);
+
+        std::vector<bool> unpacked;
+        codec::unpack_bits(fromArray.data(), quantity, unpacked);
+        CHECK(unpacked == values);
+    }
+}
+
+TEST_CASE("testing modbus codec -- unpacking masks the last byte")
+{
+    const std::uint8_t packed[] = {0xFF, 0xFF};
+
+    // appended after what is already there, nothing past 'quantity'
+    std::vector<bool> values{false};
+    codec::unpack_bits(packed, 11, values);
+    REQUIRE(values.size() == 12);
+    CHECK_FALSE(values[0]);
+    for (std::size_t i = 1; i < values.size(); ++i)
+    {
+        CHECK(values[i]);
+    }
+
+    bool array[16];
+    std::fill(array, array + 16, false);
+    codec::unpack_bits(packed, 11, array);
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        CHECK(array[i] == (i < 11));
+    }
+}
+
+TEST_CASE("testing modbus codec -- read requests (FC 1-4)")
+{
+    codec::adu_buffer_t adu;
+    REQUIRE(codec::encode_read_request(adu.data(), 0x1234, 0x11, 0x01, 0x0013, 0x0013) == codec::READ_REQUEST_SIZE);
+    CHECK(bytes_t(adu.begin(), adu.begin() + codec::READ_REQUEST_SIZE)
+        == bytes_t{0x12, 0x34, 0x00, 0x00, 0x00, 0x06, 0x11, 0x01, 0x00, 0x13, 0x00, 0x13});
+
+    REQUIRE(codec::encode_read_request(adu.data(), 0x0001, 0x01, 0x02, 0x00C4, 0x0016) == codec::READ_REQUEST_SIZE);
+    CHECK(bytes_t(adu.begin() + codec::HEADER_SIZE, adu.begin() + codec::READ_REQUEST_SIZE) == bytes_t{0x02, 0x00, 0xC4, 0x00, 0x16});
+    REQUIRE(codec::encode_read_request(adu.data(), 0x0001, 0x01, 0x03, 0x006B, 0x0003) == codec::READ_REQUEST_SIZE);
+    CHECK(bytes_t(adu.begin() + codec::HEADER_SIZE, adu.begin() + codec::READ_REQUEST_SIZE) == bytes_t{0x03, 0x00, 0x6B, 0x00, 0x03});
+    REQUIRE(codec::encode_read_request(adu.data(), 0x0001, 0x01, 0x04, 0x0008, 0x0001) == codec::READ_REQUEST_SIZE);
+    CHECK(bytes_t(adu.begin() + codec::HEADER_SIZE, adu.begin() + codec::READ_REQUEST_SIZE) == bytes_t{0x04, 0x00, 0x08, 0x00, 0x01});
+
+    // quantities the function codes do not allow
+    CHECK(codec::encode_read_request(adu.data(), 1, 1, 0x01, 0, 0) == 0);
+    CHECK(codec::encode_read_request(adu.data(), 1, 1, 0x01, 0, 2000) == codec::READ_REQUEST_SIZE);
+    CHECK(codec::encode_read_request(adu.data(), 1, 1, 0x02, 0, 2001) == 0);
+    CHECK(codec::encode_read_request(adu.data(), 1, 1, 0x03, 0, 125) == codec::READ_REQUEST_SIZE);
+    CHECK(codec::encode_read_request(adu.data(), 1, 1, 0x04, 0, 126) == 0);
+}
+
+TEST_CASE("testing modbus codec -- read responses (FC 1-4)")
+{
+    // FC 1: 19 coils in three bytes
+    auto adu = response({0x01, 0x03, 0xCD, 0x6B, 0x05});
+    std::vector<bool> bits;
+    CHECK(codec::decode_read_bits_response(adu.data(), adu.size(), 0x01, 19, bits) == error_code_t::NO_ERROR);
+    CHECK(bits == COILS_20_38);
+
+    bool array[19];
+    CHECK(codec::decode_read_bits_response(adu.data(), adu.size(), 0x01, 19, array) == error_code_t::NO_ERROR);
+    CHECK(std::vector<bool>(array, array + 19) == COILS_20_38);
+
+    // FC 2: 22 discrete inputs
+    adu = response({0x02, 0x03, 0xAC, 0xDB, 0x35});
+    bits.clear();
+    CHECK(codec::decode_read_bits_response(adu.data(), adu.size(), 0x02, 22, bits) == error_code_t::NO_ERROR);
+    CHECK(bits == INPUTS_197_218);
+
+    // FC 3 and 4
+    adu = response({0x03, 0x06, 0x02, 0x2B, 0x00, 0x00, 0x00, 0x64});
+    std::vector<std::uint16_t> registers;
+    CHECK(codec::decode_read_registers_response(adu.data(), adu.size(), 0x03, 3, registers) == error_code_t::NO_ERROR);
+    CHECK(registers == std::vector<std::uint16_t>{0x022B, 0x0000, 0x0064});
+
+    adu = response({0x04, 0x02, 0x00, 0x0A});
+    std::uint16_t value = 0;
+    CHECK(codec::decode_read_registers_response(adu.data(), adu.size(), 0x04, 1, &value) == error_code_t::NO_ERROR);
+    CHECK(value == 0x000A);
+
+    // exceptions and other function codes
+    adu = response({0x81, 0x02});
+    bits.clear();
+    CHECK(codec::decode_read_bits_response(adu.data(), adu.size(), 0x01, 19, bits) == error_code_t::ILLEGAL_DATA_ADDRESS);
+    CHECK(bits.empty());
+    CHECK(codec::check_response(adu.data(), adu.size(), 0x03) == error_code_t::ERROR);
+}
+
+TEST_CASE("testing modbus codec -- write requests (FC 15 and 16)")
+{
+    codec::adu_buffer_t adu;
+
+    // FC 15: 10 coils from 20
+    const bytes_t coils{0x00, 0x01, 0x00, 0x00, 0x00, 0x09, 0x11, 0x0F, 0x00, 0x13, 0x00, 0x0A, 0x02, 0xCD, 0x01};
+    bool values[10] = {1, 0, 1, 1, 0, 0, 1, 1, 1, 0};
+    std::size_t size = codec::encode_write_coils_request(adu.data(), 0x0001, 0x11, 0x0013, values, 10);
+    CHECK(bytes_t(adu.begin(), adu.begin() + size) == coils);
+    size = codec::encode_write_coils_request(adu.data(), 0x0001, 0x11, 0x0013, std::vector<bool>(values, values + 10));
+    CHECK(bytes_t(adu.begin(), adu.begin() + size) == coils);
+
+    // the packed bytes unpack to what was written
+    std::vector<bool> unpacked;
+    codec::unpack_bits(&adu[codec::HEADER_SIZE + 6], 10, unpacked);
+    CHECK(unpacked == std::vector<bool>(values, values + 10));
+
+    // FC 16: two registers from 1
+    const std::uint16_t registers[] = {0x000A, 0x0102};
+    size = codec::encode_write_registers_request(adu.data(), 0x0001, 0x11, 0x0001, registers, 2);
+    CHECK(bytes_t(adu.begin(), adu.begin() + size)
+        == bytes_t{0x00, 0x01, 0x00, 0x00, 0x00, 0x0B, 0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04, 0x00, 0x0A, 0x01, 0x02});
+    std::uint16_t decoded[2];
+    codec::decode_registers(&adu[codec::HEADER_SIZE + 6], 2, decoded);
+    CHECK(decoded[0] == registers[0]);
+    CHECK(decoded[1] == registers[1]);
+
+    // quantities the function codes do not allow, and the largest that fit an ADU
+    CHECK(codec::encode_write_coils_request(adu.data(), 1, 1, 0, values, 0) == 0);
+    CHECK(codec::encode_write_coils_request(adu.data(), 1, 1, 0, std::vector<bool>(1969)) == 0);
+    CHECK(codec::encode_write_coils_request(adu.data(), 1, 1, 0, std::vector<bool>(1968)) == codec::HEADER_SIZE + 6 + 246);
+    std::vector<std::uint16_t> many(124);
+    CHECK(codec::encode_write_registers_request(adu.data(), 1, 1, 0, many.data(), 124) == 0);
+    CHECK(codec::encode_write_registers_request(adu.data(), 1, 1, 0, many.data(), 123) == codec::HEADER_SIZE + 6 + 246);
+    CHECK(codec::HEADER_SIZE + 6 + 246 <= MB_MAX_ADU_LENGTH);
+}
+
+TEST_CASE("testing modbus codec -- length fields are checked")
+{
+    error_code_t::type error;
+
+    // truncated: no function code
+    auto adu = response({0x03, 0x02, 0x00, 0x0A});
+    CHECK(codec::check_response(adu.data(), codec::HEADER_SIZE + 1, 0x03) == error_code_t::LENGTH_CONSTRAINT_FAILURE);
+
+    // MBAP length past the received bytes
+    CHECK(codec::read_response_data(adu.data(), adu.size() - 1, 0x03, 2, error) == nullptr);
+    CHECK(error == error_code_t::LENGTH_CONSTRAINT_FAILURE);
+
+    // MBAP length too short for a PDU, or past any ADU
+    codec::put_u16(&adu[MBAP_HDR_LENGTH], 2);
+    CHECK(codec::check_response(adu.data(), adu.size(), 0x03) == error_code_t::LENGTH_CONSTRAINT_FAILURE);
+    std::vector<std::uint8_t> big(MB_MAX_ADU_LENGTH + 8, 0);
+    std::copy(adu.begin(), adu.end(), big.begin());
+    codec::put_u16(&big[MBAP_HDR_LENGTH], MB_MAX_ADU_LENGTH);
+    CHECK(codec::check_response(big.data(), big.size(), 0x03) == error_code_t::LENGTH_CONSTRAINT_FAILURE);
+
+    // byte count not matching the request
+    adu = response({0x03, 0x02, 0x00, 0x0A});
+    std::vector<std::uint16_t> registers;
+    CHECK(codec::decode_read_registers_response(adu.data(), adu.size(), 0x03, 2, registers) == error_code_t::LENGTH_CONSTRAINT_FAILURE);
+    CHECK(registers.empty());
+
+    // byte count over-long for the MBAP length
+    adu = response({0x01, 0x03, 0xCD, 0x6B, 0x05});
+    codec::put_u16(&adu[MBAP_HDR_LENGTH], 5);
+    std::vector<bool> bits;
+    CHECK(codec::decode_read_bits_response(adu.data(), adu.size(), 0x01, 19, bits) == error_code_t::LENGTH_CONSTRAINT_FAILURE);
+    CHECK(bits.empty());
+
+    // a response longer than the MBAP length is fine, the rest is ignored
+    adu = response({0x04, 0x02, 0x00, 0x0A});
+    adu.push_back(0xFF);
+    CHECK(codec::read_response_data(adu.data(), adu.size(), 0x04, 2, error) == &adu[codec::HEADER_SIZE + 2]);
+    CHECK(error == error_code_t::NO_ERROR);
+}
@@ -0,0 +1,106 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zmq/zmq.hpp"
+
+#include "bennu/devices/field-device/DataManager.hpp"
+#include "bennu/devices/modules/io/OutputModule.hpp"
+#include "bennu/distributed/Utils.hpp"
+
+using namespace bennu;
+
+TEST_CASE("testing output module -- delayed WRITE retry races a newer write")
+{
+    const std::string endpoint("tcp://127.0.0.1:5995");
+    std::mutex mutex;
+    std::vector<std::string> received; // WRITE bodies in the order the provider saw them
+    std::atomic<bool> running(true);
+
+    // Provider that sits on the first WRITE past the client timeout (so it
+    // is retried) and only then answers it, as a slow or busy worker would
+    zmq::socket_t router(distributed::Context::the()->getContext(), ZMQ_ROUTER);
+    router.bind(endpoint);
+    std::thread provider([&]() {
+        std::vector<std::vector<zmq::message_t>> held;
+        auto release = std::chrono::steady_clock::now() + std::chrono::milliseconds(1500);
+        while (running)
+        {
+            zmq::pollitem_t items[] = { { router, 0, ZMQ_POLLIN, 0 } };
+            zmq::poll(&items[0], 1, 10);
+            if (items[0].revents & ZMQ_POLLIN)
+            {
+                // [identity][request id][empty][body]
+                std::vector<zmq::message_t> parts(1);
+                router.recv(&parts.back());
+                while (parts.back().more())
+                {
+                    parts.emplace_back();
+                    router.recv(&parts.back());
+                }
+                {
+                    std::scoped_lock<std::mutex> lock(mutex);
+                    received.emplace_back(parts.back().data<char>());
+                }
+                held.push_back(std::move(parts));
+            }
+            if (std::chrono::steady_clock::now() < release)
+            {
+                continue;
+            }
+            for (auto& parts : held)
+            {
+                zmq::message_t ack(std::string("ACK=Wrote point(s)") + '\0');
+                router.send(parts[0], ZMQ_SNDMORE);
+                router.send(parts[1], ZMQ_SNDMORE);
+                router.send(parts[2], ZMQ_SNDMORE);
+                router.send(ack);
+            }
+            held.clear();
+        }
+    });
+
+    auto dm = std::make_shared<field_device::DataManager>();
+    dm->addExternalData<double>("setpoint", "load.mw_setpoint");
+    dm->addTagToPointMapping("load-mw-setpoint", "setpoint");
+
+    {
+        io::OutputModule output;
+        output.setDataManager(dm);
+        output.start(distributed::Endpoint{endpoint});
+
+        // first scan's WRITE goes out and is held by the provider
+        dm->addUpdatedAnalogTag("load-mw-setpoint", 1);
+        output.scanOutputs();
+        dm->clearUpdatedTags();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        // newer scans while the first WRITE is still waiting to be retried
+        dm->addUpdatedAnalogTag("load-mw-setpoint", 2);
+        output.scanOutputs();
+        dm->clearUpdatedTags();
+        dm->addUpdatedAnalogTag("load-mw-setpoint", 3);
+        output.scanOutputs();
+        dm->clearUpdatedTags();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    }
+    running = false;
+    provider.join();
+    router.close();
+
+    std::scoped_lock<std::mutex> lock(mutex);
+    const std::string first("WRITE=load.mw_setpoint:" + std::to_string(1.0));
+    const std::string last("WRITE=load.mw_setpoint:" + std::to_string(3.0));
+    // the original and its retry, then the two newer scans merged into one WRITE
+    REQUIRE(received.size() == 3);
+    CHECK(received[0] == first);
+    CHECK(received[1] == first);
+    CHECK(received[2] == last);
+}
@@ -0,0 +1,157 @@
+#include "doctest.h"
+
+#include <string>
+#include <vector>
+
+#include "bennu/devices/modules/comms/modbus/module/ReadPlanner.hpp"
+
+using namespace bennu::comms;
+using namespace bennu::comms::modbus;
+
+namespace {
+
+RegisterDescriptor reg(RegisterType type, std::uint16_t address, const std::string& tag = "")
+{
+    RegisterDescriptor rd;
+    rd.mRegisterType = type;
+    rd.mRegisterAddress = address;
+    rd.mTag = tag.empty() ? "tag" + std::to_string(address) : tag;
+    return rd;
+}
+
+std::vector<std::uint16_t> addresses(const ReadBlock& block)
+{
+    std::vector<std::uint16_t> result;
+    for (const auto& rd : block.mRegisters)
+    {
+        result.push_back(rd.mRegisterAddress);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("testing read planner -- contiguous and gapped registers")
+{
+    ReadPlanner planner(5);
+    // unconfigured 1..5 and 7..10 are within the gap, 12..17 is not
+    auto blocks = planner.plan({reg(eValueReadWrite, 18), reg(eValueReadWrite, 0), reg(eValueReadWrite, 6), reg(eValueReadWrite, 11)});
+    REQUIRE(blocks.size() == 2);
+    CHECK(blocks[0].mStart == 0);
+    CHECK(blocks[0].mCount == 12);
+    CHECK(addresses(blocks[0]) == std::vector<std::uint16_t>{0, 6, 11});
+    CHECK(blocks[1].mStart == 18);
+    CHECK(blocks[1].mCount == 1);
+
+    // one block per type, and types that can't be read are left out
+    blocks = planner.plan({reg(eStatusReadWrite, 1), reg(eValueReadOnly, 1), reg(eIntReadOnly, 1), reg(eStatusReadWrite, 2)});
+    REQUIRE(blocks.size() == 2);
+    CHECK(blocks[0].mRegisterType == eStatusReadWrite);
+    CHECK(blocks[0].mCount == 2);
+    CHECK(blocks[1].mRegisterType == eValueReadOnly);
+    CHECK(blocks[1].mCount == 1);
+}
+
+TEST_CASE("testing read planner -- tags sharing an address")
+{
+    ReadPlanner planner;
+    auto blocks = planner.plan({reg(eStatusReadOnly, 10, "a"), reg(eStatusReadOnly, 11, "c"), reg(eStatusReadOnly, 10, "b")});
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0].mStart == 10);
+    CHECK(blocks[0].mCount == 2);
+    REQUIRE(blocks[0].mRegisters.size() == 3);
+    // stable: tags of one address keep their configured order
+    CHECK(blocks[0].mRegisters[0].mTag == "a");
+    CHECK(blocks[0].mRegisters[1].mTag == "b");
+    CHECK(blocks[0].mRegisters[2].mTag == "c");
+
+    // a single address can't be split, however many tags read it
+    ReadBlock first, second;
+    ReadBlock single{eStatusReadOnly, 10, 1, {reg(eStatusReadOnly, 10, "a"), reg(eStatusReadOnly, 10, "b")}};
+    CHECK_FALSE(ReadPlanner::split(single, first, second));
+
+    // halving never separates tags of one address
+    ReadBlock pairs{eStatusReadOnly, 10, 2, {reg(eStatusReadOnly, 10, "a"), reg(eStatusReadOnly, 10, "b"), reg(eStatusReadOnly, 10, "c"), reg(eStatusReadOnly, 11, "d")}};
+    REQUIRE(ReadPlanner::split(pairs, first, second));
+    CHECK(addresses(first) == std::vector<std::uint16_t>{10, 10, 10});
+    CHECK(first.mCount == 1);
+    CHECK(addresses(second) == std::vector<std::uint16_t>{11});
+    CHECK(second.mStart == 11);
+}
+
+TEST_CASE("testing read planner -- split at the widest gap, else halve")
+{
+    ReadPlanner planner(100);
+    auto blocks = planner.plan({reg(eValueReadOnly, 0), reg(eValueReadOnly, 1), reg(eValueReadOnly, 5), reg(eValueReadOnly, 50), reg(eValueReadOnly, 51)});
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0].mCount == 52);
+
+    ReadBlock first, second;
+    REQUIRE(ReadPlanner::split(blocks[0], first, second));
+    CHECK(first.mRegisterType == eValueReadOnly);
+    CHECK(first.mStart == 0);
+    CHECK(first.mCount == 6);
+    CHECK(second.mStart == 50);
+    CHECK(second.mCount == 2);
+
+    // no hole left: halving fallback
+    ReadBlock left, right;
+    REQUIRE(ReadPlanner::split(second, left, right));
+    CHECK(left.mStart == 50);
+    CHECK(left.mCount == 1);
+    CHECK(right.mStart == 51);
+    CHECK(right.mCount == 1);
+
+    std::vector<RegisterDescriptor> contiguous;
+    for (std::uint16_t i = 0; i < 8; ++i)
+    {
+        contiguous.push_back(reg(eValueReadOnly, i));
+    }
+    blocks = planner.plan(contiguous);
+    REQUIRE(blocks.size() == 1);
+    REQUIRE(ReadPlanner::split(blocks[0], first, second));
+    CHECK(first.mStart == 0);
+    CHECK(first.mCount == 4);
+    CHECK(second.mStart == 4);
+    CHECK(second.mCount == 4);
+}
+
+TEST_CASE("testing read planner -- spec limits across a gap")
+{
+    ReadPlanner planner(3000);
+    CHECK(ReadPlanner::maxCount(eStatusReadWrite) == 2000);
+    CHECK(ReadPlanner::maxCount(eStatusReadOnly) == 2000);
+    CHECK(ReadPlanner::maxCount(eValueReadWrite) == 125);
+    CHECK(ReadPlanner::maxCount(eValueReadOnly) == 125);
+
+    // the gap alone would allow it, the request quantity limit does not
+    auto blocks = planner.plan({reg(eStatusReadWrite, 0), reg(eStatusReadWrite, 1999)});
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0].mCount == 2000);
+    blocks = planner.plan({reg(eStatusReadWrite, 0), reg(eStatusReadWrite, 2000)});
+    REQUIRE(blocks.size() == 2);
+    CHECK(blocks[0].mCount == 1);
+    CHECK(blocks[1].mStart == 2000);
+
+    blocks = planner.plan({reg(eValueReadWrite, 100), reg(eValueReadWrite, 224)});
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0].mCount == 125);
+    blocks = planner.plan({reg(eValueReadWrite, 100), reg(eValueReadWrite, 200), reg(eValueReadWrite, 225)});
+    REQUIRE(blocks.size() == 2);
+    CHECK(blocks[0].mCount == 101);
+    CHECK(blocks[1].mStart == 225);
+
+    // a block ending at the top of the address space
+    blocks = planner.plan({reg(eValueReadOnly, 65500), reg(eValueReadOnly, 65535)});
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0].mStart == 65500);
+    CHECK(blocks[0].mCount == 36);
+}
+
+TEST_CASE("testing read planner -- refused reads")
+{
+    CHECK(ReadPlanner::refused(MB_ILLEGAL_DATA_ADDRESS));
+    CHECK(ReadPlanner::refused(MB_ILLEGAL_DATA_VALUE));
+    CHECK_FALSE(ReadPlanner::refused(MB_ILLEGAL_FUNCTION));
+    CHECK_FALSE(ReadPlanner::refused(MB_SLAVE_DEVICE_FAILURE));
+}
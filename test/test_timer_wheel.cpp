@@ -0,0 +1,150 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <vector>
+
+#include "bennu/devices/modules/logic/TimerWheel.hpp"
+
+using namespace bennu::logic;
+using std::chrono::milliseconds;
+
+namespace {
+
+typedef std::vector<std::size_t> ids_t;
+
+// Ids expired by advancing 'wheel' to 't'
+ids_t advance(TimerWheel& wheel, const TimerWheel::Clock::time_point& t)
+{
+    ids_t expired;
+    wheel.advance(t, expired);
+    return expired;
+}
+
+} // namespace
+
+TEST_CASE("testing timer wheel -- delays on level boundaries")
+{
+    // 64 ms and 4096 ms are where a delay moves to the next level, 262144 ms the top one
+    for (long delay : {1L, 63L, 64L, 65L, 127L, 128L, 4095L, 4096L, 4097L, 262143L, 262144L, 262145L})
+    {
+        // from the start of a block and from partway into one
+        for (long offset : {0L, 37L, 4090L})
+        {
+            INFO("delay " << delay << " ms armed at " << offset << " ms");
+            TimerWheel wheel(1);
+            auto start = TimerWheel::Clock::now();
+            CHECK(advance(wheel, start + milliseconds(offset)).empty());
+
+            auto armed = start + milliseconds(offset);
+            wheel.arm(0, milliseconds(delay), armed);
+            CHECK(wheel.remaining(0, armed) == milliseconds(delay));
+            CHECK(advance(wheel, armed + milliseconds(delay - 1)).empty());
+            CHECK(wheel.armed(0));
+            CHECK(advance(wheel, armed + milliseconds(delay)) == ids_t{0});
+            CHECK_FALSE(wheel.armed(0));
+            CHECK(wheel.size() == 0);
+        }
+    }
+
+    // stepping every millisecond across the boundaries cascades the same way as jumping
+    TimerWheel wheel(3);
+    auto start = TimerWheel::Clock::now();
+    wheel.arm(0, milliseconds(64), start);
+    wheel.arm(1, milliseconds(4096), start);
+    wheel.arm(2, milliseconds(4160), start);
+    std::vector<long> fired(3, -1);
+    for (long t = 1; t <= 4200; ++t)
+    {
+        for (auto id : advance(wheel, start + milliseconds(t)))
+        {
+            CHECK(fired[id] == -1);
+            fired[id] = t;
+        }
+    }
+    CHECK(fired == std::vector<long>{64, 4096, 4160});
+}
+
+TEST_CASE("testing timer wheel -- delays past the wheel's range")
+{
+    // parked in the top level and re-cascaded until due (the range is 2^24 ms)
+    TimerWheel wheel(1);
+    auto start = TimerWheel::Clock::now();
+    const long delay = (1L << 24) + 5000;
+    wheel.arm(0, milliseconds(delay), start);
+    CHECK(advance(wheel, start + milliseconds(1L << 24)).empty());
+    CHECK(advance(wheel, start + milliseconds(delay - 1)).empty());
+    CHECK(advance(wheel, start + milliseconds(delay)) == ids_t{0});
+}
+
+TEST_CASE("testing timer wheel -- cancelling")
+{
+    TimerWheel wheel(4);
+    auto start = TimerWheel::Clock::now();
+
+    // three timers in one slot: cancel the middle one, then the head of what is left
+    wheel.arm(0, milliseconds(100), start);
+    wheel.arm(1, milliseconds(100), start);
+    wheel.arm(2, milliseconds(100), start);
+    wheel.arm(3, milliseconds(5000), start);
+    CHECK(wheel.size() == 4);
+    wheel.cancel(1);
+    CHECK_FALSE(wheel.armed(1));
+    CHECK(wheel.remaining(1, start) == milliseconds(0));
+    wheel.cancel(2);
+    wheel.cancel(2); // not armed any more
+    CHECK(wheel.size() == 2);
+    CHECK(advance(wheel, start + milliseconds(100)) == ids_t{0});
+
+    // a timer cancelled after cascading down from a higher level
+    CHECK(advance(wheel, start + milliseconds(4999)).empty());
+    CHECK(wheel.armed(3));
+    wheel.cancel(3);
+    CHECK(wheel.size() == 0);
+    CHECK(advance(wheel, start + milliseconds(10000)).empty());
+
+    // ids never armed
+    wheel.cancel(7);
+    CHECK_FALSE(wheel.armed(7));
+}
+
+TEST_CASE("testing timer wheel -- re-arming")
+{
+    TimerWheel wheel(2);
+    auto start = TimerWheel::Clock::now();
+
+    // sooner: fires once, at the new expiry only
+    wheel.arm(0, milliseconds(4096), start);
+    wheel.arm(0, milliseconds(10), start);
+    CHECK(wheel.size() == 1);
+    CHECK(advance(wheel, start + milliseconds(10)) == ids_t{0});
+    CHECK(advance(wheel, start + milliseconds(5000)).empty());
+
+    // later, from another level
+    auto now = start + milliseconds(5000);
+    wheel.arm(1, milliseconds(10), now);
+    wheel.arm(1, milliseconds(5000), now);
+    CHECK(wheel.remaining(1, now) == milliseconds(5000));
+    CHECK(advance(wheel, now + milliseconds(4999)).empty());
+    CHECK(advance(wheel, now + milliseconds(5000)) == ids_t{1});
+
+    // cancelling after a re-arm removes the timer from its new slot
+    now += milliseconds(5000);
+    wheel.arm(0, milliseconds(64), now);
+    wheel.arm(0, milliseconds(4096), now);
+    wheel.cancel(0);
+    CHECK(wheel.size() == 0);
+    CHECK_FALSE(wheel.armed(0));
+    CHECK(advance(wheel, now + milliseconds(10000)).empty());
+
+    // re-armed from its own expiry
+    now += milliseconds(10000);
+    wheel.arm(0, milliseconds(64), now);
+    CHECK(advance(wheel, now + milliseconds(64)) == ids_t{0});
+    wheel.arm(0, milliseconds(64), now + milliseconds(64));
+    CHECK(advance(wheel, now + milliseconds(127)).empty());
+    CHECK(advance(wheel, now + milliseconds(128)) == ids_t{0});
+
+    // a delay that has already passed expires on the next tick
+    wheel.arm(1, milliseconds(0), now + milliseconds(128));
+    CHECK(advance(wheel, now + milliseconds(129)) == ids_t{1});
+}